@@ -0,0 +1,168 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import "Ed25519.h"
+#import <SignalCoreKit/NSData+OWS.h>
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+typedef struct curve25519_verify_ctx curve25519_verify_ctx;
+
+extern int curve25519_verify(const unsigned char *signature,
+    const unsigned char *curve25519_pubkey,
+    const unsigned char *msg,
+    const unsigned long msg_len);
+extern curve25519_verify_ctx *curve25519_verify_ctx_init(const unsigned char *curve25519_pubkey);
+extern void curve25519_verify_ctx_free(curve25519_verify_ctx *ctx);
+extern int curve25519_verify_with_ctx(const curve25519_verify_ctx *ctx,
+    const unsigned char *signature,
+    const unsigned char *msg,
+    const unsigned long msg_len);
+
+@interface BatchVerifyTests : XCTestCase
+
+@property (nonatomic) NSMutableArray<NSData *> *signatures;
+@property (nonatomic) NSMutableArray<NSData *> *publicKeys;
+@property (nonatomic) NSMutableArray<NSData *> *messages;
+
+@end
+
+@implementation BatchVerifyTests
+
+- (void)signCount:(NSUInteger)count
+{
+    self.signatures = [NSMutableArray new];
+    self.publicKeys = [NSMutableArray new];
+    self.messages = [NSMutableArray new];
+    for (NSUInteger i = 0; i < count; i++) {
+        ECKeyPair *key = [Curve25519 generateKeyPair];
+        NSData *data = [Randomness generateRandomBytes:(int)(1 + i % 200)];
+        [self.signatures addObject:[Ed25519 throws_sign:data withKeyPair:key]];
+        [self.publicKeys addObject:key.publicKey];
+        [self.messages addObject:data];
+    }
+}
+
+- (NSArray<NSNumber *> *)verifyBatch
+{
+    return [Ed25519 throws_verifySignatures:self.signatures publicKeys:self.publicKeys data:self.messages];
+}
+
+- (void)testAllValid
+{
+    for (NSUInteger count = 0; count < 80; count += 7) {
+        [self signCount:count];
+        NSArray<NSNumber *> *results = [self verifyBatch];
+        XCTAssertEqual(results.count, count);
+        for (NSNumber *result in results) {
+            XCTAssertTrue(result.boolValue);
+        }
+    }
+}
+
+- (void)testInvalidSignaturesAreLocated
+{
+    [self signCount:100];
+
+    NSMutableData *signature = [self.signatures[3] mutableCopy];
+    ((uint8_t *)signature.mutableBytes)[10] ^= 1;
+    self.signatures[3] = signature;
+
+    signature = [self.signatures[70] mutableCopy];
+    ((uint8_t *)signature.mutableBytes)[40] ^= 0x80;
+    self.signatures[70] = signature;
+
+    self.messages[42] = [Randomness generateRandomBytes:32];
+    self.publicKeys[97] = self.publicKeys[96];
+
+    NSArray<NSNumber *> *results = [self verifyBatch];
+    for (NSUInteger i = 0; i < results.count; i++) {
+        BOOL expected = [Ed25519 throws_verifySignature:self.signatures[i]
+                                              publicKey:self.publicKeys[i]
+                                                   data:self.messages[i]];
+        XCTAssertEqual(results[i].boolValue, expected, @"Mismatch at index %lu", (unsigned long)i);
+        XCTAssertEqual(expected, i != 3 && i != 42 && i != 70 && i != 97);
+    }
+}
+
+// A signer who knows the private key can publish R = r*B + T, with T the point of order 2 and
+// S = r + h*a. R then differs from S*B - h*A by T: single verification rejects it, while the
+// cofactored batch accepts it for every choice of random coefficients, not for about half of them.
+- (void)testSmallOrderComponentInR
+{
+    NSData *publicKey = [NSData dataFromHexString:@"5e9d342b7ca9dd7483c1617c8d07c3e99bff21c855a89951e548c85df975b94d"];
+    NSData *signature = [NSData dataFromHexString:@"1143c7a1cc29587a2625f4f835d996670f98cfe5045548b9d12e3c4c51ac5972"
+                                                   @"a4667cd9e9a96ffb65c48e4ffa3c8b8e8d2a8730bfcf5ef3f789952d4f4d1c0f"];
+    NSData *message = [@"malicious signer" dataUsingEncoding:NSUTF8StringEncoding];
+
+    XCTAssertNotEqual(curve25519_verify(signature.bytes, publicKey.bytes, message.bytes, message.length), 0);
+
+    curve25519_verify_ctx *ctx = curve25519_verify_ctx_init(publicKey.bytes);
+    XCTAssertNotEqual(curve25519_verify_with_ctx(ctx, signature.bytes, message.bytes, message.length), 0);
+    curve25519_verify_ctx_free(ctx);
+
+    XCTAssertFalse([Ed25519 throws_verifySignature:signature publicKey:publicKey data:message]);
+
+    // Each batch call draws fresh coefficients; pair the item with an honest one so the
+    // combination, not the single-item path, decides.
+    [self signCount:1];
+    [self.signatures addObject:signature];
+    [self.publicKeys addObject:publicKey];
+    [self.messages addObject:message];
+    for (int i = 0; i < 400; i++) {
+        NSArray<NSNumber *> *results = [self verifyBatch];
+        XCTAssertTrue(results[0].boolValue);
+        XCTAssertTrue(results[1].boolValue, @"Mismatch on round %d", i);
+    }
+}
+
+- (void)testMismatchedCountsThrow
+{
+    [self signCount:3];
+    [self.messages removeLastObject];
+
+    NSError *error;
+    XCTAssertNil([Ed25519 verifySignatures:self.signatures publicKeys:self.publicKeys data:self.messages error:&error]);
+    XCTAssertNotNil(error);
+}
+
+- (void)measureBatchVerifyWithCount:(NSUInteger)count
+{
+    [self signCount:count];
+
+    [self measureBlock:^{
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            [Ed25519 throws_verifySignature:self.signatures[i] publicKey:self.publicKeys[i] data:self.messages[i]];
+        }
+        CFAbsoluteTime single = CFAbsoluteTimeGetCurrent() - start;
+
+        start = CFAbsoluteTimeGetCurrent();
+        [self verifyBatch];
+        CFAbsoluteTime batch = CFAbsoluteTimeGetCurrent() - start;
+
+        NSLog(@"batch of %lu: %.0f us/sig single, %.0f us/sig batched",
+            (unsigned long)count,
+            single * 1e6 / count,
+            batch * 1e6 / count);
+    }];
+}
+
+- (void)testBatchVerifyPerformance16
+{
+    [self measureBatchVerifyWithCount:16];
+}
+
+- (void)testBatchVerifyPerformance64
+{
+    [self measureBatchVerifyWithCount:64];
+}
+
+- (void)testBatchVerifyPerformance256
+{
+    [self measureBatchVerifyWithCount:256];
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import <SignalCoreKit/NSData+OWS.h>
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+extern int curve25519_donna(unsigned char *output, const unsigned char *a, const unsigned char *b);
+extern int curve25519_donna_portable(unsigned char *output, const unsigned char *a, const unsigned char *b);
+
+@interface Curve25519DonnaTests : XCTestCase
+
+@end
+
+@implementation Curve25519DonnaTests
+
+// RFC 7748, section 5.2
+- (void)testRFC7748Vectors
+{
+    NSData *scalar = [NSData dataFromHexString:@"a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4"];
+    NSData *point = [NSData dataFromHexString:@"e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c"];
+    NSData *expected = [NSData dataFromHexString:@"c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552"];
+
+    uint8_t output[32];
+    curve25519_donna(output, scalar.bytes, point.bytes);
+    XCTAssertEqualObjects([NSData dataWithBytes:output length:32], expected);
+
+    uint8_t k[32] = { 9 };
+    uint8_t u[32] = { 9 };
+    for (int i = 0; i < 1000; i++) {
+        curve25519_donna(output, k, u);
+        memcpy(u, k, 32);
+        memcpy(k, output, 32);
+    }
+    expected = [NSData dataFromHexString:@"684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51"];
+    XCTAssertEqualObjects([NSData dataWithBytes:k length:32], expected);
+}
+
+// The 64-bit backend must agree with the portable 10-limb code, including
+// for points that are not reduced mod 2^255 - 19.
+- (void)testMatchesPortableImplementation
+{
+    for (int i = 0; i < 2000; i++) {
+        NSData *scalar = [Randomness generateRandomBytes:32];
+        NSMutableData *point = [[Randomness generateRandomBytes:32] mutableCopy];
+        if (i % 4 == 0) {
+            memset(point.mutableBytes, 0xff, 32);
+            ((uint8_t *)point.mutableBytes)[0] = (uint8_t)(0xed + i % 0x13);
+        }
+
+        uint8_t fast[32], portable[32];
+        curve25519_donna(fast, scalar.bytes, point.bytes);
+        curve25519_donna_portable(portable, scalar.bytes, point.bytes);
+
+        if (memcmp(fast, portable, 32) != 0) {
+            XCTAssert(false, @"Backends disagree for scalar %@ and point %@", scalar, point);
+            return;
+        }
+    }
+}
+
+- (void)testScalarMultPerformance
+{
+    const int count = 1000;
+    static const uint8_t basepoint[32] = { 9 };
+    NSMutableData *scalar = [[Randomness generateRandomBytes:32] mutableCopy];
+
+    [self measureBlock:^{
+        uint8_t output[32];
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < count; i++) {
+            ((uint8_t *)scalar.mutableBytes)[0] = (uint8_t)i;
+            curve25519_donna(output, scalar.bytes, basepoint);
+        }
+        NSLog(@"curve25519_donna: %.0f scalar mults/sec", count / (CFAbsoluteTimeGetCurrent() - start));
+    }];
+}
+
+@end
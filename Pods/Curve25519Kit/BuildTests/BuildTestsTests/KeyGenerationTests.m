@@ -0,0 +1,98 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import "Ed25519.h"
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+extern int curve25519_donna(unsigned char *output, const unsigned char *a, const unsigned char *b);
+extern void curve25519_keygen(unsigned char *curve25519_pubkey_out, const unsigned char *curve25519_privkey_in);
+extern void curve25519_keygen_batch(unsigned char *curve25519_pubkeys_out,
+    const unsigned char *curve25519_privkeys_in,
+    unsigned long count);
+
+@interface KeyGenerationTests : XCTestCase
+
+@end
+
+@implementation KeyGenerationTests
+
+- (void)testBatchMatchesDonna
+{
+    static const uint8_t basepoint[32] = { 9 };
+
+    for (NSUInteger count = 0; count < 150; count = count * 2 + 1) {
+        NSArray<ECKeyPair *> *keyPairs = [Curve25519 generateKeyPairs:count];
+        XCTAssertEqual(keyPairs.count, count);
+
+        for (ECKeyPair *keyPair in keyPairs) {
+            uint8_t expected[32];
+            curve25519_donna(expected, keyPair.privateKey.bytes, basepoint);
+            XCTAssertEqualObjects(keyPair.publicKey, [NSData dataWithBytes:expected length:32]);
+        }
+    }
+}
+
+// Scalars that are not clamped, including 0 and the group order, whose
+// public key is the u=0 that curve25519_keygen gives.
+- (void)testBatchMatchesKeygenForEdgeScalars
+{
+    static const uint8_t order[32] = { 0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde,
+        0xf9, 0xde, 0x14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10 };
+    const int count = 40;
+    uint8_t privateKeys[count][32];
+    uint8_t publicKeys[count][32];
+
+    for (int i = 0; i < count; i++) {
+        memcpy(privateKeys[i], [Randomness generateRandomBytes:32].bytes, 32);
+        privateKeys[i][31] &= 127;
+    }
+    memset(privateKeys[0], 0, 32);
+    memcpy(privateKeys[1], order, 32);
+    memset(privateKeys[2], 0, 32);
+    privateKeys[2][0] = 1;
+    memset(privateKeys[3], 0xff, 31);
+    privateKeys[3][31] = 0x7f;
+
+    curve25519_keygen_batch(publicKeys[0], privateKeys[0], count);
+    for (int i = 0; i < count; i++) {
+        uint8_t expected[32];
+        curve25519_keygen(expected, privateKeys[i]);
+        XCTAssertEqual(memcmp(publicKeys[i], expected, 32), 0, @"Mismatch at index %d", i);
+    }
+}
+
+- (void)testBatchKeysSign
+{
+    for (ECKeyPair *keyPair in [Curve25519 generateKeyPairs:10]) {
+        NSData *data = [Randomness generateRandomBytes:32];
+        NSData *signature = [Ed25519 throws_sign:data withKeyPair:keyPair];
+        XCTAssertTrue([Ed25519 throws_verifySignature:signature publicKey:keyPair.publicKey data:data]);
+    }
+}
+
+- (void)testKeyGenerationPerformance
+{
+    const NSUInteger count = 100;
+
+    [self measureBlock:^{
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            [Curve25519 generateKeyPair];
+        }
+        CFAbsoluteTime single = CFAbsoluteTimeGetCurrent() - start;
+
+        start = CFAbsoluteTimeGetCurrent();
+        [Curve25519 generateKeyPairs:count];
+        CFAbsoluteTime batch = CFAbsoluteTimeGetCurrent() - start;
+
+        NSLog(@"key generation: %.0f keys/sec one at a time, %.0f keys/sec in a batch of %lu",
+            count / single,
+            count / batch,
+            (unsigned long)count);
+    }];
+}
+
+@end
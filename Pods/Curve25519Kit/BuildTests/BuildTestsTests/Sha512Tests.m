@@ -0,0 +1,80 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import "Ed25519.h"
+#import <SignalCoreKit/NSData+OWS.h>
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+typedef struct {
+    unsigned char h[64];
+    unsigned char buf[128];
+    unsigned long long bytes;
+} crypto_hash_sha512_state;
+
+extern int crypto_hash_sha512(unsigned char *out, const unsigned char *in, unsigned long long inlen);
+extern int crypto_hash_sha512_init(crypto_hash_sha512_state *state);
+extern int crypto_hash_sha512_update(crypto_hash_sha512_state *state, const unsigned char *in, unsigned long long inlen);
+extern int crypto_hash_sha512_final(crypto_hash_sha512_state *state, unsigned char *out);
+
+@interface Sha512Tests : XCTestCase
+
+@end
+
+@implementation Sha512Tests
+
+// FIPS 180-2, appendix C
+- (void)testKnownAnswers
+{
+    uint8_t digest[64];
+
+    crypto_hash_sha512(digest, (const unsigned char *)"abc", 3);
+    XCTAssertEqualObjects([NSData dataWithBytes:digest length:64],
+        [NSData dataFromHexString:@"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                                   @"2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"]);
+
+    const char *message = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+    crypto_hash_sha512(digest, (const unsigned char *)message, strlen(message));
+    XCTAssertEqualObjects([NSData dataWithBytes:digest length:64],
+        [NSData dataFromHexString:@"8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+                                   @"501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"]);
+}
+
+// Any way of splitting the input must give the one-shot digest.
+- (void)testStreamingMatchesOneShot
+{
+    NSData *data = [Randomness generateRandomBytes:5000];
+
+    for (int i = 0; i < 300; i++) {
+        NSUInteger length = arc4random_uniform((uint32_t)data.length);
+        uint8_t expected[64], actual[64];
+        crypto_hash_sha512(expected, data.bytes, length);
+
+        crypto_hash_sha512_state state;
+        crypto_hash_sha512_init(&state);
+        NSUInteger offset = 0;
+        while (offset < length) {
+            NSUInteger piece = MIN(arc4random_uniform(i % 2 ? 7 : 400), length - offset);
+            crypto_hash_sha512_update(&state, (const uint8_t *)data.bytes + offset, piece);
+            offset += piece;
+        }
+        crypto_hash_sha512_final(&state, actual);
+
+        XCTAssertEqual(memcmp(expected, actual, 64), 0, @"Mismatch for length %lu", (unsigned long)length);
+    }
+}
+
+- (void)testLargeMessageSigningPerformance
+{
+    ECKeyPair *key = [Curve25519 generateKeyPair];
+    NSData *data = [Randomness generateRandomBytes:1024 * 1024];
+
+    [self measureBlock:^{
+        NSData *signature = [Ed25519 throws_sign:data withKeyPair:key];
+        XCTAssertTrue([Ed25519 throws_verifySignature:signature publicKey:key.publicKey data:data]);
+    }];
+}
+
+@end
@@ -0,0 +1,121 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import "Ed25519.h"
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+typedef struct curve25519_verify_ctx curve25519_verify_ctx;
+
+extern int curve25519_verify(const unsigned char *signature,
+    const unsigned char *curve25519_pubkey,
+    const unsigned char *msg,
+    const unsigned long msg_len);
+extern curve25519_verify_ctx *curve25519_verify_ctx_init(const unsigned char *curve25519_pubkey);
+extern void curve25519_verify_ctx_free(curve25519_verify_ctx *ctx);
+extern int curve25519_verify_with_ctx(const curve25519_verify_ctx *ctx,
+    const unsigned char *signature,
+    const unsigned char *msg,
+    const unsigned long msg_len);
+
+@interface VerifyContextTests : XCTestCase
+
+@end
+
+@implementation VerifyContextTests
+
+// Every kind of corruption must give the same answer as curve25519_verify,
+// including a flipped sign bit and the key u = -1.
+- (void)testMatchesVerify
+{
+    for (int i = 0; i < 800; i++) {
+        ECKeyPair *key = [Curve25519 generateKeyPair];
+        NSMutableData *data = [[Randomness generateRandomBytes:1 + i % 100] mutableCopy];
+        NSMutableData *signature = [[Ed25519 throws_sign:data withKeyPair:key] mutableCopy];
+        NSMutableData *publicKey = [key.publicKey mutableCopy];
+        uint8_t *sigBytes = signature.mutableBytes;
+        uint8_t *keyBytes = publicKey.mutableBytes;
+
+        switch (i % 8) {
+            case 1:
+                sigBytes[5] ^= 1;
+                break;
+            case 2:
+                ((uint8_t *)data.mutableBytes)[0] ^= 1;
+                break;
+            case 3:
+                keyBytes[3] ^= 4;
+                break;
+            case 4:
+                sigBytes[40] ^= 1;
+                break;
+            case 5:
+                sigBytes[63] ^= 0x80;
+                break;
+            case 6:
+                memset(keyBytes, 0xff, 32);
+                keyBytes[0] = 0xec;
+                keyBytes[31] = 0x7f;
+                break;
+            case 7:
+                sigBytes[63] |= 0x40;
+                break;
+        }
+
+        curve25519_verify_ctx *ctx = curve25519_verify_ctx_init(keyBytes);
+        XCTAssert(ctx != NULL);
+        int expected = curve25519_verify(sigBytes, keyBytes, data.bytes, data.length);
+        int actual = curve25519_verify_with_ctx(ctx, sigBytes, data.bytes, data.length);
+        curve25519_verify_ctx_free(ctx);
+
+        XCTAssertEqual(actual, expected, @"Mismatch for case %d", i % 8);
+        if (i % 8 == 0) {
+            XCTAssertEqual(actual, 0);
+        }
+    }
+}
+
+// More keys than the context cache holds.
+- (void)testManyKeys
+{
+    for (int i = 0; i < 200; i++) {
+        ECKeyPair *key = [Curve25519 generateKeyPair];
+        NSData *data = [Randomness generateRandomBytes:32];
+        NSData *signature = [Ed25519 throws_sign:data withKeyPair:key];
+        XCTAssertTrue([Ed25519 throws_verifySignature:signature publicKey:key.publicKey data:data]);
+        XCTAssertFalse([Ed25519 throws_verifySignature:signature
+                                             publicKey:key.publicKey
+                                                  data:[Randomness generateRandomBytes:32]]);
+    }
+}
+
+- (void)testRepeatedKeyPerformance
+{
+    const int count = 1000;
+    ECKeyPair *key = [Curve25519 generateKeyPair];
+    NSData *data = [Randomness generateRandomBytes:32];
+    NSData *signature = [Ed25519 throws_sign:data withKeyPair:key];
+    curve25519_verify_ctx *ctx = curve25519_verify_ctx_init(key.publicKey.bytes);
+
+    [self measureBlock:^{
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < count; i++) {
+            curve25519_verify(signature.bytes, key.publicKey.bytes, data.bytes, data.length);
+        }
+        CFAbsoluteTime plain = CFAbsoluteTimeGetCurrent() - start;
+
+        start = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < count; i++) {
+            curve25519_verify_with_ctx(ctx, signature.bytes, data.bytes, data.length);
+        }
+        CFAbsoluteTime cached = CFAbsoluteTimeGetCurrent() - start;
+
+        NSLog(@"verify: %.0f us plain, %.0f us with context", plain * 1e6 / count, cached * 1e6 / count);
+    }];
+
+    curve25519_verify_ctx_free(ctx);
+}
+
+@end
@@ -60,6 +60,16 @@ typedef NS_ERROR_ENUM(Curve25519KitErrorDomain, Curve25519KitError){
  */
 + (ECKeyPair *)generateKeyPair;
 
+/**
+ *  Generate many curve25519 key pairs at once, e.g. a batch of prekeys. Faster per key than
+ *  calling generateKeyPair repeatedly.
+ *
+ *  @param count number of key pairs to generate.
+ *
+ *  @return count curve25519 key pairs.
+ */
++ (NSArray<ECKeyPair *> *)generateKeyPairs:(NSUInteger)count;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -18,6 +18,10 @@ NSString *const TSECKeyPairPreKeyId = @"TSECKeyPairPreKeyId";
 
 extern void curve25519_donna(unsigned char *output, const unsigned char *a, const unsigned char *b);
 
+extern void curve25519_keygen_batch(unsigned char *curve25519_pubkeys_out, /* 32 * count bytes */
+    const unsigned char *curve25519_privkeys_in, /* 32 * count bytes */
+    unsigned long count);
+
 extern int curve25519_sign(unsigned char *signature_out, /* 64 bytes */
     const unsigned char *curve25519_privkey, /* 32 bytes */
     const unsigned char *msg,
@@ -151,6 +155,39 @@ extern int curve25519_sign(unsigned char *signature_out, /* 64 bytes */
     return [ECKeyPair generateKeyPair];
 }
 
++ (NSArray<ECKeyPair *> *)generateKeyPairs:(NSUInteger)count
+{
+    if (count == 0) {
+        return @[];
+    }
+
+    NSMutableData *privateKeys = [[Randomness generateRandomBytes:(int)(count * ECCKeyLength)] mutableCopy];
+    NSMutableData *publicKeys = [NSMutableData dataWithLength:count * ECCKeyLength];
+    if (!privateKeys || !publicKeys) {
+        OWSFail(@"Could not allocate buffer");
+    }
+
+    uint8_t *privateKeyBytes = privateKeys.mutableBytes;
+    for (NSUInteger i = 0; i < count; i++) {
+        privateKeyBytes[i * ECCKeyLength] &= 248;
+        privateKeyBytes[i * ECCKeyLength + 31] &= 127;
+        privateKeyBytes[i * ECCKeyLength + 31] |= 64;
+    }
+
+    curve25519_keygen_batch(publicKeys.mutableBytes, privateKeyBytes, count);
+
+    NSMutableArray<ECKeyPair *> *keyPairs = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSRange range = NSMakeRange(i * ECCKeyLength, ECCKeyLength);
+        ECKeyPair *keyPair = [[ECKeyPair alloc] initWithPublicKeyData:[publicKeys subdataWithRange:range]
+                                                       privateKeyData:[privateKeys subdataWithRange:range]
+                                                                error:nil];
+        OWSAssert(keyPair != nil);
+        [keyPairs addObject:keyPair];
+    }
+    return [keyPairs copy];
+}
+
 + (NSData *)throws_generateSharedSecretFromPublicKey:(NSData *)theirPublicKey andKeyPair:(ECKeyPair *)keyPair
 {
     if (!keyPair) {
@@ -55,6 +55,31 @@
               didVerify:(BOOL *)didVerify
                   error:(NSError **)outError NS_REFINED_FOR_SWIFT;
 
+/**
+ *  Verify many ed25519 signatures at once, which is about twice as fast per signature as
+ *  verifying them one by one. Throws an NSInvalidArgumentException on malformed input.
+ *
+ *  @param signatures ed25519 64-byte signatures.
+ *  @param publicKeys public key of the signer of each signature.
+ *  @param data       data to be checked against each signature.
+ *
+ *  Unlike throws_verifySignature:publicKey:data:, batch verification is cofactored: it accepts a
+ *  signature whose R differs from S*B - h*A by a point of small order, which only the signer can
+ *  arrange.
+ *  All other results match throws_verifySignature:publicKey:data:, whatever the batch's internal
+ *  randomness.
+ *
+ *  @return One boolean NSNumber per signature, YES if that signature is valid.
+ */
++ (NSArray<NSNumber *> *)throws_verifySignatures:(NSArray<NSData *> *)signatures
+                                      publicKeys:(NSArray<NSData *> *)publicKeys
+                                            data:(NSArray<NSData *> *)data
+    NS_SWIFT_UNAVAILABLE("throws objc exceptions");
++ (nullable NSArray<NSNumber *> *)verifySignatures:(NSArray<NSData *> *)signatures
+                                        publicKeys:(NSArray<NSData *> *)publicKeys
+                                              data:(NSArray<NSData *> *)data
+                                             error:(NSError **)outError;
+
 @end
 
 NS_ASSUME_NONNULL_END
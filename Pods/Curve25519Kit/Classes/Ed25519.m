@@ -5,6 +5,7 @@
 #import "Ed25519.h"
 #import "Curve25519.h"
 #import <SignalCoreKit/OWSAsserts.h>
+#import <SignalCoreKit/Randomness.h>
 #import <SignalCoreKit/SCKExceptionWrapper.h>
 
 NS_ASSUME_NONNULL_BEGIN
@@ -14,6 +15,56 @@ extern int curve25519_verify(const unsigned char *signature, /* 64 bytes */
     const unsigned char *msg,
     const unsigned long msg_len);
 
+extern int curve25519_verify_batch(const unsigned char *const *signatures, /* 64 bytes each */
+    const unsigned char *const *curve25519_pubkeys, /* 32 bytes each */
+    const unsigned char *const *msgs,
+    const unsigned long *msg_lens,
+    unsigned long count,
+    int *results,
+    const unsigned char *random); /* 32 bytes */
+
+typedef struct curve25519_verify_ctx curve25519_verify_ctx;
+
+extern curve25519_verify_ctx *curve25519_verify_ctx_init(const unsigned char *curve25519_pubkey); /* 32 bytes */
+extern void curve25519_verify_ctx_free(curve25519_verify_ctx *ctx);
+extern int curve25519_verify_with_ctx(const curve25519_verify_ctx *ctx,
+    const unsigned char *signature, /* 64 bytes */
+    const unsigned char *msg,
+    const unsigned long msg_len);
+
+// Identity keys are verified over and over; each cached context is about 2.6 KB.
+static const NSUInteger kVerifyContextCacheCountLimit = 64;
+
+@interface SCKVerifyContext : NSObject
+
+@property (nonatomic, readonly) curve25519_verify_ctx *ctx;
+
+@end
+
+@implementation SCKVerifyContext
+
+- (nullable instancetype)initWithPublicKey:(NSData *)publicKey
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+    _ctx = curve25519_verify_ctx_init(publicKey.bytes);
+    if (!_ctx) {
+        return nil;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    curve25519_verify_ctx_free(_ctx);
+}
+
+@end
+
+#pragma mark -
+
 @interface ECKeyPair ()
 
 - (NSData *)throws_sign:(NSData *)data;
@@ -24,6 +75,30 @@ extern int curve25519_verify(const unsigned char *signature, /* 64 bytes */
 
 @implementation Ed25519
 
++ (NSCache<NSData *, SCKVerifyContext *> *)verifyContextCache
+{
+    static NSCache<NSData *, SCKVerifyContext *> *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSCache new];
+        cache.countLimit = kVerifyContextCacheCountLimit;
+    });
+    return cache;
+}
+
++ (nullable SCKVerifyContext *)verifyContextForPublicKey:(NSData *)publicKey
+{
+    NSCache<NSData *, SCKVerifyContext *> *cache = [self verifyContextCache];
+    SCKVerifyContext *_Nullable context = [cache objectForKey:publicKey];
+    if (!context) {
+        context = [[SCKVerifyContext alloc] initWithPublicKey:publicKey];
+        if (context) {
+            [cache setObject:context forKey:[publicKey copy]];
+        }
+    }
+    return context;
+}
+
 + (nullable NSData *)sign:(NSData *)data withKeyPair:(ECKeyPair *)keyPair error:(NSError **)outError
 {
     @try {
@@ -83,10 +158,89 @@ extern int curve25519_verify(const unsigned char *signature, /* 64 bytes */
             NSInvalidArgumentException, @"Signature has unexpected length: %lu", (unsigned long)signature.length);
     }
 
-    BOOL success = (curve25519_verify([signature bytes], [pubKey bytes], [data bytes], [data length]) == 0);
+    SCKVerifyContext *_Nullable context = [self verifyContextForPublicKey:pubKey];
+    if (!context) {
+        BOOL success = (curve25519_verify([signature bytes], [pubKey bytes], [data bytes], [data length]) == 0);
+        return success;
+    }
+    BOOL success = (curve25519_verify_with_ctx(context.ctx, [signature bytes], [data bytes], [data length]) == 0);
     return success;
 }
 
++ (nullable NSArray<NSNumber *> *)verifySignatures:(NSArray<NSData *> *)signatures
+                                        publicKeys:(NSArray<NSData *> *)publicKeys
+                                              data:(NSArray<NSData *> *)data
+                                             error:(NSError **)outError
+{
+    @try {
+        return [self throws_verifySignatures:signatures publicKeys:publicKeys data:data];
+    } @catch (NSException *exception) {
+        *outError = SCKExceptionWrapperErrorMake(exception);
+        return nil;
+    }
+}
+
++ (NSArray<NSNumber *> *)throws_verifySignatures:(NSArray<NSData *> *)signatures
+                                      publicKeys:(NSArray<NSData *> *)publicKeys
+                                            data:(NSArray<NSData *> *)data
+{
+    NSUInteger count = signatures.count;
+    if (publicKeys.count != count || data.count != count) {
+        OWSRaiseException(NSInvalidArgumentException, @"Mismatched signature, key and data counts.");
+    }
+    if (count == 0) {
+        return @[];
+    }
+
+    NSMutableData *signaturePointers = [NSMutableData dataWithLength:count * sizeof(const unsigned char *)];
+    NSMutableData *keyPointers = [NSMutableData dataWithLength:count * sizeof(const unsigned char *)];
+    NSMutableData *dataPointers = [NSMutableData dataWithLength:count * sizeof(const unsigned char *)];
+    NSMutableData *dataLengths = [NSMutableData dataWithLength:count * sizeof(unsigned long)];
+    NSMutableData *results = [NSMutableData dataWithLength:count * sizeof(int)];
+    if (!signaturePointers || !keyPointers || !dataPointers || !dataLengths || !results) {
+        OWSFail(@"Could not allocate buffer");
+    }
+
+    const unsigned char **signatureBytes = signaturePointers.mutableBytes;
+    const unsigned char **keyBytes = keyPointers.mutableBytes;
+    const unsigned char **dataBytes = dataPointers.mutableBytes;
+    unsigned long *lengths = dataLengths.mutableBytes;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (data[i].length < 1) {
+            OWSRaiseException(NSInvalidArgumentException, @"Data needs to be at least one byte");
+        }
+        if (data[i].length >= ULONG_MAX) {
+            OWSRaiseException(NSInvalidArgumentException, @"Data is too long.");
+        }
+        if (publicKeys[i].length != ECCKeyLength) {
+            OWSRaiseException(NSInvalidArgumentException,
+                @"Public Key has unexpected length: %lu",
+                (unsigned long)publicKeys[i].length);
+        }
+        if (signatures[i].length != ECCSignatureLength) {
+            OWSRaiseException(NSInvalidArgumentException,
+                @"Signature has unexpected length: %lu",
+                (unsigned long)signatures[i].length);
+        }
+        signatureBytes[i] = signatures[i].bytes;
+        keyBytes[i] = publicKeys[i].bytes;
+        dataBytes[i] = data[i].bytes;
+        lengths[i] = data[i].length;
+    }
+
+    NSData *random = [Randomness generateRandomBytes:32];
+    curve25519_verify_batch(
+        signatureBytes, keyBytes, dataBytes, lengths, count, results.mutableBytes, random.bytes);
+
+    const int *resultBytes = results.bytes;
+    NSMutableArray<NSNumber *> *verified = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [verified addObject:@(resultBytes[i] == 0)];
+    }
+    return [verified copy];
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
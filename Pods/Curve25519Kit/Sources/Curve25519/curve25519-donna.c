@@ -56,6 +56,13 @@ typedef uint8_t u8;
 typedef int32_t s32;
 typedef int64_t limb;
 
+/* 64-bit targets (x86-64, arm64) use five 51-bit limbs with 128-bit products,
+ * which needs about half the multiplications of the 10-limb code. Define
+ * CURVE25519_DONNA_NO_INT128 to build only the portable code. */
+#if defined(__SIZEOF_INT128__) && !defined(CURVE25519_DONNA_NO_INT128)
+#define CURVE25519_DONNA_64 1
+#endif
+
 /* Field element representation:
  *
  * Field elements are written as an array of signed, 64-bit limbs, least
@@ -840,8 +847,11 @@ crecip(limb *out, const limb *z) {
   /* 2^255 - 21 */ fmul(out,t1,z11);
 }
 
+/* The portable 10-limb implementation. It is the only backend on targets
+ * without a 128-bit integer type and stays exported so that the 5-limb
+ * backend below can be checked against it. */
 int
-curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+curve25519_donna_portable(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
   limb bp[10], x[10], z[11], zmone[10];
   uint8_t e[32];
   int i;
@@ -858,3 +868,470 @@ curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
   fcontract(mypublic, z);
   return 0;
 }
+
+#if defined(CURVE25519_DONNA_64)
+
+/* Field element representation for the 64-bit backend:
+ *
+ * Five unsigned 64-bit limbs, least significant first, each nominally 51
+ * bits wide:
+ *   x[0] + 2^51·x[1] + 2^102·x[2] + 2^153·x[3] + 2^204·x[4]
+ *
+ * Sums and differences are left unreduced; the multiplications accept limbs
+ * of up to 2^55 and return limbs below 2^51 + 2^13. */
+
+typedef uint64_t limb51;
+typedef unsigned __int128 uint128_t;
+typedef limb51 felem51[5];
+
+#define MASK51 ((limb51) 0x7ffffffffffff)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DONNA_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define DONNA_ALWAYS_INLINE inline
+#endif
+
+/* Sum two numbers: output += in */
+static DONNA_ALWAYS_INLINE void fsum_51(felem51 output, const felem51 in) {
+  output[0] += in[0];
+  output[1] += in[1];
+  output[2] += in[2];
+  output[3] += in[3];
+  output[4] += in[4];
+}
+
+/* Find the difference of two numbers: output = in - output
+ * (note the order of the arguments!). 8p is added first so that the limbs
+ * cannot underflow; their inputs must be below 2^54. */
+static DONNA_ALWAYS_INLINE void fdifference_51(felem51 output,
+                                               const felem51 in) {
+  static const limb51 two54m152 = (((limb51) 1) << 54) - 152;
+  static const limb51 two54m8 = (((limb51) 1) << 54) - 8;
+
+  output[0] = in[0] + two54m152 - output[0];
+  output[1] = in[1] + two54m8 - output[1];
+  output[2] = in[2] + two54m8 - output[2];
+  output[3] = in[3] + two54m8 - output[3];
+  output[4] = in[4] + two54m8 - output[4];
+}
+
+/* Multiply a number by a scalar: output = in * scalar */
+static DONNA_ALWAYS_INLINE void fscalar_product_51(felem51 output,
+                                                   const felem51 in,
+                                                   const limb51 scalar) {
+  uint128_t a;
+
+  a = ((uint128_t) in[0]) * scalar;
+  output[0] = ((limb51) a) & MASK51;
+  a = ((uint128_t) in[1]) * scalar + ((limb51) (a >> 51));
+  output[1] = ((limb51) a) & MASK51;
+  a = ((uint128_t) in[2]) * scalar + ((limb51) (a >> 51));
+  output[2] = ((limb51) a) & MASK51;
+  a = ((uint128_t) in[3]) * scalar + ((limb51) (a >> 51));
+  output[3] = ((limb51) a) & MASK51;
+  a = ((uint128_t) in[4]) * scalar + ((limb51) (a >> 51));
+  output[4] = ((limb51) a) & MASK51;
+
+  output[0] += (limb51) ((a >> 51) * 19);
+}
+
+/* Carry the 128-bit column sums t[] into limbs r0..r4 and fold the top carry
+ * back into the bottom limb (2^255 = 19). */
+#define CARRY_51(t, r0, r1, r2, r3, r4)                                       \
+  do {                                                                        \
+    limb51 c;                                                                 \
+    r0 = ((limb51) t[0]) & MASK51; c = (limb51) (t[0] >> 51);                 \
+    t[1] += c; r1 = ((limb51) t[1]) & MASK51; c = (limb51) (t[1] >> 51);      \
+    t[2] += c; r2 = ((limb51) t[2]) & MASK51; c = (limb51) (t[2] >> 51);      \
+    t[3] += c; r3 = ((limb51) t[3]) & MASK51; c = (limb51) (t[3] >> 51);      \
+    t[4] += c; r4 = ((limb51) t[4]) & MASK51; c = (limb51) (t[4] >> 51);      \
+    r0 += c * 19; c = r0 >> 51; r0 &= MASK51;                                 \
+    r1 += c;                                                                  \
+  } while (0)
+
+/* Multiply two numbers: output = in2 * in
+ *
+ * output may alias either input. */
+static DONNA_ALWAYS_INLINE void fmul_51(felem51 output, const felem51 in2,
+                                        const felem51 in) {
+  uint128_t t[5];
+  limb51 r0, r1, r2, r3, r4, s0, s1, s2, s3, s4;
+
+  r0 = in[0];
+  r1 = in[1];
+  r2 = in[2];
+  r3 = in[3];
+  r4 = in[4];
+
+  s0 = in2[0];
+  s1 = in2[1];
+  s2 = in2[2];
+  s3 = in2[3];
+  s4 = in2[4];
+
+  t[0] = ((uint128_t) r0) * s0;
+  t[1] = ((uint128_t) r0) * s1 + ((uint128_t) r1) * s0;
+  t[2] = ((uint128_t) r0) * s2 + ((uint128_t) r2) * s0 + ((uint128_t) r1) * s1;
+  t[3] = ((uint128_t) r0) * s3 + ((uint128_t) r3) * s0 + ((uint128_t) r1) * s2 +
+         ((uint128_t) r2) * s1;
+  t[4] = ((uint128_t) r0) * s4 + ((uint128_t) r4) * s0 + ((uint128_t) r3) * s1 +
+         ((uint128_t) r1) * s3 + ((uint128_t) r2) * s2;
+
+  r4 *= 19;
+  r1 *= 19;
+  r2 *= 19;
+  r3 *= 19;
+
+  t[0] += ((uint128_t) r4) * s1 + ((uint128_t) r1) * s4 + ((uint128_t) r2) * s3 +
+          ((uint128_t) r3) * s2;
+  t[1] += ((uint128_t) r4) * s2 + ((uint128_t) r2) * s4 + ((uint128_t) r3) * s3;
+  t[2] += ((uint128_t) r4) * s3 + ((uint128_t) r3) * s4;
+  t[3] += ((uint128_t) r4) * s4;
+
+  CARRY_51(t, r0, r1, r2, r3, r4);
+
+  output[0] = r0;
+  output[1] = r1;
+  output[2] = r2;
+  output[3] = r3;
+  output[4] = r4;
+}
+
+/* Square a number count times: output = in**(2**count)
+ *
+ * output may alias the input. */
+static DONNA_ALWAYS_INLINE void fsquare_times_51(felem51 output,
+                                                 const felem51 in,
+                                                 limb51 count) {
+  uint128_t t[5];
+  limb51 r0, r1, r2, r3, r4;
+  limb51 d0, d1, d2, d4, d419;
+
+  r0 = in[0];
+  r1 = in[1];
+  r2 = in[2];
+  r3 = in[3];
+  r4 = in[4];
+
+  do {
+    d0 = r0 * 2;
+    d1 = r1 * 2;
+    d2 = r2 * 2 * 19;
+    d419 = r4 * 19;
+    d4 = d419 * 2;
+
+    t[0] = ((uint128_t) r0) * r0 + ((uint128_t) d4) * r1 +
+           (((uint128_t) d2) * (r3));
+    t[1] = ((uint128_t) d0) * r1 + ((uint128_t) d4) * r2 +
+           (((uint128_t) r3) * (r3 * 19));
+    t[2] = ((uint128_t) d0) * r2 + ((uint128_t) r1) * r1 +
+           (((uint128_t) d4) * (r3));
+    t[3] = ((uint128_t) d0) * r3 + ((uint128_t) d1) * r2 +
+           (((uint128_t) r4) * (d419));
+    t[4] = ((uint128_t) d0) * r4 + ((uint128_t) d1) * r3 +
+           (((uint128_t) r2) * (r2));
+
+    CARRY_51(t, r0, r1, r2, r3, r4);
+  } while (--count);
+
+  output[0] = r0;
+  output[1] = r1;
+  output[2] = r2;
+  output[3] = r3;
+  output[4] = r4;
+}
+
+/* Load a little-endian 64-bit number */
+static limb51
+load_limb_51(const u8 *in) {
+  return
+    ((limb51) in[0]) |
+    (((limb51) in[1]) << 8) |
+    (((limb51) in[2]) << 16) |
+    (((limb51) in[3]) << 24) |
+    (((limb51) in[4]) << 32) |
+    (((limb51) in[5]) << 40) |
+    (((limb51) in[6]) << 48) |
+    (((limb51) in[7]) << 56);
+}
+
+static void
+store_limb_51(u8 *out, limb51 in) {
+  out[0] = in & 0xff;
+  out[1] = (in >> 8) & 0xff;
+  out[2] = (in >> 16) & 0xff;
+  out[3] = (in >> 24) & 0xff;
+  out[4] = (in >> 32) & 0xff;
+  out[5] = (in >> 40) & 0xff;
+  out[6] = (in >> 48) & 0xff;
+  out[7] = (in >> 56) & 0xff;
+}
+
+/* Take a little-endian, 32-byte number and expand it into polynomial form */
+static void
+fexpand_51(felem51 output, const u8 *in) {
+  output[0] = load_limb_51(in) & MASK51;
+  output[1] = (load_limb_51(in + 6) >> 3) & MASK51;
+  output[2] = (load_limb_51(in + 12) >> 6) & MASK51;
+  output[3] = (load_limb_51(in + 19) >> 1) & MASK51;
+  output[4] = (load_limb_51(in + 24) >> 12) & MASK51;
+}
+
+/* Take a polynomial form number with limbs below 2^52, reduce it fully mod
+ * 2^255 - 19 and contract it into a little-endian, 32-byte array. */
+static void
+fcontract_51(u8 *output, const felem51 input) {
+  limb51 t[5];
+
+#define FCONTRACT_CARRY_51()            \
+  do {                                  \
+    t[1] += t[0] >> 51; t[0] &= MASK51; \
+    t[2] += t[1] >> 51; t[1] &= MASK51; \
+    t[3] += t[2] >> 51; t[2] &= MASK51; \
+    t[4] += t[3] >> 51; t[3] &= MASK51; \
+  } while (0)
+
+#define FCONTRACT_FULL_CARRY_51()                       \
+  do {                                                  \
+    FCONTRACT_CARRY_51();                               \
+    t[0] += 19 * (t[4] >> 51); t[4] &= MASK51;          \
+  } while (0)
+
+  t[0] = input[0];
+  t[1] = input[1];
+  t[2] = input[2];
+  t[3] = input[3];
+  t[4] = input[4];
+
+  FCONTRACT_FULL_CARRY_51();
+  FCONTRACT_FULL_CARRY_51();
+
+  /* now t is between 0 and 2^255-1, properly carried.
+   * case 1: between 0 and 2^255-20. case 2: between 2^255-19 and 2^255-1. */
+  t[0] += 19;
+  FCONTRACT_FULL_CARRY_51();
+
+  /* now between 19 and 2^255-1 in both cases, and offset by 19. */
+  t[0] += (((limb51) 1) << 51) - 19;
+  t[1] += (((limb51) 1) << 51) - 1;
+  t[2] += (((limb51) 1) << 51) - 1;
+  t[3] += (((limb51) 1) << 51) - 1;
+  t[4] += (((limb51) 1) << 51) - 1;
+
+  /* now between 2^255 and 2^256-20, and offset by 2^255. */
+  FCONTRACT_CARRY_51();
+  t[4] &= MASK51;
+
+#undef FCONTRACT_FULL_CARRY_51
+#undef FCONTRACT_CARRY_51
+
+  store_limb_51(output,      t[0] | (t[1] << 51));
+  store_limb_51(output + 8,  (t[1] >> 13) | (t[2] << 38));
+  store_limb_51(output + 16, (t[2] >> 26) | (t[3] << 25));
+  store_limb_51(output + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+/* Input: Q, Q', Q-Q'
+ * Output: 2Q, Q+Q'
+ *
+ *   x z: destroyed
+ *   xprime zprime: destroyed
+ *   qmqp: preserved
+ *
+ * On entry and exit the limbs of all inputs and outputs are below 2^52. */
+static DONNA_ALWAYS_INLINE void
+fmonty_51(felem51 x2, felem51 z2,  /* output 2Q */
+          felem51 x3, felem51 z3,  /* output Q + Q' */
+          felem51 x, felem51 z,    /* input Q */
+          felem51 xprime, felem51 zprime,  /* input Q' */
+          const felem51 qmqp /* input Q - Q' */) {
+  felem51 origx, origxprime, zzz, xx, zz, xxprime, zzprime, zzzprime;
+
+  memcpy(origx, x, sizeof(felem51));
+  fsum_51(x, z);
+  fdifference_51(z, origx);  /* does x - z */
+
+  memcpy(origxprime, xprime, sizeof(felem51));
+  fsum_51(xprime, zprime);
+  fdifference_51(zprime, origxprime);
+  fmul_51(xxprime, xprime, z);
+  fmul_51(zzprime, x, zprime);
+  memcpy(origxprime, xxprime, sizeof(felem51));
+  fsum_51(xxprime, zzprime);
+  fdifference_51(zzprime, origxprime);
+  fsquare_times_51(x3, xxprime, 1);
+  fsquare_times_51(zzzprime, zzprime, 1);
+  fmul_51(z3, zzzprime, qmqp);
+
+  fsquare_times_51(xx, x, 1);
+  fsquare_times_51(zz, z, 1);
+  fmul_51(x2, xx, zz);
+  fdifference_51(zz, xx);  /* does zz = xx - zz */
+  fscalar_product_51(zzz, zz, 121665);
+  fsum_51(zzz, xx);
+  fmul_51(z2, zz, zzz);
+}
+
+/* Conditionally swap two field elements if 'iswap' is 1, but leave them
+ * unchanged if 'iswap' is 0. Runs in data-invariant time to avoid
+ * side-channel attacks. 'iswap' must be 1 or 0. */
+static DONNA_ALWAYS_INLINE void
+swap_conditional_51(felem51 a, felem51 b, limb51 iswap) {
+  unsigned i;
+  const limb51 swap = -iswap;
+
+  for (i = 0; i < 5; ++i) {
+    const limb51 x = swap & (a[i] ^ b[i]);
+    a[i] ^= x;
+    b[i] ^= x;
+  }
+}
+
+/* Calculates nQ where Q is the x-coordinate of a point on the curve
+ *
+ *   resultx/resultz: the x coordinate of the resulting curve point
+ *   n: a little endian, 32-byte number
+ *   q: a point of the curve */
+static DONNA_ALWAYS_INLINE void
+cmult_51_inner(felem51 resultx, felem51 resultz, const u8 *n,
+               const felem51 q) {
+  felem51 a = {0}, b = {1}, c = {1}, d = {0};
+  limb51 *nqpqx = a, *nqpqz = b, *nqx = c, *nqz = d, *t;
+  felem51 e = {0}, f = {1}, g = {0}, h = {1};
+  limb51 *nqpqx2 = e, *nqpqz2 = f, *nqx2 = g, *nqz2 = h;
+
+  unsigned i, j;
+
+  memcpy(nqpqx, q, sizeof(felem51));
+
+  for (i = 0; i < 32; ++i) {
+    u8 byte = n[31 - i];
+    for (j = 0; j < 8; ++j) {
+      const limb51 bit = byte >> 7;
+
+      swap_conditional_51(nqx, nqpqx, bit);
+      swap_conditional_51(nqz, nqpqz, bit);
+      fmonty_51(nqx2, nqz2,
+                nqpqx2, nqpqz2,
+                nqx, nqz,
+                nqpqx, nqpqz,
+                q);
+      swap_conditional_51(nqx2, nqpqx2, bit);
+      swap_conditional_51(nqz2, nqpqz2, bit);
+
+      t = nqx;
+      nqx = nqx2;
+      nqx2 = t;
+      t = nqz;
+      nqz = nqz2;
+      nqz2 = t;
+      t = nqpqx;
+      nqpqx = nqpqx2;
+      nqpqx2 = t;
+      t = nqpqz;
+      nqpqz = nqpqz2;
+      nqpqz2 = t;
+
+      byte <<= 1;
+    }
+  }
+
+  memcpy(resultx, nqx, sizeof(felem51));
+  memcpy(resultz, nqz, sizeof(felem51));
+}
+
+static void
+cmult_51(felem51 resultx, felem51 resultz, const u8 *n, const felem51 q) {
+  cmult_51_inner(resultx, resultz, n, q);
+}
+
+/* Same ladder built for BMI2: mulx leaves the flags alone and takes any
+ * destination, which removes most of the register shuffling around the
+ * 128-bit products. Picked at run time. */
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && \
+    !defined(CURVE25519_DONNA_NO_BMI2)
+#define CURVE25519_DONNA_BMI2 1
+
+__attribute__((target("bmi2"))) static void
+cmult_51_bmi2(felem51 resultx, felem51 resultz, const u8 *n,
+              const felem51 q) {
+  cmult_51_inner(resultx, resultz, n, q);
+}
+#endif
+
+static void
+crecip_51(felem51 out, const felem51 z) {
+  felem51 a, t0, b, c;
+
+  /* 2 */ fsquare_times_51(a, z, 1); /* a = 2 */
+  /* 8 */ fsquare_times_51(t0, a, 2);
+  /* 9 */ fmul_51(b, t0, z); /* b = 9 */
+  /* 11 */ fmul_51(a, b, a); /* a = 11 */
+  /* 22 */ fsquare_times_51(t0, a, 1);
+  /* 2^5 - 2^0 = 31 */ fmul_51(b, t0, b);
+  /* 2^10 - 2^5 */ fsquare_times_51(t0, b, 5);
+  /* 2^10 - 2^0 */ fmul_51(b, t0, b);
+  /* 2^20 - 2^10 */ fsquare_times_51(t0, b, 10);
+  /* 2^20 - 2^0 */ fmul_51(c, t0, b);
+  /* 2^40 - 2^20 */ fsquare_times_51(t0, c, 20);
+  /* 2^40 - 2^0 */ fmul_51(t0, t0, c);
+  /* 2^50 - 2^10 */ fsquare_times_51(t0, t0, 10);
+  /* 2^50 - 2^0 */ fmul_51(b, t0, b);
+  /* 2^100 - 2^50 */ fsquare_times_51(t0, b, 50);
+  /* 2^100 - 2^0 */ fmul_51(c, t0, b);
+  /* 2^200 - 2^100 */ fsquare_times_51(t0, c, 100);
+  /* 2^200 - 2^0 */ fmul_51(t0, t0, c);
+  /* 2^250 - 2^50 */ fsquare_times_51(t0, t0, 50);
+  /* 2^250 - 2^0 */ fmul_51(t0, t0, b);
+  /* 2^255 - 2^5 */ fsquare_times_51(t0, t0, 5);
+  /* 2^255 - 21 */ fmul_51(out, t0, a);
+}
+
+typedef void (*cmult_51_fn)(felem51, felem51, const u8 *, const felem51);
+
+static cmult_51_fn
+select_cmult_51(void) {
+#if defined(CURVE25519_DONNA_BMI2)
+  static cmult_51_fn selected = NULL;
+  cmult_51_fn fn = __atomic_load_n(&selected, __ATOMIC_RELAXED);
+  if (fn == NULL) {
+    __builtin_cpu_init();
+    fn = __builtin_cpu_supports("bmi2") ? &cmult_51_bmi2 : &cmult_51;
+    __atomic_store_n(&selected, fn, __ATOMIC_RELAXED);
+  }
+  return fn;
+#else
+  return &cmult_51;
+#endif
+}
+
+static int
+curve25519_donna_64(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+  felem51 bp, x, z, zmone;
+  uint8_t e[32];
+  int i;
+
+  for (i = 0; i < 32; ++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  fexpand_51(bp, basepoint);
+  select_cmult_51()(x, z, e, bp);
+  crecip_51(zmone, z);
+  fmul_51(z, x, zmone);
+  fcontract_51(mypublic, z);
+  return 0;
+}
+
+#endif
+
+int
+curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+#if defined(CURVE25519_DONNA_64)
+  return curve25519_donna_64(mypublic, secret, basepoint);
+#else
+  return curve25519_donna_portable(mypublic, secret, basepoint);
+#endif
+}
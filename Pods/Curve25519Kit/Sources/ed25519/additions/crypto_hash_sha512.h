@@ -3,4 +3,16 @@
 
 extern int crypto_hash_sha512(unsigned char *,const unsigned char *,unsigned long long);
 
+/* Streaming interface: init, any number of updates, final.  The result
+   is the same as crypto_hash_sha512 over the concatenated input. */
+typedef struct {
+  unsigned char h[64];
+  unsigned char buf[128];
+  unsigned long long bytes;
+} crypto_hash_sha512_state;
+
+extern int crypto_hash_sha512_init(crypto_hash_sha512_state *);
+extern int crypto_hash_sha512_update(crypto_hash_sha512_state *,const unsigned char *,unsigned long long);
+extern int crypto_hash_sha512_final(crypto_hash_sha512_state *,unsigned char *);
+
 #endif
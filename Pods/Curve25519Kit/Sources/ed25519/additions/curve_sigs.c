@@ -3,6 +3,9 @@
 #include "ge.h"
 #include "curve_sigs.h"
 #include "crypto_sign.h"
+#include "crypto_hash_sha512.h"
+#include "crypto_verify_32.h"
+#include "sc.h"
 
 void curve25519_keygen(unsigned char* curve25519_pubkey_out,
                        const unsigned char* curve25519_privkey_in)
@@ -34,6 +37,56 @@ void curve25519_keygen(unsigned char* curve25519_pubkey_out,
   fe_tobytes(curve25519_pubkey_out, mont_x);
 }
 
+#define KEYGEN_BATCH_CHUNK 32
+
+void curve25519_keygen_batch(unsigned char* curve25519_pubkeys_out,
+                             const unsigned char* curve25519_privkeys_in,
+                             unsigned long count)
+{
+  ge_p3 ed[KEYGEN_BATCH_CHUNK];
+  fe prefix[KEYGEN_BATCH_CHUNK];
+  fe one_minus_ed_y, ed_y_plus_one, acc, inv, mont_x, zero, one;
+  unsigned int nonzero[KEYGEN_BATCH_CHUNK];
+  unsigned long base, n, i;
+
+  /* As curve25519_keygen, but with the comb tables and one fe_invert per
+     chunk: prefix[i] holds the product of the (Z - Y) before item i, so
+     that the inverse of each (Z - Y) falls out of the inverse of the whole
+     product.  A zero (Z - Y) is replaced by one in the product and gives
+     mont_x=0, as fe_invert would; the choice is made in constant time. */
+  fe_0(zero);
+  fe_1(one);
+  for (base = 0; base < count; base += n) {
+    n = count - base;
+    if (n > KEYGEN_BATCH_CHUNK) {
+      n = KEYGEN_BATCH_CHUNK;
+    }
+
+    fe_1(acc);
+    for (i = 0; i < n; i++) {
+      ge_scalarmult_base_comb(&ed[i], curve25519_privkeys_in + 32 * (base + i));
+      fe_sub(one_minus_ed_y, ed[i].Z, ed[i].Y);
+      nonzero[i] = fe_isnonzero(one_minus_ed_y) & 1;
+      fe_cmov(one_minus_ed_y, one, 1 ^ nonzero[i]);
+      fe_copy(prefix[i], acc);
+      fe_mul(acc, acc, one_minus_ed_y);
+    }
+
+    fe_invert(acc, acc);
+    for (i = n; i-- > 0; ) {
+      fe_sub(one_minus_ed_y, ed[i].Z, ed[i].Y);
+      fe_cmov(one_minus_ed_y, one, 1 ^ nonzero[i]);
+      fe_mul(inv, prefix[i], acc);
+      fe_mul(acc, acc, one_minus_ed_y);
+
+      fe_add(ed_y_plus_one, ed[i].Y, ed[i].Z);
+      fe_mul(mont_x, ed_y_plus_one, inv);
+      fe_cmov(mont_x, zero, 1 ^ nonzero[i]);
+      fe_tobytes(curve25519_pubkeys_out + 32 * (base + i), mont_x);
+    }
+  }
+}
+
 int curve25519_sign(unsigned char* signature_out,
                     const unsigned char* curve25519_privkey,
                     const unsigned char* msg, const unsigned long msg_len,
@@ -41,54 +94,107 @@ int curve25519_sign(unsigned char* signature_out,
 {
   ge_p3 ed_pubkey_point; /* Ed25519 pubkey point */
   unsigned char ed_pubkey[32]; /* Ed25519 encoded pubkey */
-  unsigned char *sigbuf; /* working buffer */
   unsigned char sign_bit = 0;
 
-  if ((sigbuf = malloc(msg_len + 128)) == 0) {
-    memset(signature_out, 0, 64);
-    return -1;
-  }
-
   /* Convert the Curve25519 privkey to an Ed25519 public key */
   ge_scalarmult_base(&ed_pubkey_point, curve25519_privkey);
   ge_p3_tobytes(ed_pubkey, &ed_pubkey_point);
   sign_bit = ed_pubkey[31] & 0x80;
 
   /* Perform an Ed25519 signature with explicit private key */
-  crypto_sign_modified(sigbuf, msg, msg_len, curve25519_privkey,
+  crypto_sign_modified(signature_out, msg, msg_len, curve25519_privkey,
                        ed_pubkey, random);
-  memmove(signature_out, sigbuf, 64);
 
   /* Encode the sign bit into signature (in unused high bit of S) */
    signature_out[63] &= 0x7F; /* bit should be zero already, but just in case */
    signature_out[63] |= sign_bit;
 
-   free(sigbuf);
    return 0;
 }
 
-int curve25519_verify(const unsigned char* signature,
-                      const unsigned char* curve25519_pubkey,
-                      const unsigned char* msg, const unsigned long msg_len)
+/* h = SHA512(R || A || M) reduced mod q, hashed in pieces rather than
+   from a concatenated copy of the message */
+static void hash_ram(unsigned char* h, const unsigned char* R,
+                     const unsigned char* ed_pubkey,
+                     const unsigned char* msg, const unsigned long msg_len)
 {
-  fe mont_x, mont_x_minus_one, mont_x_plus_one, inv_mont_x_plus_one;
-  fe one;
-  fe ed_y;
-  unsigned char ed_pubkey[32];
-  unsigned long long some_retval;
-  unsigned char *verifybuf = NULL; /* working buffer */
-  unsigned char *verifybuf2 = NULL; /* working buffer #2 */
-  int result;
+  crypto_hash_sha512_state hs;
+
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, R, 32);
+  crypto_hash_sha512_update(&hs, ed_pubkey, 32);
+  crypto_hash_sha512_update(&hs, msg, msg_len);
+  crypto_hash_sha512_final(&hs, h);
+  sc_reduce(h);
+}
+
+/* Decodes the R half of a signature as -R, refusing the encodings that no
+   computed point has (y >= p, or x = 0 with the sign bit set) */
+static int minus_r_frombytes(ge_p3* minus_R, const unsigned char* signature)
+{
+  unsigned char rcheck[32];
+  fe y;
+
+  fe_frombytes(y, signature);
+  fe_tobytes(rcheck, y);
+  rcheck[31] |= (signature[31] & 0x80);
+  if (memcmp(rcheck, signature, 32) != 0 ||
+      ge_frombytes_negate_vartime(minus_R, signature) != 0 ||
+      ((signature[31] & 0x80) && !fe_isnonzero(minus_R->X))) {
+    return -1;
+  }
+  return 0;
+}
 
-  if ((verifybuf = malloc(msg_len + 64)) == 0) {
-    result = -1;
-    goto err;
+/* Cofactored check of R == S*B - h*A, for the batch: returns 0 if [8]R
+   equals [8]check */
+static int r_equals_cofactored(const ge_p2* check, const ge_p3* minus_R)
+{
+  ge_p2 P, Q;
+  ge_p1p1 t;
+  fe a, b;
+  int i;
+
+  P = *check;
+  ge_p3_to_p2(&Q, minus_R);
+  fe_neg(Q.X, Q.X);
+  for (i = 0; i < 3; i++) {
+    ge_p2_dbl(&t, &P);
+    ge_p1p1_to_p2(&P, &t);
+    ge_p2_dbl(&t, &Q);
+    ge_p1p1_to_p2(&Q, &t);
   }
 
-  if ((verifybuf2 = malloc(msg_len + 64)) == 0) {
-    result = -1;
-    goto err;
+  /* compare X/Z and Y/Z */
+  fe_mul(a, P.X, Q.Z);
+  fe_mul(b, Q.X, P.Z);
+  fe_sub(a, a, b);
+  if (fe_isnonzero(a)) {
+    return -1;
   }
+  fe_mul(a, P.Y, Q.Z);
+  fe_mul(b, Q.Y, P.Z);
+  fe_sub(a, a, b);
+  return fe_isnonzero(a) ? -1 : 0;
+}
+
+/* curve25519_verify, comparing R cofactored if asked to, as
+   curve25519_verify_batch does */
+static int verify_single(const unsigned char* signature,
+                         const unsigned char* curve25519_pubkey,
+                         const unsigned char* msg, const unsigned long msg_len,
+                         int cofactored)
+{
+  fe mont_x, mont_x_minus_one, mont_x_plus_one, inv_mont_x_plus_one;
+  fe one;
+  fe ed_y;
+  unsigned char ed_pubkey[32];
+  unsigned char scopy[32];
+  unsigned char h[64];
+  unsigned char rcheck[32];
+  ge_p3 A;
+  ge_p3 minus_R;
+  ge_p2 R;
 
   /* Convert the Curve25519 public key into an Ed25519 public key.  In
      particular, convert Curve25519's "montgomery" x-coordinate into an
@@ -111,28 +217,306 @@ int curve25519_verify(const unsigned char* signature,
   /* Copy the sign bit, and remove it from signature */
   ed_pubkey[31] &= 0x7F;  /* bit should be zero already, but just in case */
   ed_pubkey[31] |= (signature[63] & 0x80);
-  memmove(verifybuf, signature, 64);
-  verifybuf[63] &= 0x7F;
+  memmove(scopy, signature + 32, 32);
+  scopy[31] &= 0x7F;
+
+  /* Then perform a normal Ed25519 verification, return 0 on success.
+     This is crypto_sign_open, except that R || A || M is hashed in pieces
+     instead of from two working copies of the message. */
+  if (scopy[31] & 224) {
+    return -1;
+  }
+  if (ge_frombytes_negate_vartime(&A, ed_pubkey) != 0) {
+    return -1;
+  }
+  if (cofactored && minus_r_frombytes(&minus_R, signature) != 0) {
+    return -1;
+  }
 
-  memmove(verifybuf+64, msg, msg_len);
+  hash_ram(h, signature, ed_pubkey, msg, msg_len);
+  ge_double_scalarmult_vartime(&R, h, &A, scopy);
+  if (cofactored) {
+    return r_equals_cofactored(&R, &minus_R);
+  }
+  ge_tobytes(rcheck, &R);
+  return crypto_verify_32(rcheck, signature);
+}
 
-  /* Then perform a normal Ed25519 verification, return 0 on success */
-  /* The below call has a strange API: */
-  /* verifybuf = R || S || message */
-  /* verifybuf2 = internal to next call gets a copy of verifybuf, S gets 
-     replaced with pubkey for hashing, then the whole thing gets zeroized
-     (if bad sig), or contains a copy of msg (good sig) */
-  result = crypto_sign_open(verifybuf2, &some_retval, verifybuf, 64 + msg_len, ed_pubkey);
+int curve25519_verify(const unsigned char* signature,
+                      const unsigned char* curve25519_pubkey,
+                      const unsigned char* msg, const unsigned long msg_len)
+{
+  return verify_single(signature, curve25519_pubkey, msg, msg_len, 0);
+}
 
-  err:
+struct curve25519_verify_ctx {
+  int valid;
+  unsigned char ed_pubkey[32]; /* sign bit clear */
+  ge_cached Ai[2][8];          /* odd multiples, indexed by the sign bit */
+};
 
-  if (verifybuf != NULL) {
-    free(verifybuf);
+curve25519_verify_ctx* curve25519_verify_ctx_init(const unsigned char* curve25519_pubkey)
+{
+  curve25519_verify_ctx* ctx;
+  fe mont_x, mont_x_minus_one, mont_x_plus_one, inv_mont_x_plus_one;
+  fe one;
+  fe ed_y;
+  ge_p3 A;
+
+  if ((ctx = malloc(sizeof(*ctx))) == 0) {
+    return NULL;
+  }
+
+  /* Same conversion as curve25519_verify */
+  fe_frombytes(mont_x, curve25519_pubkey);
+  fe_1(one);
+  fe_sub(mont_x_minus_one, mont_x, one);
+  fe_add(mont_x_plus_one, mont_x, one);
+  fe_invert(inv_mont_x_plus_one, mont_x_plus_one);
+  fe_mul(ed_y, mont_x_minus_one, inv_mont_x_plus_one);
+  fe_tobytes(ctx->ed_pubkey, ed_y);
+  ctx->ed_pubkey[31] &= 0x7F;
+
+  /* crypto_sign_open works with the negated key.  Decompressing with the
+     sign bit clear gives that point for signatures with the bit clear, and
+     its negation is the point for signatures with the bit set (decoding
+     succeeds or fails regardless of the bit). */
+  ctx->valid = ge_frombytes_negate_vartime(&A, ctx->ed_pubkey) == 0;
+  if (ctx->valid) {
+    ge_cached_odd_multiples(ctx->Ai[0], &A);
+    fe_neg(A.X, A.X);
+    fe_neg(A.T, A.T);
+    ge_cached_odd_multiples(ctx->Ai[1], &A);
+  }
+  return ctx;
+}
+
+void curve25519_verify_ctx_free(curve25519_verify_ctx* ctx)
+{
+  free(ctx);
+}
+
+int curve25519_verify_with_ctx(const curve25519_verify_ctx* ctx,
+                               const unsigned char* signature,
+                               const unsigned char* msg, const unsigned long msg_len)
+{
+  unsigned char scopy[32];
+  unsigned char h[64];
+  unsigned char rcheck[32];
+  unsigned char ed_pubkey[32];
+  ge_p2 R;
+  int sign = signature[63] >> 7;
+
+  memmove(scopy, signature + 32, 32);
+  scopy[31] &= 0x7F;
+  if (!ctx->valid || (scopy[31] & 224)) {
+    return -1;
+  }
+
+  memmove(ed_pubkey, ctx->ed_pubkey, 32);
+  ed_pubkey[31] |= signature[63] & 0x80;
+  hash_ram(h, signature, ed_pubkey, msg, msg_len);
+
+  ge_double_scalarmult_cached_vartime(&R, h, ctx->Ai[sign], scopy);
+  ge_tobytes(rcheck, &R);
+  return crypto_verify_32(rcheck, signature);
+}
+
+/* Signatures per multi-scalar multiplication; bounds the scratch memory */
+#define VERIFY_BATCH_CHUNK 64
+
+typedef struct {
+  ge_p3 points[2 * VERIFY_BATCH_CHUNK];              /* -R_i, -A_i */
+  unsigned char scalars[2 * VERIFY_BATCH_CHUNK][32]; /* z_i, z_i * h_i */
+  signed char slides[2 * VERIFY_BATCH_CHUNK * 256];
+  ge_cached tables[2 * VERIFY_BATCH_CHUNK * 8];
+  fe num[VERIFY_BATCH_CHUNK];
+  fe den[VERIFY_BATCH_CHUNK];
+  unsigned long index[VERIFY_BATCH_CHUNK];
+} verify_batch_scratch;
+
+/* Verifies signatures[first..first+count) with one random linear
+   combination. Items that cannot take part (bad encodings) and, if the
+   combination does not vanish, all items are checked one by one, with the
+   same cofactored comparison. */
+static int verify_batch_chunk(verify_batch_scratch* scratch,
+                              const unsigned char* const* signatures,
+                              const unsigned char* const* curve25519_pubkeys,
+                              const unsigned char* const* msgs,
+                              const unsigned long* msg_lens,
+                              unsigned long first, unsigned long count,
+                              int* results, const unsigned char* random)
+{
+  static const unsigned char zero[32];
+  unsigned char bscalar[32];
+  unsigned char zbuf[32 + 64 + 32 + 64 + 8];
+  unsigned char ed_pubkey[32];
+  unsigned char h[64];
+  unsigned char z[64];
+  fe one, inv, t, y;
+  ge_p1p1 check2;
+  ge_p2 check;
+  unsigned long i, k, batched = 0;
+  int zero_den[VERIFY_BATCH_CHUNK];
+  int result = 0;
+
+  /* Montgomery x to Edwards y as in curve25519_verify, sharing one
+     inversion across the chunk */
+  fe_1(one);
+  for (i = 0; i < count; i++) {
+    fe mont_x;
+    fe_frombytes(mont_x, curve25519_pubkeys[first + i]);
+    fe_sub(scratch->num[i], mont_x, one);
+    fe_add(scratch->den[i], mont_x, one);
+    zero_den[i] = !fe_isnonzero(scratch->den[i]);
+    if (zero_den[i]) {
+      fe_1(scratch->den[i]);
+    }
+  }
+  /* prefix products, walked back to recover each inverse */
+  {
+    fe prefix[VERIFY_BATCH_CHUNK];
+    fe_copy(prefix[0], scratch->den[0]);
+    for (i = 1; i < count; i++) {
+      fe_mul(prefix[i], prefix[i - 1], scratch->den[i]);
+    }
+    fe_invert(inv, prefix[count - 1]);
+    for (i = count; i-- > 1;) {
+      fe_mul(t, inv, prefix[i - 1]);
+      fe_mul(inv, inv, scratch->den[i]);
+      fe_copy(scratch->den[i], t);
+    }
+    fe_copy(scratch->den[0], inv);
+  }
+
+  memset(bscalar, 0, sizeof(bscalar));
+
+  for (i = 0; i < count; i++) {
+    const unsigned long item = first + i;
+    const unsigned char* sig = signatures[item];
+    ge_p3* R = &scratch->points[2 * batched];
+    ge_p3* A = &scratch->points[2 * batched + 1];
+    unsigned char s[32];
+
+    if (zero_den[i]) {
+      fe_0(y);
+    } else {
+      fe_mul(y, scratch->num[i], scratch->den[i]);
+    }
+    fe_tobytes(ed_pubkey, y);
+    ed_pubkey[31] &= 0x7F;
+    ed_pubkey[31] |= (sig[63] & 0x80);
+
+    memmove(s, sig + 32, 32);
+    s[31] &= 0x7F;
+
+    /* Anything verify_single rejects before its final comparison goes the
+       single way */
+    if ((s[31] & 224) ||
+        ge_frombytes_negate_vartime(A, ed_pubkey) != 0 ||
+        minus_r_frombytes(R, sig) != 0) {
+      results[item] = verify_single(sig, curve25519_pubkeys[item],
+                                    msgs[item], msg_lens[item], 1);
+      if (results[item] != 0) {
+        result = -1;
+      }
+      continue;
+    }
+
+    /* h_i = SHA512(R || A || M) */
+    hash_ram(h, sig, ed_pubkey, msgs[item], msg_lens[item]);
+
+    /* z_i: 128 bits bound to the caller's randomness and this item */
+    memmove(zbuf, random, 32);
+    memmove(zbuf + 32, sig, 64);
+    memmove(zbuf + 96, ed_pubkey, 32);
+    memmove(zbuf + 128, h, 64);
+    for (k = 0; k < 8; k++) {
+      zbuf[192 + k] = (unsigned char)(item >> (8 * k));
+    }
+    crypto_hash_sha512(z, zbuf, sizeof(zbuf));
+    memset(z + 16, 0, 16);
+
+    memmove(scratch->scalars[2 * batched], z, 32);
+    sc_muladd(scratch->scalars[2 * batched + 1], z, h, zero);
+    sc_muladd(bscalar, z, s, bscalar);
+    scratch->index[batched] = item;
+    batched++;
+  }
+
+  if (batched == 0) {
+    return result;
+  }
+
+  /* [8] * sum z_i * (S_i * B - h_i * A_i - R_i) must be the neutral
+     element: cofactored, so that a small-order component in R or A does
+     not cancel out for some choices of z_i only */
+  ge_multi_scalarmult_vartime(&check, bscalar, scratch->points,
+                              (const unsigned char (*)[32])scratch->scalars,
+                              2 * batched, scratch->slides, scratch->tables);
+  for (k = 0; k < 3; k++) {
+    ge_p2_dbl(&check2, &check);
+    ge_p1p1_to_p2(&check, &check2);
+  }
+  fe_sub(t, check.Y, check.Z);
+  if (!fe_isnonzero(check.X) && !fe_isnonzero(t)) {
+    for (i = 0; i < batched; i++) {
+      results[scratch->index[i]] = 0;
+    }
+    return result;
+  }
+
+  for (i = 0; i < batched; i++) {
+    const unsigned long item = scratch->index[i];
+    results[item] = verify_single(signatures[item],
+                                  curve25519_pubkeys[item],
+                                  msgs[item], msg_lens[item], 1);
+    if (results[item] != 0) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+int curve25519_verify_batch(const unsigned char* const* signatures,
+                            const unsigned char* const* curve25519_pubkeys,
+                            const unsigned char* const* msgs,
+                            const unsigned long* msg_lens,
+                            unsigned long count,
+                            int* results,
+                            const unsigned char* random)
+{
+  verify_batch_scratch* scratch = NULL;
+  unsigned long i;
+  int result = 0;
+
+  if (count > 1) {
+    scratch = malloc(sizeof(*scratch));
+  }
+  if (scratch == NULL) {
+    /* A single item, or no memory for the batch: still answer every item */
+    for (i = 0; i < count; i++) {
+      results[i] = verify_single(signatures[i], curve25519_pubkeys[i],
+                                 msgs[i], msg_lens[i], 1);
+      if (results[i] != 0) {
+        result = -1;
+      }
+    }
+    goto done;
   }
 
-  if (verifybuf2 != NULL) {
-    free(verifybuf2);
+  for (i = 0; i < count; i += VERIFY_BATCH_CHUNK) {
+    unsigned long chunk = count - i;
+    if (chunk > VERIFY_BATCH_CHUNK) {
+      chunk = VERIFY_BATCH_CHUNK;
+    }
+    if (verify_batch_chunk(scratch, signatures, curve25519_pubkeys,
+                           msgs, msg_lens, i, chunk, results, random) != 0) {
+      result = -1;
+    }
   }
 
+done:
+  free(scratch);
   return result;
 }
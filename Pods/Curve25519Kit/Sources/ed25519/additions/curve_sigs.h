@@ -2,9 +2,20 @@
 #ifndef __CURVE_SIGS_H__
 #define __CURVE_SIGS_H__
 
+/* The private key must have bit 255 clear, as clamped keys do: like
+   ge_scalarmult_base, the keygens read it as a 255-bit scalar and give
+   unspecified results otherwise.  Other bits need not be clamped. */
 void curve25519_keygen(unsigned char* curve25519_pubkey_out, /* 32 bytes */
                        const unsigned char* curve25519_privkey_in); /* 32 bytes */
 
+/* curve25519_keygen for count keys at once (e.g. a batch of prekeys),
+   using wider fixed-base tables and one field inversion per 32 keys.
+   Same results as curve25519_keygen for every key with bit 255 clear;
+   the two may differ for keys with it set. */
+void curve25519_keygen_batch(unsigned char* curve25519_pubkeys_out, /* 32 * count bytes */
+                             const unsigned char* curve25519_privkeys_in, /* 32 * count bytes */
+                             unsigned long count);
+
 /* returns 0 on success */
 int curve25519_sign(unsigned char* signature_out, /* 64 bytes */
                      const unsigned char* curve25519_privkey, /* 32 bytes */
@@ -16,6 +27,40 @@ int curve25519_verify(const unsigned char* signature, /* 64 bytes */
                       const unsigned char* curve25519_pubkey, /* 32 bytes */
                       const unsigned char* msg, const unsigned long msg_len);
 
+/* Verification context for a public key that is checked repeatedly: holds
+   the decoded Edwards point as the odd-multiples table used by
+   curve25519_verify, so each verification skips the key conversion and
+   decompression.  Returns NULL if out of memory.  The context is read-only
+   after init and may be shared between threads. */
+typedef struct curve25519_verify_ctx curve25519_verify_ctx;
+
+curve25519_verify_ctx* curve25519_verify_ctx_init(const unsigned char* curve25519_pubkey); /* 32 bytes */
+void curve25519_verify_ctx_free(curve25519_verify_ctx* ctx);
+
+/* returns 0 on success, same results as curve25519_verify */
+int curve25519_verify_with_ctx(const curve25519_verify_ctx* ctx,
+                               const unsigned char* signature, /* 64 bytes */
+                               const unsigned char* msg, const unsigned long msg_len);
+
+/* Verifies count signatures at once, returns 0 if all of them are valid.
+   results[i] receives 0 or -1 for item i.
+
+   The items are checked with random linear combinations of their
+   verification equations (Straus multi-scalar multiplication, 64 items per
+   combination), falling back to checking one by one when a combination
+   fails or an item has a bad encoding.  Unlike curve25519_verify, these
+   checks are cofactored: R may differ from S*B - h*A by a point of small
+   order, which only a malicious signer can arrange.  Otherwise the results
+   are curve25519_verify's, beyond a 2^-128 chance and whatever the random
+   bytes are. */
+int curve25519_verify_batch(const unsigned char* const* signatures, /* 64 bytes each */
+                            const unsigned char* const* curve25519_pubkeys, /* 32 bytes each */
+                            const unsigned char* const* msgs,
+                            const unsigned long* msg_lens,
+                            unsigned long count,
+                            int* results,
+                            const unsigned char* random); /* 32 bytes */
+
 /* helper function - modified version of crypto_sign() to use 
    explicit private key.  In particular:
 
@@ -36,9 +81,12 @@ int curve25519_verify(const unsigned char* signature, /* 64 bytes */
    M = SHA512(R || pk || m)
    S = sig_nonce + (m * sk)
    signature = (R || S)
+
+   Only the 64-byte signature is written to sm; the message is hashed in
+   place.
  */
 int crypto_sign_modified(
-  unsigned char *sm,
+  unsigned char *sm, /* 64 bytes */
   const unsigned char *m,unsigned long long mlen,
   const unsigned char *sk, /* Curve/Ed25519 private key */
   const unsigned char *pk, /* Ed25519 public key */
@@ -18,30 +18,37 @@ int crypto_sign_modified(
 {
   unsigned char nonce[64];
   unsigned char hram[64];
+  unsigned char prefix[32];
+  crypto_hash_sha512_state hs;
   ge_p3 R;
   int count=0;
 
-  memmove(sm + 64,m,mlen);
-  memmove(sm + 32,sk,32); /* NEW: Use privkey directly for nonce derivation */
-
   /* NEW : add prefix to separate hash uses - see .h */
-  sm[0] = 0xFE;
+  prefix[0] = 0xFE;
   for (count = 1; count < 32; count++)
-    sm[count] = 0xFF;
-
-  /* NEW: add suffix of random data */
-  memmove(sm + mlen + 64, random, 64);
+    prefix[count] = 0xFF;
 
-  crypto_hash_sha512(nonce,sm,mlen + 128);
-  memmove(sm + 32,pk,32);
+  /* The hash inputs are fed in pieces, so the message is never copied */
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs,prefix,32);
+  crypto_hash_sha512_update(&hs,sk,32); /* NEW: Use privkey directly for nonce derivation */
+  crypto_hash_sha512_update(&hs,m,mlen);
+  crypto_hash_sha512_update(&hs,random,64); /* NEW: add suffix of random data */
+  crypto_hash_sha512_final(&hs,nonce);
 
   sc_reduce(nonce);
   ge_scalarmult_base(&R,nonce);
   ge_p3_tobytes(sm,&R);
 
-  crypto_hash_sha512(hram,sm,mlen + 64);
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs,sm,32);
+  crypto_hash_sha512_update(&hs,pk,32);
+  crypto_hash_sha512_update(&hs,m,mlen);
+  crypto_hash_sha512_final(&hs,hram);
   sc_reduce(hram);
   sc_muladd(sm + 32,hram,sk,nonce); /* NEW: Use privkey directly */
 
+  zeroize(nonce, 64);
+  zeroize((unsigned char*)&hs, sizeof(hs));
   return 0;
 }
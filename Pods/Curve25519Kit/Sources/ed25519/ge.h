@@ -69,7 +69,11 @@ typedef struct {
 #define ge_add crypto_sign_ed25519_ref10_ge_add
 #define ge_sub crypto_sign_ed25519_ref10_ge_sub
 #define ge_scalarmult_base crypto_sign_ed25519_ref10_ge_scalarmult_base
+#define ge_scalarmult_base_comb crypto_sign_ed25519_ref10_ge_scalarmult_base_comb
 #define ge_double_scalarmult_vartime crypto_sign_ed25519_ref10_ge_double_scalarmult_vartime
+#define ge_multi_scalarmult_vartime crypto_sign_ed25519_ref10_ge_multi_scalarmult_vartime
+#define ge_cached_odd_multiples crypto_sign_ed25519_ref10_ge_cached_odd_multiples
+#define ge_double_scalarmult_cached_vartime crypto_sign_ed25519_ref10_ge_double_scalarmult_cached_vartime
 
 extern void ge_tobytes(unsigned char *,const ge_p2 *);
 extern void ge_p3_tobytes(unsigned char *,const ge_p3 *);
@@ -90,6 +94,10 @@ extern void ge_msub(ge_p1p1 *,const ge_p3 *,const ge_precomp *);
 extern void ge_add(ge_p1p1 *,const ge_p3 *,const ge_cached *);
 extern void ge_sub(ge_p1p1 *,const ge_p3 *,const ge_cached *);
 extern void ge_scalarmult_base(ge_p3 *,const unsigned char *);
+extern void ge_scalarmult_base_comb(ge_p3 *,const unsigned char *);
 extern void ge_double_scalarmult_vartime(ge_p2 *,const unsigned char *,const ge_p3 *,const unsigned char *);
+extern void ge_multi_scalarmult_vartime(ge_p2 *,const unsigned char *,const ge_p3 *,const unsigned char (*)[32],unsigned long,signed char *,ge_cached *);
+extern void ge_cached_odd_multiples(ge_cached *,const ge_p3 *);
+extern void ge_double_scalarmult_cached_vartime(ge_p2 *,const unsigned char *,const ge_cached *,const unsigned char *);
 
 #endif
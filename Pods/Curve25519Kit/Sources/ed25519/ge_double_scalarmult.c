@@ -43,29 +43,36 @@ and b = b[0]+256*b[1]+...+256^31 b[31].
 B is the Ed25519 base point (x,4/5) with x positive.
 */
 
-void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A,const unsigned char *b)
+void ge_cached_odd_multiples(ge_cached *Ai,const ge_p3 *A)
+{
+  ge_p1p1 t;
+  ge_p3 u;
+  ge_p3 A2;
+  int k;
+
+  ge_p3_to_cached(&Ai[0],A);
+  ge_p3_dbl(&t,A); ge_p1p1_to_p3(&A2,&t);
+  for (k = 1;k < 8;++k) {
+    ge_add(&t,&A2,&Ai[k - 1]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[k],&u);
+  }
+}
+
+/*
+As ge_double_scalarmult_vartime, with A given as the table
+A,3A,5A,7A,9A,11A,13A,15A built by ge_cached_odd_multiples.
+*/
+
+void ge_double_scalarmult_cached_vartime(ge_p2 *r,const unsigned char *a,const ge_cached *Ai,const unsigned char *b)
 {
   signed char aslide[256];
   signed char bslide[256];
-  ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
   ge_p1p1 t;
   ge_p3 u;
-  ge_p3 A2;
   int i;
 
   slide(aslide,a);
   slide(bslide,b);
 
-  ge_p3_to_cached(&Ai[0],A);
-  ge_p3_dbl(&t,A); ge_p1p1_to_p3(&A2,&t);
-  ge_add(&t,&A2,&Ai[0]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[1],&u);
-  ge_add(&t,&A2,&Ai[1]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[2],&u);
-  ge_add(&t,&A2,&Ai[2]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[3],&u);
-  ge_add(&t,&A2,&Ai[3]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[4],&u);
-  ge_add(&t,&A2,&Ai[4]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[5],&u);
-  ge_add(&t,&A2,&Ai[5]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[6],&u);
-  ge_add(&t,&A2,&Ai[6]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[7],&u);
-
   ge_p2_0(r);
 
   for (i = 255;i >= 0;--i) {
@@ -94,3 +101,72 @@ void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A
     ge_p1p1_to_p2(r,&t);
   }
 }
+
+void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A,const unsigned char *b)
+{
+  ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+
+  ge_cached_odd_multiples(Ai,A);
+  ge_double_scalarmult_cached_vartime(r,a,Ai,b);
+}
+
+/*
+r = b * B + a[0] * A[0] + ... + a[n-1] * A[n-1]
+Straus' method: every scalar is recoded as by slide() and all of them share
+one chain of doublings. slides must hold 256 * n entries and Ai 8 * n; they
+are caller-provided so that large batches can reuse one allocation.
+*/
+
+void ge_multi_scalarmult_vartime(ge_p2 *r,const unsigned char *b,
+                                 const ge_p3 *A,const unsigned char (*a)[32],
+                                 unsigned long n,signed char *slides,
+                                 ge_cached *Ai)
+{
+  signed char bslide[256];
+  ge_p1p1 t;
+  ge_p3 u;
+  unsigned long j;
+  int i;
+
+  slide(bslide,b);
+
+  for (j = 0;j < n;++j) {
+    slide(slides + 256 * j,a[j]);
+    ge_cached_odd_multiples(&Ai[8 * j],&A[j]);
+  }
+
+  ge_p2_0(r);
+
+  for (i = 255;i >= 0;--i) {
+    if (bslide[i]) break;
+    for (j = 0;j < n;++j) {
+      if (slides[256 * j + i]) break;
+    }
+    if (j < n) break;
+  }
+
+  for (;i >= 0;--i) {
+    ge_p2_dbl(&t,r);
+
+    for (j = 0;j < n;++j) {
+      const signed char s = slides[256 * j + i];
+      if (s > 0) {
+        ge_p1p1_to_p3(&u,&t);
+        ge_add(&t,&u,&Ai[8 * j + s/2]);
+      } else if (s < 0) {
+        ge_p1p1_to_p3(&u,&t);
+        ge_sub(&t,&u,&Ai[8 * j + (-s)/2]);
+      }
+    }
+
+    if (bslide[i] > 0) {
+      ge_p1p1_to_p3(&u,&t);
+      ge_madd(&t,&u,&Bi[bslide[i]/2]);
+    } else if (bslide[i] < 0) {
+      ge_p1p1_to_p3(&u,&t);
+      ge_msub(&t,&u,&Bi[(-bslide[i])/2]);
+    }
+
+    ge_p1p1_to_p2(r,&t);
+  }
+}
@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "ge.h"
+#include "crypto_uint32.h"
+
+/*
+Fixed-base multiplication with one table per signed radix-2^5 digit, so no
+doublings are needed: 52 additions instead of ge_scalarmult_base's 64
+additions and 4 doublings.  The 52 * 16 entries (100 KB) are too many to
+ship as source like base.h, so they are computed on first use (about a
+millisecond), with all conversions to affine coordinates sharing a single
+inversion.  Falls back to ge_scalarmult_base if that allocation fails.
+*/
+
+#define COMB_W 5
+#define COMB_ENTRIES (1 << (COMB_W - 1))
+#define COMB_DIGITS (255 / COMB_W + 1)
+
+/* comb[i][j] = (j+1)*2^(5i)*B */
+static ge_precomp comb[COMB_DIGITS][COMB_ENTRIES];
+static int comb_ready;
+static pthread_once_t comb_once = PTHREAD_ONCE_INIT;
+
+static crypto_uint32 equal(crypto_uint32 b,crypto_uint32 c)
+{
+  crypto_uint32 y = b ^ c; /* 0: yes; 1..255: no */
+  y -= 1; /* 4294967295: yes; 0..254: no */
+  y >>= 31; /* 1: yes; 0: no */
+  return y;
+}
+
+static void cmov(ge_precomp *t,const ge_precomp *u,crypto_uint32 b)
+{
+  crypto_int32 mask = -(crypto_int32) b;
+  int k;
+
+  for (k = 0;k < 10;++k) {
+    t->yplusx[k] ^= (t->yplusx[k] ^ u->yplusx[k]) & mask;
+    t->yminusx[k] ^= (t->yminusx[k] ^ u->yminusx[k]) & mask;
+    t->xy2d[k] ^= (t->xy2d[k] ^ u->xy2d[k]) & mask;
+  }
+}
+
+static void comb_select(ge_precomp *t,int pos,signed char b)
+{
+  ge_precomp minust;
+  crypto_uint32 bnegative = ((crypto_uint32) (crypto_int32) b) >> 31;
+  crypto_uint32 babs = (crypto_uint32) (b - (((-(int) bnegative) & b) << 1));
+  crypto_int32 mask;
+  int j;
+  int k;
+
+  /* At most one entry matches, so OR-ing the masked entries selects it.
+     The loops are written out over the limbs rather than calling fe_cmov
+     so that the compiler can vectorize them: this scan is most of the
+     cost of a wide table. */
+  mask = -(crypto_int32) equal(babs,0);
+  for (k = 0;k < 10;++k) {
+    t->yplusx[k] = 0;
+    t->yminusx[k] = 0;
+    t->xy2d[k] = 0;
+  }
+  t->yplusx[0] = 1 & mask;
+  t->yminusx[0] = 1 & mask;
+  for (j = 0;j < COMB_ENTRIES;++j) {
+    const ge_precomp *u = &comb[pos][j];
+    mask = -(crypto_int32) equal(babs,j + 1);
+    for (k = 0;k < 10;++k) {
+      t->yplusx[k] |= u->yplusx[k] & mask;
+      t->yminusx[k] |= u->yminusx[k] & mask;
+      t->xy2d[k] |= u->xy2d[k] & mask;
+    }
+  }
+  fe_copy(minust.yplusx,t->yminusx);
+  fe_copy(minust.yminusx,t->yplusx);
+  fe_neg(minust.xy2d,t->xy2d);
+  cmov(t,&minust,bnegative);
+}
+
+static const fe d2 = {
+#include "d2.h"
+} ;
+
+static void comb_init(void)
+{
+  static const unsigned char one[32] = { 1 };
+  ge_p3 (*p)[COMB_ENTRIES];
+  fe *z;
+  fe acc;
+  fe t;
+  ge_cached c;
+  ge_p1p1 r;
+  ge_p2 s;
+  int n = COMB_DIGITS * COMB_ENTRIES;
+  int i;
+  int j;
+
+  p = malloc(sizeof(ge_p3) * n);
+  z = malloc(sizeof(fe) * n);
+  if (p == NULL || z == NULL) {
+    free(p);
+    free(z);
+    return;
+  }
+
+  ge_scalarmult_base(&p[0][0],one);
+  for (i = 0;i < COMB_DIGITS;++i) {
+    if (i > 0) {
+      /* p[i][0] = 2^5 * p[i-1][0] */
+      ge_p3_dbl(&r,&p[i - 1][0]);
+      for (j = 1;j < COMB_W;++j) {
+        ge_p1p1_to_p2(&s,&r);
+        ge_p2_dbl(&r,&s);
+      }
+      ge_p1p1_to_p3(&p[i][0],&r);
+    }
+    ge_p3_to_cached(&c,&p[i][0]);
+    for (j = 1;j < COMB_ENTRIES;++j) {
+      ge_add(&r,&p[i][j - 1],&c);
+      ge_p1p1_to_p3(&p[i][j],&r);
+    }
+  }
+
+  /* Montgomery's trick: z[k] = Z_0 * ... * Z_{k-1}, then one inversion */
+  fe_1(acc);
+  for (i = 0;i < n;++i) {
+    fe_copy(z[i],acc);
+    fe_mul(acc,acc,(&p[0][0])[i].Z);
+  }
+  fe_invert(acc,acc);
+  for (i = n - 1;i >= 0;--i) {
+    const ge_p3 *q = &(&p[0][0])[i];
+    ge_precomp *e = &(&comb[0][0])[i];
+
+    fe_mul(z[i],z[i],acc);
+    fe_mul(acc,acc,q->Z);
+
+    fe_add(t,q->Y,q->X); fe_mul(e->yplusx,t,z[i]);
+    fe_sub(t,q->Y,q->X); fe_mul(e->yminusx,t,z[i]);
+    fe_mul(t,q->T,z[i]); fe_mul(e->xy2d,t,d2);
+  }
+
+  free(p);
+  free(z);
+  comb_ready = 1;
+}
+
+/*
+h = a * B, as ge_scalarmult_base
+
+Preconditions:
+  a[31] <= 127
+*/
+
+void ge_scalarmult_base_comb(ge_p3 *h,const unsigned char *a)
+{
+  signed char e[COMB_DIGITS];
+  signed char carry;
+  ge_p1p1 r;
+  ge_precomp t;
+  int i;
+
+  pthread_once(&comb_once,comb_init);
+  if (!comb_ready) {
+    ge_scalarmult_base(h,a);
+    return;
+  }
+
+  for (i = 0;i < COMB_DIGITS;++i) {
+    int bit = COMB_W * i;
+    int v = a[bit >> 3] >> (bit & 7);
+    if ((bit >> 3) + 1 < 32) v |= a[(bit >> 3) + 1] << (8 - (bit & 7));
+    e[i] = v & (2 * COMB_ENTRIES - 1);
+  }
+  /* each e[i] is between 0 and 31 */
+  /* e[51] is 0 */
+
+  carry = 0;
+  for (i = 0;i < COMB_DIGITS - 1;++i) {
+    e[i] += carry;
+    carry = e[i] + COMB_ENTRIES;
+    carry >>= COMB_W;
+    e[i] -= carry << COMB_W;
+  }
+  e[COMB_DIGITS - 1] += carry;
+  /* each e[i] is between -16 and 16 */
+
+  ge_p3_0(h);
+  for (i = 0;i < COMB_DIGITS;++i) {
+    comb_select(&t,i,e[i]);
+    ge_madd(&r,h,&t); ge_p1p1_to_p3(h,&r);
+  }
+}
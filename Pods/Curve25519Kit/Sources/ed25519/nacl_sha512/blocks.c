@@ -69,7 +69,7 @@ static void store_bigendian(unsigned char *x,uint64 u)
   b = a; \
   a = T1 + T2;
 
-int crypto_hashblocks_sha512(unsigned char *statebytes,const unsigned char *in,unsigned long long inlen)
+static int blocks_ref(unsigned char *statebytes,const unsigned char *in,unsigned long long inlen)
 {
   uint64 state[8];
   uint64 a;
@@ -236,3 +236,182 @@ int crypto_hashblocks_sha512(unsigned char *statebytes,const unsigned char *in,u
 
   return 0;
 }
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(CRYPTO_SHA512_NO_SIMD)
+#define HAVE_BLOCKS_AVX2
+
+#include <immintrin.h>
+
+/*
+The message schedule of two blocks at a time in AVX2: each 128-bit lane
+holds a pair of consecutive words of one block, which suffices because
+w[t] and w[t+1] do not depend on each other.  The rounds stay scalar and
+read the precomputed w+k.
+*/
+
+static const uint64 K[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+} ;
+
+#define VROTR(x,c) _mm256_or_si256(_mm256_srli_epi64(x,c),_mm256_slli_epi64(x,64 - (c)))
+#define VSIGMA0(x) _mm256_xor_si256(_mm256_xor_si256(VROTR(x, 1),VROTR(x, 8)),_mm256_srli_epi64(x,7))
+#define VSIGMA1(x) _mm256_xor_si256(_mm256_xor_si256(VROTR(x,19),VROTR(x,61)),_mm256_srli_epi64(x,6))
+
+#define R(a,b,c,d,e,f,g,h,wk) \
+  T1 = h + Sigma1(e) + Ch(e,f,g) + (wk); \
+  d += T1; \
+  h = T1 + Sigma0(a) + Maj(a,b,c);
+
+#define VSTORE(x,t) \
+  w = _mm256_add_epi64(x,_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (K + (t))))); \
+  _mm_storeu_si128((__m128i *) (wk0 + (t)),_mm256_castsi256_si128(w)); \
+  _mm_storeu_si128((__m128i *) (wk1 + (t)),_mm256_extracti128_si256(w,1));
+
+/* x0 = w[t],w[t+1] becomes w[t+16],w[t+17] */
+#define VEXPAND(x0,x1,x4,x5,x7,t) \
+  VSTORE(x0,t) \
+  x0 = _mm256_add_epi64(x0,VSIGMA0(_mm256_alignr_epi8(x1,x0,8))); \
+  x0 = _mm256_add_epi64(x0,_mm256_alignr_epi8(x5,x4,8)); \
+  x0 = _mm256_add_epi64(x0,VSIGMA1(x7));
+
+#define VLOAD(i) \
+  _mm256_shuffle_epi8(_mm256_inserti128_si256( \
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (in0 + 16 * (i)))), \
+      _mm_loadu_si128((const __m128i *) (in1 + 16 * (i))),1),bswap)
+
+__attribute__((target("avx2")))
+static void schedule_x2_avx2(uint64 *wk0,uint64 *wk1,const unsigned char *in0,const unsigned char *in1)
+{
+  const __m256i bswap = _mm256_setr_epi8(
+      7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+      7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+  __m256i x0 = VLOAD(0);
+  __m256i x1 = VLOAD(1);
+  __m256i x2 = VLOAD(2);
+  __m256i x3 = VLOAD(3);
+  __m256i x4 = VLOAD(4);
+  __m256i x5 = VLOAD(5);
+  __m256i x6 = VLOAD(6);
+  __m256i x7 = VLOAD(7);
+  __m256i w;
+  int t;
+
+  for (t = 0;t < 64;t += 16) {
+    VEXPAND(x0,x1,x4,x5,x7,t +  0)
+    VEXPAND(x1,x2,x5,x6,x0,t +  2)
+    VEXPAND(x2,x3,x6,x7,x1,t +  4)
+    VEXPAND(x3,x4,x7,x0,x2,t +  6)
+    VEXPAND(x4,x5,x0,x1,x3,t +  8)
+    VEXPAND(x5,x6,x1,x2,x4,t + 10)
+    VEXPAND(x6,x7,x2,x3,x5,t + 12)
+    VEXPAND(x7,x0,x3,x4,x6,t + 14)
+  }
+  VSTORE(x0,64)
+  VSTORE(x1,66)
+  VSTORE(x2,68)
+  VSTORE(x3,70)
+  VSTORE(x4,72)
+  VSTORE(x5,74)
+  VSTORE(x6,76)
+  VSTORE(x7,78)
+}
+
+__attribute__((target("avx2,bmi2")))
+static void rounds(uint64 state[8],const uint64 *wk)
+{
+  uint64 a = state[0];
+  uint64 b = state[1];
+  uint64 c = state[2];
+  uint64 d = state[3];
+  uint64 e = state[4];
+  uint64 f = state[5];
+  uint64 g = state[6];
+  uint64 h = state[7];
+  uint64 T1;
+  int t;
+
+  for (t = 0;t < 80;t += 8) {
+    R(a,b,c,d,e,f,g,h,wk[t + 0])
+    R(h,a,b,c,d,e,f,g,wk[t + 1])
+    R(g,h,a,b,c,d,e,f,wk[t + 2])
+    R(f,g,h,a,b,c,d,e,wk[t + 3])
+    R(e,f,g,h,a,b,c,d,wk[t + 4])
+    R(d,e,f,g,h,a,b,c,wk[t + 5])
+    R(c,d,e,f,g,h,a,b,wk[t + 6])
+    R(b,c,d,e,f,g,h,a,wk[t + 7])
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+__attribute__((target("avx2,bmi2")))
+static int blocks_avx2(unsigned char *statebytes,const unsigned char *in,unsigned long long inlen)
+{
+  uint64 state[8];
+  uint64 wk0[80];
+  uint64 wk1[80];
+  int i;
+
+  for (i = 0;i < 8;++i) state[i] = load_bigendian(statebytes + 8 * i);
+
+  while (inlen >= 256) {
+    schedule_x2_avx2(wk0,wk1,in,in + 128);
+    rounds(state,wk0);
+    rounds(state,wk1);
+    in += 256;
+    inlen -= 256;
+  }
+  if (inlen >= 128) {
+    schedule_x2_avx2(wk0,wk1,in,in);
+    rounds(state,wk0);
+  }
+
+  for (i = 0;i < 8;++i) store_bigendian(statebytes + 8 * i,state[i]);
+
+  return 0;
+}
+
+#endif
+
+int crypto_hashblocks_sha512(unsigned char *statebytes,const unsigned char *in,unsigned long long inlen)
+{
+#ifdef HAVE_BLOCKS_AVX2
+  static int have_avx2 = -1;
+  int avx2 = __atomic_load_n(&have_avx2,__ATOMIC_RELAXED);
+
+  if (avx2 < 0) {
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+    __atomic_store_n(&have_avx2,avx2,__ATOMIC_RELAXED);
+  }
+  if (avx2) return blocks_avx2(statebytes,in,inlen);
+#endif
+  return blocks_ref(statebytes,in,inlen);
+}
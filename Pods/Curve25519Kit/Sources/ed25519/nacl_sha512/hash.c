@@ -5,6 +5,8 @@ Public domain.
 */
 
 #include <stdint.h>
+#include <string.h>
+#include "crypto_hash_sha512.h"
 typedef uint64_t uint64;
 
 extern int crypto_hashblocks_sha512(unsigned char *statebytes,const unsigned char *in,unsigned long long inlen);
@@ -22,21 +24,49 @@ static const unsigned char iv[64] = {
   0x5b,0xe0,0xcd,0x19,0x13,0x7e,0x21,0x79
 } ;
 
-int crypto_hash_sha512(unsigned char *out,const unsigned char *in,unsigned long long inlen)
+int crypto_hash_sha512_init(crypto_hash_sha512_state *state)
 {
-  unsigned char h[64];
-  unsigned char padded[256];
-  int i;
-  unsigned long long bytes = inlen;
+  memcpy(state->h,iv,64);
+  state->bytes = 0;
+  return 0;
+}
 
-  for (i = 0;i < 64;++i) h[i] = iv[i];
+int crypto_hash_sha512_update(crypto_hash_sha512_state *state,const unsigned char *in,unsigned long long inlen)
+{
+  unsigned long long have = state->bytes & 127;
+  unsigned long long take;
 
-  blocks(h,in,inlen);
-  in += inlen;
-  inlen &= 127;
-  in -= inlen;
+  state->bytes += inlen;
 
-  for (i = 0;i < inlen;++i) padded[i] = in[i];
+  if (have) {
+    take = 128 - have;
+    if (take > inlen) take = inlen;
+    memcpy(state->buf + have,in,take);
+    in += take;
+    inlen -= take;
+    if (have + take < 128) return 0;
+    blocks(state->h,state->buf,128);
+  }
+
+  /* Whole blocks straight from the input, without copying */
+  take = inlen & ~127ULL;
+  if (take) {
+    blocks(state->h,in,take);
+    in += take;
+    inlen -= take;
+  }
+  memcpy(state->buf,in,inlen);
+  return 0;
+}
+
+int crypto_hash_sha512_final(crypto_hash_sha512_state *state,unsigned char *out)
+{
+  unsigned char padded[256];
+  unsigned long long bytes = state->bytes;
+  unsigned long long inlen = bytes & 127;
+  int i;
+
+  for (i = 0;i < inlen;++i) padded[i] = state->buf[i];
   padded[inlen] = 0x80;
 
   if (inlen < 112) {
@@ -50,7 +80,7 @@ int crypto_hash_sha512(unsigned char *out,const unsigned char *in,unsigned long
     padded[125] = bytes >> 13;
     padded[126] = bytes >> 5;
     padded[127] = bytes << 3;
-    blocks(h,padded,128);
+    blocks(state->h,padded,128);
   } else {
     for (i = inlen + 1;i < 247;++i) padded[i] = 0;
     padded[247] = bytes >> 61;
@@ -62,10 +92,19 @@ int crypto_hash_sha512(unsigned char *out,const unsigned char *in,unsigned long
     padded[253] = bytes >> 13;
     padded[254] = bytes >> 5;
     padded[255] = bytes << 3;
-    blocks(h,padded,256);
+    blocks(state->h,padded,256);
   }
 
-  for (i = 0;i < 64;++i) out[i] = h[i];
+  for (i = 0;i < 64;++i) out[i] = state->h[i];
 
   return 0;
 }
+
+int crypto_hash_sha512(unsigned char *out,const unsigned char *in,unsigned long long inlen)
+{
+  crypto_hash_sha512_state state;
+
+  crypto_hash_sha512_init(&state);
+  crypto_hash_sha512_update(&state,in,inlen);
+  return crypto_hash_sha512_final(&state,out);
+}
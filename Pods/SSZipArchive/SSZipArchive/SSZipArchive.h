@@ -33,6 +33,8 @@ typedef NS_ENUM(NSInteger, SSZipArchiveErrorCode) {
 + (BOOL)isPasswordValidForArchiveAtPath:(NSString *)path password:(NSString *)pw error:(NSError * _Nullable * _Nullable)error NS_SWIFT_NOTHROW;
 
 // Unzip
+// entries are extracted on several threads, unless the delegate implements zipArchiveShouldUnzipFileAtIndex or
+// zipArchiveWillUnzipFileAtIndex; delegate and progress callbacks still come from the calling thread in archive order
 + (BOOL)unzipFileAtPath:(NSString *)path toDestination:(NSString *)destination;
 + (BOOL)unzipFileAtPath:(NSString *)path toDestination:(NSString *)destination delegate:(nullable id<SSZipArchiveDelegate>)delegate;
 
@@ -80,6 +82,21 @@ typedef NS_ENUM(NSInteger, SSZipArchiveErrorCode) {
         progressHandler:(void (^_Nullable)(NSString *entry, unz_file_info zipInfo, long entryNumber, long total))progressHandler
       completionHandler:(void (^_Nullable)(NSString *path, BOOL succeeded, NSError * _Nullable error))completionHandler;
 
+// memoryMapped maps the archive and inflates entries in place instead of reading them through a buffer; only use it
+// for archives nothing else writes to and that stay readable while unzipping, as a truncated file or a page locked by
+// data protection crashes the process with SIGBUS instead of failing
++ (BOOL)unzipFileAtPath:(NSString *)path
+          toDestination:(NSString *)destination
+     preserveAttributes:(BOOL)preserveAttributes
+              overwrite:(BOOL)overwrite
+         nestedZipLevel:(NSInteger)nestedZipLevel
+           memoryMapped:(BOOL)memoryMapped
+               password:(nullable NSString *)password
+                  error:(NSError **)error
+               delegate:(nullable id<SSZipArchiveDelegate>)delegate
+        progressHandler:(void (^_Nullable)(NSString *entry, unz_file_info zipInfo, long entryNumber, long total))progressHandler
+      completionHandler:(void (^_Nullable)(NSString *path, BOOL succeeded, NSError * _Nullable error))completionHandler;
+
 // Zip
 // default compression level is Z_DEFAULT_COMPRESSION (from "zlib.h")
 
@@ -107,9 +124,30 @@ typedef NS_ENUM(NSInteger, SSZipArchiveErrorCode) {
                         AES:(BOOL)aes
             progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler;
 
+// the methods above write the files one after another on the calling thread; these compress them on workers
+// threads, 0 for one per CPU (see openWithWorkers:memoryBudget:), or with 1 write them like the methods above
++ (BOOL)createZipFileAtPath:(NSString *)path withFilesAtPaths:(NSArray<NSString *> *)paths withPassword:(nullable NSString *)password workers:(NSUInteger)workers;
++ (BOOL)createZipFileAtPath:(NSString *)path
+    withContentsOfDirectory:(NSString *)directoryPath
+        keepParentDirectory:(BOOL)keepParentDirectory
+           compressionLevel:(int)compressionLevel
+                   password:(nullable NSString *)password
+                        AES:(BOOL)aes
+                    workers:(NSUInteger)workers
+            progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler;
+
 - (instancetype)init NS_UNAVAILABLE;
 - (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+/// store the files written from now on that deflate would not shrink, like photos and videos, instead of deflating
+/// them, deciding from the first 64 KB of each; NO by default, when every file is deflated at its compression level
+@property (nonatomic) BOOL storesIncompressibleFiles;
 - (BOOL)open;
+/// open for writing files with several threads compressing them, 0 workers for one per CPU; entries keep
+/// the order they were written in and at most memoryBudget bytes (0 for 64 MB) of compressed data wait in memory
+- (BOOL)openWithWorkers:(NSUInteger)workers memoryBudget:(unsigned long long)memoryBudget;
+/// as above, calling writtenHandler on the writing thread once for every file passed to writeFileAtPath:,
+/// when it is in the archive or has failed; writeFileAtPath: returns once a file is queued
+- (BOOL)openWithWorkers:(NSUInteger)workers memoryBudget:(unsigned long long)memoryBudget writtenHandler:(void (^_Nullable)(NSString *fileName, BOOL succeeded))writtenHandler;
 
 /// write empty folder
 - (BOOL)writeFolderAtPath:(NSString *)path withFolderName:(NSString *)folderName withPassword:(nullable NSString *)password;
@@ -123,6 +161,17 @@ typedef NS_ENUM(NSInteger, SSZipArchiveErrorCode) {
 
 - (BOOL)close;
 
+/// open an existing archive to read single entries; its central directory is indexed once here,
+/// so finding an entry takes constant time however many the archive holds
+- (BOOL)openForReading;
+- (BOOL)openForReadingCaseInsensitive:(BOOL)caseInsensitive;
+/// memoryMapped reads entries in place from a mapping of the archive, with the same caveats as unzipping mapped
+- (BOOL)openForReadingCaseInsensitive:(BOOL)caseInsensitive memoryMapped:(BOOL)memoryMapped;
+/// read one entry into memory
+- (nullable NSData *)dataForEntry:(NSString *)entryName password:(nullable NSString *)password error:(NSError * _Nullable * _Nullable)error;
+/// extract one entry to a file
+- (BOOL)extractEntry:(NSString *)entryName toPath:(NSString *)destinationPath password:(nullable NSString *)password error:(NSError * _Nullable * _Nullable)error;
+
 @end
 
 @protocol SSZipArchiveDelegate <NSObject>
@@ -9,6 +9,7 @@
 #import "SSZipArchive.h"
 #include "unzip.h"
 #include "zip.h"
+#include "ioapi_mmap.h"
 #include "minishared.h"
 
 #include <sys/stat.h>
@@ -17,9 +18,29 @@ NSString *const SSZipArchiveErrorDomain = @"SSZipArchiveErrorDomain";
 
 #define CHUNK 16384
 
-int _zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, int level, NSString *password, BOOL aes);
+uint16_t _zipMethod(int level, BOOL storeIncompressible);
+int _zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, int level, BOOL storeIncompressible, NSString *password, BOOL aes);
 BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
 
+/// outcome of unzipping one entry
+typedef NS_ENUM(int, SSZipEntryResult) {
+    /// reported to the delegate; stops the unzipping afterwards if the entry failed
+    SSZipEntryExtracted = 0,
+    /// resource fork, or existing file that is not overwritten
+    SSZipEntrySkipped,
+    /// stops the unzipping
+    SSZipEntryFailed,
+};
+
+/// blocks called back by unzExtractParallel
+typedef struct {
+    __unsafe_unretained int (^extract)(unzFile zip, uint64_t entryNumber);
+    __unsafe_unretained int (^done)(uint64_t entryNumber, int result);
+} SSUnzipCallbacks;
+static int _unzipExtractEntry(void *opaque, unzFile zip, uint64_t entryNumber);
+static int _unzipEntryDone(void *opaque, uint64_t entryNumber, int result);
+static void _zipEntryWritten(void *opaque, const char *filename, int err);
+
 #ifndef API_AVAILABLE
 // Xcode 7- compatibility
 #define API_AVAILABLE(...)
@@ -39,6 +60,11 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     /// path for zip file
     NSString *_path;
     zipFile _zip;
+    unzFile _unzip;
+    /// files are compressed by zipParallel workers
+    BOOL _parallel;
+    /// told about every file written with writeFileAtPath:
+    void (^_writtenHandler)(NSString *fileName, BOOL succeeded);
 }
 
 #pragma mark - Password check
@@ -227,6 +253,21 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
                delegate:(nullable id<SSZipArchiveDelegate>)delegate
         progressHandler:(void (^_Nullable)(NSString *entry, unz_file_info zipInfo, long entryNumber, long total))progressHandler
       completionHandler:(void (^_Nullable)(NSString *path, BOOL succeeded, NSError * _Nullable error))completionHandler
+{
+    return [self unzipFileAtPath:path toDestination:destination preserveAttributes:preserveAttributes overwrite:overwrite nestedZipLevel:nestedZipLevel memoryMapped:NO password:password error:error delegate:delegate progressHandler:progressHandler completionHandler:completionHandler];
+}
+
++ (BOOL)unzipFileAtPath:(NSString *)path
+          toDestination:(NSString *)destination
+     preserveAttributes:(BOOL)preserveAttributes
+              overwrite:(BOOL)overwrite
+         nestedZipLevel:(NSInteger)nestedZipLevel
+           memoryMapped:(BOOL)memoryMapped
+               password:(nullable NSString *)password
+                  error:(NSError **)error
+               delegate:(nullable id<SSZipArchiveDelegate>)delegate
+        progressHandler:(void (^_Nullable)(NSString *entry, unz_file_info zipInfo, long entryNumber, long total))progressHandler
+      completionHandler:(void (^_Nullable)(NSString *path, BOOL succeeded, NSError * _Nullable error))completionHandler
 {
     // Guard against empty strings
     if (path.length == 0 || destination.length == 0)
@@ -244,8 +285,19 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
         return NO;
     }
     
-    // Begin opening
-    zipFile zip = unzOpen(path.fileSystemRepresentation);
+    // Begin opening, mapped if asked so entries are inflated in place
+    zipFile zip = NULL;
+    if (memoryMapped)
+    {
+        zlib_filefunc64_map_def mmapFilefunc;
+        fill_mmap_filefunc64(&mmapFilefunc);
+        zip = unzOpenMapped64(path.fileSystemRepresentation, &mmapFilefunc, 0);
+    }
+    if (zip == NULL)
+    {
+        // not mapped, read it through stdio
+        zip = unzOpen64(path.fileSystemRepresentation);
+    }
     if (zip == NULL)
     {
         NSDictionary *userInfo = @{NSLocalizedDescriptionKey: @"failed to open zip file"};
@@ -263,7 +315,7 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     
     NSDictionary * fileAttributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
     unsigned long long fileSize = [[fileAttributes objectForKey:NSFileSize] unsignedLongLongValue];
-    unsigned long long currentPosition = 0;
+    __block unsigned long long currentPosition = 0;
     
     unz_global_info globalInfo = {};
     unzGetGlobalInfo(zip, &globalInfo);
@@ -286,12 +338,11 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
         return NO;
     }
     
-    BOOL success = YES;
-    BOOL canceled = NO;
-    int crc_ret = 0;
-    unsigned char buffer[4096] = {0};
-    NSFileManager *fileManager = [NSFileManager defaultManager];
+    __block BOOL success = YES;
+    __block BOOL canceled = NO;
+    __block int crc_ret = 0;
     NSMutableArray<NSDictionary *> *directoriesModificationDates = [[NSMutableArray alloc] init];
+    __block NSError *unzippingError;
     
     // Message delegate
     if ([delegate respondsToSelector:@selector(zipArchiveWillUnzipArchiveAtPath:zipInfo:)]) {
@@ -301,307 +352,131 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
         [delegate zipArchiveProgressEvent:currentPosition total:fileSize];
     }
     
-    NSInteger currentFileNumber = -1;
-    NSError *unzippingError;
-    do {
-        currentFileNumber++;
-        if (ret == UNZ_END_OF_LIST_OF_FILE)
-            break;
+    // Entries are extracted on several threads, each reading the archive through its own handle, unless the
+    // delegate has to be asked before each entry. Files are written to a staging directory inside the destination
+    // (so they get its data protection, and moving them is a rename), and put in place below in archive order:
+    // entries sharing a path, symbolic links and the entries beneath them are handled as if unzipped one by one,
+    // and nothing after the first failure reaches the destination.
+    BOOL askDelegate = [delegate respondsToSelector:@selector(zipArchiveShouldUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]
+        || [delegate respondsToSelector:@selector(zipArchiveWillUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)];
+    NSMutableDictionary<NSNumber *, NSMutableDictionary *> *entries = [[NSMutableDictionary alloc] init];
+    NSString *stagingPath = [destination stringByAppendingPathComponent:[@".SSZipArchive-" stringByAppendingString:[NSUUID UUID].UUIDString]];
+    NSError *stagingError = nil;
+    if (globalInfo.number_entry > 0
+        && ![[NSFileManager defaultManager] createDirectoryAtPath:stagingPath withIntermediateDirectories:YES attributes:nil error:&stagingError]) {
+        unzippingError = stagingError;
+        success = NO;
+    }
+    
+    int (^extractEntry)(unzFile, uint64_t) = ^int(unzFile entryZip, uint64_t entryNumber) {
         @autoreleasepool {
-            if (password.length == 0) {
-                ret = unzOpenCurrentFile(zip);
-            } else {
-                ret = unzOpenCurrentFilePassword(zip, [password cStringUsingEncoding:NSUTF8StringEncoding]);
+            NSMutableDictionary *entry = [[NSMutableDictionary alloc] init];
+            int result = [self _unzipCurrentEntryOf:entryZip
+                                        entryNumber:(NSInteger)entryNumber
+                                         totalFiles:(NSInteger)globalInfo.number_entry
+                                        archivePath:path
+                                      toDestination:destination
+                                        stagingPath:stagingPath
+                                 preserveAttributes:preserveAttributes
+                                          overwrite:overwrite
+                                     nestedZipLevel:nestedZipLevel
+                                           password:password
+                                           delegate:askDelegate ? delegate : nil
+                                              entry:entry];
+            @synchronized (entries) {
+                entries[@(entryNumber)] = entry;
             }
-            
-            if (ret != UNZ_OK) {
-                unzippingError = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"failed to open file in zip file"}];
-                success = NO;
-                break;
+            return result;
+        }
+    };
+    
+    int (^entryDone)(uint64_t, int) = ^int(uint64_t entryNumber, int result) {
+        @autoreleasepool {
+            NSMutableDictionary *entry;
+            @synchronized (entries) {
+                entry = entries[@(entryNumber)];
+                [entries removeObjectForKey:@(entryNumber)];
+            }
+            if (entry) {
+                result = [self _placeEntry:entry
+                                    result:(SSZipEntryResult)result
+                                 overwrite:overwrite
+                        preserveAttributes:preserveAttributes
+                            nestedZipLevel:nestedZipLevel
+                                  password:password];
             }
             
-            // Reading data and write to file
+            NSValue *fileInfoValue = entry[@"fileInfo"];
             unz_file_info fileInfo;
             memset(&fileInfo, 0, sizeof(unz_file_info));
-            
-            ret = unzGetCurrentFileInfo(zip, &fileInfo, NULL, 0, NULL, 0, NULL, 0);
-            if (ret != UNZ_OK) {
-                unzippingError = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFileInfoNotLoadable userInfo:@{NSLocalizedDescriptionKey: @"failed to retrieve info for file"}];
-                success = NO;
-                unzCloseCurrentFile(zip);
-                break;
-            }
-            
-            currentPosition += fileInfo.compressed_size;
-            
-            // Message delegate
-            if ([delegate respondsToSelector:@selector(zipArchiveShouldUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]) {
-                if (![delegate zipArchiveShouldUnzipFileAtIndex:currentFileNumber
-                                                     totalFiles:(NSInteger)globalInfo.number_entry
-                                                    archivePath:path
-                                                       fileInfo:fileInfo]) {
-                    success = NO;
-                    canceled = YES;
-                    break;
+            if (fileInfoValue) {
+                [fileInfoValue getValue:&fileInfo];
+                currentPosition += fileInfo.compressed_size;
+                
+                // Message delegate
+                if ([delegate respondsToSelector:@selector(zipArchiveProgressEvent:total:)]) {
+                    [delegate zipArchiveProgressEvent:(NSInteger)currentPosition total:(NSInteger)fileSize];
                 }
             }
-            if ([delegate respondsToSelector:@selector(zipArchiveWillUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]) {
-                [delegate zipArchiveWillUnzipFileAtIndex:currentFileNumber totalFiles:(NSInteger)globalInfo.number_entry
-                                             archivePath:path fileInfo:fileInfo];
+            if (entry[@"modDate"]) {
+                [directoriesModificationDates addObject:@{@"path": entry[@"fullPath"], @"modDate": entry[@"modDate"]}];
             }
-            if ([delegate respondsToSelector:@selector(zipArchiveProgressEvent:total:)]) {
-                [delegate zipArchiveProgressEvent:(NSInteger)currentPosition total:(NSInteger)fileSize];
+            if (entry[@"error"]) {
+                unzippingError = entry[@"error"];
             }
-            
-            char *filename = (char *)malloc(fileInfo.size_filename + 1);
-            if (filename == NULL)
-            {
-                success = NO;
-                break;
+            if ([entry[@"crcError"] boolValue]) {
+                crc_ret = UNZ_CRCERROR;
             }
-            
-            unzGetCurrentFileInfo(zip, &fileInfo, filename, fileInfo.size_filename + 1, NULL, 0, NULL, 0);
-            filename[fileInfo.size_filename] = '\0';
-            
-            BOOL fileIsSymbolicLink = _fileIsSymbolicLink(&fileInfo);
-            
-            NSString * strPath = [SSZipArchive _filenameStringWithCString:filename
-                                                          version_made_by:fileInfo.version
-                                                     general_purpose_flag:fileInfo.flag
-                                                                     size:fileInfo.size_filename];
-            if ([strPath hasPrefix:@"__MACOSX/"]) {
-                // ignoring resource forks: https://superuser.com/questions/104500/what-is-macosx-folder
-                unzCloseCurrentFile(zip);
-                ret = unzGoToNextFile(zip);
-                free(filename);
-                continue;
+            if ([entry[@"canceled"] boolValue]) {
+                canceled = YES;
             }
-            if (!strPath.length) {
-                // if filename data is unsalvageable, we default to currentFileNumber
-                strPath = @(currentFileNumber).stringValue;
-            }
-            
-            // Check if it contains directory
-            BOOL isDirectory = NO;
-            if (filename[fileInfo.size_filename-1] == '/' || filename[fileInfo.size_filename-1] == '\\') {
-                isDirectory = YES;
-            }
-            free(filename);
             
-            // Contains a path
-            if ([strPath rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@"/\\"]].location != NSNotFound) {
-                strPath = [strPath stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+            if (result == SSZipEntrySkipped) {
+                return 0;
             }
-            
-            // Sanitize path traversal characters if they're present in the file name to prevent directory backtracking. Ignoring these characters mimicks the default behavior of the Unarchiving tool on macOS.
-            if ([strPath rangeOfString:@"../"].location != NSNotFound) {
-                // "../../../../../../../../../../../tmp/test.txt" -> "tmp/test.txt"
-                strPath = [[[NSURL URLWithString:strPath] standardizedURL] absoluteString];
-            }
-            
-            NSString *fullPath = [destination stringByAppendingPathComponent:strPath];
-            NSError *err = nil;
-            NSDictionary *directoryAttr;
-            if (preserveAttributes) {
-                NSDate *modDate = [[self class] _dateWithMSDOSFormat:(UInt32)fileInfo.dos_date];
-                directoryAttr = @{NSFileCreationDate: modDate, NSFileModificationDate: modDate};
-                [directoriesModificationDates addObject: @{@"path": fullPath, @"modDate": modDate}];
-            }
-            if (isDirectory) {
-                [fileManager createDirectoryAtPath:fullPath withIntermediateDirectories:YES attributes:directoryAttr error:&err];
-            } else {
-                [fileManager createDirectoryAtPath:fullPath.stringByDeletingLastPathComponent withIntermediateDirectories:YES attributes:directoryAttr error:&err];
-            }
-            if (err != nil) {
-                if ([err.domain isEqualToString:NSCocoaErrorDomain] &&
-                    err.code == 640) {
-                    unzippingError = err;
-                    unzCloseCurrentFile(zip);
-                    success = NO;
-                    break;
+            if (result != SSZipEntryExtracted) {
+                if (!entry) {
+                    // the entry could not be located in the archive
+                    unzippingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"failed to open file in zip file"}];
                 }
-                NSLog(@"[SSZipArchive] Error: %@", err.localizedDescription);
-            }
-            
-            if ([fileManager fileExistsAtPath:fullPath] && !isDirectory && !overwrite) {
-                //FIXME: couldBe CRC Check?
-                unzCloseCurrentFile(zip);
-                ret = unzGoToNextFile(zip);
-                continue;
-            }
-            
-            if (isDirectory && !fileIsSymbolicLink) {
-                // nothing to read/write for a directory
-            } else if (!fileIsSymbolicLink) {
-                // ensure we are not creating stale file entries
-                int readBytes = unzReadCurrentFile(zip, buffer, 4096);
-                if (readBytes >= 0) {
-                    FILE *fp = fopen(fullPath.fileSystemRepresentation, "wb");
-                    while (fp) {
-                        if (readBytes > 0) {
-                            if (0 == fwrite(buffer, readBytes, 1, fp)) {
-                                if (ferror(fp)) {
-                                    NSString *message = [NSString stringWithFormat:@"Failed to write file (check your free space)"];
-                                    NSLog(@"[SSZipArchive] %@", message);
-                                    success = NO;
-                                    unzippingError = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFailedToWriteFile userInfo:@{NSLocalizedDescriptionKey: message}];
-                                    break;
-                                }
-                            }
-                        } else {
-                            break;
-                        }
-                        readBytes = unzReadCurrentFile(zip, buffer, 4096);
-                        if (readBytes < 0) {
-                            // Let's assume error Z_DATA_ERROR is caused by an invalid password
-                            // Let's assume other errors are caused by Content Not Readable
-                            success = NO;
-                        }
-                    }
-                    
-                    if (fp) {
-                        fclose(fp);
-                        
-                        if (nestedZipLevel
-                            && [fullPath.pathExtension.lowercaseString isEqualToString:@"zip"]
-                            && [self unzipFileAtPath:fullPath
-                                       toDestination:fullPath.stringByDeletingLastPathComponent
-                                  preserveAttributes:preserveAttributes
-                                           overwrite:overwrite
-                                      nestedZipLevel:nestedZipLevel - 1
-                                            password:password
-                                               error:nil
-                                            delegate:nil
-                                     progressHandler:nil
-                                   completionHandler:nil]) {
-                            [directoriesModificationDates removeLastObject];
-                            [[NSFileManager defaultManager] removeItemAtPath:fullPath error:nil];
-                        } else if (preserveAttributes) {
-                            
-                            // Set the original datetime property
-                            if (fileInfo.dos_date != 0) {
-                                NSDate *orgDate = [[self class] _dateWithMSDOSFormat:(UInt32)fileInfo.dos_date];
-                                NSDictionary *attr = @{NSFileModificationDate: orgDate};
-                                
-                                if (attr) {
-                                    if (![fileManager setAttributes:attr ofItemAtPath:fullPath error:nil]) {
-                                        // Can't set attributes
-                                        NSLog(@"[SSZipArchive] Failed to set attributes - whilst setting modification date");
-                                    }
-                                }
-                            }
-                            
-                            // Set the original permissions on the file (+read/write to solve #293)
-                            uLong permissions = fileInfo.external_fa >> 16 | 0b110000000;
-                            if (permissions != 0) {
-                                // Store it into a NSNumber
-                                NSNumber *permissionsValue = @(permissions);
-                                
-                                // Retrieve any existing attributes
-                                NSMutableDictionary *attrs = [[NSMutableDictionary alloc] initWithDictionary:[fileManager attributesOfItemAtPath:fullPath error:nil]];
-                                
-                                // Set the value in the attributes dict
-                                [attrs setObject:permissionsValue forKey:NSFilePosixPermissions];
-                                
-                                // Update attributes
-                                if (![fileManager setAttributes:attrs ofItemAtPath:fullPath error:nil]) {
-                                    // Unable to set the permissions attribute
-                                    NSLog(@"[SSZipArchive] Failed to set attributes - whilst setting permissions");
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // if we couldn't open file descriptor we can validate global errno to see the reason
-                        if (errno == ENOSPC) {
-                            NSError *enospcError = [NSError errorWithDomain:NSPOSIXErrorDomain
-                                                                       code:ENOSPC
-                                                                   userInfo:nil];
-                            unzippingError = enospcError;
-                            unzCloseCurrentFile(zip);
-                            success = NO;
-                            break;
-                        }
-                    }
-                } else {
-                    // Let's assume error Z_DATA_ERROR is caused by an invalid password
-                    // Let's assume other errors are caused by Content Not Readable
-                    success = NO;
-                    break;
-                }
-            }
-            else
-            {
-                // Assemble the path for the symbolic link
-                NSMutableString *destinationPath = [NSMutableString string];
-                int bytesRead = 0;
-                while ((bytesRead = unzReadCurrentFile(zip, buffer, 4096)) > 0)
-                {
-                    buffer[bytesRead] = 0;
-                    [destinationPath appendString:@((const char *)buffer)];
-                }
-                if (bytesRead < 0) {
-                    // Let's assume error Z_DATA_ERROR is caused by an invalid password
-                    // Let's assume other errors are caused by Content Not Readable
-                    success = NO;
-                    break;
-                }
-                
-                // Check if the symlink exists and delete it if we're overwriting
-                if (overwrite)
-                {
-                    if ([fileManager fileExistsAtPath:fullPath])
-                    {
-                        NSError *error = nil;
-                        BOOL removeSuccess = [fileManager removeItemAtPath:fullPath error:&error];
-                        if (!removeSuccess)
-                        {
-                            NSString *message = [NSString stringWithFormat:@"Failed to delete existing symbolic link at \"%@\"", error.localizedDescription];
-                            NSLog(@"[SSZipArchive] %@", message);
-                            success = NO;
-                            unzippingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:error.code userInfo:@{NSLocalizedDescriptionKey: message}];
-                        }
-                    }
-                }
-                
-                // Create the symbolic link (making sure it stays relative if it was relative before)
-                int symlinkError = symlink([destinationPath cStringUsingEncoding:NSUTF8StringEncoding],
-                                           [fullPath cStringUsingEncoding:NSUTF8StringEncoding]);
-                
-                if (symlinkError != 0)
-                {
-                    // Bubble the error up to the completion handler
-                    NSString *message = [NSString stringWithFormat:@"Failed to create symbolic link at \"%@\" to \"%@\" - symlink() error code: %d", fullPath, destinationPath, errno];
-                    NSLog(@"[SSZipArchive] %@", message);
-                    success = NO;
-                    unzippingError = [NSError errorWithDomain:NSPOSIXErrorDomain code:symlinkError userInfo:@{NSLocalizedDescriptionKey: message}];
-                }
-            }
-            
-            crc_ret = unzCloseCurrentFile(zip);
-            if (crc_ret == UNZ_CRCERROR) {
-                // CRC ERROR
                 success = NO;
-                break;
+                return 1;
             }
-            ret = unzGoToNextFile(zip);
             
             // Message delegate
             if ([delegate respondsToSelector:@selector(zipArchiveDidUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]) {
-                [delegate zipArchiveDidUnzipFileAtIndex:currentFileNumber totalFiles:(NSInteger)globalInfo.number_entry
+                [delegate zipArchiveDidUnzipFileAtIndex:(NSInteger)entryNumber totalFiles:(NSInteger)globalInfo.number_entry
                                             archivePath:path fileInfo:fileInfo];
             } else if ([delegate respondsToSelector: @selector(zipArchiveDidUnzipFileAtIndex:totalFiles:archivePath:unzippedFilePath:)]) {
-                [delegate zipArchiveDidUnzipFileAtIndex: currentFileNumber totalFiles: (NSInteger)globalInfo.number_entry
-                                            archivePath:path unzippedFilePath: fullPath];
+                [delegate zipArchiveDidUnzipFileAtIndex: (NSInteger)entryNumber totalFiles: (NSInteger)globalInfo.number_entry
+                                            archivePath:path unzippedFilePath: entry[@"fullPath"]];
             }
             
             if (progressHandler)
             {
-                progressHandler(strPath, fileInfo, currentFileNumber, globalInfo.number_entry);
+                progressHandler(entry[@"path"], fileInfo, (long)entryNumber, globalInfo.number_entry);
+            }
+            
+            // an entry that was written but failed stops the unzipping once it is reported
+            if ([entry[@"failed"] boolValue]) {
+                success = NO;
+                return 1;
             }
+            return 0;
         }
-    } while (ret == UNZ_OK && success);
+    };
+    
+    if (success) {
+        SSUnzipCallbacks callbacks = { extractEntry, entryDone };
+        ret = unzExtractParallel(zip, path.fileSystemRepresentation, NULL, askDelegate ? 1 : 0, _unzipExtractEntry, _unzipEntryDone, &callbacks);
+        if (ret != UNZ_OK && ret != 1 && success) {
+            // the central directory could not be read, or the archive could not be reopened for the workers
+            unzippingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"failed to open file in zip file"}];
+            success = NO;
+        }
+        // files of entries still in flight when the unzipping stopped
+        [[NSFileManager defaultManager] removeItemAtPath:stagingPath error:nil];
+    }
     
     // Close
     unzClose(zip);
@@ -658,6 +533,351 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     return success;
 }
 
+// Unzips the current entry of *zip*, on any thread, into *stagingPath*. What the caller reports or needs afterwards,
+// including what _placeEntry: puts in the destination, is stored in *entry*.
++ (SSZipEntryResult)_unzipCurrentEntryOf:(unzFile)zip
+                             entryNumber:(NSInteger)currentFileNumber
+                              totalFiles:(NSInteger)totalFiles
+                             archivePath:(NSString *)path
+                           toDestination:(NSString *)destination
+                             stagingPath:(NSString *)stagingPath
+                      preserveAttributes:(BOOL)preserveAttributes
+                               overwrite:(BOOL)overwrite
+                          nestedZipLevel:(NSInteger)nestedZipLevel
+                                password:(nullable NSString *)password
+                                delegate:(nullable id<SSZipArchiveDelegate>)delegate
+                                   entry:(NSMutableDictionary *)entry
+{
+    int ret;
+    unsigned char buffer[4096] = {0};
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    
+    if (password.length == 0) {
+        ret = unzOpenCurrentFile(zip);
+    } else {
+        ret = unzOpenCurrentFilePassword(zip, [password cStringUsingEncoding:NSUTF8StringEncoding]);
+    }
+    
+    if (ret != UNZ_OK) {
+        entry[@"error"] = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"failed to open file in zip file"}];
+        return SSZipEntryFailed;
+    }
+    
+    // Reading data and write to file
+    unz_file_info fileInfo;
+    memset(&fileInfo, 0, sizeof(unz_file_info));
+    
+    ret = unzGetCurrentFileInfo(zip, &fileInfo, NULL, 0, NULL, 0, NULL, 0);
+    if (ret != UNZ_OK) {
+        entry[@"error"] = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFileInfoNotLoadable userInfo:@{NSLocalizedDescriptionKey: @"failed to retrieve info for file"}];
+        unzCloseCurrentFile(zip);
+        return SSZipEntryFailed;
+    }
+    
+    entry[@"fileInfo"] = [NSValue valueWithBytes:&fileInfo objCType:@encode(unz_file_info)];
+    
+    // Message delegate (only passed when entries are unzipped one at a time, on the calling thread)
+    if ([delegate respondsToSelector:@selector(zipArchiveShouldUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]) {
+        if (![delegate zipArchiveShouldUnzipFileAtIndex:currentFileNumber
+                                             totalFiles:totalFiles
+                                            archivePath:path
+                                               fileInfo:fileInfo]) {
+            entry[@"canceled"] = @YES;
+            return SSZipEntryFailed;
+        }
+    }
+    if ([delegate respondsToSelector:@selector(zipArchiveWillUnzipFileAtIndex:totalFiles:archivePath:fileInfo:)]) {
+        [delegate zipArchiveWillUnzipFileAtIndex:currentFileNumber totalFiles:totalFiles
+                                     archivePath:path fileInfo:fileInfo];
+    }
+    
+    char *filename = (char *)malloc(fileInfo.size_filename + 1);
+    if (filename == NULL)
+    {
+        return SSZipEntryFailed;
+    }
+    
+    unzGetCurrentFileInfo(zip, &fileInfo, filename, fileInfo.size_filename + 1, NULL, 0, NULL, 0);
+    filename[fileInfo.size_filename] = '\0';
+    
+    BOOL fileIsSymbolicLink = _fileIsSymbolicLink(&fileInfo);
+    
+    NSString * strPath = [SSZipArchive _filenameStringWithCString:filename
+                                                  version_made_by:fileInfo.version
+                                             general_purpose_flag:fileInfo.flag
+                                                             size:fileInfo.size_filename];
+    if ([strPath hasPrefix:@"__MACOSX/"]) {
+        // ignoring resource forks: https://superuser.com/questions/104500/what-is-macosx-folder
+        unzCloseCurrentFile(zip);
+        free(filename);
+        return SSZipEntrySkipped;
+    }
+    if (!strPath.length) {
+        // if filename data is unsalvageable, we default to currentFileNumber
+        strPath = @(currentFileNumber).stringValue;
+    }
+    
+    // Check if it contains directory
+    BOOL isDirectory = NO;
+    if (filename[fileInfo.size_filename-1] == '/' || filename[fileInfo.size_filename-1] == '\\') {
+        isDirectory = YES;
+    }
+    free(filename);
+    
+    // Contains a path
+    if ([strPath rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@"/\\"]].location != NSNotFound) {
+        strPath = [strPath stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+    }
+    
+    // Sanitize path traversal characters if they're present in the file name to prevent directory backtracking. Ignoring these characters mimicks the default behavior of the Unarchiving tool on macOS.
+    if ([strPath rangeOfString:@"../"].location != NSNotFound) {
+        // "../../../../../../../../../../../tmp/test.txt" -> "tmp/test.txt"
+        strPath = [[[NSURL URLWithString:strPath] standardizedURL] absoluteString];
+    }
+    
+    NSString *fullPath = [destination stringByAppendingPathComponent:strPath];
+    entry[@"path"] = strPath;
+    entry[@"fullPath"] = fullPath;
+    entry[@"isDirectory"] = @(isDirectory);
+    entry[@"isSymbolicLink"] = @(fileIsSymbolicLink);
+    if (preserveAttributes) {
+        entry[@"modDate"] = [[self class] _dateWithMSDOSFormat:(UInt32)fileInfo.dos_date];
+    }
+    
+    // When not overwriting, only nested archives are removed once written, so any other existing file would make
+    // _placeEntry: skip the entry as well
+    BOOL mayBeRemoved = nestedZipLevel && [fullPath.pathExtension.lowercaseString isEqualToString:@"zip"];
+    if ([fileManager fileExistsAtPath:fullPath] && !isDirectory && !overwrite && !mayBeRemoved) {
+        //FIXME: couldBe CRC Check?
+        unzCloseCurrentFile(zip);
+        return SSZipEntrySkipped;
+    }
+    
+    if (isDirectory && !fileIsSymbolicLink) {
+        // nothing to read/write for a directory
+    } else if (!fileIsSymbolicLink) {
+        // ensure we are not creating stale file entries
+        NSString *stagedPath = [stagingPath stringByAppendingPathComponent:@(currentFileNumber).stringValue];
+        int readBytes = unzReadCurrentFile(zip, buffer, 4096);
+        if (readBytes >= 0) {
+            FILE *fp = fopen(stagedPath.fileSystemRepresentation, "wb");
+            while (fp) {
+                if (readBytes > 0) {
+                    if (0 == fwrite(buffer, readBytes, 1, fp)) {
+                        if (ferror(fp)) {
+                            NSString *message = [NSString stringWithFormat:@"Failed to write file (check your free space)"];
+                            NSLog(@"[SSZipArchive] %@", message);
+                            entry[@"failed"] = @YES;
+                            entry[@"error"] = [NSError errorWithDomain:@"SSZipArchiveErrorDomain" code:SSZipArchiveErrorCodeFailedToWriteFile userInfo:@{NSLocalizedDescriptionKey: message}];
+                            break;
+                        }
+                    }
+                } else {
+                    break;
+                }
+                readBytes = unzReadCurrentFile(zip, buffer, 4096);
+                if (readBytes < 0) {
+                    // Let's assume error Z_DATA_ERROR is caused by an invalid password
+                    // Let's assume other errors are caused by Content Not Readable
+                    entry[@"failed"] = @YES;
+                }
+            }
+            
+            if (fp) {
+                fclose(fp);
+                entry[@"stagedPath"] = stagedPath;
+                
+                if (preserveAttributes) {
+                    
+                    // Set the original datetime property
+                    if (fileInfo.dos_date != 0) {
+                        NSDate *orgDate = [[self class] _dateWithMSDOSFormat:(UInt32)fileInfo.dos_date];
+                        NSDictionary *attr = @{NSFileModificationDate: orgDate};
+                        
+                        if (attr) {
+                            if (![fileManager setAttributes:attr ofItemAtPath:stagedPath error:nil]) {
+                                // Can't set attributes
+                                NSLog(@"[SSZipArchive] Failed to set attributes - whilst setting modification date");
+                            }
+                        }
+                    }
+                    
+                    // Set the original permissions on the file (+read/write to solve #293)
+                    uLong permissions = fileInfo.external_fa >> 16 | 0b110000000;
+                    if (permissions != 0) {
+                        // Store it into a NSNumber
+                        NSNumber *permissionsValue = @(permissions);
+                        
+                        // Retrieve any existing attributes
+                        NSMutableDictionary *attrs = [[NSMutableDictionary alloc] initWithDictionary:[fileManager attributesOfItemAtPath:stagedPath error:nil]];
+                        
+                        // Set the value in the attributes dict
+                        [attrs setObject:permissionsValue forKey:NSFilePosixPermissions];
+                        
+                        // Update attributes
+                        if (![fileManager setAttributes:attrs ofItemAtPath:stagedPath error:nil]) {
+                            // Unable to set the permissions attribute
+                            NSLog(@"[SSZipArchive] Failed to set attributes - whilst setting permissions");
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // if we couldn't open file descriptor we can validate global errno to see the reason
+                if (errno == ENOSPC) {
+                    NSError *enospcError = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                                               code:ENOSPC
+                                                           userInfo:nil];
+                    entry[@"error"] = enospcError;
+                    unzCloseCurrentFile(zip);
+                    return SSZipEntryFailed;
+                }
+            }
+        } else {
+            // Let's assume error Z_DATA_ERROR is caused by an invalid password
+            // Let's assume other errors are caused by Content Not Readable
+            unzCloseCurrentFile(zip);
+            return SSZipEntryFailed;
+        }
+    }
+    else
+    {
+        // Assemble the path for the symbolic link
+        NSMutableString *destinationPath = [NSMutableString string];
+        int bytesRead = 0;
+        while ((bytesRead = unzReadCurrentFile(zip, buffer, 4096)) > 0)
+        {
+            buffer[bytesRead] = 0;
+            [destinationPath appendString:@((const char *)buffer)];
+        }
+        if (bytesRead < 0) {
+            // Let's assume error Z_DATA_ERROR is caused by an invalid password
+            // Let's assume other errors are caused by Content Not Readable
+            unzCloseCurrentFile(zip);
+            return SSZipEntryFailed;
+        }
+        entry[@"linkTarget"] = destinationPath;
+    }
+    
+    if (unzCloseCurrentFile(zip) == UNZ_CRCERROR) {
+        // CRC ERROR
+        entry[@"crcError"] = @YES;
+        return SSZipEntryFailed;
+    }
+    return SSZipEntryExtracted;
+}
+
+// Puts an entry read by _unzipCurrentEntryOf: in place in the destination: creates its directories, moves its staged
+// file or creates its symbolic link. Called on the calling thread in archive order, so entries with the same path,
+// symbolic links and the entries beneath them end up as if the archive had been unzipped one entry at a time.
++ (SSZipEntryResult)_placeEntry:(NSMutableDictionary *)entry
+                         result:(SSZipEntryResult)result
+                      overwrite:(BOOL)overwrite
+             preserveAttributes:(BOOL)preserveAttributes
+                 nestedZipLevel:(NSInteger)nestedZipLevel
+                       password:(nullable NSString *)password
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *fullPath = entry[@"fullPath"];
+    NSString *stagedPath = entry[@"stagedPath"];
+    BOOL isDirectory = [entry[@"isDirectory"] boolValue];
+    
+    if (!fullPath) {
+        // failed or skipped before its path was known
+        return result;
+    }
+    
+    NSError *err = nil;
+    NSDictionary *directoryAttr;
+    NSDate *modDate = entry[@"modDate"];
+    if (modDate) {
+        directoryAttr = @{NSFileCreationDate: modDate, NSFileModificationDate: modDate};
+    }
+    if (isDirectory) {
+        [fileManager createDirectoryAtPath:fullPath withIntermediateDirectories:YES attributes:directoryAttr error:&err];
+    } else {
+        [fileManager createDirectoryAtPath:fullPath.stringByDeletingLastPathComponent withIntermediateDirectories:YES attributes:directoryAttr error:&err];
+    }
+    if (err != nil) {
+        if ([err.domain isEqualToString:NSCocoaErrorDomain] &&
+            err.code == 640) {
+            entry[@"error"] = err;
+            return SSZipEntryFailed;
+        }
+        NSLog(@"[SSZipArchive] Error: %@", err.localizedDescription);
+    }
+    
+    if (result == SSZipEntrySkipped) {
+        return result;
+    }
+    if ([fileManager fileExistsAtPath:fullPath] && !isDirectory && !overwrite) {
+        // written by an earlier entry with the same path
+        return SSZipEntrySkipped;
+    }
+    
+    if (stagedPath) {
+        if (rename(stagedPath.fileSystemRepresentation, fullPath.fileSystemRepresentation) != 0) {
+            if (errno == ENOSPC) {
+                entry[@"error"] = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOSPC userInfo:nil];
+                return SSZipEntryFailed;
+            }
+            NSLog(@"[SSZipArchive] Failed to move file to \"%@\" - rename() error code: %d", fullPath, errno);
+            stagedPath = nil;
+        }
+    } else if (entry[@"linkTarget"]) {
+        NSString *destinationPath = entry[@"linkTarget"];
+        
+        // Check if the symlink exists and delete it if we're overwriting
+        if (overwrite)
+        {
+            if ([fileManager fileExistsAtPath:fullPath])
+            {
+                NSError *error = nil;
+                BOOL removeSuccess = [fileManager removeItemAtPath:fullPath error:&error];
+                if (!removeSuccess)
+                {
+                    NSString *message = [NSString stringWithFormat:@"Failed to delete existing symbolic link at \"%@\"", error.localizedDescription];
+                    NSLog(@"[SSZipArchive] %@", message);
+                    entry[@"failed"] = @YES;
+                    entry[@"error"] = [NSError errorWithDomain:SSZipArchiveErrorDomain code:error.code userInfo:@{NSLocalizedDescriptionKey: message}];
+                }
+            }
+        }
+        
+        // Create the symbolic link (making sure it stays relative if it was relative before)
+        int symlinkError = symlink([destinationPath cStringUsingEncoding:NSUTF8StringEncoding],
+                                   [fullPath cStringUsingEncoding:NSUTF8StringEncoding]);
+        
+        if (symlinkError != 0)
+        {
+            // Bubble the error up to the completion handler
+            NSString *message = [NSString stringWithFormat:@"Failed to create symbolic link at \"%@\" to \"%@\" - symlink() error code: %d", fullPath, destinationPath, errno];
+            NSLog(@"[SSZipArchive] %@", message);
+            entry[@"failed"] = @YES;
+            entry[@"error"] = [NSError errorWithDomain:NSPOSIXErrorDomain code:symlinkError userInfo:@{NSLocalizedDescriptionKey: message}];
+        }
+    }
+    
+    if (stagedPath
+        && nestedZipLevel
+        && [fullPath.pathExtension.lowercaseString isEqualToString:@"zip"]
+        && [self unzipFileAtPath:fullPath
+                   toDestination:fullPath.stringByDeletingLastPathComponent
+              preserveAttributes:preserveAttributes
+                       overwrite:overwrite
+                  nestedZipLevel:nestedZipLevel - 1
+                        password:password
+                           error:nil
+                        delegate:nil
+                 progressHandler:nil
+               completionHandler:nil]) {
+        [entry removeObjectForKey:@"modDate"];
+        [fileManager removeItemAtPath:fullPath error:nil];
+    }
+    return result;
+}
+
 #pragma mark - Zipping
 + (BOOL)createZipFileAtPath:(NSString *)path withFilesAtPaths:(NSArray<NSString *> *)paths
 {
@@ -672,12 +892,29 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
 }
 
 + (BOOL)createZipFileAtPath:(NSString *)path withFilesAtPaths:(NSArray<NSString *> *)paths withPassword:(NSString *)password
+{
+    return [SSZipArchive createZipFileAtPath:path withFilesAtPaths:paths withPassword:password workers:1];
+}
+
++ (BOOL)createZipFileAtPath:(NSString *)path withFilesAtPaths:(NSArray<NSString *> *)paths withPassword:(nullable NSString *)password workers:(NSUInteger)workers
 {
     SSZipArchive *zipArchive = [[SSZipArchive alloc] initWithPath:path];
-    BOOL success = [zipArchive open];
+    BOOL parallel = workers != 1;
+    // files written by workers are accounted for once they are actually in the archive
+    __block BOOL success = YES;
+    if (parallel) {
+        success = [zipArchive openWithWorkers:workers memoryBudget:0 writtenHandler:^(NSString *fileName, BOOL succeeded) {
+            success &= succeeded;
+        }];
+    } else {
+        success = [zipArchive open];
+    }
     if (success) {
         for (NSString *filePath in paths) {
-            success &= [zipArchive writeFile:filePath withPassword:password];
+            BOOL written = [zipArchive writeFile:filePath withPassword:password];
+            if (!parallel) {
+                success &= written;
+            }
         }
         success &= [zipArchive close];
     }
@@ -713,19 +950,47 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
                    password:(nullable NSString *)password
                         AES:(BOOL)aes
             progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler {
+    return [self createZipFileAtPath:path withContentsOfDirectory:directoryPath keepParentDirectory:keepParentDirectory compressionLevel:compressionLevel password:password AES:aes workers:1 progressHandler:progressHandler];
+}
+
++ (BOOL)createZipFileAtPath:(NSString *)path
+    withContentsOfDirectory:(NSString *)directoryPath
+        keepParentDirectory:(BOOL)keepParentDirectory
+           compressionLevel:(int)compressionLevel
+                   password:(nullable NSString *)password
+                        AES:(BOOL)aes
+                    workers:(NSUInteger)workers
+            progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler {
     
     SSZipArchive *zipArchive = [[SSZipArchive alloc] initWithPath:path];
-    BOOL success = [zipArchive open];
-    if (success) {
-        // use a local fileManager (queue/thread compatibility)
-        NSFileManager *fileManager = [[NSFileManager alloc] init];
-        NSDirectoryEnumerator *dirEnumerator = [fileManager enumeratorAtPath:directoryPath];
-        NSArray<NSString *> *allObjects = dirEnumerator.allObjects;
-        NSUInteger total = allObjects.count, complete = 0;
-        if (keepParentDirectory && !total) {
-            allObjects = @[@""];
-            total = 1;
+    BOOL parallel = workers != 1;
+    // use a local fileManager (queue/thread compatibility)
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    NSDirectoryEnumerator *dirEnumerator = [fileManager enumeratorAtPath:directoryPath];
+    NSArray<NSString *> *allObjects = dirEnumerator.allObjects;
+    NSUInteger total = allObjects.count;
+    __block NSUInteger complete = 0;
+    if (keepParentDirectory && !total) {
+        allObjects = @[@""];
+        total = 1;
+    }
+    // files written by workers: progress and failures are reported as entries reach the archive
+    __block BOOL success = YES;
+    void (^entryDone)(BOOL) = ^(BOOL succeeded) {
+        success &= succeeded;
+        if (progressHandler) {
+            complete++;
+            progressHandler(complete, total);
         }
+    };
+    if (parallel) {
+        success = [zipArchive openWithWorkers:workers memoryBudget:0 writtenHandler:^(NSString *fileName, BOOL succeeded) {
+            entryDone(succeeded);
+        }];
+    } else {
+        success = [zipArchive open];
+    }
+    if (success) {
         for (__strong NSString *fileName in allObjects) {
             NSString *fullFilePath = [directoryPath stringByAppendingPathComponent:fileName];
             
@@ -736,18 +1001,17 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
             BOOL isDir;
             [fileManager fileExistsAtPath:fullFilePath isDirectory:&isDir];
             if (!isDir) {
-                // file
-                success &= [zipArchive writeFileAtPath:fullFilePath withFileName:fileName compressionLevel:compressionLevel password:password AES:aes];
-            } else {
-                // directory
-                if (![fileManager enumeratorAtPath:fullFilePath].nextObject) {
-                    // empty directory
-                    success &= [zipArchive writeFolderAtPath:fullFilePath withFolderName:fileName withPassword:password];
+                // file, reported by the writtenHandler when written by workers
+                BOOL written = [zipArchive writeFileAtPath:fullFilePath withFileName:fileName compressionLevel:compressionLevel password:password AES:aes];
+                if (!parallel) {
+                    entryDone(written);
                 }
-            }
-            if (progressHandler) {
-                complete++;
-                progressHandler(complete, total);
+            } else if (![fileManager enumeratorAtPath:fullFilePath].nextObject) {
+                // empty directory; opening its entry writes the files queued before it first
+                entryDone([zipArchive writeFolderAtPath:fullFilePath withFolderName:fileName withPassword:password]);
+            } else {
+                // directory, its files are entries of their own
+                entryDone(YES);
             }
         }
         success &= [zipArchive close];
@@ -767,6 +1031,13 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     return self;
 }
 
+- (void)dealloc
+{
+    if (_unzip != NULL) {
+        unzClose(_unzip);
+    }
+}
+
 
 - (BOOL)open
 {
@@ -775,6 +1046,25 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     return (NULL != _zip);
 }
 
+- (BOOL)openWithWorkers:(NSUInteger)workers memoryBudget:(unsigned long long)memoryBudget
+{
+    return [self openWithWorkers:workers memoryBudget:memoryBudget writtenHandler:nil];
+}
+
+- (BOOL)openWithWorkers:(NSUInteger)workers memoryBudget:(unsigned long long)memoryBudget writtenHandler:(void (^_Nullable)(NSString *fileName, BOOL succeeded))writtenHandler
+{
+    if (![self open]) {
+        return NO;
+    }
+    _writtenHandler = [writtenHandler copy];
+    // without parallel support in minizip, files are simply written one after another
+    _parallel = zipParallelBegin(_zip, (uint32_t)MIN(workers, UINT32_MAX), memoryBudget, NSTemporaryDirectory().fileSystemRepresentation) == ZIP_OK;
+    if (_parallel && _writtenHandler) {
+        zipParallelSetWrittenFunc(_zip, _zipEntryWritten, (__bridge void *)_writtenHandler);
+    }
+    return YES;
+}
+
 - (BOOL)writeFolderAtPath:(NSString *)path withFolderName:(NSString *)folderName withPassword:(nullable NSString *)password
 {
     NSAssert((_zip != NULL), @"Attempting to write to an archive which was never opened");
@@ -783,7 +1073,7 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     
     [SSZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:path];
     
-    int error = _zipOpenEntry(_zip, [folderName stringByAppendingString:@"/"], &zipInfo, Z_NO_COMPRESSION, password, 0);
+    int error = _zipOpenEntry(_zip, [folderName stringByAppendingString:@"/"], &zipInfo, Z_NO_COMPRESSION, NO, password, 0);
     const void *buffer = NULL;
     zipWriteInFileInZip(_zip, buffer, 0);
     zipCloseFileInZip(_zip);
@@ -807,15 +1097,27 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
 {
     NSAssert((_zip != NULL), @"Attempting to write to an archive which was never opened");
     
+    if (!fileName) {
+        fileName = path.lastPathComponent;
+    }
+    
+    if (_parallel) {
+        zip_fileinfo zipInfo = {};
+        [SSZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:path];
+        // errors of the entries written meanwhile are reported here, the rest by close;
+        // the writtenHandler is told about each entry separately
+        int error = zipParallelAddFile(_zip, fileName.fileSystemRepresentation, &zipInfo, path.fileSystemRepresentation, _zipMethod(compressionLevel, _storesIncompressibleFiles), compressionLevel, password.UTF8String, aes);
+        return error == ZIP_OK;
+    }
+    
     FILE *input = fopen(path.fileSystemRepresentation, "r");
     if (NULL == input) {
+        if (_writtenHandler) {
+            _writtenHandler(fileName, NO);
+        }
         return NO;
     }
     
-    if (!fileName) {
-        fileName = path.lastPathComponent;
-    }
-    
     zip_fileinfo zipInfo = {};
     
     [SSZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:path];
@@ -824,10 +1126,13 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     if (buffer == NULL)
     {
         fclose(input);
+        if (_writtenHandler) {
+            _writtenHandler(fileName, NO);
+        }
         return NO;
     }
     
-    int error = _zipOpenEntry(_zip, fileName, &zipInfo, compressionLevel, password, aes);
+    int error = _zipOpenEntry(_zip, fileName, &zipInfo, compressionLevel, _storesIncompressibleFiles, password, aes);
     
     while (!feof(input) && !ferror(input))
     {
@@ -838,6 +1143,9 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     zipCloseFileInZip(_zip);
     free(buffer);
     fclose(input);
+    if (_writtenHandler) {
+        _writtenHandler(fileName, error == ZIP_OK);
+    }
     return error == ZIP_OK;
 }
 
@@ -857,7 +1165,7 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
     zip_fileinfo zipInfo = {};
     [SSZipArchive zipInfo:&zipInfo setDate:[NSDate date]];
     
-    int error = _zipOpenEntry(_zip, filename, &zipInfo, compressionLevel, password, aes);
+    int error = _zipOpenEntry(_zip, filename, &zipInfo, compressionLevel, _storesIncompressibleFiles, password, aes);
     
     zipWriteInFileInZip(_zip, data.bytes, (unsigned int)data.length);
     
@@ -867,12 +1175,136 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
 
 - (BOOL)close
 {
+    if (_unzip != NULL) {
+        int error = unzClose(_unzip);
+        _unzip = NULL;
+        return error == UNZ_OK;
+    }
     NSAssert((_zip != NULL), @"[SSZipArchive] Attempting to close an archive which was never opened");
     int error = zipClose(_zip, NULL);
     _zip = nil;
+    _parallel = NO;
+    _writtenHandler = nil;
     return error == ZIP_OK;
 }
 
+#pragma mark - Reading single entries
+
+- (BOOL)openForReading
+{
+    return [self openForReadingCaseInsensitive:NO];
+}
+
+- (BOOL)openForReadingCaseInsensitive:(BOOL)caseInsensitive
+{
+    return [self openForReadingCaseInsensitive:caseInsensitive memoryMapped:NO];
+}
+
+- (BOOL)openForReadingCaseInsensitive:(BOOL)caseInsensitive memoryMapped:(BOOL)memoryMapped
+{
+    NSAssert((_zip == NULL && _unzip == NULL), @"Attempting to open an archive which is already open");
+    int indexMode = caseInsensitive ? UNZ_INDEX_CASE_INSENSITIVE : UNZ_INDEX_CASE_SENSITIVE;
+    if (memoryMapped)
+    {
+        zlib_filefunc64_map_def mmapFilefunc;
+        fill_mmap_filefunc64(&mmapFilefunc);
+        _unzip = unzOpenMapped64(_path.fileSystemRepresentation, &mmapFilefunc, indexMode);
+    }
+    if (_unzip == NULL)
+    {
+        _unzip = unzOpenIndexed64(_path.fileSystemRepresentation, NULL, indexMode);
+    }
+    return (NULL != _unzip);
+}
+
+- (nullable NSData *)dataForEntry:(NSString *)entryName password:(nullable NSString *)password error:(NSError **)error
+{
+    NSMutableData *data = [NSMutableData data];
+    BOOL success = [self _readEntry:entryName password:password error:error usingBlock:^BOOL(const void *bytes, int length) {
+        [data appendBytes:bytes length:length];
+        return YES;
+    }];
+    return success ? data : nil;
+}
+
+- (BOOL)extractEntry:(NSString *)entryName toPath:(NSString *)destinationPath password:(nullable NSString *)password error:(NSError **)error
+{
+    FILE *fp = fopen(destinationPath.fileSystemRepresentation, "wb");
+    if (fp == NULL) {
+        if (error) {
+            *error = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedToWriteFile userInfo:@{NSLocalizedDescriptionKey: @"failed to create file"}];
+        }
+        return NO;
+    }
+    BOOL success = [self _readEntry:entryName password:password error:error usingBlock:^BOOL(const void *bytes, int length) {
+        return fwrite(bytes, length, 1, fp) == 1;
+    }];
+    if (fclose(fp) != 0 && success) {
+        success = NO;
+        if (error) {
+            *error = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedToWriteFile userInfo:@{NSLocalizedDescriptionKey: @"Failed to write file (check your free space)"}];
+        }
+    }
+    if (!success) {
+        [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+    }
+    return success;
+}
+
+/// Finds the entry through the index and passes its contents to `block` in chunks; `block` returns NO on a write failure.
+- (BOOL)_readEntry:(NSString *)entryName password:(nullable NSString *)password error:(NSError **)error usingBlock:(BOOL (^)(const void *bytes, int length))block
+{
+    NSAssert((_unzip != NULL), @"Attempting to read from an archive which was never opened for reading");
+    if (error) {
+        *error = nil;
+    }
+
+    // Most archivers store names precomposed, while names we write use the file system representation
+    int ret = unzLocateFileIndexed(_unzip, entryName.UTF8String);
+    if (ret == UNZ_END_OF_LIST_OF_FILE && strcmp(entryName.UTF8String, entryName.fileSystemRepresentation) != 0) {
+        ret = unzLocateFileIndexed(_unzip, entryName.fileSystemRepresentation);
+    }
+    if (ret != UNZ_OK) {
+        if (error) {
+            *error = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"file not found in zip file"}];
+        }
+        return NO;
+    }
+
+    if (password.length == 0) {
+        ret = unzOpenCurrentFile(_unzip);
+    } else {
+        ret = unzOpenCurrentFilePassword(_unzip, [password cStringUsingEncoding:NSUTF8StringEncoding]);
+    }
+    if (ret != UNZ_OK) {
+        if (error) {
+            *error = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedOpenFileInZip userInfo:@{NSLocalizedDescriptionKey: @"failed to open file in zip file"}];
+        }
+        return NO;
+    }
+
+    NSError *readingError = nil;
+    unsigned char buffer[CHUNK];
+    int readBytes;
+    while ((readBytes = unzReadCurrentFile(_unzip, buffer, CHUNK)) > 0) {
+        if (!block(buffer, readBytes)) {
+            readingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFailedToWriteFile userInfo:@{NSLocalizedDescriptionKey: @"Failed to write file (check your free space)"}];
+            break;
+        }
+    }
+    if (readBytes < 0 && !readingError) {
+        readingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFileContentNotReadable userInfo:@{NSLocalizedDescriptionKey: @"failed to read file in zip file"}];
+    }
+    if (unzCloseCurrentFile(_unzip) == UNZ_CRCERROR && !readingError) {
+        readingError = [NSError errorWithDomain:SSZipArchiveErrorDomain code:SSZipArchiveErrorCodeFileInfoNotLoadable userInfo:@{NSLocalizedDescriptionKey: @"crc check failed for file"}];
+    }
+
+    if (error) {
+        *error = readingError;
+    }
+    return readingError == nil;
+}
+
 #pragma mark - Private
 
 + (NSString *)_filenameStringWithCString:(const char *)filename
@@ -1039,9 +1471,34 @@ BOOL _fileIsSymbolicLink(const unz_file_info *fileInfo);
 
 @end
 
-int _zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, int level, NSString *password, BOOL aes)
+// with storeIncompressible, entries that deflate would not shrink, like photos and videos, are stored unless level 0
+// asks for no compression
+uint16_t _zipMethod(int level, BOOL storeIncompressible)
+{
+    return (storeIncompressible && level != 0) ? Z_DEFLATED_AUTO : Z_DEFLATED;
+}
+
+int _zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, int level, BOOL storeIncompressible, NSString *password, BOOL aes)
+{
+    return zipOpenNewFileInZip5(entry, name.fileSystemRepresentation, zipfi, NULL, 0, NULL, 0, NULL, 0, 0, _zipMethod(level, storeIncompressible), level, 0, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, password.UTF8String, aes, 0);
+}
+
+#pragma mark - Private tools for parallel unzipping
+
+static int _unzipExtractEntry(void *opaque, unzFile zip, uint64_t entryNumber)
+{
+    return ((SSUnzipCallbacks *)opaque)->extract(zip, entryNumber);
+}
+
+static int _unzipEntryDone(void *opaque, uint64_t entryNumber, int result)
+{
+    return ((SSUnzipCallbacks *)opaque)->done(entryNumber, result);
+}
+
+static void _zipEntryWritten(void *opaque, const char *filename, int err)
 {
-    return zipOpenNewFileInZip5(entry, name.fileSystemRepresentation, zipfi, NULL, 0, NULL, 0, NULL, 0, 0, Z_DEFLATED, level, 0, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, password.UTF8String, aes, 0);
+    void (^writtenHandler)(NSString *fileName, BOOL succeeded) = (__bridge void (^)(NSString *, BOOL))opaque;
+    writtenHandler([[NSFileManager defaultManager] stringWithFileSystemRepresentation:filename length:strlen(filename)], err == ZIP_OK);
 }
 
 #pragma mark - Private tools for file info
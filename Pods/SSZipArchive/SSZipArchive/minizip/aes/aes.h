@@ -126,6 +126,9 @@ AES_RETURN aes_encrypt_key(const unsigned char *key, int key_len, aes_encrypt_ct
 
 AES_RETURN aes_encrypt(const unsigned char *in, unsigned char *out, const aes_encrypt_ctx cx[1]);
 
+/* encrypt n_blocks consecutive blocks, several at a time when AESNI is used */
+AES_RETURN aes_encrypt_blocks(const unsigned char *in, unsigned char *out, unsigned int n_blocks, const aes_encrypt_ctx cx[1]);
+
 #endif
 
 #if defined( AES_DECRYPT )
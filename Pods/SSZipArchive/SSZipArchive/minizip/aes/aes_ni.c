@@ -406,6 +406,53 @@ AES_RETURN aes_ni(encrypt)(const unsigned char *in, unsigned char *out, const ae
 	return EXIT_SUCCESS;
 }
 
+/* Eight blocks are in flight, enough to hide the latency of AESENC */
+#define AES_NI_LANES 8
+
+AES_RETURN aes_ni(encrypt_blocks)(const unsigned char *in, unsigned char *out, unsigned int n_blocks, const aes_encrypt_ctx cx[1])
+{
+	const __m128i *key = (const __m128i*)cx->ks;
+	__m128i t[AES_NI_LANES], k;
+	int rounds, r, i;
+
+	if(cx->inf.b[0] != 10 * 16 && cx->inf.b[0] != 12 * 16 && cx->inf.b[0] != 14 * 16)
+		return EXIT_FAILURE;
+
+	if(!has_aes_ni())
+	{
+		return aes_xi(encrypt_blocks)(in, out, n_blocks, cx);
+	}
+
+	rounds = cx->inf.b[0] >> 4;
+
+	for(; n_blocks >= AES_NI_LANES; n_blocks -= AES_NI_LANES)
+	{
+		k = key[0];
+		for(i = 0; i < AES_NI_LANES; i++)
+			t[i] = _mm_xor_si128(_mm_loadu_si128(&((const __m128i*)in)[i]), k);
+		for(r = 1; r < rounds; r++)
+		{
+			k = key[r];
+			for(i = 0; i < AES_NI_LANES; i++)
+				t[i] = _mm_aesenc_si128(t[i], k);
+		}
+		k = key[rounds];
+		for(i = 0; i < AES_NI_LANES; i++)
+			_mm_storeu_si128(&((__m128i*)out)[i], _mm_aesenclast_si128(t[i], k));
+
+		in += AES_NI_LANES * AES_BLOCK_SIZE;
+		out += AES_NI_LANES * AES_BLOCK_SIZE;
+	}
+
+	for(; n_blocks > 0; n_blocks--)
+	{
+		aes_ni(encrypt)(in, out, cx);
+		in += AES_BLOCK_SIZE;
+		out += AES_BLOCK_SIZE;
+	}
+	return EXIT_SUCCESS;
+}
+
 AES_RETURN aes_ni(decrypt)(const unsigned char *in, unsigned char *out, const aes_decrypt_ctx cx[1])
 {
 	__m128i *key = (__m128i*)cx->ks + (cx->inf.b[0] >> 4), t;
@@ -163,6 +163,18 @@ AES_RETURN aes_xi(encrypt)(const unsigned char *in, unsigned char *out, const ae
     return EXIT_SUCCESS;
 }
 
+AES_RETURN aes_xi(encrypt_blocks)(const unsigned char *in, unsigned char *out, unsigned int n_blocks, const aes_encrypt_ctx cx[1])
+{
+    while(n_blocks--)
+    {
+        if(aes_xi(encrypt)(in, out, cx) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        in += AES_BLOCK_SIZE;
+        out += AES_BLOCK_SIZE;
+    }
+    return EXIT_SUCCESS;
+}
+
 #endif
 
 #if ( FUNCS_IN_C & DECRYPTION_IN_C)
@@ -45,33 +45,91 @@ extern "C"
 {
 #endif
 
+/* the number of counter blocks encrypted together  */
+#define ENCR_BLOCKS     8
+
+/* the data is encrypted and authenticated in pieces */
+/* of this size so that it stays in the L1 cache     */
+#define FCRYPT_CHUNK    16384
+
+static void incr_nonce(fcrypt_ctx cx[1])
+{
+    unsigned int j = 0;
+    while (j < 8 && !++cx->nonce[j])
+        ++j;
+}
+
 /* subroutine for data encryption/decryption    */
-/* this could be speeded up a lot by aligning   */
-/* buffers and using 32 bit operations          */
 
 static void encr_data(unsigned char data[], unsigned long d_len, fcrypt_ctx cx[1])
 {
-    unsigned int i = 0, pos = cx->encr_pos;
+    unsigned char ctr[ENCR_BLOCKS * AES_BLOCK_SIZE], ks[ENCR_BLOCKS * AES_BLOCK_SIZE];
+    unsigned long i = 0;
+    unsigned int pos = cx->encr_pos, n, b, k;
 
-    while (i < d_len)
+    /* use up the key stream left from the last call    */
+    while (i < d_len && pos < AES_BLOCK_SIZE)
+        data[i++] ^= cx->encr_bfr[pos++];
+
+    /* then whole blocks, encrypting several counters   */
+    /* at once so that AESNI can pipeline them          */
+    while (d_len - i >= AES_BLOCK_SIZE)
     {
-        if (pos == AES_BLOCK_SIZE)
+        n = (unsigned int)((d_len - i) / AES_BLOCK_SIZE);
+        if (n > ENCR_BLOCKS)
+            n = ENCR_BLOCKS;
+        for (b = 0; b < n; ++b)
         {
-            unsigned int j = 0;
-            /* increment encryption nonce   */
-            while (j < 8 && !++cx->nonce[j])
-                ++j;
-            /* encrypt the nonce to form next xor buffer    */
-            aes_encrypt(cx->nonce, cx->encr_bfr, cx->encr_ctx);
-            pos = 0;
+            incr_nonce(cx);
+            memcpy(ctr + b * AES_BLOCK_SIZE, cx->nonce, AES_BLOCK_SIZE);
         }
+        aes_encrypt_blocks(ctr, ks, n, cx->encr_ctx);
+        for (b = 0; b < n; ++b, i += AES_BLOCK_SIZE)
+            for (k = 0; k < AES_BLOCK_SIZE; ++k)
+                data[i + k] ^= ks[b * AES_BLOCK_SIZE + k];
+    }
 
-        data[i++] ^= cx->encr_bfr[pos++];
+    /* a part block keeps the rest of its key stream    */
+    if (i < d_len)
+    {
+        incr_nonce(cx);
+        aes_encrypt(cx->nonce, cx->encr_bfr, cx->encr_ctx);
+        pos = 0;
+        while (i < d_len)
+            data[i++] ^= cx->encr_bfr[pos++];
     }
 
     cx->encr_pos = pos;
 }
 
+/* set up the context from the derived keys and password verifier */
+
+static void fcrypt_init_keys(
+    int mode,                               /* the mode to be used (input)          */
+    const unsigned char kbuf[],             /* the derived keys (input)             */
+#ifdef PASSWORD_VERIFIER
+    unsigned char pwd_ver[PWD_VER_LENGTH],  /* 2 byte password verifier (output)    */
+#endif
+    fcrypt_ctx      cx[1])                  /* the file encryption context (output) */
+{
+    /* initialise the encryption nonce and buffer pos   */
+    cx->encr_pos = AES_BLOCK_SIZE;
+    /* if we need a random component in the encryption  */
+    /* nonce, this is where it would have to be set     */
+    memset(cx->nonce, 0, AES_BLOCK_SIZE * sizeof(unsigned char));
+
+    /* initialise for encryption using key 1            */
+    aes_encrypt_key(kbuf, KEY_LENGTH(mode), cx->encr_ctx);
+
+    /* initialise for authentication using key 2        */
+    hmac_sha_begin(HMAC_SHA1, cx->auth_ctx);
+    hmac_sha_key(kbuf + KEY_LENGTH(mode), KEY_LENGTH(mode), cx->auth_ctx);
+
+#ifdef PASSWORD_VERIFIER
+    memcpy(pwd_ver, kbuf + 2 * KEY_LENGTH(mode), PWD_VER_LENGTH);
+#endif
+}
+
 int fcrypt_init(
     int mode,                               /* the mode to be used (input)          */
     const unsigned char pwd[],              /* the user specified password (input)  */
@@ -96,21 +154,53 @@ int fcrypt_init(
     derive_key(pwd, pwd_len, salt, SALT_LENGTH(mode), KEYING_ITERATIONS,
                         kbuf, 2 * KEY_LENGTH(mode) + PWD_VER_LENGTH);
 
-    /* initialise the encryption nonce and buffer pos   */
-    cx->encr_pos = AES_BLOCK_SIZE;
-    /* if we need a random component in the encryption  */
-    /* nonce, this is where it would have to be set     */
-    memset(cx->nonce, 0, AES_BLOCK_SIZE * sizeof(unsigned char));
+#ifdef PASSWORD_VERIFIER
+    fcrypt_init_keys(mode, kbuf, pwd_ver, cx);
+#else
+    fcrypt_init_keys(mode, kbuf, cx);
+#endif
 
-    /* initialise for encryption using key 1            */
-    aes_encrypt_key(kbuf, KEY_LENGTH(mode), cx->encr_ctx);
+    return GOOD_RETURN;
+}
 
-    /* initialise for authentication using key 2        */
-    hmac_sha_begin(HMAC_SHA1, cx->auth_ctx);
-    hmac_sha_key(kbuf + KEY_LENGTH(mode), KEY_LENGTH(mode), cx->auth_ctx);
+int fcrypt_init_cached(
+    int mode,                               /* the mode to be used (input)          */
+    const unsigned char pwd[],              /* the user specified password (input)  */
+    unsigned int pwd_len,                   /* the length of the password (input)   */
+    const unsigned char salt[],             /* the salt (input)                     */
+#ifdef PASSWORD_VERIFIER
+    unsigned char pwd_ver[PWD_VER_LENGTH],  /* 2 byte password verifier (output)    */
+#endif
+    fcrypt_key_cache kc[1],                 /* the derived key cache (input/output) */
+    fcrypt_ctx      cx[1])                  /* the file encryption context (output) */
+{   unsigned char pwd_hash[SHA1_DIGEST_SIZE];
+
+    if (pwd_len > MAX_PWD_LENGTH)
+        return PASSWORD_TOO_LONG;
+
+    if (mode < 1 || mode > 3)
+        return BAD_MODE;
+
+    cx->mode = mode;
+    cx->pwd_len = pwd_len;
+
+    /* the password is only kept as its hash            */
+    sha1(pwd_hash, pwd, pwd_len);
+
+    if (kc->mode != (unsigned int)mode || memcmp(kc->pwd_hash, pwd_hash, SHA1_DIGEST_SIZE) != 0
+        || memcmp(kc->salt, salt, SALT_LENGTH(mode)) != 0)
+    {
+        derive_key(pwd, pwd_len, salt, SALT_LENGTH(mode), KEYING_ITERATIONS,
+                            kc->kbuf, 2 * KEY_LENGTH(mode) + PWD_VER_LENGTH);
+        memcpy(kc->pwd_hash, pwd_hash, SHA1_DIGEST_SIZE);
+        memcpy(kc->salt, salt, SALT_LENGTH(mode));
+        kc->mode = mode;
+    }
 
 #ifdef PASSWORD_VERIFIER
-    memcpy(pwd_ver, kbuf + 2 * KEY_LENGTH(mode), PWD_VER_LENGTH);
+    fcrypt_init_keys(mode, kc->kbuf, pwd_ver, cx);
+#else
+    fcrypt_init_keys(mode, kc->kbuf, cx);
 #endif
 
     return GOOD_RETURN;
@@ -120,16 +210,32 @@ int fcrypt_init(
 
 void fcrypt_encrypt(unsigned char data[], unsigned int data_len, fcrypt_ctx cx[1])
 {
-    encr_data(data, data_len, cx);
-    hmac_sha_data(data, data_len, cx->auth_ctx);
+    unsigned int len;
+
+    while (data_len)
+    {
+        len = (data_len < FCRYPT_CHUNK ? data_len : FCRYPT_CHUNK);
+        encr_data(data, len, cx);
+        hmac_sha_data(data, len, cx->auth_ctx);
+        data += len;
+        data_len -= len;
+    }
 }
 
 /* perform 'in place' authentication and decryption */
 
 void fcrypt_decrypt(unsigned char data[], unsigned int data_len, fcrypt_ctx cx[1])
 {
-    hmac_sha_data(data, data_len, cx->auth_ctx);
-    encr_data(data, data_len, cx);
+    unsigned int len;
+
+    while (data_len)
+    {
+        len = (data_len < FCRYPT_CHUNK ? data_len : FCRYPT_CHUNK);
+        hmac_sha_data(data, len, cx->auth_ctx);
+        encr_data(data, len, cx);
+        data += len;
+        data_len -= len;
+    }
 }
 
 /* close encryption/decryption and return the MAC value */
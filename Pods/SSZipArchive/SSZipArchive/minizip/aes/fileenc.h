@@ -91,6 +91,17 @@ typedef struct
     unsigned int    mode;                       /* File encryption mode   */
 } fcrypt_ctx;
 
+/* the keys derived from a password and a salt, kept so that files  */
+/* sharing both can be opened without deriving the keys again       */
+
+typedef struct
+{   unsigned char   pwd_hash[SHA1_DIGEST_SIZE]; /* SHA1 of the password   */
+    unsigned char   salt[MAX_SALT_LENGTH];      /* the salt               */
+    unsigned char   kbuf[2 * MAX_KEY_LENGTH + PWD_VER_LENGTH];
+                                                /* the derived keys       */
+    unsigned int    mode;                       /* mode, 0 if empty       */
+} fcrypt_key_cache;
+
 /* initialise file encryption or decryption */
 
 int fcrypt_init(
@@ -103,6 +114,20 @@ int fcrypt_init(
 #endif
     fcrypt_ctx      cx[1]);                 /* the file encryption context (output) */
 
+/* as fcrypt_init, taking the keys from the cache if they were derived  */
+/* for the same mode, password and salt, and storing them there if not  */
+
+int fcrypt_init_cached(
+    int mode,                               /* the mode to be used (input)          */
+    const unsigned char pwd[],              /* the user specified password (input)  */
+    unsigned int pwd_len,                   /* the length of the password (input)   */
+    const unsigned char salt[],             /* the salt (input)                     */
+#ifdef PASSWORD_VERIFIER
+    unsigned char pwd_ver[PWD_VER_LENGTH],  /* 2 byte password verifier (output)    */
+#endif
+    fcrypt_key_cache kc[1],                 /* the derived key cache (input/output) */
+    fcrypt_ctx      cx[1]);                 /* the file encryption context (output) */
+
 /* perform 'in place' encryption or decryption and authentication               */
 
 void fcrypt_encrypt(unsigned char data[], unsigned int data_len, fcrypt_ctx cx[1]);
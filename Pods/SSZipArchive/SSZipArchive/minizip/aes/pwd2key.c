@@ -29,6 +29,14 @@ extern "C"
 {
 #endif
 
+/* The HMAC of a 20 byte value is two compression function */
+/* calls, one from the state left by the key block xored   */
+/* with ipad and one from the state left by the key block  */
+/* xored with opad, each on a single padded block. Those   */
+/* two states are found once, and the iterations then run  */
+/* the compression function on words directly, for up to   */
+/* SHA1_LANES blocks of the key at the same time           */
+
 void derive_key(const unsigned char pwd[],  /* the PASSWORD     */
                unsigned int pwd_len,        /* and its length   */
                const unsigned char salt[],  /* the SALT and its */
@@ -37,56 +45,105 @@ void derive_key(const unsigned char pwd[],  /* the PASSWORD     */
                unsigned char key[], /* space for the output key */
                unsigned int key_len)/* and its required length  */
 {
-    unsigned int    i, j, k, n_blk, h_size;
-    unsigned char uu[HMAC_MAX_OUTPUT_SIZE], ux[HMAC_MAX_OUTPUT_SIZE];
+    unsigned int    i, j, k, l, n_blk, h_size;
+    unsigned char uu[HMAC_MAX_OUTPUT_SIZE];
+    uint32_t ih[SHA1_DIGEST_SIZE >> 2], oh[SHA1_DIGEST_SIZE >> 2];
+    uint32_t hv[SHA1_DIGEST_SIZE >> 2][SHA1_LANES];
+    uint32_t wv[SHA1_BLOCK_SIZE >> 2][SHA1_LANES];
+    uint32_t ux[SHA1_DIGEST_SIZE >> 2][SHA1_LANES];
     hmac_ctx c1[1], c2[1], c3[1];
+    sha1_ctx s1[1];
 
     /* set HMAC context (c1) for password               */
     h_size = hmac_sha_begin(HMAC_SHA1, c1);
     hmac_sha_key(pwd, pwd_len, c1);
 
+    /* hash the key block xored with ipad (c1) and save */
+    /* the state as the start of every inner hash       */
+    hmac_sha_data((const unsigned char*)0, 0, c1);
+    memcpy(ih, c1->sha_ctx->u_sha1.hash, sizeof(ih));
+
     /* set HMAC context (c2) for password and salt      */
     memcpy(c2, c1, sizeof(hmac_ctx));
     hmac_sha_data(salt, salt_len, c2);
 
+    /* and the state for every outer hash from the key  */
+    /* block with ipad removed and opad added           */
+    for(k = 0; k < SHA1_BLOCK_SIZE; ++k)
+        c1->key[k] ^= 0x36 ^ 0x5c;
+    sha1_begin(s1);
+    sha1_hash(c1->key, SHA1_BLOCK_SIZE, s1);
+    memcpy(oh, s1->hash, sizeof(oh));
+
+    /* the message blocks hold a digest in words 0..4   */
+    /* followed by the padding and the bit length of a  */
+    /* key block plus a digest, which never change      */
+    memset(wv, 0, sizeof(wv));
+    for(l = 0; l < SHA1_LANES; ++l)
+    {
+        wv[SHA1_DIGEST_SIZE >> 2][l] = 0x80000000;
+        wv[15][l] = (SHA1_BLOCK_SIZE + SHA1_DIGEST_SIZE) << 3;
+    }
+
     /* find the number of SHA blocks in the key         */
     n_blk = 1 + (key_len - 1) / h_size;
 
-    for(i = 0; i < n_blk; ++i) /* for each block in key */
+    for(i = 0; i < n_blk; i += SHA1_LANES) /* for each group of blocks */
     {
-        /* ux[] holds the running xor value             */
-        memset(ux, 0, h_size);
+        for(l = 0; l < SHA1_LANES; ++l)
+        {
+            /* set HMAC context (c3) for password and salt  */
+            memcpy(c3, c2, sizeof(hmac_ctx));
+
+            /* enter additional data for 1st block into uu  */
+            uu[0] = (unsigned char)((i + l + 1) >> 24);
+            uu[1] = (unsigned char)((i + l + 1) >> 16);
+            uu[2] = (unsigned char)((i + l + 1) >> 8);
+            uu[3] = (unsigned char)(i + l + 1);
 
-        /* set HMAC context (c3) for password and salt  */
-        memcpy(c3, c2, sizeof(hmac_ctx));
+            /* the first iteration takes the salt as well   */
+            hmac_sha_data(uu, 4, c3);
+            hmac_sha_end(uu, h_size, c3);
 
-        /* enter additional data for 1st block into uu  */
-        uu[0] = (unsigned char)((i + 1) >> 24);
-        uu[1] = (unsigned char)((i + 1) >> 16);
-        uu[2] = (unsigned char)((i + 1) >> 8);
-        uu[3] = (unsigned char)(i + 1);
+            /* ux[] holds the running xor value             */
+            for(k = 0; k < (SHA1_DIGEST_SIZE >> 2); ++k)
+                ux[k][l] = wv[k][l] = ((uint32_t)uu[4 * k] << 24) | ((uint32_t)uu[4 * k + 1] << 16)
+                                    | ((uint32_t)uu[4 * k + 2] << 8) | uu[4 * k + 3];
+        }
 
         /* this is the key mixing iteration         */
-        for(j = 0, k = 4; j < iter; ++j)
+        for(j = 1; j < iter; ++j)
         {
-            /* add previous round data to HMAC      */
-            hmac_sha_data(uu, k, c3);
-
-            /* obtain HMAC for uu[]                 */
-            hmac_sha_end(uu, h_size, c3);
+            /* the inner hash of the previous value */
+            for(k = 0; k < (SHA1_DIGEST_SIZE >> 2); ++k)
+                for(l = 0; l < SHA1_LANES; ++l)
+                    hv[k][l] = ih[k];
+            sha1_compile_lanes(hv, (const uint32_t (*)[SHA1_LANES])wv);
+
+            /* and the outer hash of the inner one  */
+            memcpy(wv, hv, sizeof(hv));
+            for(k = 0; k < (SHA1_DIGEST_SIZE >> 2); ++k)
+                for(l = 0; l < SHA1_LANES; ++l)
+                    hv[k][l] = oh[k];
+            sha1_compile_lanes(hv, (const uint32_t (*)[SHA1_LANES])wv);
 
             /* xor into the running xor block       */
-            for(k = 0; k < h_size; ++k)
-                ux[k] ^= uu[k];
-
-            /* set HMAC context (c3) for password   */
-            memcpy(c3, c1, sizeof(hmac_ctx));
+            memcpy(wv, hv, sizeof(hv));
+            for(k = 0; k < (SHA1_DIGEST_SIZE >> 2); ++k)
+                for(l = 0; l < SHA1_LANES; ++l)
+                    ux[k][l] ^= hv[k][l];
         }
 
         /* compile key blocks into the key output   */
-        j = 0; k = i * h_size;
-        while(j < h_size && k < key_len)
-            key[k++] = ux[j++];
+        for(l = 0; l < SHA1_LANES && i + l < n_blk; ++l)
+        {
+            j = 0; k = (i + l) * h_size;
+            while(j < h_size && k < key_len)
+            {
+                key[k++] = (unsigned char)(ux[j >> 2][l] >> (8 * (~j & 3)));
+                ++j;
+            }
+        }
     }
 }
 
@@ -60,6 +60,18 @@ extern "C"
 
 #define SHA1_MASK   (SHA1_BLOCK_SIZE - 1)
 
+/* The Intel SHA extensions are used if they are detected   */
+/* at run time, as AESNI is in aes_ni.c                     */
+#if defined( __GNUC__ ) && defined( __x86_64__ ) && !defined( __APPLE__ ) \
+ && !defined( SHA1_NI_POSSIBLE )
+#  define SHA1_NI_POSSIBLE
+#endif
+
+#if defined( SHA1_NI_POSSIBLE )
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #if 0
 
 #define ch(x,y,z)       (((x) & (y)) ^ (~(x) & (z)))
@@ -157,6 +169,241 @@ VOID_RETURN sha1_compile(sha1_ctx ctx[1])
 #endif
 }
 
+#if defined( SHA1_NI_POSSIBLE )
+
+static int has_sha_ni(void)
+{
+    static int test = -1;
+    if(test < 0)
+    {
+        unsigned int a, b, c, d;
+        /* SSE4.1 and SSSE3 in leaf 1, SHA in leaf 7    */
+        if(!__get_cpuid(1, &a, &b, &c, &d) || (c & 0x00080200) != 0x00080200)
+            test = 0;
+        else if(!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+            test = 0;
+        else
+            test = (b & 0x20000000) != 0;
+    }
+    return test;
+}
+
+/* Compile n_blocks of 64 bytes straight from the message   */
+/* with the SHA instructions, four rounds per SHA1RNDS4     */
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha1_ni_compile(uint32_t hash[5], const unsigned char *sp, unsigned long n_blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i m0, m1, m2, m3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)hash), 0x1b);
+    e0 = _mm_set_epi32((int)hash[4], 0, 0, 0);
+
+    while(n_blocks--)
+    {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        /* rounds 0-15, loading the message */
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(sp +  0)), mask);
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(sp + 16)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(sp + 32)), mask);
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(sp + 48)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+
+        /* rounds 16-67, expanding the message four words at a time */
+#define sha1_ni_rounds(ea, eb, mi, mj, mk, ml, f)   \
+        ea = _mm_sha1nexte_epu32(ea, mi);           \
+        eb = abcd;                                  \
+        mj = _mm_sha1msg2_epu32(mj, mi);            \
+        abcd = _mm_sha1rnds4_epu32(abcd, ea, f);    \
+        ml = _mm_sha1msg1_epu32(ml, mi);            \
+        mk = _mm_xor_si128(mk, mi)
+
+        sha1_ni_rounds(e0, e1, m0, m1, m2, m3, 0);
+        sha1_ni_rounds(e1, e0, m1, m2, m3, m0, 1);
+        sha1_ni_rounds(e0, e1, m2, m3, m0, m1, 1);
+        sha1_ni_rounds(e1, e0, m3, m0, m1, m2, 1);
+        sha1_ni_rounds(e0, e1, m0, m1, m2, m3, 1);
+        sha1_ni_rounds(e1, e0, m1, m2, m3, m0, 1);
+        sha1_ni_rounds(e0, e1, m2, m3, m0, m1, 2);
+        sha1_ni_rounds(e1, e0, m3, m0, m1, m2, 2);
+        sha1_ni_rounds(e0, e1, m0, m1, m2, m3, 2);
+        sha1_ni_rounds(e1, e0, m1, m2, m3, m0, 2);
+        sha1_ni_rounds(e0, e1, m2, m3, m0, m1, 2);
+        sha1_ni_rounds(e1, e0, m3, m0, m1, m2, 3);
+        sha1_ni_rounds(e0, e1, m0, m1, m2, m3, 3);
+#undef  sha1_ni_rounds
+
+        /* rounds 68-79, the last message words are completed */
+
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        m3 = _mm_xor_si128(m3, m1);
+
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+
+        sp += SHA1_BLOCK_SIZE;
+    }
+
+    _mm_storeu_si128((__m128i*)hash, _mm_shuffle_epi32(abcd, 0x1b));
+    hash[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#endif
+
+/* Compile whole blocks taken directly from the message     */
+
+static void sha1_compile_blocks(const unsigned char *sp, unsigned long n_blocks, sha1_ctx ctx[1])
+{
+#if defined( SHA1_NI_POSSIBLE )
+    if(has_sha_ni())
+    {
+        sha1_ni_compile(ctx->hash, sp, n_blocks);
+        return;
+    }
+#endif
+    while(n_blocks--)
+    {
+        memcpy(ctx->wbuf, sp, SHA1_BLOCK_SIZE);
+        bsw_32(ctx->wbuf, SHA1_BLOCK_SIZE >> 2);
+        sha1_compile(ctx);
+        sp += SHA1_BLOCK_SIZE;
+    }
+}
+
+/* Four lanes fill the 128-bit vectors of SSE2 and NEON and */
+/* the round macros above work unchanged on GCC vectors. In */
+/* PBKDF2 this is also faster than the SHA instructions on  */
+/* one lane at a time, so they are not used here            */
+#if defined( __GNUC__ ) && !defined( SHA1_VECTOR_LANES )
+#  define SHA1_VECTOR_LANES
+#endif
+
+#if defined( SHA1_VECTOR_LANES )
+typedef uint32_t sha1_vec __attribute__((vector_size(SHA1_LANES * 4)));
+#endif
+
+VOID_RETURN sha1_compile_lanes(uint32_t hash[SHA1_DIGEST_SIZE >> 2][SHA1_LANES],
+                    const uint32_t wbuf[SHA1_BLOCK_SIZE >> 2][SHA1_LANES])
+{
+#if defined( SHA1_VECTOR_LANES )
+    sha1_vec    w[SHA1_BLOCK_SIZE >> 2], h[SHA1_DIGEST_SIZE >> 2];
+#ifdef ARRAY
+    sha1_vec    v[5];
+#else
+    sha1_vec    v0, v1, v2, v3, v4;
+#endif
+#endif
+
+#if defined( SHA1_VECTOR_LANES )
+    memcpy(w, wbuf, sizeof(w));
+    memcpy(h, hash, sizeof(h));
+#ifdef ARRAY
+    memcpy(v, h, sizeof(v));
+#else
+    v0 = h[0]; v1 = h[1];
+    v2 = h[2]; v3 = h[3];
+    v4 = h[4];
+#endif
+
+#undef  hf
+#define hf(i)   w[i]
+
+    five_cycle(v, ch, 0x5a827999,  0);
+    five_cycle(v, ch, 0x5a827999,  5);
+    five_cycle(v, ch, 0x5a827999, 10);
+    one_cycle(v,0,1,2,3,4, ch, 0x5a827999, hf(15));
+
+#undef  hf
+#define hf(i) (w[(i) & 15] = rotl32(                    \
+                 w[((i) + 13) & 15] ^ w[((i) + 8) & 15] \
+               ^ w[((i) +  2) & 15] ^ w[(i) & 15], 1))
+
+    one_cycle(v,4,0,1,2,3, ch, 0x5a827999, hf(16));
+    one_cycle(v,3,4,0,1,2, ch, 0x5a827999, hf(17));
+    one_cycle(v,2,3,4,0,1, ch, 0x5a827999, hf(18));
+    one_cycle(v,1,2,3,4,0, ch, 0x5a827999, hf(19));
+
+    five_cycle(v, parity, 0x6ed9eba1,  20);
+    five_cycle(v, parity, 0x6ed9eba1,  25);
+    five_cycle(v, parity, 0x6ed9eba1,  30);
+    five_cycle(v, parity, 0x6ed9eba1,  35);
+
+    five_cycle(v, maj, 0x8f1bbcdc,  40);
+    five_cycle(v, maj, 0x8f1bbcdc,  45);
+    five_cycle(v, maj, 0x8f1bbcdc,  50);
+    five_cycle(v, maj, 0x8f1bbcdc,  55);
+
+    five_cycle(v, parity, 0xca62c1d6,  60);
+    five_cycle(v, parity, 0xca62c1d6,  65);
+    five_cycle(v, parity, 0xca62c1d6,  70);
+    five_cycle(v, parity, 0xca62c1d6,  75);
+
+#undef  hf
+
+#ifdef ARRAY
+    h[0] += v[0]; h[1] += v[1];
+    h[2] += v[2]; h[3] += v[3];
+    h[4] += v[4];
+#else
+    h[0] += v0; h[1] += v1;
+    h[2] += v2; h[3] += v3;
+    h[4] += v4;
+#endif
+    memcpy(hash, h, sizeof(h));
+#else
+    {   sha1_ctx ctx[1];
+        int l, i;
+
+        for(l = 0; l < SHA1_LANES; ++l)
+        {
+            for(i = 0; i < (SHA1_BLOCK_SIZE >> 2); ++i)
+                ctx->wbuf[i] = wbuf[i][l];
+            for(i = 0; i < (SHA1_DIGEST_SIZE >> 2); ++i)
+                ctx->hash[i] = hash[i][l];
+            sha1_compile(ctx);
+            for(i = 0; i < (SHA1_DIGEST_SIZE >> 2); ++i)
+                hash[i][l] = ctx->hash[i];
+        }
+    }
+#endif
+}
+
 VOID_RETURN sha1_begin(sha1_ctx ctx[1])
 {
     memset(ctx, 0, sizeof(sha1_ctx));
@@ -211,13 +458,19 @@ VOID_RETURN sha1_hash(const unsigned char data[], unsigned long len, sha1_ctx ct
 #endif
     {   uint32_t space = SHA1_BLOCK_SIZE - pos;
 
-        while(len >= (space << 3))
+        if(pos && len >= (space << 3))
         {
             memcpy(w + pos, sp, space);
             bsw_32(w, SHA1_BLOCK_SIZE >> 2);
             sha1_compile(ctx); 
             sp += space; len -= (space << 3); 
-            space = SHA1_BLOCK_SIZE; pos = 0;
+            pos = 0;
+        }
+        if(len >= (SHA1_BLOCK_SIZE << 3))
+        {   unsigned long n_blocks = len >> 9;
+
+            sha1_compile_blocks(sp, n_blocks, ctx);
+            sp += n_blocks * SHA1_BLOCK_SIZE; len -= (n_blocks << 9);
         }
         memcpy(w + pos, sp, (len + 7 * SHA1_BITS) >> 3);
     }
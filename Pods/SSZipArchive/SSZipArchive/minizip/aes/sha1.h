@@ -36,6 +36,9 @@ Issue Date: 20/12/2007
 #define SHA1_BLOCK_SIZE  64
 #define SHA1_DIGEST_SIZE 20
 
+/* the number of independent hashes sha1_compile_lanes() runs   */
+#define SHA1_LANES        4
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -60,6 +63,14 @@ typedef struct
 
 VOID_RETURN sha1_compile(sha1_ctx ctx[1]);
 
+/* Compile one block into each of SHA1_LANES hash values at */
+/* once. Lanes are interleaved word by word, so hash[i][l]  */
+/* and wbuf[i][l] are word i of lane l, with the words in   */
+/* the same order as in ctx->wbuf[] for sha1_compile()      */
+
+VOID_RETURN sha1_compile_lanes(uint32_t hash[SHA1_DIGEST_SIZE >> 2][SHA1_LANES],
+                    const uint32_t wbuf[SHA1_BLOCK_SIZE >> 2][SHA1_LANES]);
+
 VOID_RETURN sha1_begin(sha1_ctx ctx[1]);
 VOID_RETURN sha1_hash(const unsigned char data[], unsigned long len, sha1_ctx ctx[1]);
 VOID_RETURN sha1_end(unsigned char hval[], sha1_ctx ctx[1]);
@@ -0,0 +1,273 @@
+/* crc32_hw.c -- crc32 for compress/uncompress .zip files using zlib + zip or unzip API
+
+   On x86-64 with PCLMULQDQ the data is folded 64 bytes at a time into four 128-bit
+   remainders, then reduced to 32 bits with a Barrett reduction, as described in Intel's
+   "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction". On ARMv8
+   the crc32 instructions take 8 bytes each. The copying variants store every block to
+   its destination while it is in a register, so stored entries are read once.
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#include "crc32_hw.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(CRC32_PCLMUL_POSSIBLE)
+#  define CRC32_PCLMUL_POSSIBLE
+#endif
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(CRC32_ARM_POSSIBLE)
+#  define CRC32_ARM_POSSIBLE
+#endif
+
+#if defined(CRC32_PCLMUL_POSSIBLE)
+#  include <cpuid.h>
+#  include <immintrin.h>
+#elif defined(CRC32_ARM_POSSIBLE)
+#  include <arm_acle.h>
+#endif
+
+/* Data copied and summed per step by the portable crc32_copy, small enough that it is
+   still in L1 when zlib's crc32 reads it back */
+#ifndef CRC32_COPY_CHUNK
+#  define CRC32_COPY_CHUNK (8 * 1024)
+#endif
+
+/***************************************************************************/
+
+#if defined(CRC32_PCLMUL_POSSIBLE)
+
+/* Shorter data is not worth setting up the folding for */
+#define CRC32_PCLMUL_MIN (64)
+
+static int has_pclmul(void)
+{
+    static int test = -1;
+    if (test < 0)
+    {
+        unsigned int a, b, c, d;
+        /* PCLMULQDQ and SSE4.1 in leaf 1 */
+        if (!__get_cpuid(1, &a, &b, &c, &d))
+            test = 0;
+        else
+            test = (c & 0x00080002) == 0x00080002;
+    }
+    return test;
+}
+
+/* Folds len bytes of src into crc, a multiple of 16 and at least 64, storing them to dst
+   as well unless it is NULL. crc is not inverted on the way in and out. */
+__attribute__((target("pclmul,sse4.1"), always_inline))
+static inline uint32_t crc32_pclmul_fold(uint32_t crc, uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    /* x^(4*128+64), x^(4*128) and so on mod P, bit reflected, then the Barrett constants */
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(src + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(src + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(src + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(src + 0x30));
+    if (dst != NULL)
+    {
+        _mm_storeu_si128((__m128i *)(dst + 0x00), x1);
+        _mm_storeu_si128((__m128i *)(dst + 0x10), x2);
+        _mm_storeu_si128((__m128i *)(dst + 0x20), x3);
+        _mm_storeu_si128((__m128i *)(dst + 0x30), x4);
+        dst += 64;
+    }
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    src += 64;
+    len -= 64;
+
+    /* Fold the four remainders 64 bytes forward at a time */
+    x0 = k1k2;
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(src + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(src + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(src + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(src + 0x30));
+        if (dst != NULL)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 0x00), y5);
+            _mm_storeu_si128((__m128i *)(dst + 0x10), y6);
+            _mm_storeu_si128((__m128i *)(dst + 0x20), y7);
+            _mm_storeu_si128((__m128i *)(dst + 0x30), y8);
+            dst += 64;
+        }
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        src += 64;
+        len -= 64;
+    }
+
+    /* Fold the four remainders into one */
+    x0 = k3k4;
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold in the remaining 16 byte blocks one at a time */
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i *)src);
+        if (dst != NULL)
+        {
+            _mm_storeu_si128((__m128i *)dst, x2);
+            dst += 16;
+        }
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        src += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduce to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    return ~crc32_pclmul_fold(~crc, NULL, buf, len);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_copy(uint32_t crc, uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    return ~crc32_pclmul_fold(~crc, dst, src, len);
+}
+
+#elif defined(CRC32_ARM_POSSIBLE)
+
+/* Sums len bytes of src into crc, storing them to dst as well unless it is NULL */
+static inline uint32_t crc32_arm(uint32_t crc, uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    uint64_t value = 0;
+
+    crc = ~crc;
+    while (len >= 8)
+    {
+        memcpy(&value, src, 8);
+        if (dst != NULL)
+        {
+            memcpy(dst, &value, 8);
+            dst += 8;
+        }
+        crc = __crc32d(crc, value);
+        src += 8;
+        len -= 8;
+    }
+    while (len > 0)
+    {
+        if (dst != NULL)
+            *dst++ = *src;
+        crc = __crc32b(crc, *src++);
+        len -= 1;
+    }
+    return ~crc;
+}
+
+#endif
+
+/***************************************************************************/
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+#if defined(CRC32_PCLMUL_POSSIBLE)
+    if ((len >= CRC32_PCLMUL_MIN) && (has_pclmul()))
+    {
+        uint32_t folded = len & ~15;
+        crc = crc32_pclmul(crc, buf, folded);
+        buf += folded;
+        len -= folded;
+    }
+#elif defined(CRC32_ARM_POSSIBLE)
+    return crc32_arm(crc, NULL, buf, len);
+#endif
+    if (len == 0)
+        return crc;
+    return (uint32_t)crc32(crc, buf, len);
+}
+
+uint32_t crc32_copy(uint32_t crc, uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    uint32_t chunk = 0;
+
+#if defined(CRC32_PCLMUL_POSSIBLE)
+    if ((len >= CRC32_PCLMUL_MIN) && (has_pclmul()))
+    {
+        uint32_t folded = len & ~15;
+        crc = crc32_pclmul_copy(crc, dst, src, folded);
+        dst += folded;
+        src += folded;
+        len -= folded;
+    }
+#elif defined(CRC32_ARM_POSSIBLE)
+    return crc32_arm(crc, dst, src, len);
+#endif
+    while (len > 0)
+    {
+        chunk = (len < CRC32_COPY_CHUNK) ? len : CRC32_COPY_CHUNK;
+        memcpy(dst, src, chunk);
+        crc = (uint32_t)crc32(crc, dst, chunk);
+        dst += chunk;
+        src += chunk;
+        len -= chunk;
+    }
+    return crc;
+}
@@ -0,0 +1,34 @@
+/* crc32_hw.h -- crc32 for compress/uncompress .zip files using zlib + zip or unzip API
+
+   Uses the carry-less multiply instructions on x86-64 and the crc32 instructions on ARMv8
+   when they are available, zlib's crc32 otherwise.
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#ifndef _CRC32_HW_H
+#define _CRC32_HW_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************/
+
+/* Updates crc with len bytes of buf, same result as zlib's crc32 */
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+/* Copies len bytes from src to dst and updates crc with them in the same pass, the buffers
+   must not overlap */
+uint32_t crc32_copy(uint32_t crc, uint8_t *dst, const uint8_t *src, uint32_t len);
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRC32_HW_H */
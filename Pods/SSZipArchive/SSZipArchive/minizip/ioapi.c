@@ -63,6 +63,13 @@ uint64_t call_ztell64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream
     return position;
 }
 
+const void* call_zmap64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream, uint64_t offset, uint64_t size)
+{
+    if (pfilefunc->zmap64_file == NULL)
+        return NULL;
+    return (*(pfilefunc->zmap64_file))(pfilefunc->zfile_func64.opaque, filestream, offset, size);
+}
+
 void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def *p_filefunc64_32, const zlib_filefunc_def *p_filefunc32)
 {
     p_filefunc64_32->zfile_func64.zopen64_file = NULL;
@@ -79,6 +86,7 @@ void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def *p_filef
     p_filefunc64_32->zfile_func64.opaque = p_filefunc32->opaque;
     p_filefunc64_32->zseek32_file = p_filefunc32->zseek_file;
     p_filefunc64_32->ztell32_file = p_filefunc32->ztell_file;
+    p_filefunc64_32->zmap64_file = NULL;
 }
 
 static voidpf   ZCALLBACK fopen_file_func(ZIP_UNUSED voidpf opaque, const char *filename, int mode);
@@ -101,6 +101,9 @@ typedef uint64_t (ZCALLBACK *tell64_file_func)    (voidpf opaque, voidpf stream)
 typedef long     (ZCALLBACK *seek64_file_func)    (voidpf opaque, voidpf stream, uint64_t offset, int origin);
 typedef voidpf   (ZCALLBACK *open64_file_func)    (voidpf opaque, const void *filename, int mode);
 typedef voidpf   (ZCALLBACK *opendisk64_file_func)(voidpf opaque, voidpf stream, uint32_t number_disk, int mode);
+/* Return size bytes of the stream at offset in place, valid until the stream is closed, or NULL if the
+   stream cannot; the caller then reads them. A call also tells that the range is about to be read. */
+typedef const void* (ZCALLBACK *map64_file_func)(voidpf opaque, voidpf stream, uint64_t offset, uint64_t size);
 
 typedef struct zlib_filefunc64_def_s
 {
@@ -115,6 +118,13 @@ typedef struct zlib_filefunc64_def_s
     voidpf               opaque;
 } zlib_filefunc64_def;
 
+/* 64-bit functions that can also map the stream, for unzOpenMapped64 */
+typedef struct zlib_filefunc64_map_def_s
+{
+    zlib_filefunc64_def  zfile_func64;
+    map64_file_func      zmap64_file;
+} zlib_filefunc64_map_def;
+
 void fill_fopen_filefunc(zlib_filefunc_def *pzlib_filefunc_def);
 void fill_fopen64_filefunc(zlib_filefunc64_def *pzlib_filefunc_def);
 
@@ -126,6 +136,7 @@ typedef struct zlib_filefunc64_32_def_s
     opendisk_file_func  zopendisk32_file;
     tell_file_func      ztell32_file;
     seek_file_func      zseek32_file;
+    map64_file_func     zmap64_file;
 } zlib_filefunc64_32_def;
 
 #define ZREAD64(filefunc,filestream,buf,size)       ((*((filefunc).zfile_func64.zread_file))        ((filefunc).zfile_func64.opaque,filestream,buf,size))
@@ -139,6 +150,7 @@ voidpf   call_zopen64(const zlib_filefunc64_32_def *pfilefunc,const void*filenam
 voidpf   call_zopendisk64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream, uint32_t number_disk, int mode);
 long     call_zseek64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream, uint64_t offset, int origin);
 uint64_t call_ztell64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream);
+const void* call_zmap64(const zlib_filefunc64_32_def *pfilefunc, voidpf filestream, uint64_t offset, uint64_t size);
 
 void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def *p_filefunc64_32, const zlib_filefunc_def *p_filefunc32);
 
@@ -146,6 +158,7 @@ void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def *p_filef
 #define ZOPENDISK64(filefunc,filestream,diskn,mode) (call_zopendisk64((&(filefunc)),(filestream),(diskn),(mode)))
 #define ZTELL64(filefunc,filestream)                (call_ztell64((&(filefunc)),(filestream)))
 #define ZSEEK64(filefunc,filestream,pos,mode)       (call_zseek64((&(filefunc)),(filestream),(pos),(mode)))
+#define ZMAP64(filefunc,filestream,pos,size)        (call_zmap64((&(filefunc)),(filestream),(pos),(size)))
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,234 @@
+/* ioapi_mmap.c -- IO base function header for compress/uncompress .zip
+   files using zlib + zip or unzip API
+
+   This version of ioapi maps zip files read-only into memory, so unzip can
+   read compressed data and the central directory in place instead of
+   copying them through a buffer. Ranges that unzip is about to read get
+   madvise hints, so the kernel reads ahead of inflate.
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#if !defined(_LARGEFILE64_SOURCE) && !defined(USE_FILE32API)
+#  define _LARGEFILE64_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+
+#include "ioapi_mmap.h"
+
+#if defined(USE_FILE32API) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__DragonFly__) || \
+    defined(__OpenBSD__) || defined(__APPLE__) || defined(__ANDROID__)
+#  define open64 open
+#  define fstat64 fstat
+#  define stat64 stat
+#endif
+
+/* Smaller ranges are not worth an madvise call */
+#ifndef IOMMAP_ADVISE_MIN
+#  define IOMMAP_ADVISE_MIN (64 * 1024)
+#endif
+
+typedef struct ourmmap_s {
+    int fd;
+    uint8_t *base;          /* Mapping of the whole file, NULL if it is empty */
+    uint64_t size;          /* Size of the file */
+    uint64_t position;      /* Current offset */
+    char *filename;         /* For opening the other disks of a spanned zip */
+} ourmmap_t;
+
+voidpf ZCALLBACK fopen64_mmap_func(ZIP_UNUSED voidpf opaque, const void *filename, int mode)
+{
+    ourmmap_t *mmapped = NULL;
+    struct stat64 st;
+    void *base = NULL;
+    int fd = -1;
+
+    if ((filename == NULL) || ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ))
+        return NULL;
+
+    fd = open64((const char*)filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if ((fstat64(fd, &st) != 0) || (st.st_size < 0) || ((uint64_t)st.st_size != (uint64_t)(size_t)st.st_size))
+    {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > 0)
+    {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+
+    mmapped = (ourmmap_t*)malloc(sizeof(ourmmap_t));
+    if (mmapped != NULL)
+        mmapped->filename = (char*)malloc(strlen((const char*)filename) + 1);
+    if ((mmapped == NULL) || (mmapped->filename == NULL))
+    {
+        if (base != NULL)
+            munmap(base, (size_t)st.st_size);
+        close(fd);
+        free(mmapped);
+        return NULL;
+    }
+    strcpy(mmapped->filename, (const char*)filename);
+    mmapped->fd = fd;
+    mmapped->base = (uint8_t*)base;
+    mmapped->size = (uint64_t)st.st_size;
+    mmapped->position = 0;
+    return mmapped;
+}
+
+voidpf ZCALLBACK fopendisk64_mmap_func(voidpf opaque, voidpf stream, uint32_t number_disk, int mode)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+    char *disk_filename = NULL;
+    voidpf ret = NULL;
+    size_t length = 0;
+    size_t i = 0;
+
+    if (mmapped == NULL)
+        return NULL;
+    length = strlen(mmapped->filename) + 1;
+    disk_filename = (char*)malloc(length);
+    if (disk_filename == NULL)
+        return NULL;
+    strcpy(disk_filename, mmapped->filename);
+    for (i = length - 1; i > 0; i -= 1)
+    {
+        if (disk_filename[i] != '.')
+            continue;
+        snprintf(&disk_filename[i], length - i, ".z%02u", number_disk + 1);
+        ret = fopen64_mmap_func(opaque, disk_filename, mode);
+        break;
+    }
+    free(disk_filename);
+    return ret;
+}
+
+uint32_t ZCALLBACK fread_mmap_func(ZIP_UNUSED voidpf opaque, voidpf stream, void *buf, uint32_t size)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+
+    if (mmapped->position >= mmapped->size)
+        return 0;
+    if (size > mmapped->size - mmapped->position)
+        size = (uint32_t)(mmapped->size - mmapped->position);
+
+    memcpy(buf, mmapped->base + mmapped->position, size);
+    mmapped->position += size;
+    return size;
+}
+
+uint32_t ZCALLBACK fwrite_mmap_func(ZIP_UNUSED voidpf opaque, ZIP_UNUSED voidpf stream, ZIP_UNUSED const void *buf,
+    ZIP_UNUSED uint32_t size)
+{
+    return 0;
+}
+
+uint64_t ZCALLBACK ftell64_mmap_func(ZIP_UNUSED voidpf opaque, voidpf stream)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+    return mmapped->position;
+}
+
+long ZCALLBACK fseek64_mmap_func(ZIP_UNUSED voidpf opaque, voidpf stream, uint64_t offset, int origin)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+    uint64_t new_pos = 0;
+
+    switch (origin)
+    {
+        case ZLIB_FILEFUNC_SEEK_CUR:
+            new_pos = mmapped->position + offset;
+            break;
+        case ZLIB_FILEFUNC_SEEK_END:
+            new_pos = mmapped->size + offset;
+            break;
+        case ZLIB_FILEFUNC_SEEK_SET:
+            new_pos = offset;
+            break;
+        default:
+            return -1;
+    }
+
+    if (new_pos > mmapped->size)
+        return -1;
+    mmapped->position = new_pos;
+    return 0;
+}
+
+int ZCALLBACK fclose_mmap_func(ZIP_UNUSED voidpf opaque, voidpf stream)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+    int ret = 0;
+
+    if (mmapped == NULL)
+        return -1;
+    if (mmapped->base != NULL)
+        munmap(mmapped->base, (size_t)mmapped->size);
+    ret = close(mmapped->fd);
+    free(mmapped->filename);
+    free(mmapped);
+    return ret;
+}
+
+int ZCALLBACK ferror_mmap_func(ZIP_UNUSED voidpf opaque, ZIP_UNUSED voidpf stream)
+{
+    /* We never return errors */
+    return 0;
+}
+
+const void* ZCALLBACK fmap64_mmap_func(ZIP_UNUSED voidpf opaque, voidpf stream, uint64_t offset, uint64_t size)
+{
+    ourmmap_t *mmapped = (ourmmap_t*)stream;
+    uintptr_t page_mask = 0;
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+
+    if ((offset > mmapped->size) || (size > mmapped->size - offset))
+        return NULL;
+    if (mmapped->base == NULL)
+        return mmapped->base;
+
+    /* Have the pages read ahead of the caller */
+    if (size >= IOMMAP_ADVISE_MIN)
+    {
+        page_mask = (uintptr_t)getpagesize() - 1;
+        start = (uintptr_t)(mmapped->base + offset) & ~page_mask;
+        end = (uintptr_t)(mmapped->base + offset + size);
+        madvise((void*)start, end - start, MADV_SEQUENTIAL);
+        madvise((void*)start, end - start, MADV_WILLNEED);
+    }
+    return mmapped->base + offset;
+}
+
+void fill_mmap_filefunc64(zlib_filefunc64_map_def *pzlib_filefunc_def)
+{
+    pzlib_filefunc_def->zfile_func64.zopen64_file = fopen64_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zopendisk64_file = fopendisk64_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zread_file = fread_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zwrite_file = fwrite_mmap_func;
+    pzlib_filefunc_def->zfile_func64.ztell64_file = ftell64_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zseek64_file = fseek64_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zclose_file = fclose_mmap_func;
+    pzlib_filefunc_def->zfile_func64.zerror_file = ferror_mmap_func;
+    pzlib_filefunc_def->zfile_func64.opaque = NULL;
+    pzlib_filefunc_def->zmap64_file = fmap64_mmap_func;
+}
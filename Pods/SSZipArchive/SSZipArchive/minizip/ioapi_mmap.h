@@ -0,0 +1,45 @@
+/* ioapi_mmap.h -- IO base function header for compress/uncompress .zip
+   files using zlib + zip or unzip API
+
+   This version of ioapi maps zip files read-only into memory.
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#ifndef _IOAPI_MMAP_H
+#define _IOAPI_MMAP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+voidpf      ZCALLBACK fopen64_mmap_func(voidpf opaque, const void* filename, int mode);
+voidpf      ZCALLBACK fopendisk64_mmap_func(voidpf opaque, voidpf stream, uint32_t number_disk, int mode);
+uint32_t    ZCALLBACK fread_mmap_func(voidpf opaque, voidpf stream, void* buf, uint32_t size);
+uint32_t    ZCALLBACK fwrite_mmap_func(voidpf opaque, voidpf stream, const void* buf, uint32_t size);
+uint64_t    ZCALLBACK ftell64_mmap_func(voidpf opaque, voidpf stream);
+long        ZCALLBACK fseek64_mmap_func(voidpf opaque, voidpf stream, uint64_t offset, int origin);
+int         ZCALLBACK fclose_mmap_func(voidpf opaque, voidpf stream);
+int         ZCALLBACK ferror_mmap_func(voidpf opaque, voidpf stream);
+const void* ZCALLBACK fmap64_mmap_func(voidpf opaque, voidpf stream, uint64_t offset, uint64_t size);
+
+/* Read-only access for unzOpenMapped64: unzReadCurrentFile inflates, or copies, unencrypted entries straight
+   from the mapping and the central directory is parsed in place. Opening for writing fails.
+
+   The file must not be truncated while it is open, and must stay readable: touching a page that is gone,
+   or that data protection has locked, raises SIGBUS. Only map files that nothing else writes to. */
+void fill_mmap_filefunc64(zlib_filefunc64_map_def* pzlib_filefunc_def);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "zlib.h"
 #include "unzip.h"
+#include "crc32_hw.h"
 
 #ifdef HAVE_AES
 #  define AES_METHOD          (99)
@@ -46,6 +47,14 @@
 #  include "crypt.h"
 #endif
 
+#if defined(_WIN32) && !defined(NO_PARALLEL_UNZIP)
+#  define NO_PARALLEL_UNZIP
+#endif
+#ifndef NO_PARALLEL_UNZIP
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
 #define DISKHEADERMAGIC             (0x08074b50)
 #define LOCALHEADERMAGIC            (0x04034b50)
 #define CENTRALHEADERMAGIC          (0x02014b50)
@@ -68,6 +77,10 @@
 #  define UNZ_MAXFILENAMEINZIP      (256)
 #endif
 
+#ifndef UNZ_INDEX_BUFSIZE
+#  define UNZ_INDEX_BUFSIZE         (256 * 1024)
+#endif
+
 #ifndef ALLOC
 #  define ALLOC(size) (malloc(size))
 #endif
@@ -122,8 +135,31 @@ typedef struct
     uint16_t compression_method;        /* compression method (0==store) */
     uint64_t byte_before_the_zipfile;   /* byte before the zipfile, (>0 for sfx) */
     int      raw;
+
+    const uint8_t *mapped;              /* compressed data in place, NULL if read through read_buffer */
+    uint64_t mapped_pos;                /* pos_in_zipfile of the first byte of mapped */
 } file_in_zip64_read_info_s;
 
+/* unz_index_entry_s locates one entry of the central directory by name */
+typedef struct unz_index_entry_s
+{
+    unz64_file_pos pos;                 /* where unzGoToFilePos64 finds the entry */
+    uint64_t name_offset;               /* offset of the name in the names arena */
+    uint32_t hash;                      /* hash of the (folded) name */
+    uint16_t name_size;                 /* length of the name */
+} unz_index_entry;
+
+/* unz_index_s is the name index built by unzOpenIndexed64 */
+typedef struct unz_index_s
+{
+    unz_index_entry *entries;           /* one per central directory entry, in order */
+    uint64_t entry_count;
+    char *names;                        /* arena holding all the names back to back */
+    uint32_t *slots;                    /* open addressing table of entry number + 1, 0 if empty */
+    uint64_t slot_mask;                 /* number of slots - 1, a power of two - 1 */
+    int mode;                           /* UNZ_INDEX_CASE_SENSITIVE or UNZ_INDEX_CASE_INSENSITIVE */
+} unz_index;
+
 /* unz64_s contain internal information about the zipfile */
 typedef struct
 {
@@ -150,10 +186,17 @@ typedef struct
     file_in_zip64_read_info_s *pfile_in_zip_read;
                                         /* structure about the current file if we are decompressing it */
     int is_zip64;                       /* is the current file zip64 */
+    unz_index *index;                   /* name index, NULL unless opened with unzOpenIndexed64 */
+    int index_mode;                     /* mode passed to unzOpenIndexed64, 0 otherwise */
+    uint8_t *read_block;                /* headers read from a stream that cannot map them */
+    uint32_t read_block_size;
 #ifndef NOUNCRYPT
     uint32_t keys[3];                   /* keys defining the pseudo-random sequence */
     const z_crc_t *pcrc_32_tab;
 #endif
+#ifdef HAVE_AES
+    fcrypt_key_cache aes_key_cache;     /* keys derived for the last AES entry opened */
+#endif
 } unz64_internal;
 
 /* Read a byte from a gz_stream; Return EOF for end of file. */
@@ -252,6 +295,57 @@ static int unzReadUInt64(const zlib_filefunc64_32_def *pzlib_filefunc_def, voidp
     return err;
 }
 
+/* Decode little endian values of a header in memory */
+static uint16_t unzGetUInt16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t unzGetUInt32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t unzGetUInt64(const uint8_t *p)
+{
+    return (uint64_t)unzGetUInt32(p) | ((uint64_t)unzGetUInt32(p + 4) << 32);
+}
+
+/* Return size bytes of filestream at pos, in place when the stream maps them, otherwise read into the
+   read_block of the handle, valid until the next call. Returns NULL if they cannot be read */
+static const uint8_t *unzReadBlock(unz64_internal *s, voidpf filestream, uint64_t pos, uint32_t size)
+{
+    const uint8_t *block = NULL;
+    void *grown = NULL;
+    uint32_t block_size = 0;
+
+    /* A disk that failed to open leaves no stream */
+    if (filestream == NULL)
+        return NULL;
+
+    block = (const uint8_t*)ZMAP64(s->z_filefunc, filestream, pos, size);
+    if (block != NULL)
+        return block;
+
+    if ((s->read_block == NULL) || (size > s->read_block_size))
+    {
+        block_size = (s->read_block_size == 0) ? 1024 : s->read_block_size;
+        while (block_size < size)
+            block_size *= 2;
+        grown = realloc(s->read_block, block_size);
+        if (grown == NULL)
+            return NULL;
+        s->read_block = (uint8_t*)grown;
+        s->read_block_size = block_size;
+    }
+
+    if (ZSEEK64(s->z_filefunc, filestream, pos, ZLIB_FILEFUNC_SEEK_SET) != 0)
+        return NULL;
+    if (ZREAD64(s->z_filefunc, filestream, s->read_block, size) != size)
+        return NULL;
+    return s->read_block;
+}
+
 /* Locate the Central directory of a zip file (at the end, just before the global comment) */
 static int unzSearchCentralDir(const zlib_filefunc64_32_def *pzlib_filefunc_def, uint64_t *pos_found, voidpf filestream)
 {
@@ -339,7 +433,234 @@ static int unzSearchCentralDir64(const zlib_filefunc64_32_def *pzlib_filefunc_de
     return UNZ_OK;
 }
 
-static unzFile unzOpenInternal(const void *path, zlib_filefunc64_32_def *pzlib_filefunc64_32_def)
+static uint8_t unzIndexFoldCase(uint8_t c)
+{
+    if ((c >= 'A') && (c <= 'Z'))
+        c += 'a' - 'A';
+    return c;
+}
+
+/* FNV-1a hash of a name, folding ASCII case for UNZ_INDEX_CASE_INSENSITIVE */
+static uint32_t unzIndexHash(const char *name, uint16_t name_size, int mode)
+{
+    uint32_t hash = 2166136261u;
+    uint8_t c = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < name_size; i += 1)
+    {
+        c = (uint8_t)name[i];
+        if (mode == UNZ_INDEX_CASE_INSENSITIVE)
+            c = unzIndexFoldCase(c);
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+static int unzIndexNamesEqual(const char *name1, const char *name2, uint16_t name_size, int mode)
+{
+    uint16_t i = 0;
+
+    if (mode != UNZ_INDEX_CASE_INSENSITIVE)
+        return (memcmp(name1, name2, name_size) == 0);
+
+    for (i = 0; i < name_size; i += 1)
+    {
+        if (unzIndexFoldCase((uint8_t)name1[i]) != unzIndexFoldCase((uint8_t)name2[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* unzFileNameComparer ignoring ASCII case, for lookups that fall back to a scan; unzLocateFile only
+   tells apart 0, for names that match, from the rest */
+static int unzIndexCompareInsensitive(ZIP_UNUSED unzFile file, const char *filename1, const char *filename2)
+{
+    size_t name_size = strlen(filename1);
+
+    if ((name_size != strlen(filename2)) || (name_size > UINT16_MAX))
+        return 1;
+    return !unzIndexNamesEqual(filename1, filename2, (uint16_t)name_size, UNZ_INDEX_CASE_INSENSITIVE);
+}
+
+/* Return the slot holding the name, or the empty slot where it belongs */
+static uint64_t unzIndexFindSlot(const unz_index *index, const char *name, uint16_t name_size, uint32_t hash)
+{
+    const unz_index_entry *entry = NULL;
+    uint64_t slot = hash & index->slot_mask;
+
+    while (index->slots[slot] != 0)
+    {
+        entry = &index->entries[index->slots[slot] - 1];
+        if ((entry->hash == hash) && (entry->name_size == name_size) &&
+            (unzIndexNamesEqual(index->names + entry->name_offset, name, name_size, index->mode)))
+            break;
+        slot = (slot + 1) & index->slot_mask;
+    }
+    return slot;
+}
+
+static void unzIndexFree(unz_index *index)
+{
+    if (index == NULL)
+        return;
+    TRYFREE(index->entries);
+    TRYFREE(index->names);
+    TRYFREE(index->slots);
+    TRYFREE(index);
+}
+
+/* Return size bytes of the central directory at pos, refilling the buffer if they are not in it */
+static const uint8_t *unzIndexRead(unz64_internal *s, uint8_t *buffer, uint64_t *buffer_pos, uint32_t *buffer_len,
+    uint64_t pos, uint32_t size)
+{
+    const uint8_t *mapped = NULL;
+
+    mapped = (const uint8_t*)ZMAP64(s->z_filefunc, s->filestream_with_CD, pos + s->byte_before_the_zipfile, size);
+    if (mapped != NULL)
+        return mapped;
+
+    if ((pos < *buffer_pos) || (pos + size > *buffer_pos + *buffer_len))
+    {
+        *buffer_pos = pos;
+        *buffer_len = 0;
+        if (ZSEEK64(s->z_filefunc, s->filestream_with_CD, pos + s->byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET) != 0)
+            return NULL;
+        *buffer_len = ZREAD64(s->z_filefunc, s->filestream_with_CD, buffer, UNZ_INDEX_BUFSIZE);
+        if (*buffer_len > UNZ_INDEX_BUFSIZE)
+            *buffer_len = 0;
+        if (size > *buffer_len)
+            return NULL;
+    }
+    return buffer + (pos - *buffer_pos);
+}
+
+/* Index the names of the central directory in one pass, reading it in large blocks instead of
+   parsing every header field by field. Stops where unzGoToNextFile2 would, at the first entry
+   without a valid header or after max_entries. Returns NULL if out of memory */
+static unz_index *unzIndexBuild(unz64_internal *s, int mode, uint64_t max_entries)
+{
+    unz_index *index = NULL;
+    unz_index_entry *entry = NULL;
+    uint8_t *buffer = NULL;
+    const uint8_t *header = NULL;
+    const uint8_t *name = NULL;
+    void *grown = NULL;
+    uint64_t buffer_pos = 0;
+    uint32_t buffer_len = 0;
+    uint64_t pos = s->offset_central_dir;
+    uint64_t entry_capacity = 0;
+    uint64_t names_size = 0;
+    uint64_t names_capacity = 64 * 1024;
+    uint64_t slot_count = 16;
+    uint64_t slot = 0;
+    uint64_t i = 0;
+    uint16_t name_size = 0;
+    uint16_t extra_size = 0;
+    uint16_t comment_size = 0;
+    int err = UNZ_OK;
+
+    index = (unz_index*)ALLOC(sizeof(unz_index));
+    buffer = (uint8_t*)ALLOC(UNZ_INDEX_BUFSIZE);
+    if (index != NULL)
+    {
+        memset(index, 0, sizeof(unz_index));
+        index->mode = mode;
+        index->names = (char*)ALLOC((size_t)names_capacity);
+    }
+    if ((index == NULL) || (buffer == NULL) || (index->names == NULL))
+        err = UNZ_INTERNALERROR;
+
+    while ((err == UNZ_OK) && (index->entry_count < max_entries))
+    {
+        header = unzIndexRead(s, buffer, &buffer_pos, &buffer_len, pos, SIZECENTRALDIRITEM);
+        if (header == NULL)
+            break;
+        if ((header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24)) != CENTRALHEADERMAGIC)
+            break;
+        name_size = (uint16_t)(header[28] | (header[29] << 8));
+        extra_size = (uint16_t)(header[30] | (header[31] << 8));
+        comment_size = (uint16_t)(header[32] | (header[33] << 8));
+
+        name = unzIndexRead(s, buffer, &buffer_pos, &buffer_len, pos + SIZECENTRALDIRITEM, name_size);
+        if (name == NULL)
+            break;
+
+        if (index->entry_count == entry_capacity)
+        {
+            entry_capacity = (entry_capacity == 0) ? 1024 : entry_capacity * 2;
+            grown = NULL;
+            if ((entry_capacity < UINT32_MAX) && (entry_capacity <= SIZE_MAX / sizeof(unz_index_entry)))
+                grown = realloc(index->entries, (size_t)(entry_capacity * sizeof(unz_index_entry)));
+            if (grown == NULL)
+            {
+                err = UNZ_INTERNALERROR;
+                break;
+            }
+            index->entries = (unz_index_entry*)grown;
+        }
+        if (names_size + name_size > names_capacity)
+        {
+            while (names_size + name_size > names_capacity)
+                names_capacity *= 2;
+            grown = NULL;
+            if ((size_t)names_capacity == names_capacity)
+                grown = realloc(index->names, (size_t)names_capacity);
+            if (grown == NULL)
+            {
+                err = UNZ_INTERNALERROR;
+                break;
+            }
+            index->names = (char*)grown;
+        }
+
+        entry = &index->entries[index->entry_count];
+        entry->pos.pos_in_zip_directory = pos;
+        entry->pos.num_of_file = index->entry_count;
+        entry->name_offset = names_size;
+        entry->name_size = name_size;
+        entry->hash = unzIndexHash((const char*)name, name_size, mode);
+        memcpy(index->names + names_size, name, name_size);
+
+        names_size += name_size;
+        index->entry_count += 1;
+        pos += SIZECENTRALDIRITEM + name_size + extra_size + comment_size;
+    }
+
+    TRYFREE(buffer);
+
+    /* Keep the table at most half full so probe sequences stay short */
+    if (err == UNZ_OK)
+    {
+        while (slot_count < index->entry_count * 2)
+            slot_count *= 2;
+        index->slot_mask = slot_count - 1;
+        index->slots = (uint32_t*)ALLOC((size_t)(slot_count * sizeof(uint32_t)));
+        if (index->slots == NULL)
+            err = UNZ_INTERNALERROR;
+    }
+    if (err == UNZ_OK)
+    {
+        memset(index->slots, 0, (size_t)(slot_count * sizeof(uint32_t)));
+        for (i = 0; i < index->entry_count; i += 1)
+        {
+            entry = &index->entries[i];
+            slot = unzIndexFindSlot(index, index->names + entry->name_offset, entry->name_size, entry->hash);
+            /* A duplicate name keeps the first entry, which is what unzLocateFile finds */
+            if (index->slots[slot] == 0)
+                index->slots[slot] = (uint32_t)(i + 1);
+        }
+    }
+
+    if (err != UNZ_OK)
+    {
+        unzIndexFree(index);
+        return NULL;
+    }
+    return index;
+}
+
+static unzFile unzOpenInternal(const void *path, zlib_filefunc64_32_def *pzlib_filefunc64_32_def, int index_mode)
 {
     unz64_internal us = { 0 };
     unz64_internal *s = NULL;
@@ -363,6 +684,7 @@ static unzFile unzOpenInternal(const void *path, zlib_filefunc64_32_def *pzlib_f
                (pzlib_filefunc64_32_def->zseek32_file || pzlib_filefunc64_32_def->zfile_func64.zseek64_file));
         us.z_filefunc = *pzlib_filefunc64_32_def;
     }
+    us.index_mode = index_mode;
 
     us.filestream = ZOPEN64(us.z_filefunc, path, ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_EXISTING);
 
@@ -492,10 +814,20 @@ static unzFile unzOpenInternal(const void *path, zlib_filefunc64_32_def *pzlib_f
     if (s != NULL)
     {
         *s = us;
+        /* Have a mapped stream read the central directory ahead of the walk over it */
+        ZMAP64(s->z_filefunc, s->filestream_with_CD, s->offset_central_dir + s->byte_before_the_zipfile,
+            s->size_central_dir);
+        if (index_mode != 0)
+            s->index = unzIndexBuild(s, index_mode, (err64 == UNZ_OK) ? s->gi.number_entry : UINT64_MAX);
         if (err64 != UNZ_OK)
+        {
             // workaround incorrect count #184
-            s->gi.number_entry = unzCountEntries(s);
-        
+            if (s->index != NULL)
+                s->gi.number_entry = s->index->entry_count;
+            else
+                s->gi.number_entry = unzCountEntries(s);
+        }
+
         unzGoToFirstFile((unzFile)s);
     }
     return (unzFile)s;
@@ -507,9 +839,9 @@ extern unzFile ZEXPORT unzOpen2(const char *path, zlib_filefunc_def *pzlib_filef
     {
         zlib_filefunc64_32_def zlib_filefunc64_32_def_fill = { 0 };
         fill_zlib_filefunc64_32_def_from_filefunc32(&zlib_filefunc64_32_def_fill, pzlib_filefunc32_def);
-        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill);
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 0);
     }
-    return unzOpenInternal(path, NULL);
+    return unzOpenInternal(path, NULL, 0);
 }
 
 extern unzFile ZEXPORT unzOpen2_64(const void *path, zlib_filefunc64_def *pzlib_filefunc_def)
@@ -518,19 +850,45 @@ extern unzFile ZEXPORT unzOpen2_64(const void *path, zlib_filefunc64_def *pzlib_
     {
         zlib_filefunc64_32_def zlib_filefunc64_32_def_fill = { 0 };
         zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
-        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill);
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 0);
     }
-    return unzOpenInternal(path, NULL);
+    return unzOpenInternal(path, NULL, 0);
 }
 
 extern unzFile ZEXPORT unzOpen(const char *path)
 {
-    return unzOpenInternal(path, NULL);
+    return unzOpenInternal(path, NULL, 0);
 }
 
 extern unzFile ZEXPORT unzOpen64(const void *path)
 {
-    return unzOpenInternal(path, NULL);
+    return unzOpenInternal(path, NULL, 0);
+}
+
+extern unzFile ZEXPORT unzOpenIndexed64(const void *path, zlib_filefunc64_def *pzlib_filefunc_def, int index_mode)
+{
+    if ((index_mode != UNZ_INDEX_CASE_SENSITIVE) && (index_mode != UNZ_INDEX_CASE_INSENSITIVE))
+        return NULL;
+    if (pzlib_filefunc_def != NULL)
+    {
+        zlib_filefunc64_32_def zlib_filefunc64_32_def_fill = { 0 };
+        zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, index_mode);
+    }
+    return unzOpenInternal(path, NULL, index_mode);
+}
+
+extern unzFile ZEXPORT unzOpenMapped64(const void *path, zlib_filefunc64_map_def *pzlib_filefunc_def, int index_mode)
+{
+    zlib_filefunc64_32_def zlib_filefunc64_32_def_fill = { 0 };
+
+    if ((index_mode != 0) && (index_mode != UNZ_INDEX_CASE_SENSITIVE) && (index_mode != UNZ_INDEX_CASE_INSENSITIVE))
+        return NULL;
+    if (pzlib_filefunc_def == NULL)
+        return NULL;
+    zlib_filefunc64_32_def_fill.zfile_func64 = pzlib_filefunc_def->zfile_func64;
+    zlib_filefunc64_32_def_fill.zmap64_file = pzlib_filefunc_def->zmap64_file;
+    return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, index_mode);
 }
 
 extern int ZEXPORT unzClose(unzFile file)
@@ -550,6 +908,11 @@ extern int ZEXPORT unzClose(unzFile file)
 
     s->filestream = NULL;
     s->filestream_with_CD = NULL;
+    unzIndexFree(s->index);
+    TRYFREE(s->read_block);
+#ifdef HAVE_AES
+    memset(&s->aes_key_cache, 0, sizeof(s->aes_key_cache));
+#endif
     TRYFREE(s);
     return UNZ_OK;
 }
@@ -647,50 +1010,27 @@ extern int ZEXPORT unzGetGlobalComment(unzFile file, char *comment, uint16_t com
     return (int)bytes_to_read;
 }
 
-static int unzGetCurrentFileInfoField(unzFile file, uint32_t *seek, void *field, uint16_t field_size, uint16_t size_file_field, int null_terminated_field)
+/* Copy a field of the central directory header the way unzGetCurrentFileInfo returns it */
+static void unzGetCurrentFileInfoField(void *field, uint16_t field_size, const uint8_t *file_field,
+    uint16_t size_file_field, int null_terminated_field)
 {
-    unz64_internal *s = NULL;
-    uint32_t bytes_to_read = 0;
-    int err = UNZ_OK;
+    uint16_t bytes_to_copy = 0;
 
-    if (file == NULL)
-        return (int)UNZ_PARAMERROR;
-    s = (unz64_internal*)file;
+    if (field == NULL)
+        return;
 
-    /* Read field */
-    if (field != NULL)
+    if (size_file_field < field_size)
     {
-        if (size_file_field < field_size)
-        {
-            if (null_terminated_field)
-                *((char *)field+size_file_field) = 0;
+        if (null_terminated_field)
+            *((char *)field+size_file_field) = 0;
 
-            bytes_to_read = size_file_field;
-        }
-        else
-            bytes_to_read = field_size;
-        
-        if (*seek != 0)
-        {
-            if (ZSEEK64(s->z_filefunc, s->filestream_with_CD, *seek, ZLIB_FILEFUNC_SEEK_CUR) == 0)
-                *seek = 0;
-            else
-                err = UNZ_ERRNO;
-        }
-        
-        if ((size_file_field > 0) && (field_size > 0))
-        {
-            if (ZREAD64(s->z_filefunc, s->filestream_with_CD, field, bytes_to_read) != bytes_to_read)
-                err = UNZ_ERRNO;
-        }
-        *seek += size_file_field - bytes_to_read;
+        bytes_to_copy = size_file_field;
     }
     else
-    {
-        *seek += size_file_field;
-    }
+        bytes_to_copy = field_size;
 
-    return err;
+    if (bytes_to_copy > 0)
+        memcpy(field, file_field, bytes_to_copy);
 }
 
 /* Get info about the current file in the zipfile, with internal only info */
@@ -701,183 +1041,138 @@ static int unzGetCurrentFileInfoInternal(unzFile file, unz_file_info64 *pfile_in
     unz64_internal *s = NULL;
     unz_file_info64 file_info;
     unz_file_info64_internal file_info_internal;
-    uint32_t magic = 0;
-    uint64_t current_pos = 0;
-    uint32_t seek = 0;
+    const uint8_t *header = NULL;
+    const uint8_t *variable = NULL;
+    const uint8_t *extra = NULL;
+    const uint8_t *extra_data = NULL;
+    uint32_t size_variable = 0;
     uint32_t extra_pos = 0;
+    uint32_t extra_data_pos = 0;
     uint16_t extra_header_id = 0;
     uint16_t extra_data_size = 0;
-    uint16_t value16 = 0;
-    uint32_t value32 = 0;
-    uint64_t value64 = 0;
     int err = UNZ_OK;
 
     if (file == NULL)
         return UNZ_PARAMERROR;
     s = (unz64_internal*)file;
 
-    if (ZSEEK64(s->z_filefunc, s->filestream_with_CD,
-            s->pos_in_central_dir + s->byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET) != 0)
-        err = UNZ_ERRNO;
-
-    /* Check the magic */
-    if (err == UNZ_OK)
-    {
-        if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &magic) != UNZ_OK)
-            err = UNZ_ERRNO;
-        else if (magic != CENTRALHEADERMAGIC)
-            err = UNZ_BADZIPFILE;
-    }
+    /* Read central directory header, in place when the stream is mapped */
+    header = unzReadBlock(s, s->filestream_with_CD, s->pos_in_central_dir + s->byte_before_the_zipfile,
+        SIZECENTRALDIRITEM);
+    if (header == NULL)
+        return UNZ_ERRNO;
+    if (unzGetUInt32(header) != CENTRALHEADERMAGIC)
+        return UNZ_BADZIPFILE;
 
-    /* Read central directory header */
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.version) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.version_needed) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.flag) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.compression_method) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &file_info.dos_date) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &file_info.crc) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &value32) != UNZ_OK)
-        err = UNZ_ERRNO;
-    file_info.compressed_size = value32;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &value32) != UNZ_OK)
-        err = UNZ_ERRNO;
-    file_info.uncompressed_size = value32;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.size_filename) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.size_file_extra) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.size_file_comment) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &value16) != UNZ_OK)
-        err = UNZ_ERRNO;
-    file_info.disk_num_start = value16;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &file_info.internal_fa) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &file_info.external_fa) != UNZ_OK)
-        err = UNZ_ERRNO;
+    file_info.version = unzGetUInt16(header + 4);
+    file_info.version_needed = unzGetUInt16(header + 6);
+    file_info.flag = unzGetUInt16(header + 8);
+    file_info.compression_method = unzGetUInt16(header + 10);
+    file_info.dos_date = unzGetUInt32(header + 12);
+    file_info.crc = unzGetUInt32(header + 16);
+    file_info.compressed_size = unzGetUInt32(header + 20);
+    file_info.uncompressed_size = unzGetUInt32(header + 24);
+    file_info.size_filename = unzGetUInt16(header + 28);
+    file_info.size_file_extra = unzGetUInt16(header + 30);
+    file_info.size_file_comment = unzGetUInt16(header + 32);
+    file_info.disk_num_start = unzGetUInt16(header + 34);
+    file_info.internal_fa = unzGetUInt16(header + 36);
+    file_info.external_fa = unzGetUInt32(header + 38);
     /* Relative offset of local header */
-    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &value32) != UNZ_OK)
-        err = UNZ_ERRNO;
+    file_info.disk_offset = unzGetUInt32(header + 42);
 
     file_info.size_file_extra_internal = 0;
-    file_info.disk_offset = value32;
-    file_info_internal.offset_curfile = value32;
+    file_info_internal.offset_curfile = file_info.disk_offset;
 #ifdef HAVE_AES
     file_info_internal.aes_compression_method = 0;
     file_info_internal.aes_encryption_mode = 0;
     file_info_internal.aes_version = 0;
 #endif
 
-    if (err == UNZ_OK)
-        err = unzGetCurrentFileInfoField(file, &seek, filename, filename_size, file_info.size_filename, 1);
-
-    /* Read extrafield */
-    if (err == UNZ_OK)
-        err = unzGetCurrentFileInfoField(file, &seek, extrafield, extrafield_size, file_info.size_file_extra, 0);
+    /* Filename, extrafield and comment follow the header */
+    size_variable = (uint32_t)file_info.size_filename + file_info.size_file_extra + file_info.size_file_comment;
+    variable = unzReadBlock(s, s->filestream_with_CD,
+        s->pos_in_central_dir + s->byte_before_the_zipfile + SIZECENTRALDIRITEM, size_variable);
+    if (variable == NULL)
+        return UNZ_ERRNO;
+    extra = variable + file_info.size_filename;
 
-    if ((err == UNZ_OK) && (file_info.size_file_extra != 0))
+    while ((err == UNZ_OK) && (extra_pos + 4 <= file_info.size_file_extra))
     {
-        if (seek != 0)
-        {
-            if (ZSEEK64(s->z_filefunc, s->filestream_with_CD, seek, ZLIB_FILEFUNC_SEEK_CUR) == 0)
-                seek = 0;
-            else
-                err = UNZ_ERRNO;
-        }
-
-        /* We are going to parse the extra field so we need to move back */
-        current_pos = ZTELL64(s->z_filefunc, s->filestream_with_CD);
-        if (current_pos < file_info.size_file_extra)
-            err = UNZ_ERRNO;
-        current_pos -= file_info.size_file_extra;
-        if (ZSEEK64(s->z_filefunc, s->filestream_with_CD, current_pos, ZLIB_FILEFUNC_SEEK_SET) != 0)
-            err = UNZ_ERRNO;
+        extra_header_id = unzGetUInt16(extra + extra_pos);
+        extra_data_size = unzGetUInt16(extra + extra_pos + 2);
+        extra_data = extra + extra_pos + 4;
+        extra_data_pos = 0;
 
-        while ((err != UNZ_ERRNO) && (extra_pos < file_info.size_file_extra))
+        if (extra_pos + 4 + extra_data_size > file_info.size_file_extra)
+            err = UNZ_BADZIPFILE;
+        /* ZIP64 extra fields */
+        else if (extra_header_id == 0x0001)
         {
-            if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &extra_header_id) != UNZ_OK)
-                err = UNZ_ERRNO;
-            if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &extra_data_size) != UNZ_OK)
-                err = UNZ_ERRNO;
+            /* Subtract size of ZIP64 field, since ZIP64 is handled internally */
+            file_info.size_file_extra_internal += 2 + 2 + extra_data_size;
 
-            /* ZIP64 extra fields */
-            if (extra_header_id == 0x0001)
+            if ((err == UNZ_OK) && (file_info.uncompressed_size == UINT32_MAX))
             {
-                /* Subtract size of ZIP64 field, since ZIP64 is handled internally */
-                file_info.size_file_extra_internal += 2 + 2 + extra_data_size;
-
-                if (file_info.uncompressed_size == UINT32_MAX)
-                {
-                    if (unzReadUInt64(&s->z_filefunc, s->filestream_with_CD, &file_info.uncompressed_size) != UNZ_OK)
-                        err = UNZ_ERRNO;
-                }
-                if (file_info.compressed_size == UINT32_MAX)
-                {
-                    if (unzReadUInt64(&s->z_filefunc, s->filestream_with_CD, &file_info.compressed_size) != UNZ_OK)
-                        err = UNZ_ERRNO;
-                }
-                if (file_info_internal.offset_curfile == UINT32_MAX)
-                {
-                    /* Relative Header offset */
-                    if (unzReadUInt64(&s->z_filefunc, s->filestream_with_CD, &value64) != UNZ_OK)
-                        err = UNZ_ERRNO;
-                    file_info_internal.offset_curfile = value64;
-                    file_info.disk_offset = value64;
-                }
-                if (file_info.disk_num_start == UINT32_MAX)
-                {
-                    /* Disk Start Number */
-                    if (unzReadUInt32(&s->z_filefunc, s->filestream_with_CD, &file_info.disk_num_start) != UNZ_OK)
-                        err = UNZ_ERRNO;
-                }
+                if (extra_data_pos + 8 > extra_data_size)
+                    err = UNZ_BADZIPFILE;
+                else
+                    file_info.uncompressed_size = unzGetUInt64(extra_data + extra_data_pos);
+                extra_data_pos += 8;
             }
-#ifdef HAVE_AES
-            /* AES header */
-            else if (extra_header_id == 0x9901)
+            if ((err == UNZ_OK) && (file_info.compressed_size == UINT32_MAX))
             {
-                uint8_t value8 = 0;
-
-                /* Subtract size of AES field, since AES is handled internally */
-                file_info.size_file_extra_internal += 2 + 2 + extra_data_size;
+                if (extra_data_pos + 8 > extra_data_size)
+                    err = UNZ_BADZIPFILE;
+                else
+                    file_info.compressed_size = unzGetUInt64(extra_data + extra_data_pos);
+                extra_data_pos += 8;
+            }
+            if ((err == UNZ_OK) && (file_info_internal.offset_curfile == UINT32_MAX))
+            {
+                /* Relative Header offset */
+                if (extra_data_pos + 8 > extra_data_size)
+                    err = UNZ_BADZIPFILE;
+                else
+                    file_info_internal.offset_curfile = unzGetUInt64(extra_data + extra_data_pos);
+                file_info.disk_offset = file_info_internal.offset_curfile;
+                extra_data_pos += 8;
+            }
+            if ((err == UNZ_OK) && (file_info.disk_num_start == UINT32_MAX))
+            {
+                /* Disk Start Number */
+                if (extra_data_pos + 4 > extra_data_size)
+                    err = UNZ_BADZIPFILE;
+                else
+                    file_info.disk_num_start = unzGetUInt32(extra_data + extra_data_pos);
+                extra_data_pos += 4;
+            }
+        }
+#ifdef HAVE_AES
+        /* AES header */
+        else if (extra_header_id == 0x9901)
+        {
+            /* Subtract size of AES field, since AES is handled internally */
+            file_info.size_file_extra_internal += 2 + 2 + extra_data_size;
 
-                /* Verify version info */
-                if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &value16) != UNZ_OK)
-                    err = UNZ_ERRNO;
-                /* Support AE-1 and AE-2 */
-                if (value16 != 1 && value16 != 2)
-                    err = UNZ_ERRNO;
-                file_info_internal.aes_version = value16;
-                if (unzReadUInt8(&s->z_filefunc, s->filestream_with_CD, &value8) != UNZ_OK)
-                    err = UNZ_ERRNO;
-                if ((char)value8 != 'A')
-                    err = UNZ_ERRNO;
-                if (unzReadUInt8(&s->z_filefunc, s->filestream_with_CD, &value8) != UNZ_OK)
+            if (extra_data_size < 7)
+                err = UNZ_BADZIPFILE;
+            else
+            {
+                /* Verify version info, support AE-1 and AE-2 */
+                file_info_internal.aes_version = unzGetUInt16(extra_data);
+                if ((file_info_internal.aes_version != 1) && (file_info_internal.aes_version != 2))
                     err = UNZ_ERRNO;
-                if ((char)value8 != 'E')
+                if ((extra_data[2] != 'A') || (extra_data[3] != 'E'))
                     err = UNZ_ERRNO;
                 /* Get AES encryption strength and actual compression method */
-                if (unzReadUInt8(&s->z_filefunc, s->filestream_with_CD, &value8) != UNZ_OK)
-                    err = UNZ_ERRNO;
-                file_info_internal.aes_encryption_mode = value8;
-                if (unzReadUInt16(&s->z_filefunc, s->filestream_with_CD, &value16) != UNZ_OK)
-                    err = UNZ_ERRNO;
-                file_info_internal.aes_compression_method = value16;
+                file_info_internal.aes_encryption_mode = extra_data[4];
+                file_info_internal.aes_compression_method = unzGetUInt16(extra_data + 5);
             }
+        }
 #endif
-            else
-            {
-                if (ZSEEK64(s->z_filefunc, s->filestream_with_CD, extra_data_size, ZLIB_FILEFUNC_SEEK_CUR) != 0)
-                    err = UNZ_ERRNO;
-            }
 
-            extra_pos += 2 + 2 + extra_data_size;
-        }
+        extra_pos += 2 + 2 + extra_data_size;
     }
 
     if (file_info.disk_num_start == s->gi.number_disk_with_CD)
@@ -886,7 +1181,12 @@ static int unzGetCurrentFileInfoInternal(unzFile file, unz_file_info64 *pfile_in
         file_info_internal.byte_before_the_zipfile = 0;
 
     if (err == UNZ_OK)
-        err = unzGetCurrentFileInfoField(file, &seek, comment, comment_size, file_info.size_file_comment, 1);
+    {
+        unzGetCurrentFileInfoField(filename, filename_size, variable, file_info.size_filename, 1);
+        unzGetCurrentFileInfoField(extrafield, extrafield_size, extra, file_info.size_file_extra, 0);
+        unzGetCurrentFileInfoField(comment, comment_size, extra + file_info.size_file_extra,
+            file_info.size_file_comment, 1);
+    }
 
     if ((err == UNZ_OK) && (pfile_info != NULL))
         *pfile_info = file_info;
@@ -941,8 +1241,7 @@ extern int ZEXPORT unzGetCurrentFileInfo64(unzFile file, unz_file_info64 * pfile
 static int unzCheckCurrentFileCoherencyHeader(unz64_internal *s, uint32_t *psize_variable, uint64_t *poffset_local_extrafield,
     uint16_t *psize_local_extrafield)
 {
-    uint32_t magic = 0;
-    uint16_t value16 = 0;
+    const uint8_t *header = NULL;
     uint32_t value32 = 0;
     uint32_t flags = 0;
     uint16_t size_filename = 0;
@@ -964,26 +1263,16 @@ static int unzCheckCurrentFileCoherencyHeader(unz64_internal *s, uint32_t *psize
     if (err != UNZ_OK)
         return err;
 
-    if (ZSEEK64(s->z_filefunc, s->filestream, s->cur_file_info_internal.offset_curfile +
-        s->cur_file_info_internal.byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET) != 0)
+    header = unzReadBlock(s, s->filestream, s->cur_file_info_internal.offset_curfile +
+        s->cur_file_info_internal.byte_before_the_zipfile, SIZEZIPLOCALHEADER);
+    if (header == NULL)
         return UNZ_ERRNO;
 
-    if (err == UNZ_OK)
-    {
-        if (unzReadUInt32(&s->z_filefunc, s->filestream, &magic) != UNZ_OK)
-            err = UNZ_ERRNO;
-        else if (magic != LOCALHEADERMAGIC)
-            err = UNZ_BADZIPFILE;
-    }
+    if (unzGetUInt32(header) != LOCALHEADERMAGIC)
+        err = UNZ_BADZIPFILE;
 
-    if (unzReadUInt16(&s->z_filefunc, s->filestream, &value16) != UNZ_OK)
-        err = UNZ_ERRNO;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream, &value16) != UNZ_OK)
-        err = UNZ_ERRNO;
-    flags = value16;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream, &value16) != UNZ_OK)
-        err = UNZ_ERRNO;
-    else if ((err == UNZ_OK) && (value16 != s->cur_file_info.compression_method))
+    flags = unzGetUInt16(header + 6);
+    if ((err == UNZ_OK) && (unzGetUInt16(header + 8) != s->cur_file_info.compression_method))
         err = UNZ_BADZIPFILE;
 
     compression_method = s->cur_file_info.compression_method;
@@ -1000,27 +1289,20 @@ static int unzCheckCurrentFileCoherencyHeader(unz64_internal *s, uint32_t *psize
             err = UNZ_BADZIPFILE;
     }
 
-    if (unzReadUInt32(&s->z_filefunc, s->filestream, &value32) != UNZ_OK) /* date/time */
-        err = UNZ_ERRNO;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream, &value32) != UNZ_OK) /* crc */
-        err = UNZ_ERRNO;
-    else if ((err == UNZ_OK) && (value32 != s->cur_file_info.crc) && ((flags & 8) == 0))
+    /* date/time at 10 is not checked */
+    value32 = unzGetUInt32(header + 14); /* crc */
+    if ((err == UNZ_OK) && (value32 != s->cur_file_info.crc) && ((flags & 8) == 0))
         err = UNZ_BADZIPFILE;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream, &value32) != UNZ_OK) /* size compr */
-        err = UNZ_ERRNO;
-    else if ((value32 != UINT32_MAX) && (err == UNZ_OK) && (value32 != s->cur_file_info.compressed_size) && ((flags & 8) == 0))
+    value32 = unzGetUInt32(header + 18); /* size compr */
+    if ((value32 != UINT32_MAX) && (err == UNZ_OK) && (value32 != s->cur_file_info.compressed_size) && ((flags & 8) == 0))
         err = UNZ_BADZIPFILE;
-    if (unzReadUInt32(&s->z_filefunc, s->filestream, &value32) != UNZ_OK) /* size uncompr */
-        err = UNZ_ERRNO;
-    else if ((value32 != UINT32_MAX) && (err == UNZ_OK) && (value32 != s->cur_file_info.uncompressed_size) && ((flags & 8) == 0))
+    value32 = unzGetUInt32(header + 22); /* size uncompr */
+    if ((value32 != UINT32_MAX) && (err == UNZ_OK) && (value32 != s->cur_file_info.uncompressed_size) && ((flags & 8) == 0))
         err = UNZ_BADZIPFILE;
-    if (unzReadUInt16(&s->z_filefunc, s->filestream, &size_filename) != UNZ_OK)
-        err = UNZ_ERRNO;
 
+    size_filename = unzGetUInt16(header + 26);
     *psize_variable += size_filename;
-
-    if (unzReadUInt16(&s->z_filefunc, s->filestream, &size_extra_field) != UNZ_OK)
-        err = UNZ_ERRNO;
+    size_extra_field = unzGetUInt16(header + 28);
 
     *poffset_local_extrafield = s->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER + size_filename;
     *psize_local_extrafield = size_extra_field;
@@ -1049,6 +1331,9 @@ extern uint64_t ZEXPORT unzCountEntries(const unzFile file)
         + s.cur_file_info.size_file_comment;
         s.num_file += 1;
     }
+    /* The copy may have grown the block headers are read into */
+    ((unz64_internal*)file)->read_block = s.read_block;
+    ((unz64_internal*)file)->read_block_size = s.read_block_size;
     return s.num_file;
 }
 
@@ -1154,6 +1439,14 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int *method, int *level, in
         
     pfile_in_zip_read_info->pos_in_zipfile = s->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER + size_variable;
 
+    /* Inflate or copy an unencrypted entry straight from a stream that maps it */
+    pfile_in_zip_read_info->mapped = NULL;
+    pfile_in_zip_read_info->mapped_pos = pfile_in_zip_read_info->pos_in_zipfile;
+    if ((s->cur_file_info.flag & 1) == 0)
+        pfile_in_zip_read_info->mapped = (const uint8_t*)ZMAP64(s->z_filefunc, s->filestream,
+            pfile_in_zip_read_info->pos_in_zipfile + pfile_in_zip_read_info->byte_before_the_zipfile,
+            s->cur_file_info.compressed_size);
+
     pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
     pfile_in_zip_read_info->stream.zfree = (free_func)0;
     pfile_in_zip_read_info->stream.opaque = (voidpf)s;
@@ -1246,8 +1539,9 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int *method, int *level, in
             if (ZREAD64(s->z_filefunc, s->filestream, passverify_archive, AES_PWVERIFYSIZE) != AES_PWVERIFYSIZE)
                 return UNZ_INTERNALERROR;
 
-            fcrypt_init(s->cur_file_info_internal.aes_encryption_mode, (uint8_t *)password,
-                (uint32_t)strlen(password), salt_value, passverify_password, &s->pfile_in_zip_read->aes_ctx);
+            fcrypt_init_cached(s->cur_file_info_internal.aes_encryption_mode, (uint8_t *)password,
+                (uint32_t)strlen(password), salt_value, passverify_password, &s->aes_key_cache,
+                &s->pfile_in_zip_read->aes_ctx);
 
             if (memcmp(passverify_archive, passverify_password, AES_PWVERIFYSIZE) != 0)
                 return UNZ_BADPASSWORD;
@@ -1339,7 +1633,20 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
 
     do
     {
-        if (s->pfile_in_zip_read->stream.avail_in == 0)
+        if ((s->pfile_in_zip_read->stream.avail_in == 0) && (s->pfile_in_zip_read->mapped != NULL))
+        {
+            uint64_t bytes_mapped = s->pfile_in_zip_read->rest_read_compressed;
+
+            if (bytes_mapped > UINT32_MAX)
+                bytes_mapped = UINT32_MAX;
+
+            s->pfile_in_zip_read->stream.next_in = (uint8_t*)s->pfile_in_zip_read->mapped +
+                (s->pfile_in_zip_read->pos_in_zipfile - s->pfile_in_zip_read->mapped_pos);
+            s->pfile_in_zip_read->stream.avail_in = (uint32_t)bytes_mapped;
+            s->pfile_in_zip_read->pos_in_zipfile += bytes_mapped;
+            s->pfile_in_zip_read->rest_read_compressed -= bytes_mapped;
+        }
+        else if (s->pfile_in_zip_read->stream.avail_in == 0)
         {
             uint32_t bytes_to_read = UNZ_BUFSIZE;
             uint32_t bytes_not_read = 0;
@@ -1411,7 +1718,6 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
 
         if ((s->pfile_in_zip_read->compression_method == 0) || (s->pfile_in_zip_read->raw))
         {
-            uint32_t i = 0;
             uint32_t copy = 0;
 
             if ((s->pfile_in_zip_read->stream.avail_in == 0) &&
@@ -1423,14 +1729,11 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
             else
                 copy = s->pfile_in_zip_read->stream.avail_in;
 
-            for (i = 0; i < copy; i++)
-                *(s->pfile_in_zip_read->stream.next_out + i) =
-                        *(s->pfile_in_zip_read->stream.next_in + i);
+            s->pfile_in_zip_read->crc32 = crc32_copy(s->pfile_in_zip_read->crc32,
+                                s->pfile_in_zip_read->stream.next_out, s->pfile_in_zip_read->stream.next_in, copy);
 
             s->pfile_in_zip_read->total_out_64 = s->pfile_in_zip_read->total_out_64 + copy;
             s->pfile_in_zip_read->rest_read_uncompressed -= copy;
-            s->pfile_in_zip_read->crc32 = (uint32_t)crc32(s->pfile_in_zip_read->crc32,
-                                s->pfile_in_zip_read->stream.next_out, copy);
 
             s->pfile_in_zip_read->stream.avail_in -= copy;
             s->pfile_in_zip_read->stream.avail_out -= copy;
@@ -1471,7 +1774,7 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
 
             s->pfile_in_zip_read->total_out_64 = s->pfile_in_zip_read->total_out_64 + out_bytes;
             s->pfile_in_zip_read->rest_read_uncompressed -= out_bytes;
-            s->pfile_in_zip_read->crc32 = crc32(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
+            s->pfile_in_zip_read->crc32 = crc32_update(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
 
             read += (uint32_t)out_bytes;
 
@@ -1520,7 +1823,7 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
             s->pfile_in_zip_read->total_out_64 += out_bytes;
             s->pfile_in_zip_read->rest_read_uncompressed -= out_bytes;
             s->pfile_in_zip_read->crc32 =
-                crc32(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
+                crc32_update(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
 
             read += (uint32_t)out_bytes;
 
@@ -1564,7 +1867,7 @@ extern int ZEXPORT unzReadCurrentFile(unzFile file, voidp buf, uint32_t len)
             s->pfile_in_zip_read->total_out_64 += out_bytes;
             s->pfile_in_zip_read->rest_read_uncompressed -= out_bytes;
             s->pfile_in_zip_read->crc32 =
-                (uint32_t)crc32(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
+                crc32_update(s->pfile_in_zip_read->crc32, buf_before, (uint32_t)out_bytes);
 
             read += (uint32_t)out_bytes;
 
@@ -1796,6 +2099,38 @@ extern int ZEXPORT unzLocateFile(unzFile file, const char *filename, unzFileName
     return err;
 }
 
+extern int ZEXPORT unzLocateFileIndexed(unzFile file, const char *filename)
+{
+    unz64_internal *s = NULL;
+    const unz_index *index = NULL;
+    size_t filename_size = 0;
+    uint64_t slot = 0;
+    uint32_t hash = 0;
+
+    if (file == NULL || filename == NULL)
+        return UNZ_PARAMERROR;
+    s = (unz64_internal*)file;
+    index = s->index;
+    if (index == NULL)
+    {
+        /* No memory for the index: scan, still honouring the mode it was opened with */
+        if (s->index_mode == UNZ_INDEX_CASE_INSENSITIVE)
+            return unzLocateFile(file, filename, unzIndexCompareInsensitive);
+        return unzLocateFile(file, filename, NULL);
+    }
+
+    filename_size = strlen(filename);
+    if (filename_size > UINT16_MAX)
+        return UNZ_END_OF_LIST_OF_FILE;
+
+    hash = unzIndexHash(filename, (uint16_t)filename_size, index->mode);
+    slot = unzIndexFindSlot(index, filename, (uint16_t)filename_size, hash);
+    if (index->slots[slot] == 0)
+        return UNZ_END_OF_LIST_OF_FILE;
+
+    return unzGoToFilePos64(file, &index->entries[index->slots[slot] - 1].pos);
+}
+
 extern int ZEXPORT unzGetFilePos(unzFile file, unz_file_pos *file_pos)
 {
     unz64_file_pos file_pos64;
@@ -1971,7 +2306,15 @@ extern int ZEXPORT unzSeek64(unzFile file, uint64_t offset, int origin)
         (s->pfile_in_zip_read->rest_read_compressed != 0 || s->cur_file_info.compressed_size < UNZ_BUFSIZE) &&
         (position >= stream_pos_begin && position < stream_pos_end);
 
-    if (is_within_buffer)
+    if (s->pfile_in_zip_read->mapped != NULL)
+    {
+        s->pfile_in_zip_read->stream.avail_in = 0;
+        s->pfile_in_zip_read->stream.next_in = 0;
+
+        s->pfile_in_zip_read->pos_in_zipfile = s->pfile_in_zip_read->mapped_pos + position;
+        s->pfile_in_zip_read->rest_read_compressed = s->cur_file_info.compressed_size - position;
+    }
+    else if (is_within_buffer)
     {
         s->pfile_in_zip_read->stream.next_in += position - s->pfile_in_zip_read->total_out_64;
         s->pfile_in_zip_read->stream.avail_in = (uInt)(stream_pos_end - position);
@@ -2004,3 +2347,249 @@ extern int ZEXPORT unzEndOfFile(unzFile file)
         return 1;
     return 0;
 }
+
+/***************************************************************************/
+/* Extracting entries on several threads */
+
+/* Run the callbacks for each entry on the calling thread */
+static int unzExtractSerial(unzFile file, unz_extract_entry_func extract, unz_entry_done_func done, void *opaque)
+{
+    uint64_t entry = 0;
+    int err = UNZ_OK;
+    int ret = 0;
+
+    err = unzGoToFirstFile(file);
+    while (err == UNZ_OK)
+    {
+        ret = done(opaque, entry, extract(opaque, file, entry));
+        if (ret != 0)
+            return ret;
+        entry += 1;
+        err = unzGoToNextFile(file);
+    }
+    if (err == UNZ_END_OF_LIST_OF_FILE)
+        err = UNZ_OK;
+    return err;
+}
+
+#ifndef NO_PARALLEL_UNZIP
+
+typedef struct unz_parallel_s
+{
+    pthread_mutex_t lock;
+    pthread_cond_t entry_done;          /* a worker finished an entry */
+    pthread_cond_t reported;            /* done was called for an entry */
+    unz64_file_pos *pos;                /* central directory position of each entry */
+    int *results;                       /* what extract returned for each entry */
+    uint8_t *finished;
+    uint64_t entry_count;
+    uint64_t next;                      /* next entry to extract */
+    uint64_t done_count;                /* entries passed to done */
+    uint64_t window;                    /* how far the workers may run ahead of done */
+    int stop;
+    unz_extract_entry_func extract;
+    void *opaque;
+} unz_parallel;
+
+typedef struct unz_parallel_worker_s
+{
+    unz_parallel *up;
+    unzFile file;                       /* own handle, so no read position is shared */
+    pthread_t thread;
+} unz_parallel_worker;
+
+static void *unzParallelWorker(void *arg)
+{
+    unz_parallel_worker *worker = (unz_parallel_worker*)arg;
+    unz_parallel *up = worker->up;
+    uint64_t entry = 0;
+    int result = UNZ_OK;
+
+    pthread_mutex_lock(&up->lock);
+    for (;;)
+    {
+        while ((!up->stop) && (up->next < up->entry_count) && (up->next - up->done_count >= up->window))
+            pthread_cond_wait(&up->reported, &up->lock);
+        if ((up->stop) || (up->next >= up->entry_count))
+            break;
+        entry = up->next;
+        up->next += 1;
+        pthread_mutex_unlock(&up->lock);
+
+        result = unzGoToFilePos64(worker->file, &up->pos[entry]);
+        if (result == UNZ_OK)
+            result = up->extract(up->opaque, worker->file, entry);
+
+        pthread_mutex_lock(&up->lock);
+        up->results[entry] = result;
+        up->finished[entry] = 1;
+        pthread_cond_signal(&up->entry_done);
+    }
+    pthread_mutex_unlock(&up->lock);
+    return NULL;
+}
+
+/* Record the central directory position of every entry, so workers can go straight to theirs */
+static int unzParallelSnapshot(unzFile file, unz_parallel *up)
+{
+    unz64_file_pos *grown = NULL;
+    uint64_t capacity = 0;
+    int err = UNZ_OK;
+
+    err = unzGoToFirstFile(file);
+    while (err == UNZ_OK)
+    {
+        if (up->entry_count == capacity)
+        {
+            capacity = (capacity == 0) ? 1024 : capacity * 2;
+            grown = NULL;
+            if (capacity <= SIZE_MAX / sizeof(unz64_file_pos))
+                grown = realloc(up->pos, (size_t)(capacity * sizeof(unz64_file_pos)));
+            if (grown == NULL)
+                return UNZ_INTERNALERROR;
+            up->pos = grown;
+        }
+        unzGetFilePos64(file, &up->pos[up->entry_count]);
+        up->entry_count += 1;
+        err = unzGoToNextFile(file);
+    }
+    if (err == UNZ_END_OF_LIST_OF_FILE)
+        err = UNZ_OK;
+    return err;
+}
+
+static int unzExtractThreaded(unzFile file, const void *path, zlib_filefunc64_def *pzlib_filefunc_def,
+    uint32_t workers, unz_extract_entry_func extract, unz_entry_done_func done, void *opaque)
+{
+    unz_parallel up;
+    unz_parallel_worker *threads = NULL;
+    uint64_t entry = 0;
+    uint32_t opened = 0;
+    uint32_t started = 0;
+    uint32_t i = 0;
+    int result = UNZ_OK;
+    int err = UNZ_OK;
+    int ret = 0;
+
+    memset(&up, 0, sizeof(unz_parallel));
+    err = unzParallelSnapshot(file, &up);
+    if ((err == UNZ_OK) && (up.entry_count < workers))
+        workers = (uint32_t)up.entry_count;
+
+    if ((err == UNZ_OK) && (workers > 1))
+    {
+        up.results = (int*)ALLOC((size_t)(up.entry_count * sizeof(int)));
+        up.finished = (uint8_t*)ALLOC((size_t)up.entry_count);
+        threads = (unz_parallel_worker*)ALLOC(workers * sizeof(unz_parallel_worker));
+        if ((up.results == NULL) || (up.finished == NULL) || (threads == NULL))
+            err = UNZ_INTERNALERROR;
+    }
+    if ((err == UNZ_OK) && (workers > 1))
+    {
+        memset(up.finished, 0, (size_t)up.entry_count);
+        for (opened = 0; opened < workers; opened += 1)
+        {
+            threads[opened].up = &up;
+            if (pzlib_filefunc_def != NULL)
+                threads[opened].file = unzOpen2_64(path, pzlib_filefunc_def);
+            else
+                threads[opened].file = unzOpenInternal(path, &((unz64_internal*)file)->z_filefunc, 0);
+            if (threads[opened].file == NULL)
+            {
+                err = UNZ_ERRNO;
+                break;
+            }
+        }
+    }
+
+    if ((err == UNZ_OK) && (workers > 1))
+    {
+        pthread_mutex_init(&up.lock, NULL);
+        pthread_cond_init(&up.entry_done, NULL);
+        pthread_cond_init(&up.reported, NULL);
+        /* A few entries per worker keep them busy while done catches up, and bound the work left over
+           when done stops the extraction */
+        up.window = (uint64_t)workers * 4;
+        up.extract = extract;
+        up.opaque = opaque;
+
+        for (started = 0; started < workers; started += 1)
+        {
+            if (pthread_create(&threads[started].thread, NULL, unzParallelWorker, &threads[started]) != 0)
+                break;
+        }
+
+        for (entry = 0; (started > 0) && (entry < up.entry_count); entry += 1)
+        {
+            pthread_mutex_lock(&up.lock);
+            while (!up.finished[entry])
+                pthread_cond_wait(&up.entry_done, &up.lock);
+            result = up.results[entry];
+            pthread_mutex_unlock(&up.lock);
+
+            ret = done(opaque, entry, result);
+
+            pthread_mutex_lock(&up.lock);
+            up.done_count = entry + 1;
+            if (ret != 0)
+                up.stop = 1;
+            pthread_cond_broadcast(&up.reported);
+            pthread_mutex_unlock(&up.lock);
+            if (ret != 0)
+                break;
+        }
+
+        for (i = 0; i < started; i += 1)
+            pthread_join(threads[i].thread, NULL);
+        pthread_cond_destroy(&up.reported);
+        pthread_cond_destroy(&up.entry_done);
+        pthread_mutex_destroy(&up.lock);
+    }
+
+    for (i = 0; i < opened; i += 1)
+        unzClose(threads[i].file);
+    TRYFREE(threads);
+    TRYFREE(up.finished);
+    TRYFREE(up.results);
+    TRYFREE(up.pos);
+
+    if (err != UNZ_OK)
+        return err;
+    /* Too few entries, or no thread could be started */
+    if ((workers <= 1) || (started == 0))
+        return unzExtractSerial(file, extract, done, opaque);
+    return ret;
+}
+
+extern int ZEXPORT unzExtractParallel(unzFile file, const void *path, zlib_filefunc64_def *pzlib_filefunc_def,
+    uint32_t workers, unz_extract_entry_func extract, unz_entry_done_func done, void *opaque)
+{
+    long cpus = 0;
+
+    if ((file == NULL) || (path == NULL) || (extract == NULL) || (done == NULL))
+        return UNZ_PARAMERROR;
+
+    if (workers == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+    if (workers > 256)
+        workers = 256;
+    if (workers == 1)
+        return unzExtractSerial(file, extract, done, opaque);
+    return unzExtractThreaded(file, path, pzlib_filefunc_def, workers, extract, done, opaque);
+}
+
+#else
+
+extern int ZEXPORT unzExtractParallel(unzFile file, ZIP_UNUSED const void *path,
+    ZIP_UNUSED zlib_filefunc64_def *pzlib_filefunc_def, ZIP_UNUSED uint32_t workers,
+    unz_extract_entry_func extract, unz_entry_done_func done, void *opaque)
+{
+    if ((file == NULL) || (extract == NULL) || (done == NULL))
+        return UNZ_PARAMERROR;
+    return unzExtractSerial(file, extract, done, opaque);
+}
+
+#endif
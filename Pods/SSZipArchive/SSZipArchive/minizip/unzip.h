@@ -82,6 +82,26 @@ extern unzFile ZEXPORT unzOpen2(const char *path, zlib_filefunc_def *pzlib_filef
 extern unzFile ZEXPORT unzOpen2_64(const void *path, zlib_filefunc64_def *pzlib_filefunc_def);
 /* Open a Zip file, like unz64Open, but provide a set of file low level API for read/write 64-bit operations */
 
+#define UNZ_INDEX_CASE_SENSITIVE        (1)
+#define UNZ_INDEX_CASE_INSENSITIVE      (2)
+
+extern unzFile ZEXPORT unzOpenIndexed64(const void *path, zlib_filefunc64_def *pzlib_filefunc_def, int index_mode);
+/* Open a Zip file, like unzOpen2_64 (pzlib_filefunc_def may be NULL), and index the names in its central
+   directory for unzLocateFileIndexed. The index is built in a single buffered pass over the central directory
+   and costs about 32 bytes per entry plus the names.
+
+   index_mode is UNZ_INDEX_CASE_SENSITIVE, or UNZ_INDEX_CASE_INSENSITIVE to match names ignoring ASCII case.
+   If there is not enough memory for the index the file is still opened, and lookups fall back to a scan
+   that matches names the same way */
+
+extern unzFile ZEXPORT unzOpenMapped64(const void *path, zlib_filefunc64_map_def *pzlib_filefunc_def, int index_mode);
+/* Open a Zip file, like unzOpenIndexed64, with functions that can also map it (see fill_mmap_filefunc64 in
+   ioapi_mmap.h). Entries are then inflated, and the central directory parsed, in place. index_mode may also
+   be 0 to open the file without an index.
+
+   A mapped file must not be truncated while it is open: reading a page past its new end raises SIGBUS
+   instead of returning an error */
+
 extern int ZEXPORT unzClose(unzFile file);
 /* Close a ZipFile opened with unzOpen. If there is files inside the .Zip opened with unzOpenCurrentFile,
    these files MUST be closed with unzipCloseCurrentFile before call unzipClose.
@@ -205,6 +225,35 @@ extern int ZEXPORT unzLocateFile(unzFile file, const char *filename, unzFileName
    return UNZ_OK if the file is found (it becomes the current file)
    return UNZ_END_OF_LIST_OF_FILE if the file is not found */
 
+extern int ZEXPORT unzLocateFileIndexed(unzFile file, const char *filename);
+/* Locate the file filename like unzLocateFile, in constant time when the zipfile was opened with
+   unzOpenIndexed64. If several entries have the name, the first in the central directory is found.
+
+   return UNZ_OK if the file is found (it becomes the current file)
+   return UNZ_END_OF_LIST_OF_FILE if the file is not found */
+
+/***************************************************************************/
+/* Extracting entries on several threads */
+
+typedef int (*unz_extract_entry_func)(void *opaque, unzFile file, uint64_t entry);
+typedef int (*unz_entry_done_func)(void *opaque, uint64_t entry, int result);
+
+extern int ZEXPORT unzExtractParallel(unzFile file, const void *path, zlib_filefunc64_def *pzlib_filefunc_def,
+    uint32_t workers, unz_extract_entry_func extract, unz_entry_done_func done, void *opaque);
+/* Call extract for each entry of the zipfile, from workers threads that each open their own handle of the
+   zipfile at path with pzlib_filefunc_def, or with the functions file was opened with if it is NULL, so no
+   read position is shared. The handle
+   passed to extract has the entry as its current file. done is then called on the calling thread, in
+   central directory order, with the value extract returned or the error locating the entry.
+
+   Workers run at most a few entries ahead of done. Extraction stops when done returns nonzero; entries
+   already being extracted are finished, but done is not called for them.
+
+   workers is the number of threads, 0 for one per CPU. With 1, or when threads are not available
+   (NO_PARALLEL_UNZIP), both callbacks run on the calling thread using file.
+
+   return UNZ_OK, the nonzero value returned by done, or the error reading the central directory */
+
 /***************************************************************************/
 /* Raw access to zip file */
 
@@ -19,11 +19,14 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
 #include <errno.h>
 #include <assert.h>
 
 #include "zlib.h"
 #include "zip.h"
+#include "crc32_hw.h"
 
 #ifdef HAVE_AES
 #  define AES_METHOD          (99)
@@ -45,6 +48,14 @@
 #  include "crypt.h"
 #endif
 
+#if defined(_WIN32) && !defined(NO_PARALLEL_ZIP)
+#  define NO_PARALLEL_ZIP
+#endif
+#ifndef NO_PARALLEL_ZIP
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
 #define SIZEDATA_INDATABLOCK        (4096-(4*4))
 
 #define DISKHEADERMAGIC             (0x08074b50)
@@ -56,6 +67,7 @@
 #define DATADESCRIPTORMAGIC         (0x08074b50)
 
 #define FLAG_LOCALHEADER_OFFSET     (0x06)
+#define METHOD_LOCALHEADER_OFFSET   (0x08)
 #define CRC_LOCALHEADER_OFFSET      (0x0e)
 
 #define SIZECENTRALHEADER           (0x2e) /* 46 */
@@ -74,6 +86,19 @@
 #  define Z_BUFSIZE                 (UINT16_MAX)
 #endif
 
+/* Bytes of a Z_DEFLATED_AUTO entry looked at before deciding to deflate or store it */
+#ifndef ZIP_AUTO_SAMPLE
+#  define ZIP_AUTO_SAMPLE           (64 * 1024)
+#endif
+/* Bits per byte below which the sample is deflated without a trial, text stays well under */
+#ifndef ZIP_AUTO_ENTROPY
+#  define ZIP_AUTO_ENTROPY          (7.0)
+#endif
+
+#ifndef ZIP_PARALLEL_MEMORY
+#  define ZIP_PARALLEL_MEMORY       (64 * 1024 * 1024)
+#endif
+
 #ifndef ALLOC
 #  define ALLOC(size) (malloc(size))
 #endif
@@ -123,7 +148,10 @@ typedef struct
     prng_ctx aes_rng[1];
 #endif
     int      stream_initialised;    /* 1 is stream is initialized */
+    uint8_t *buffered_data;         /* buffer contain compressed data to be writ, after its headers */
+    uint32_t size_buffered_data;    /* size of buffered_data */
     uint32_t pos_in_buffered_data;  /* last written byte in buffered_data */
+    uint32_t pos_data_in_buffered_data; /* first byte of compressed data not yet encrypted */
 
     uint64_t pos_local_header;      /* offset of the local header of the file currently writing */
     char    *central_header;        /* central header data for the current file */
@@ -136,19 +164,87 @@ typedef struct
     uint16_t method;                /* compression method written to file.*/
     uint16_t compression_method;    /* compression method to use */
     int      raw;                   /* 1 for directly writing raw data */
-    uint8_t  buffered_data[Z_BUFSIZE];  /* buffer contain compressed data to be writ*/
+    int      raw_encrypted;         /* 1 if the raw data is already encrypted, with its header and trailer */
     uint32_t dos_date;
     uint32_t crc32;
     int      zip64;                 /* add ZIP64 extended information in the extra field */
     uint32_t number_disk;           /* number of current disk used for spanning ZIP */
     uint64_t total_compressed;
     uint64_t total_uncompressed;
+    int      auto_method;           /* 1 if the file was opened with Z_DEFLATED_AUTO */
+    int      sampling;              /* 1 while the start of the file is gathered in sample */
+    uint8_t *sample;                /* start of a Z_DEFLATED_AUTO file, ZIP_AUTO_SAMPLE bytes */
+    uint32_t size_sample;
+    uint32_t pos_local_header_in_buffered_data; /* local header kept in buffered_data while sampling */
+    uint32_t pos_aes_method_in_buffered_data;   /* compression method in its AES extra info */
+    uint64_t trial_usec;            /* CPU time of the trial deflate of a sample that was stored */
+    uint32_t trial_size;
 #ifndef NOCRYPT
     uint32_t keys[3];          /* keys defining the pseudo-random sequence */
     const z_crc_t *pcrc_32_tab;
 #endif
 } curfile64_info;
 
+#ifndef NO_PARALLEL_ZIP
+/* zip_parallel_job_s is an entry queued with zipParallelAddFile */
+typedef struct zip_parallel_job_s
+{
+    FILE    *source;                /* file to compress, closed by the worker */
+    char    *filename;
+    char    *password;
+    zip_fileinfo zipfi;
+    int      has_zipfi;
+    uint16_t method;
+    int      level;
+    int      aes;
+
+    int      done;                  /* set by the worker, under the lock */
+    int      err;
+    int      data_type;             /* as detected by deflate */
+    uint32_t crc32;
+    uint64_t uncompressed_size;
+    uint8_t *data;                  /* compressed and encrypted data kept in memory */
+    uint64_t data_size;
+    uint64_t data_capacity;
+    FILE    *spill;                 /* data past the memory share of the job */
+    uint64_t spill_size;
+    int      auto_method;           /* 1 if method was chosen from Z_DEFLATED_AUTO */
+    uint64_t sample_usec;
+    uint64_t trial_usec;
+    uint32_t trial_size;
+#ifndef NOCRYPT
+#ifdef HAVE_AES
+    fcrypt_ctx aes_ctx;
+#endif
+    uint32_t keys[3];
+    const z_crc_t *pcrc_32_tab;
+#endif
+} zip_parallel_job;
+
+/* zip_parallel_s holds the workers started by zipParallelBegin. Only the thread writing
+   the zip queues and writes jobs, so queued and written need no lock */
+typedef struct zip_parallel_s
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  job_queued;     /* wakes the workers */
+    pthread_cond_t  job_done;       /* wakes the writer */
+    pthread_t      *threads;
+    uint32_t        thread_count;
+    zip_parallel_job *jobs;         /* ring of queue_size jobs */
+    uint32_t        queue_size;
+    uint64_t        queued;         /* number of jobs queued */
+    uint64_t        started;        /* number of jobs taken by a worker */
+    uint64_t        written;        /* number of jobs written to the zip */
+    uint64_t        job_memory;     /* bytes of data a job keeps in memory before spilling */
+    char           *spill_dir;
+    uint32_t        dos_date;       /* date of the last queued entry */
+    zip_written_func written_func;  /* told about every added entry, may be NULL */
+    voidpf          written_opaque;
+    int             stop;
+    int             err;            /* first error of any job */
+} zip_parallel;
+#endif
+
 typedef struct
 {
     zlib_filefunc64_32_def z_filefunc;
@@ -164,11 +260,21 @@ typedef struct
     uint64_t disk_size;             /* size of each disk */
     uint32_t number_disk;           /* number of the current disk, used for spanning ZIP */
     uint32_t number_disk_with_CD;   /* number the the disk with central dir, used for spanning ZIP */
+    int stream;                     /* 1 if the zipfile is written without seeking or telling */
+    uint64_t stream_pos;            /* bytes written, the position in the zipfile when streaming */
+    zip_compression_stats stats;
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
 #endif
+#ifndef NO_PARALLEL_ZIP
+    zip_parallel *parallel;         /* workers, if zipParallelBegin was called */
+#endif
 } zip64_internal;
 
+#ifndef NO_PARALLEL_ZIP
+static int zipParallelWrite(zip64_internal *zi, uint64_t max_pending);
+#endif
+
 /* Allocate a new data block */
 static linkedlist_datablock_internal *allocate_new_datablock(void)
 {
@@ -598,8 +704,8 @@ static uint64_t zipSearchCentralDir64(const zlib_filefunc64_32_def *pzlib_filefu
     return offset;
 }
 
-extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size, const char **globalcomment,
-    zlib_filefunc64_32_def *pzlib_filefunc64_32_def)
+static zipFile zipOpenInternal(const void *path, int append, uint64_t disk_size, const char **globalcomment,
+    zlib_filefunc64_32_def *pzlib_filefunc64_32_def, const zip_options *options)
 {
     zip64_internal ziinit = { 0 };
     zip64_internal *zi = NULL;
@@ -620,18 +726,26 @@ extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size
     int err = ZIP_OK;
     int mode = 0;
 
+    ziinit.stream = (options != NULL) && (options->stream);
+    /* A stream is written front to back, in one piece */
+    if ((ziinit.stream) && ((append != APPEND_STATUS_CREATE) || (disk_size > 0)))
+        return NULL;
+
     if (pzlib_filefunc64_32_def == NULL)
         fill_fopen64_filefunc(&ziinit.z_filefunc.zfile_func64);
     else
     {
         assert((pzlib_filefunc64_32_def->zopen32_file || pzlib_filefunc64_32_def->zfile_func64.zopen64_file) &&
-               (pzlib_filefunc64_32_def->zopendisk32_file || pzlib_filefunc64_32_def->zfile_func64.zopendisk64_file) &&
+               (ziinit.stream ||
+               ((pzlib_filefunc64_32_def->zopendisk32_file || pzlib_filefunc64_32_def->zfile_func64.zopendisk64_file) &&
                (pzlib_filefunc64_32_def->ztell32_file || pzlib_filefunc64_32_def->zfile_func64.ztell64_file) &&
-               (pzlib_filefunc64_32_def->zseek32_file || pzlib_filefunc64_32_def->zfile_func64.zseek64_file));
+               (pzlib_filefunc64_32_def->zseek32_file || pzlib_filefunc64_32_def->zfile_func64.zseek64_file))));
         ziinit.z_filefunc = *pzlib_filefunc64_32_def;
     }
 
-    if (append == APPEND_STATUS_CREATE)
+    if (ziinit.stream)
+        mode = (ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE);
+    else if (append == APPEND_STATUS_CREATE)
         mode = (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE);
     else
         mode = (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_EXISTING);
@@ -654,10 +768,17 @@ extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size
     ziinit.disk_size = disk_size;
     init_linkedlist(&(ziinit.central_dir));
 
+    ziinit.ci.size_buffered_data = Z_BUFSIZE;
+    if ((options != NULL) && (options->buffer_size > 0))
+        ziinit.ci.size_buffered_data = options->buffer_size;
+
     zi = (zip64_internal*)ALLOC(sizeof(zip64_internal));
-    if (zi == NULL)
+    ziinit.ci.buffered_data = (uint8_t*)ALLOC(ziinit.ci.size_buffered_data);
+    if ((zi == NULL) || (ziinit.ci.buffered_data == NULL))
     {
         ZCLOSE64(ziinit.z_filefunc, ziinit.filestream);
+        TRYFREE(ziinit.ci.buffered_data);
+        TRYFREE(zi);
         return NULL;
     }
 
@@ -789,6 +910,7 @@ extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size
         {
             ZCLOSE64(ziinit.z_filefunc, ziinit.filestream);
             TRYFREE(ziinit.globalcomment);
+            TRYFREE(ziinit.ci.buffered_data);
             TRYFREE(zi);
             return NULL;
         }
@@ -837,6 +959,7 @@ extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size
 #ifndef NO_ADDFILEINEXISTINGZIP
         TRYFREE(ziinit.globalcomment);
 #endif
+        TRYFREE(ziinit.ci.buffered_data);
         TRYFREE(zi);
         return NULL;
     }
@@ -846,6 +969,24 @@ extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size
     return(zipFile)zi;
 }
 
+extern zipFile ZEXPORT zipOpen4(const void *path, int append, uint64_t disk_size, const char **globalcomment,
+    zlib_filefunc64_32_def *pzlib_filefunc64_32_def)
+{
+    return zipOpenInternal(path, append, disk_size, globalcomment, pzlib_filefunc64_32_def, NULL);
+}
+
+extern zipFile ZEXPORT zipOpen5(const void *path, int append, uint64_t disk_size, const char **globalcomment,
+    zlib_filefunc64_def *pzlib_filefunc_def, const zip_options *options)
+{
+    if (pzlib_filefunc_def != NULL)
+    {
+        zlib_filefunc64_32_def zlib_filefunc64_32_def_fill = { 0 };
+        zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
+        return zipOpenInternal(path, append, disk_size, globalcomment, &zlib_filefunc64_32_def_fill, options);
+    }
+    return zipOpenInternal(path, append, disk_size, globalcomment, NULL, options);
+}
+
 extern zipFile ZEXPORT zipOpen2(const char *path, int append, const char **globalcomment,
     zlib_filefunc_def *pzlib_filefunc32_def)
 {
@@ -904,25 +1045,249 @@ extern zipFile ZEXPORT zipOpen64(const void *path, int append)
     return zipOpen3(path, append, 0, NULL, NULL);
 }
 
-extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
-                                        const char *filename,
-                                        const zip_fileinfo *zipfi,
-                                        const void *extrafield_local,
-                                        uint16_t size_extrafield_local,
-                                        const void *extrafield_global,
-                                        uint16_t size_extrafield_global,
-                                        const char *comment,
-                                        uint16_t flag_base,
-                                        int zip64,
-                                        uint16_t method,
-                                        int level,
-                                        int raw,
-                                        int windowBits,
-                                        int memLevel,
-                                        int strategy,
-                                        const char *password,
-                                        int aes,
-                                        uint16_t version_madeby)
+/* Gets the position in the zipfile of the next byte added to the write buffer */
+static uint64_t zipTellWriteBuffer(zip64_internal *zi)
+{
+    if (zi->stream)
+        return zi->stream_pos + zi->ci.pos_in_buffered_data;
+    return ZTELL64(zi->z_filefunc, zi->filestream) + zi->ci.pos_in_buffered_data;
+}
+
+/* Encrypts the compressed data added to the write buffer since the last call and counts it */
+static void zipEncryptWriteBuffer(zip64_internal *zi)
+{
+    uint8_t *data = zi->ci.buffered_data + zi->ci.pos_data_in_buffered_data;
+    uint32_t size = zi->ci.pos_in_buffered_data - zi->ci.pos_data_in_buffered_data;
+
+    if (((zi->ci.flag & 1) != 0) && (!zi->ci.raw_encrypted))
+    {
+#ifndef NOCRYPT
+#ifdef HAVE_AES
+        if (zi->ci.method == AES_METHOD)
+        {
+            fcrypt_encrypt(data, size, &zi->ci.aes_ctx);
+        }
+        else
+#endif
+        {
+            uint32_t i = 0;
+            uint8_t t = 0;
+
+            for (i = 0; i < size; i++)
+                data[i] = (uint8_t)zencode(zi->ci.keys, zi->ci.pcrc_32_tab, data[i], t);
+        }
+#endif
+    }
+
+    zi->ci.total_compressed += size;
+    zi->ci.pos_data_in_buffered_data = zi->ci.pos_in_buffered_data;
+
+#ifdef HAVE_BZIP2
+    if (zi->ci.compression_method == Z_BZIP2ED)
+    {
+        zi->ci.total_uncompressed += zi->ci.bstream.total_in_lo32;
+        zi->ci.bstream.total_in_lo32 = 0;
+        zi->ci.bstream.total_in_hi32 = 0;
+    }
+    else
+#endif
+    {
+        zi->ci.total_uncompressed += zi->ci.stream.total_in;
+        zi->ci.stream.total_in = 0;
+    }
+}
+
+/* Flushes the write buffer to disk */
+static int zipFlushWriteBuffer(zip64_internal *zi)
+{
+    uint64_t size_available = 0;
+    uint32_t written = 0;
+    uint32_t total_written = 0;
+    uint32_t write = 0;
+    uint32_t max_write = 0;
+    int err = ZIP_OK;
+
+    zipEncryptWriteBuffer(zi);
+
+    write = zi->ci.pos_in_buffered_data;
+
+    while (write > 0)
+    {
+        max_write = write;
+
+        if (zi->disk_size > 0)
+        {
+            zipGetDiskSizeAvailable((zipFile)zi, &size_available);
+
+            if (size_available == 0)
+            {
+                err = zipGoToNextDisk((zipFile)zi);
+                if (err != ZIP_OK)
+                    return err;
+            }
+
+            if (size_available < (uint64_t)max_write)
+                max_write = (uint32_t)size_available;
+        }
+
+        written = ZWRITE64(zi->z_filefunc, zi->filestream, zi->ci.buffered_data + total_written, max_write);
+        if (written != max_write)
+        {
+            err = ZIP_ERRNO;
+            break;
+        }
+
+        total_written += written;
+        write -= written;
+    }
+
+    zi->stream_pos += total_written;
+    zi->ci.pos_in_buffered_data = 0;
+    zi->ci.pos_data_in_buffered_data = 0;
+
+    return err;
+}
+
+/* Adds bytes written as they are, like headers, to the write buffer so they reach the disk in
+   the same write as the data around them */
+static int zipWriteToBuffer(zip64_internal *zi, const void *buf, uint32_t len)
+{
+    int err = ZIP_OK;
+
+    if (zi->ci.size_buffered_data - zi->ci.pos_in_buffered_data < len)
+        err = zipFlushWriteBuffer(zi);
+    if (err != ZIP_OK)
+        return err;
+
+    if (len > zi->ci.size_buffered_data)
+    {
+        if (ZWRITE64(zi->z_filefunc, zi->filestream, buf, len) != len)
+            err = ZIP_ERRNO;
+        zi->stream_pos += len;
+        return err;
+    }
+
+    memcpy(zi->ci.buffered_data + zi->ci.pos_in_buffered_data, buf, len);
+    zi->ci.pos_in_buffered_data += len;
+    zi->ci.pos_data_in_buffered_data = zi->ci.pos_in_buffered_data;
+    return err;
+}
+
+static int zipWriteValueToBuffer(zip64_internal *zi, uint64_t x, uint32_t len)
+{
+    uint8_t buf[8];
+    zipWriteValueToMemory(buf, x, len);
+    return zipWriteToBuffer(zi, buf, len);
+}
+
+/* Gets the CPU time of the calling thread */
+static uint64_t zipThreadCpuUsec(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+    return (uint64_t)clock() * 1000000 / CLOCKS_PER_SEC;
+}
+
+/* Chooses the method of an entry from its first len bytes, 0 to store it or Z_DEFLATED. Bytes spread
+   evenly over most values, like those of JPEG or MP4, are deflated once at level 1 to tell media from
+   data that only repeats longer strings; the CPU time of that trial is returned in trial_usec */
+static uint16_t zipChooseMethod(const uint8_t *buf, uint32_t len, uint64_t *trial_usec, uint64_t *sample_usec)
+{
+    z_stream stream;
+    uint32_t histogram[256];
+    uint8_t out[4096];
+    uint64_t start = zipThreadCpuUsec();
+    uint64_t trial_start = 0;
+    double entropy = 0;
+    double p = 0;
+    uint16_t method = Z_DEFLATED;
+    uint32_t i = 0;
+    int err = Z_OK;
+
+    memset(histogram, 0, sizeof(histogram));
+    for (i = 0; i < len; i++)
+        histogram[buf[i]] += 1;
+    for (i = 0; i < 256; i++)
+    {
+        if (histogram[i] == 0)
+            continue;
+        p = (double)histogram[i] / len;
+        entropy -= p * log2(p);
+    }
+
+    *trial_usec = 0;
+    if (entropy >= ZIP_AUTO_ENTROPY)
+    {
+        trial_start = zipThreadCpuUsec();
+        memset(&stream, 0, sizeof(stream));
+        if (deflateInit2(&stream, 1, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK)
+        {
+            stream.next_in = (uint8_t*)buf;
+            stream.avail_in = len;
+            do
+            {
+                stream.next_out = out;
+                stream.avail_out = sizeof(out);
+                err = deflate(&stream, Z_FINISH);
+            }
+            while (err == Z_OK);
+
+            /* Not worth it if it saves less than 1/32 */
+            if ((err == Z_STREAM_END) && (stream.total_out + len / 32 >= len))
+                method = 0;
+            deflateEnd(&stream);
+        }
+        *trial_usec = zipThreadCpuUsec() - trial_start;
+    }
+
+    *sample_usec = zipThreadCpuUsec() - start;
+    return method;
+}
+
+/* Adds a closed entry to the compression statistics */
+static void zipCountEntry(zip64_internal *zi, uint16_t compression_method, int auto_method,
+    uint64_t uncompressed_size, uint64_t compressed_size, uint64_t trial_usec, uint32_t trial_size)
+{
+    if (compression_method == 0)
+    {
+        zi->stats.bytes_stored += uncompressed_size;
+        if (auto_method)
+            zi->stats.entries_stored += 1;
+        if (trial_size > 0)
+            zi->stats.saved_usec += trial_usec * uncompressed_size / trial_size;
+    }
+    else if (compression_method == Z_DEFLATED)
+    {
+        zi->stats.bytes_deflated += uncompressed_size;
+        zi->stats.bytes_deflated_out += compressed_size;
+        if (auto_method)
+            zi->stats.entries_deflated += 1;
+    }
+}
+
+static int zipOpenNewFileInZipInternal(zipFile file,
+                                       const char *filename,
+                                       const zip_fileinfo *zipfi,
+                                       const void *extrafield_local,
+                                       uint16_t size_extrafield_local,
+                                       const void *extrafield_global,
+                                       uint16_t size_extrafield_global,
+                                       const char *comment,
+                                       uint16_t flag_base,
+                                       int zip64,
+                                       uint16_t method,
+                                       int level,
+                                       int raw,
+                                       int windowBits,
+                                       int memLevel,
+                                       int strategy,
+                                       const char *password,
+                                       int aes,
+                                       uint16_t version_madeby,
+                                       int raw_encrypted)
 {
     zip64_internal *zi = NULL;
     uint64_t size_available = 0;
@@ -931,6 +1296,8 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
     uint16_t size_comment = 0;
     uint16_t i = 0;
     unsigned char *central_dir = NULL;
+    int auto_method = 0;
+    int sampling = 0;
     int err = ZIP_OK;
 
 #ifdef NOCRYPT
@@ -941,6 +1308,13 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
     if (file == NULL)
         return ZIP_PARAMERROR;
 
+    /* Raw data is already compressed, so there is nothing to choose */
+    if (method == Z_DEFLATED_AUTO)
+    {
+        auto_method = !raw;
+        method = Z_DEFLATED;
+    }
+
     if ((method != 0) &&
 #ifdef HAVE_BZIP2
         (method != Z_BZIP2ED) &&
@@ -975,6 +1349,7 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
     zi->ci.method = method;
     zi->ci.compression_method = method;
     zi->ci.raw = raw;
+    zi->ci.raw_encrypted = raw && raw_encrypted;
     zi->ci.flag = flag_base | 8;
     if ((level == 8) || (level == 9))
         zi->ci.flag |= 2;
@@ -996,6 +1371,25 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
         zi->ci.flag &= ~1;
     }
 
+    /* The local header of a Z_DEFLATED_AUTO file stays in the write buffer until it is known whether
+       the file is stored, so that its method can still be changed */
+    if (auto_method)
+    {
+        /* With room for the zip64 and AES extra info and the salt or crypt header; without it the file
+           is deflated, and still counted as a Z_DEFLATED_AUTO entry */
+        size_needed = 30 + size_filename + size_extrafield_local + 20 + 11 + 32;
+        sampling = (size_needed <= zi->ci.size_buffered_data);
+        if ((sampling) && (zi->ci.size_buffered_data - zi->ci.pos_in_buffered_data < size_needed))
+            err = zipFlushWriteBuffer(zi);
+        if (err != ZIP_OK)
+            return err;
+
+        if ((sampling) && (zi->ci.sample == NULL))
+            zi->ci.sample = (uint8_t*)ALLOC(ZIP_AUTO_SAMPLE);
+        if (zi->ci.sample == NULL)
+            sampling = 0;
+    }
+
     if (zi->disk_size > 0)
     {
         if ((zi->number_disk == 0) && (zi->number_entry == 0))
@@ -1004,6 +1398,8 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
         /* Make sure enough space available on current disk for local header */
         zipGetDiskSizeAvailable((zipFile)zi, &size_available);
         size_needed = 30 + size_filename + size_extrafield_local;
+        if (zip64)
+            size_needed += 20;
 #ifdef HAVE_AES
         if (zi->ci.method == AES_METHOD)
             size_needed += 11;
@@ -1014,7 +1410,7 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
 
     zi->ci.zip64 = zip64;
 
-    zi->ci.pos_local_header = ZTELL64(zi->z_filefunc, zi->filestream);
+    zi->ci.pos_local_header = zipTellWriteBuffer(zi);
     if (zi->ci.pos_local_header >= UINT32_MAX)
         zi->ci.zip64 = 1;
 
@@ -1077,51 +1473,65 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
     if (zi->ci.central_header == NULL)
         return ZIP_INTERNALERROR;
 
-    /* Write the local header */
+    /* Write the local header, it is buffered and written with the start of the data */
+    zi->ci.pos_local_header_in_buffered_data = zi->ci.pos_in_buffered_data;
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)LOCALHEADERMAGIC, 4);
+        err = zipWriteValueToBuffer(zi, (uint32_t)LOCALHEADERMAGIC, 4);
 
     if (err == ZIP_OK)
     {
         if (zi->ci.zip64)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)45, 2); /* version needed to extract */
+            err = zipWriteValueToBuffer(zi, (uint16_t)45, 2); /* version needed to extract */
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)20, 2); /* version needed to extract */
+            err = zipWriteValueToBuffer(zi, (uint16_t)20, 2); /* version needed to extract */
     }
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->ci.flag, 2);
+        err = zipWriteValueToBuffer(zi, zi->ci.flag, 2);
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->ci.method, 2);
+        err = zipWriteValueToBuffer(zi, zi->ci.method, 2);
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->ci.dos_date, 4);
+        err = zipWriteValueToBuffer(zi, zi->ci.dos_date, 4);
 
     /* CRC & compressed size & uncompressed size is in data descriptor */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)0, 4); /* crc 32, unknown */
+        err = zipWriteValueToBuffer(zi, (uint32_t)0, 4); /* crc 32, unknown */
+    /* A zip64 entry has 8 byte sizes in its data descriptor, announced by the ZIP64 extra info */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)0, 4); /* compressed size, unknown */
+        err = zipWriteValueToBuffer(zi, zi->ci.zip64 ? UINT32_MAX : 0, 4); /* compressed size, unknown */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)0, 4); /* uncompressed size, unknown */
+        err = zipWriteValueToBuffer(zi, zi->ci.zip64 ? UINT32_MAX : 0, 4); /* uncompressed size, unknown */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, size_filename, 2);
+        err = zipWriteValueToBuffer(zi, size_filename, 2);
     if (err == ZIP_OK)
     {
         uint64_t size_extrafield = size_extrafield_local;
+        if (zi->ci.zip64)
+            size_extrafield += 20;
 #ifdef HAVE_AES
         if (zi->ci.method == AES_METHOD)
             size_extrafield += 11;
 #endif
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)size_extrafield, 2);
+        err = zipWriteValueToBuffer(zi, (uint16_t)size_extrafield, 2);
     }
     if ((err == ZIP_OK) && (size_filename > 0))
     {
-        if (ZWRITE64(zi->z_filefunc, zi->filestream, filename, size_filename) != size_filename)
-            err = ZIP_ERRNO;
+        err = zipWriteToBuffer(zi, filename, size_filename);
     }
     if ((err == ZIP_OK) && (size_extrafield_local > 0))
     {
-        if (ZWRITE64(zi->z_filefunc, zi->filestream, extrafield_local, size_extrafield_local) != size_extrafield_local)
-            err = ZIP_ERRNO;
+        err = zipWriteToBuffer(zi, extrafield_local, size_extrafield_local);
+    }
+
+    /* Write the ZIP64 extended info, the sizes are in the data descriptor */
+    if ((err == ZIP_OK) && (zi->ci.zip64))
+    {
+        err = zipWriteValueToBuffer(zi, 0x0001, 2);
+        if (err == ZIP_OK)
+            err = zipWriteValueToBuffer(zi, 16, 2);
+        if (err == ZIP_OK)
+            err = zipWriteValueToBuffer(zi, 0, 8);
+        if (err == ZIP_OK)
+            err = zipWriteValueToBuffer(zi, 0, 8);
     }
 
 #ifdef HAVE_AES
@@ -1131,32 +1541,35 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
         int headerid = 0x9901;
         short datasize = 7;
 
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, headerid, 2);
+        err = zipWriteValueToBuffer(zi, headerid, 2);
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, datasize, 2);
+            err = zipWriteValueToBuffer(zi, datasize, 2);
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, AES_VERSION, 2);
+            err = zipWriteValueToBuffer(zi, AES_VERSION, 2);
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, 'A', 1);
+            err = zipWriteValueToBuffer(zi, 'A', 1);
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, 'E', 1);
+            err = zipWriteValueToBuffer(zi, 'E', 1);
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, AES_ENCRYPTIONMODE, 1);
+            err = zipWriteValueToBuffer(zi, AES_ENCRYPTIONMODE, 1);
+        zi->ci.pos_aes_method_in_buffered_data = zi->ci.pos_in_buffered_data;
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->ci.compression_method, 2);
+            err = zipWriteValueToBuffer(zi, zi->ci.compression_method, 2);
     }
 #endif
 
     zi->ci.crc32 = 0;
     zi->ci.stream_initialised = 0;
-    zi->ci.pos_in_buffered_data = 0;
     zi->ci.total_compressed = 0;
     zi->ci.total_uncompressed = 0;
+    zi->ci.auto_method = auto_method;
+    zi->ci.sampling = sampling;
+    zi->ci.size_sample = 0;
+    zi->ci.trial_usec = 0;
+    zi->ci.trial_size = 0;
 
 #ifdef HAVE_BZIP2
     zi->ci.bstream.avail_in = (uint16_t)0;
-    zi->ci.bstream.avail_out = (uint16_t)Z_BUFSIZE;
-    zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
     zi->ci.bstream.total_in_hi32 = 0;
     zi->ci.bstream.total_in_lo32 = 0;
     zi->ci.bstream.total_out_hi32 = 0;
@@ -1164,8 +1577,6 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
 #endif
 
     zi->ci.stream.avail_in = (uint16_t)0;
-    zi->ci.stream.avail_out = Z_BUFSIZE;
-    zi->ci.stream.next_out = zi->ci.buffered_data;
     zi->ci.stream.total_in = 0;
     zi->ci.stream.total_out = 0;
     zi->ci.stream.data_type = Z_BINARY;
@@ -1208,7 +1619,7 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
     }
 
 #ifndef NOCRYPT
-    if ((err == Z_OK) && (password != NULL))
+    if ((err == Z_OK) && (password != NULL) && (!zi->ci.raw_encrypted))
     {
 #ifdef HAVE_AES
         if (zi->ci.method == AES_METHOD)
@@ -1228,10 +1639,9 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
 
             fcrypt_init(AES_ENCRYPTIONMODE, (uint8_t *)password, (uint32_t)strlen(password), saltvalue, passverify, &zi->ci.aes_ctx);
 
-            if (ZWRITE64(zi->z_filefunc, zi->filestream, saltvalue, saltlength) != saltlength)
-                err = ZIP_ERRNO;
-            if (ZWRITE64(zi->z_filefunc, zi->filestream, passverify, AES_PWVERIFYSIZE) != AES_PWVERIFYSIZE)
-                err = ZIP_ERRNO;
+            err = zipWriteToBuffer(zi, saltvalue, saltlength);
+            if (err == ZIP_OK)
+                err = zipWriteToBuffer(zi, passverify, AES_PWVERIFYSIZE);
 
             zi->ci.total_compressed += saltlength + AES_PWVERIFYSIZE + AES_AUTHCODESIZE;
         }
@@ -1255,17 +1665,54 @@ extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
             size_head = crypthead(password, buf_head, RAND_HEAD_LEN, zi->ci.keys, zi->ci.pcrc_32_tab, verify1, verify2);
             zi->ci.total_compressed += size_head;
 
-            if (ZWRITE64(zi->z_filefunc, zi->filestream, buf_head, size_head) != size_head)
-                err = ZIP_ERRNO;
+            err = zipWriteToBuffer(zi, buf_head, size_head);
         }
     }
 #endif
 
+    /* The compressed data follows the headers in the write buffer */
+#ifdef HAVE_BZIP2
+    zi->ci.bstream.avail_out = zi->ci.size_buffered_data - zi->ci.pos_in_buffered_data;
+    zi->ci.bstream.next_out = (char*)zi->ci.buffered_data + zi->ci.pos_in_buffered_data;
+#endif
+    zi->ci.stream.avail_out = zi->ci.size_buffered_data - zi->ci.pos_in_buffered_data;
+    zi->ci.stream.next_out = zi->ci.buffered_data + zi->ci.pos_in_buffered_data;
+
     if (err == Z_OK)
         zi->in_opened_file_inzip = 1;
     return err;
 }
 
+extern int ZEXPORT zipOpenNewFileInZip5(zipFile file,
+                                        const char *filename,
+                                        const zip_fileinfo *zipfi,
+                                        const void *extrafield_local,
+                                        uint16_t size_extrafield_local,
+                                        const void *extrafield_global,
+                                        uint16_t size_extrafield_global,
+                                        const char *comment,
+                                        uint16_t flag_base,
+                                        int zip64,
+                                        uint16_t method,
+                                        int level,
+                                        int raw,
+                                        int windowBits,
+                                        int memLevel,
+                                        int strategy,
+                                        const char *password,
+                                        int aes,
+                                        uint16_t version_madeby)
+{
+#ifndef NO_PARALLEL_ZIP
+    /* Entries queued with zipParallelAddFile come first; their errors are reported by zipParallelEnd */
+    if ((file != NULL) && (((zip64_internal*)file)->parallel != NULL))
+        zipParallelWrite((zip64_internal*)file, 0);
+#endif
+    return zipOpenNewFileInZipInternal(file, filename, zipfi, extrafield_local, size_extrafield_local,
+        extrafield_global, size_extrafield_global, comment, flag_base, zip64, method, level, raw, windowBits,
+        memLevel, strategy, password, aes, version_madeby, 0);
+}
+
 extern int ZEXPORT zipOpenNewFileInZip4_64(zipFile file, const char *filename, const zip_fileinfo *zipfi,
     const void *extrafield_local, uint16_t size_extrafield_local, const void *extrafield_global,
     uint16_t size_extrafield_global, const char *comment, uint16_t method, int level, int raw, int windowBits, int memLevel,
@@ -1346,93 +1793,58 @@ extern int ZEXPORT zipOpenNewFileInZip(zipFile file, const char *filename, const
         Z_DEFAULT_STRATEGY, NULL, 0, VERSIONMADEBY, 0, 0);
 }
 
-/* Flushes the write buffer to disk */
-static int zipFlushWriteBuffer(zip64_internal *zi)
+/* Chooses how the sampled start of a Z_DEFLATED_AUTO file is written, then writes it */
+static int zipEndSample(zip64_internal *zi)
 {
-    uint64_t size_available = 0;
-    uint32_t written = 0;
-    uint32_t total_written = 0;
-    uint32_t write = 0;
-    uint32_t max_write = 0;
+    uint8_t *local_header = zi->ci.buffered_data + zi->ci.pos_local_header_in_buffered_data;
+    uint64_t sample_usec = 0;
     int err = ZIP_OK;
 
-    if ((zi->ci.flag & 1) != 0)
+    zi->ci.sampling = 0;
+
+    if (zipChooseMethod(zi->ci.sample, zi->ci.size_sample, &zi->ci.trial_usec, &sample_usec) == 0)
     {
-#ifndef NOCRYPT
+        zi->ci.trial_size = zi->ci.size_sample;
+#ifdef HAVE_APPLE_COMPRESSION
+        compression_stream_destroy(&zi->ci.astream);
+#else
+        deflateEnd(&zi->ci.stream);
+#endif
+        zi->ci.stream_initialised = 0;
+        zi->ci.compression_method = 0;
+
+        /* The level bits only apply to deflate */
+        zi->ci.flag &= ~6;
+        zipWriteValueToMemory(local_header + FLAG_LOCALHEADER_OFFSET, zi->ci.flag, 2);
+        zipWriteValueToMemory(zi->ci.central_header + 8, zi->ci.flag, 2);
+        if (zi->ci.method == Z_DEFLATED)
+        {
+            zi->ci.method = 0;
+            zipWriteValueToMemory(local_header + METHOD_LOCALHEADER_OFFSET, (uint16_t)0, 2);
+            zipWriteValueToMemory(zi->ci.central_header + 10, (uint16_t)0, 2);
+        }
 #ifdef HAVE_AES
-        if (zi->ci.method == AES_METHOD)
+        else if (zi->ci.method == AES_METHOD)
         {
-            fcrypt_encrypt(zi->ci.buffered_data, zi->ci.pos_in_buffered_data, &zi->ci.aes_ctx);
-        }
-        else
-#endif
-        {
-            uint32_t i = 0;
-            uint8_t t = 0;
-
-            for (i = 0; i < zi->ci.pos_in_buffered_data; i++)
-                zi->ci.buffered_data[i] = (uint8_t)zencode(zi->ci.keys, zi->ci.pcrc_32_tab, zi->ci.buffered_data[i], t);
+            zipWriteValueToMemory(zi->ci.buffered_data + zi->ci.pos_aes_method_in_buffered_data, (uint16_t)0, 2);
         }
 #endif
     }
-
-    write = zi->ci.pos_in_buffered_data;
-
-    do
-    {
-        max_write = write;
-
-        if (zi->disk_size > 0)
-        {
-            zipGetDiskSizeAvailable((zipFile)zi, &size_available);
-
-            if (size_available == 0)
-            {
-                err = zipGoToNextDisk((zipFile)zi);
-                if (err != ZIP_OK)
-                    return err;
-            }
-
-            if (size_available < (uint64_t)max_write)
-                max_write = (uint32_t)size_available;
-        }
-
-        written = ZWRITE64(zi->z_filefunc, zi->filestream, zi->ci.buffered_data + total_written, max_write);
-        if (written != max_write)
-        {
-            err = ZIP_ERRNO;
-            break;
-        }
-
-        total_written += written;
-        write -= written;
-    }
-    while (write > 0);
-
-    zi->ci.total_compressed += zi->ci.pos_in_buffered_data;
-
-#ifdef HAVE_BZIP2
-    if (zi->ci.compression_method == Z_BZIP2ED)
-    {
-        zi->ci.total_uncompressed += zi->ci.bstream.total_in_lo32;
-        zi->ci.bstream.total_in_lo32 = 0;
-        zi->ci.bstream.total_in_hi32 = 0;
-    }
     else
-#endif
     {
-        zi->ci.total_uncompressed += zi->ci.stream.total_in;
-        zi->ci.stream.total_in = 0;
+        zi->ci.trial_usec = 0;
     }
+    zi->stats.sample_usec += sample_usec;
 
-    zi->ci.pos_in_buffered_data = 0;
-
+    if (zi->ci.size_sample > 0)
+        err = zipWriteInFileInZip((zipFile)zi, zi->ci.sample, zi->ci.size_sample);
     return err;
 }
 
 extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t len)
 {
     zip64_internal *zi = NULL;
+    uint32_t copy = 0;
     int err = ZIP_OK;
 
     if (file == NULL)
@@ -1442,7 +1854,27 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t l
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
 
-    zi->ci.crc32 = (uint32_t)crc32(zi->ci.crc32, buf, len);
+    /* Nothing is compressed until the start of a Z_DEFLATED_AUTO file is sampled */
+    if (zi->ci.sampling)
+    {
+        copy = ZIP_AUTO_SAMPLE - zi->ci.size_sample;
+        if (copy > len)
+            copy = len;
+        memcpy(zi->ci.sample + zi->ci.size_sample, buf, copy);
+        zi->ci.size_sample += copy;
+        if (zi->ci.size_sample < ZIP_AUTO_SAMPLE)
+            return ZIP_OK;
+
+        err = zipEndSample(zi);
+        buf = (const uint8_t*)buf + copy;
+        len -= copy;
+        if ((err != ZIP_OK) || (len == 0))
+            return err;
+    }
+
+    /* Raw data is closed with its own crc, stored data is summed as it is copied */
+    if ((!zi->ci.raw) && (zi->ci.compression_method != 0))
+        zi->ci.crc32 = crc32_update(zi->ci.crc32, buf, len);
 
 #ifdef HAVE_BZIP2
     if ((zi->ci.compression_method == Z_BZIP2ED) && (!zi->ci.raw))
@@ -1457,7 +1889,7 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t l
             {
                 err = zipFlushWriteBuffer(zi);
                 
-                zi->ci.bstream.avail_out = (uint16_t)Z_BUFSIZE;
+                zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
                 zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
             }
             else
@@ -1467,7 +1899,7 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t l
 
                 err = BZ2_bzCompress(&zi->ci.bstream, BZ_RUN);
 
-                zi->ci.pos_in_buffered_data += (uint16_t)(zi->ci.bstream.total_out_lo32 - total_out_before_lo);
+                zi->ci.pos_in_buffered_data += (uint32_t)(zi->ci.bstream.total_out_lo32 - total_out_before_lo);
             }
         }
 
@@ -1486,7 +1918,7 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t l
             {
                 err = zipFlushWriteBuffer(zi);
                 
-                zi->ci.stream.avail_out = Z_BUFSIZE;
+                zi->ci.stream.avail_out = zi->ci.size_buffered_data;
                 zi->ci.stream.next_out = zi->ci.buffered_data;
             }
 
@@ -1529,15 +1961,15 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void *buf, uint32_t l
             else
             {
                 uint32_t copy_this = 0;
-                uint32_t i = 0;
                 if (zi->ci.stream.avail_in < zi->ci.stream.avail_out)
                     copy_this = zi->ci.stream.avail_in;
                 else
                     copy_this = zi->ci.stream.avail_out;
 
-                for (i = 0; i < copy_this; i++)
-                    *(((char*)zi->ci.stream.next_out)+i) =
-                        *(((const char*)zi->ci.stream.next_in)+i);
+                if ((!zi->ci.raw) && (zi->ci.compression_method == 0))
+                    zi->ci.crc32 = crc32_copy(zi->ci.crc32, zi->ci.stream.next_out, zi->ci.stream.next_in, copy_this);
+                else
+                    memcpy(zi->ci.stream.next_out, zi->ci.stream.next_in, copy_this);
 
                 zi->ci.stream.avail_in -= copy_this;
                 zi->ci.stream.avail_out -= copy_this;
@@ -1567,6 +1999,8 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
 
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
+    if (zi->ci.sampling)
+        err = zipEndSample(zi);
     zi->ci.stream.avail_in = 0;
 
     if (!zi->ci.raw)
@@ -1581,7 +2015,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
                 {
                     err = zipFlushWriteBuffer(zi);
 
-                    zi->ci.stream.avail_out = Z_BUFSIZE;
+                    zi->ci.stream.avail_out = zi->ci.size_buffered_data;
                     zi->ci.stream.next_out = zi->ci.buffered_data;
                 }
                 
@@ -1599,7 +2033,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
                 compression_status status = 0;
                 status = compression_stream_process(&zi->ci.astream, COMPRESSION_STREAM_FINALIZE);
 
-                uint32_t total_out_after = Z_BUFSIZE - zi->ci.astream.dst_size;
+                uint32_t total_out_after = zi->ci.stream.avail_out - (uint32_t)zi->ci.astream.dst_size;
 
                 zi->ci.stream.next_in = zi->ci.astream.src_ptr;
                 zi->ci.stream.avail_in = zi->ci.astream.src_size;
@@ -1620,7 +2054,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
 #else
                 total_out_before = (uint32_t)zi->ci.stream.total_out;
                 err = deflate(&zi->ci.stream, Z_FINISH);
-                zi->ci.pos_in_buffered_data += (uint16_t)(zi->ci.stream.total_out - total_out_before);
+                zi->ci.pos_in_buffered_data += (uint32_t)(zi->ci.stream.total_out - total_out_before);
 #endif
             }
         }
@@ -1636,7 +2070,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
                 {
                     err = zipFlushWriteBuffer(zi);
                     
-                    zi->ci.bstream.avail_out = (uint16_t)Z_BUFSIZE;
+                    zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
                     zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
                 }
                 
@@ -1644,7 +2078,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
                 err = BZ2_bzCompress(&zi->ci.bstream, BZ_FINISH);
                 if (err == BZ_STREAM_END)
                     err = Z_STREAM_END;
-                zi->ci.pos_in_buffered_data += (uint16_t)(zi->ci.bstream.total_out_lo32 - total_out_before);
+                zi->ci.pos_in_buffered_data += (uint32_t)(zi->ci.bstream.total_out_lo32 - total_out_before);
             }
 
             if (err == BZ_FINISH_OK)
@@ -1656,20 +2090,19 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
     if (err == Z_STREAM_END)
         err = ZIP_OK; /* this is normal */
 
-    if ((zi->ci.pos_in_buffered_data > 0) && (err == ZIP_OK))
-    {
-        err = zipFlushWriteBuffer(zi);
-    }
+    /* The authentication code and data descriptor are written with the end of the data */
+    if (err == ZIP_OK)
+        zipEncryptWriteBuffer(zi);
 
 #ifdef HAVE_AES
-    if (zi->ci.method == AES_METHOD)
+    if ((zi->ci.method == AES_METHOD) && (!zi->ci.raw_encrypted))
     {
         unsigned char authcode[AES_AUTHCODESIZE];
 
         fcrypt_end(authcode, &zi->ci.aes_ctx);
 
-        if (ZWRITE64(zi->z_filefunc, zi->filestream, authcode, AES_AUTHCODESIZE) != AES_AUTHCODESIZE)
-            err = ZIP_ERRNO;
+        if (err == ZIP_OK)
+            err = zipWriteToBuffer(zi, authcode, AES_AUTHCODESIZE);
     }
 #endif
 
@@ -1699,28 +2132,39 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
 
         crc32 = zi->ci.crc32;
         uncompressed_size = zi->ci.total_uncompressed;
+
+        zipCountEntry(zi, zi->ci.compression_method, zi->ci.auto_method, uncompressed_size,
+            zi->ci.total_compressed, zi->ci.trial_usec, zi->ci.trial_size);
     }
 
-    /* Write data descriptor */
+    /* Write data descriptor, with 8 byte sizes as well for an entry that outgrew 4 GB
+       without being opened as zip64 */
+    if ((zi->ci.total_compressed >= UINT32_MAX) || (uncompressed_size >= UINT32_MAX))
+        zi->ci.zip64 = 1;
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)DATADESCRIPTORMAGIC, 4);
+        err = zipWriteValueToBuffer(zi, (uint32_t)DATADESCRIPTORMAGIC, 4);
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, crc32, 4);
+        err = zipWriteValueToBuffer(zi, crc32, 4);
     if (err == ZIP_OK)
     {
         if (zi->ci.zip64)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->ci.total_compressed, 8);
+            err = zipWriteValueToBuffer(zi, zi->ci.total_compressed, 8);
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)zi->ci.total_compressed, 4);
+            err = zipWriteValueToBuffer(zi, (uint32_t)zi->ci.total_compressed, 4);
     }
     if (err == ZIP_OK)
     {
         if (zi->ci.zip64)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, uncompressed_size, 8);
+            err = zipWriteValueToBuffer(zi, uncompressed_size, 8);
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)uncompressed_size, 4);
+            err = zipWriteValueToBuffer(zi, (uint32_t)uncompressed_size, 4);
     }
 
+    /* The next entry follows in the write buffer, unless disks are spanned and its header
+       must know the space left on the disk */
+    if ((err == ZIP_OK) && (zi->disk_size > 0))
+        err = zipFlushWriteBuffer(zi);
+
     /* Update crc and sizes to central directory */
     zipWriteValueToMemory(zi->ci.central_header + 16, crc32, 4); /* crc */
     if (zi->ci.total_compressed >= UINT32_MAX)
@@ -1766,6 +2210,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
         zi->ci.size_centralheader += extra_data_size + 4;
         zi->ci.size_centralextra += extra_data_size + 4;
 
+        zipWriteValueToMemory(zi->ci.central_header + 6, (uint16_t)45, 2); /* version needed */
         zipWriteValueToMemory(zi->ci.central_header + 30, zi->ci.size_centralextra, 2);
     }
 
@@ -1816,11 +2261,620 @@ extern int ZEXPORT zipCloseFileInZipRaw(zipFile file, uint32_t uncompressed_size
     return zipCloseFileInZipRaw64(file, uncompressed_size, crc32);
 }
 
+extern int ZEXPORT zipGetCompressionStats(zipFile file, zip_compression_stats *stats)
+{
+    zip64_internal *zi = NULL;
+
+    if ((file == NULL) || (stats == NULL))
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+
+    *stats = zi->stats;
+    return ZIP_OK;
+}
+
 extern int ZEXPORT zipCloseFileInZip(zipFile file)
 {
     return zipCloseFileInZipRaw(file, 0, 0);
 }
 
+#ifndef NO_PARALLEL_ZIP
+/* Open an anonymous temporary file for job data past its memory share */
+static FILE *zipParallelOpenSpill(zip_parallel *zp)
+{
+    FILE *spill = NULL;
+    char *path = NULL;
+    size_t path_size = 0;
+    int fd = -1;
+
+    if (zp->spill_dir == NULL)
+        return tmpfile();
+
+    path_size = strlen(zp->spill_dir) + 32;
+    path = (char*)ALLOC(path_size);
+    if (path == NULL)
+        return NULL;
+    snprintf(path, path_size, "%s/minizip-spill-XXXXXX", zp->spill_dir);
+    fd = mkstemp(path);
+    if (fd >= 0)
+    {
+        unlink(path);
+        spill = fdopen(fd, "w+b");
+        if (spill == NULL)
+            close(fd);
+    }
+    TRYFREE(path);
+    return spill;
+}
+
+/* Append data to the job, in memory up to its share and then in a spill file */
+static int zipParallelOutput(zip_parallel *zp, zip_parallel_job *job, uint8_t *buf, uint32_t len, int encrypt)
+{
+    uint64_t needed = job->data_size + len;
+    uint64_t capacity = 0;
+    uint8_t *data = NULL;
+
+    /* Nothing to store; job->data may still be NULL (e.g. empty source) */
+    if (len == 0)
+        return ZIP_OK;
+
+#ifndef NOCRYPT
+    if (encrypt)
+    {
+#ifdef HAVE_AES
+        if (job->aes)
+        {
+            fcrypt_encrypt(buf, len, &job->aes_ctx);
+        }
+        else
+#endif
+        {
+            uint32_t i = 0;
+            uint8_t t = 0;
+
+            for (i = 0; i < len; i++)
+                buf[i] = (uint8_t)zencode(job->keys, job->pcrc_32_tab, buf[i], t);
+        }
+    }
+#endif
+
+    if ((job->spill == NULL) && (needed > job->data_capacity))
+    {
+        if (needed > zp->job_memory)
+            job->spill = zipParallelOpenSpill(zp);
+        /* Without a spill file the data stays in memory */
+        if (job->spill == NULL)
+        {
+            capacity = (job->data_capacity == 0) ? Z_BUFSIZE : job->data_capacity;
+            while (capacity < needed)
+                capacity *= 2;
+            if ((capacity > zp->job_memory) && (needed <= zp->job_memory))
+                capacity = zp->job_memory;
+            if ((size_t)capacity == capacity)
+                data = (uint8_t*)realloc(job->data, (size_t)capacity);
+            if (data == NULL)
+                return ZIP_INTERNALERROR;
+            job->data = data;
+            job->data_capacity = capacity;
+        }
+    }
+
+    if (job->spill != NULL)
+    {
+        if (fwrite(buf, 1, len, job->spill) != len)
+            return ZIP_ERRNO;
+        job->spill_size += len;
+        return ZIP_OK;
+    }
+
+    memcpy(job->data + job->data_size, buf, len);
+    job->data_size += len;
+    return ZIP_OK;
+}
+
+/* Read, compress and encrypt the source of a job into the bytes that follow its local header */
+static int zipParallelCompress(zip_parallel *zp, zip_parallel_job *job, uint8_t *in, uint8_t *out)
+{
+    z_stream stream;
+    uint32_t read = 0;
+    int sampled = 0;
+    int encrypt = 0;
+    int flush = Z_NO_FLUSH;
+    int err = ZIP_OK;
+
+    memset(&stream, 0, sizeof(stream));
+    job->data_type = Z_BINARY;
+
+    /* The first block read decides the method, before the headers that depend on it */
+    if (job->method == Z_DEFLATED_AUTO)
+    {
+        read = (uint32_t)fread(in, 1, Z_BUFSIZE, job->source);
+        if (ferror(job->source))
+            return ZIP_ERRNO;
+        sampled = 1;
+
+        job->auto_method = 1;
+        job->method = zipChooseMethod(in, read, &job->trial_usec, &job->sample_usec);
+        if (job->method == 0)
+            job->trial_size = read;
+        else
+            job->trial_usec = 0;
+    }
+    if (job->method == Z_DEFLATED)
+    {
+        if (deflateInit2(&stream, job->level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+            return ZIP_INTERNALERROR;
+    }
+
+#ifndef NOCRYPT
+    if (job->password != NULL)
+    {
+        encrypt = 1;
+#ifdef HAVE_AES
+        if (job->aes)
+        {
+            unsigned char passverify[AES_PWVERIFYSIZE];
+            unsigned char saltvalue[AES_MAXSALTLENGTH];
+            uint16_t saltlength = SALT_LENGTH(AES_ENCRYPTIONMODE);
+            prng_ctx aes_rng[1];
+
+            prng_init(cryptrand, aes_rng);
+            prng_rand(saltvalue, saltlength, aes_rng);
+            prng_end(aes_rng);
+
+            fcrypt_init(AES_ENCRYPTIONMODE, (uint8_t *)job->password, (uint32_t)strlen(job->password), saltvalue,
+                passverify, &job->aes_ctx);
+
+            err = zipParallelOutput(zp, job, saltvalue, saltlength, 0);
+            if (err == ZIP_OK)
+                err = zipParallelOutput(zp, job, passverify, AES_PWVERIFYSIZE, 0);
+        }
+        else
+#endif
+        {
+            unsigned char buf_head[RAND_HEAD_LEN];
+            uint32_t size_head = 0;
+
+            /* Same verification bytes as zipOpenNewFileInZip5, from the date */
+            job->pcrc_32_tab = get_crc_table();
+            size_head = crypthead(job->password, buf_head, RAND_HEAD_LEN, job->keys, job->pcrc_32_tab,
+                (uint8_t)((job->zipfi.dos_date >> 16) & 0xff), (uint8_t)((job->zipfi.dos_date >> 8) & 0xff));
+            err = zipParallelOutput(zp, job, buf_head, size_head, 0);
+        }
+    }
+#endif
+
+    while ((err == ZIP_OK) && (flush != Z_FINISH))
+    {
+        if (sampled)
+            sampled = 0;
+        else
+            read = (uint32_t)fread(in, 1, Z_BUFSIZE, job->source);
+        if (ferror(job->source))
+        {
+            err = ZIP_ERRNO;
+            break;
+        }
+        if (feof(job->source))
+            flush = Z_FINISH;
+
+        job->crc32 = crc32_update(job->crc32, in, read);
+        job->uncompressed_size += read;
+
+        if (job->method == Z_DEFLATED)
+        {
+            stream.next_in = in;
+            stream.avail_in = read;
+            do
+            {
+                stream.next_out = out;
+                stream.avail_out = Z_BUFSIZE;
+                if (deflate(&stream, flush) == Z_STREAM_ERROR)
+                    err = ZIP_INTERNALERROR;
+                else
+                    err = zipParallelOutput(zp, job, out, Z_BUFSIZE - stream.avail_out, encrypt);
+            }
+            while ((err == ZIP_OK) && (stream.avail_out == 0));
+        }
+        else if (read > 0)
+        {
+            err = zipParallelOutput(zp, job, in, read, encrypt);
+        }
+    }
+
+#if !defined(NOCRYPT) && defined(HAVE_AES)
+    if ((err == ZIP_OK) && (job->password != NULL) && (job->aes))
+    {
+        unsigned char authcode[AES_AUTHCODESIZE];
+
+        fcrypt_end(authcode, &job->aes_ctx);
+        err = zipParallelOutput(zp, job, authcode, AES_AUTHCODESIZE, 0);
+    }
+#endif
+
+    if (job->method == Z_DEFLATED)
+    {
+        job->data_type = stream.data_type;
+        deflateEnd(&stream);
+    }
+    return err;
+}
+
+static void *zipParallelWorker(void *arg)
+{
+    zip_parallel *zp = (zip_parallel*)arg;
+    zip_parallel_job *job = NULL;
+    uint8_t *buffers = (uint8_t*)ALLOC(2 * Z_BUFSIZE);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&zp->lock);
+        while ((!zp->stop) && (zp->started == zp->queued))
+            pthread_cond_wait(&zp->job_queued, &zp->lock);
+        if (zp->started == zp->queued)
+        {
+            pthread_mutex_unlock(&zp->lock);
+            break;
+        }
+        job = &zp->jobs[zp->started % zp->queue_size];
+        zp->started += 1;
+        pthread_mutex_unlock(&zp->lock);
+
+        if (buffers == NULL)
+            job->err = ZIP_INTERNALERROR;
+        else
+            job->err = zipParallelCompress(zp, job, buffers, buffers + Z_BUFSIZE);
+        fclose(job->source);
+        job->source = NULL;
+
+        pthread_mutex_lock(&zp->lock);
+        job->done = 1;
+        pthread_cond_signal(&zp->job_done);
+        pthread_mutex_unlock(&zp->lock);
+    }
+
+    TRYFREE(buffers);
+    return NULL;
+}
+
+static void zipParallelFreeJob(zip_parallel_job *job)
+{
+    if (job->source != NULL)
+        fclose(job->source);
+    if (job->spill != NULL)
+        fclose(job->spill);
+    if (job->password != NULL)
+        memset(job->password, 0, strlen(job->password));
+    TRYFREE(job->password);
+    TRYFREE(job->filename);
+    TRYFREE(job->data);
+    memset(job, 0, sizeof(zip_parallel_job));
+}
+
+/* Write a finished job as a raw entry: its data is complete, so the local header can already carry zip64 */
+static int zipParallelWriteJob(zip64_internal *zi, zip_parallel_job *job)
+{
+    uint8_t *buffer = NULL;
+    uint64_t offset = 0;
+    uint32_t len = 0;
+    int zip64 = 0;
+    int err = job->err;
+
+    if (err == ZIP_OK)
+    {
+        zip64 = (job->uncompressed_size >= UINT32_MAX) || (job->data_size + job->spill_size >= UINT32_MAX);
+        err = zipOpenNewFileInZipInternal((zipFile)zi, job->filename, job->has_zipfi ? &job->zipfi : NULL,
+            NULL, 0, NULL, 0, NULL, 0, zip64, job->method, job->level, 1, -MAX_WBITS, DEF_MEM_LEVEL,
+            Z_DEFAULT_STRATEGY, job->password, job->aes, VERSIONMADEBY, 1);
+    }
+    if (err != ZIP_OK)
+        return err;
+    zi->ci.stream.data_type = job->data_type;
+
+    while ((err == ZIP_OK) && (offset < job->data_size))
+    {
+        len = (job->data_size - offset > Z_BUFSIZE) ? Z_BUFSIZE : (uint32_t)(job->data_size - offset);
+        err = zipWriteInFileInZip((zipFile)zi, job->data + offset, len);
+        offset += len;
+    }
+    if ((err == ZIP_OK) && (job->spill != NULL))
+    {
+        buffer = (uint8_t*)ALLOC(Z_BUFSIZE);
+        if ((buffer == NULL) || (fseek(job->spill, 0, SEEK_SET) != 0))
+            err = ZIP_ERRNO;
+        while (err == ZIP_OK)
+        {
+            len = (uint32_t)fread(buffer, 1, Z_BUFSIZE, job->spill);
+            if (len == 0)
+                break;
+            err = zipWriteInFileInZip((zipFile)zi, buffer, len);
+        }
+        if ((err == ZIP_OK) && (ferror(job->spill)))
+            err = ZIP_ERRNO;
+        TRYFREE(buffer);
+    }
+
+    if (err == ZIP_OK)
+        err = zipCloseFileInZipRaw64((zipFile)zi, job->uncompressed_size, job->crc32);
+    if (err == ZIP_OK)
+    {
+        zi->stats.sample_usec += job->sample_usec;
+        zipCountEntry(zi, job->method, job->auto_method, job->uncompressed_size,
+            job->data_size + job->spill_size, job->trial_usec, job->trial_size);
+    }
+    return err;
+}
+
+/* Write finished jobs in queue order, waiting until at most max_pending are left.
+   Returns the first error of the jobs written */
+static int zipParallelWrite(zip64_internal *zi, uint64_t max_pending)
+{
+    zip_parallel *zp = zi->parallel;
+    zip_parallel_job *job = NULL;
+    int done = 0;
+    int err = ZIP_OK;
+    int job_err = ZIP_OK;
+
+    while (zp->written < zp->queued)
+    {
+        job = &zp->jobs[zp->written % zp->queue_size];
+
+        pthread_mutex_lock(&zp->lock);
+        while ((!job->done) && (zp->queued - zp->written > max_pending))
+            pthread_cond_wait(&zp->job_done, &zp->lock);
+        done = job->done;
+        pthread_mutex_unlock(&zp->lock);
+        if (!done)
+            break;
+
+        job_err = zipParallelWriteJob(zi, job);
+        if (zp->written_func != NULL)
+            zp->written_func(zp->written_opaque, job->filename, job_err);
+        zipParallelFreeJob(job);
+        zp->written += 1;
+
+        if (err == ZIP_OK)
+            err = job_err;
+        if (zp->err == ZIP_OK)
+            zp->err = job_err;
+    }
+    return err;
+}
+
+extern int ZEXPORT zipParallelBegin(zipFile file, uint32_t workers, uint64_t memory_budget, const char *spill_dir)
+{
+    zip64_internal *zi = NULL;
+    zip_parallel *zp = NULL;
+    long cpus = 0;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+    if (zi->parallel != NULL)
+        return ZIP_PARAMERROR;
+
+    if (workers == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+    if (workers > 256)
+        workers = 256;
+    if (memory_budget == 0)
+        memory_budget = ZIP_PARALLEL_MEMORY;
+
+    zp = (zip_parallel*)ALLOC(sizeof(zip_parallel));
+    if (zp == NULL)
+        return ZIP_INTERNALERROR;
+    memset(zp, 0, sizeof(zip_parallel));
+
+    /* Two jobs per worker keep the workers busy while the oldest job is written */
+    zp->queue_size = workers * 2;
+    zp->job_memory = memory_budget / zp->queue_size;
+    if (zp->job_memory < Z_BUFSIZE)
+        zp->job_memory = Z_BUFSIZE;
+    zp->jobs = (zip_parallel_job*)ALLOC(zp->queue_size * sizeof(zip_parallel_job));
+    zp->threads = (pthread_t*)ALLOC(workers * sizeof(pthread_t));
+    if (spill_dir != NULL)
+    {
+        zp->spill_dir = (char*)ALLOC(strlen(spill_dir) + 1);
+        if (zp->spill_dir != NULL)
+            strcpy(zp->spill_dir, spill_dir);
+    }
+    if ((zp->jobs == NULL) || (zp->threads == NULL) || ((spill_dir != NULL) && (zp->spill_dir == NULL)))
+    {
+        TRYFREE(zp->jobs);
+        TRYFREE(zp->threads);
+        TRYFREE(zp->spill_dir);
+        TRYFREE(zp);
+        return ZIP_INTERNALERROR;
+    }
+    memset(zp->jobs, 0, zp->queue_size * sizeof(zip_parallel_job));
+
+    pthread_mutex_init(&zp->lock, NULL);
+    pthread_cond_init(&zp->job_queued, NULL);
+    pthread_cond_init(&zp->job_done, NULL);
+
+    for (zp->thread_count = 0; zp->thread_count < workers; zp->thread_count += 1)
+    {
+        if (pthread_create(&zp->threads[zp->thread_count], NULL, zipParallelWorker, zp) != 0)
+            break;
+    }
+
+    zi->parallel = zp;
+    if (zp->thread_count == 0)
+    {
+        zipParallelEnd(file);
+        return ZIP_INTERNALERROR;
+    }
+    return ZIP_OK;
+}
+
+extern int ZEXPORT zipParallelSetWrittenFunc(zipFile file, zip_written_func written_func, voidpf opaque)
+{
+    zip_parallel *zp = NULL;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zp = ((zip64_internal*)file)->parallel;
+    if (zp == NULL)
+        return ZIP_PARAMERROR;
+
+    zp->written_func = written_func;
+    zp->written_opaque = opaque;
+    return ZIP_OK;
+}
+
+/* Report an entry that zipParallelAddFile could not queue as failed, then return err */
+static int zipParallelNotQueued(zip_parallel *zp, const char *filename, int err)
+{
+    if (zp->written_func != NULL)
+        zp->written_func(zp->written_opaque, filename, err);
+    return err;
+}
+
+extern int ZEXPORT zipParallelAddFile(zipFile file, const char *filename, const zip_fileinfo *zipfi,
+    const char *source_path, uint16_t method, int level, const char *password, int aes)
+{
+    zip64_internal *zi = NULL;
+    zip_parallel *zp = NULL;
+    zip_parallel_job *job = NULL;
+    FILE *source = NULL;
+    int err = ZIP_OK;
+
+#ifdef NOCRYPT
+    if (password != NULL)
+        return ZIP_PARAMERROR;
+#endif
+
+    if ((file == NULL) || (source_path == NULL))
+        return ZIP_PARAMERROR;
+    if ((method != 0) && (method != Z_DEFLATED) && (method != Z_DEFLATED_AUTO))
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+    zp = zi->parallel;
+    if (zp == NULL)
+        return ZIP_PARAMERROR;
+
+    if (filename == NULL)
+        filename = "-";
+
+    if (zi->in_opened_file_inzip == 1)
+    {
+        err = zipCloseFileInZip(file);
+        if (err != ZIP_OK)
+            return zipParallelNotQueued(zp, filename, err);
+    }
+
+    source = fopen(source_path, "rb");
+    if (source == NULL)
+        return zipParallelNotQueued(zp, filename, ZIP_ERRNO);
+
+    /* Make room for the job */
+    err = zipParallelWrite(zi, zp->queue_size - 1);
+
+    /* Entries written since the queue was last empty set the date a zero date falls back to */
+    if (zp->written == zp->queued)
+        zp->dos_date = zi->ci.dos_date;
+
+    job = &zp->jobs[zp->queued % zp->queue_size];
+    job->source = source;
+    job->filename = (char*)ALLOC(strlen(filename) + 1);
+    if (job->filename != NULL)
+        strcpy(job->filename, filename);
+    if (password != NULL)
+    {
+        job->password = (char*)ALLOC(strlen(password) + 1);
+        if (job->password != NULL)
+            strcpy(job->password, password);
+    }
+    if ((job->filename == NULL) || ((password != NULL) && (job->password == NULL)))
+    {
+        zipParallelFreeJob(job);
+        return zipParallelNotQueued(zp, filename, ZIP_INTERNALERROR);
+    }
+
+    /* Resolve the date here as zipOpenNewFileInZip5 would, since encryption uses it */
+    job->has_zipfi = (zipfi != NULL);
+    if (zipfi != NULL)
+    {
+        job->zipfi = *zipfi;
+        if (job->zipfi.dos_date == 0)
+            job->zipfi.dos_date = zp->dos_date;
+    }
+    zp->dos_date = job->zipfi.dos_date;
+    job->method = method;
+    job->level = level;
+    job->aes = aes;
+
+    pthread_mutex_lock(&zp->lock);
+    zp->queued += 1;
+    pthread_cond_signal(&zp->job_queued);
+    pthread_mutex_unlock(&zp->lock);
+
+    return err;
+}
+
+extern int ZEXPORT zipParallelEnd(zipFile file)
+{
+    zip64_internal *zi = NULL;
+    zip_parallel *zp = NULL;
+    uint32_t i = 0;
+    int err = ZIP_OK;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+    zp = zi->parallel;
+    if (zp == NULL)
+        return ZIP_PARAMERROR;
+
+    zipParallelWrite(zi, 0);
+
+    pthread_mutex_lock(&zp->lock);
+    zp->stop = 1;
+    pthread_cond_broadcast(&zp->job_queued);
+    pthread_mutex_unlock(&zp->lock);
+    for (i = 0; i < zp->thread_count; i++)
+        pthread_join(zp->threads[i], NULL);
+
+    err = zp->err;
+    pthread_mutex_destroy(&zp->lock);
+    pthread_cond_destroy(&zp->job_queued);
+    pthread_cond_destroy(&zp->job_done);
+    TRYFREE(zp->jobs);
+    TRYFREE(zp->threads);
+    TRYFREE(zp->spill_dir);
+    TRYFREE(zp);
+    zi->parallel = NULL;
+    return err;
+}
+#else
+extern int ZEXPORT zipParallelBegin(ZIP_UNUSED zipFile file, ZIP_UNUSED uint32_t workers,
+    ZIP_UNUSED uint64_t memory_budget, ZIP_UNUSED const char *spill_dir)
+{
+    return ZIP_PARAMERROR;
+}
+
+extern int ZEXPORT zipParallelAddFile(ZIP_UNUSED zipFile file, ZIP_UNUSED const char *filename,
+    ZIP_UNUSED const zip_fileinfo *zipfi, ZIP_UNUSED const char *source_path, ZIP_UNUSED uint16_t method,
+    ZIP_UNUSED int level, ZIP_UNUSED const char *password, ZIP_UNUSED int aes)
+{
+    return ZIP_PARAMERROR;
+}
+
+extern int ZEXPORT zipParallelSetWrittenFunc(ZIP_UNUSED zipFile file, ZIP_UNUSED zip_written_func written_func,
+    ZIP_UNUSED voidpf opaque)
+{
+    return ZIP_PARAMERROR;
+}
+
+extern int ZEXPORT zipParallelEnd(ZIP_UNUSED zipFile file)
+{
+    return ZIP_PARAMERROR;
+}
+#endif
+
 extern int ZEXPORT zipClose(zipFile file, const char *global_comment)
 {
     return zipClose_64(file, global_comment);
@@ -1839,15 +2893,23 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
     uint64_t centraldir_pos_inzip = 0;
     uint64_t pos = 0;
     uint64_t cd_pos = 0;
-    uint32_t write = 0;
     int err = ZIP_OK;
 
     if (file == NULL)
         return ZIP_PARAMERROR;
     zi = (zip64_internal*)file;
 
+#ifndef NO_PARALLEL_ZIP
+    if (zi->parallel != NULL)
+        err = zipParallelEnd(file);
+#endif
+
     if (zi->in_opened_file_inzip == 1)
-        err = zipCloseFileInZip(file);
+    {
+        int tmp_err = zipCloseFileInZip(file);
+        if (err == ZIP_OK)
+            err = tmp_err;
+    }
 
 #ifndef NO_ADDFILEINEXISTINGZIP
     if (global_comment == NULL)
@@ -1864,7 +2926,10 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
         zi->filestream = zi->filestream_with_CD;
     }
 
-    centraldir_pos_inzip = ZTELL64(zi->z_filefunc, zi->filestream);
+    centraldir_pos_inzip = zipTellWriteBuffer(zi);
+
+    /* The central directory is gathered in the write buffer and not split between disks */
+    zi->disk_size = 0;
 
     if (err == ZIP_OK)
     {
@@ -1872,11 +2937,7 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
         while (ldi != NULL)
         {
             if ((err == ZIP_OK) && (ldi->filled_in_this_block > 0))
-            {
-                write = ZWRITE64(zi->z_filefunc, zi->filestream, ldi->data, ldi->filled_in_this_block);
-                if (write != ldi->filled_in_this_block)
-                    err = ZIP_ERRNO;
-            }
+                err = zipWriteToBuffer(zi, ldi->data, ldi->filled_in_this_block);
 
             size_centraldir += ldi->filled_in_this_block;
             ldi = ldi->next_datablock;
@@ -1890,97 +2951,98 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
     /* Write the ZIP64 central directory header */
     if (pos >= UINT32_MAX || zi->number_entry > UINT32_MAX)
     {
-        uint64_t zip64_eocd_pos_inzip = ZTELL64(zi->z_filefunc, zi->filestream);
+        uint64_t zip64_eocd_pos_inzip = centraldir_pos_inzip + size_centraldir;
         uint32_t zip64_datasize = 44;
 
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)ZIP64ENDHEADERMAGIC, 4);
+        if (err == ZIP_OK)
+            err = zipWriteValueToBuffer(zi, (uint32_t)ZIP64ENDHEADERMAGIC, 4);
 
         /* Size of this 'zip64 end of central directory' */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint64_t)zip64_datasize, 8);
+            err = zipWriteValueToBuffer(zi, (uint64_t)zip64_datasize, 8);
         /* Version made by */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, version_madeby, 2);
+            err = zipWriteValueToBuffer(zi, version_madeby, 2);
         /* version needed */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)45, 2);
+            err = zipWriteValueToBuffer(zi, (uint16_t)45, 2);
         /* Number of this disk */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_disk_with_CD, 4);
+            err = zipWriteValueToBuffer(zi, zi->number_disk_with_CD, 4);
         /* Number of the disk with the start of the central directory */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_disk_with_CD, 4);
+            err = zipWriteValueToBuffer(zi, zi->number_disk_with_CD, 4);
         /* Total number of entries in the central dir on this disk */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_entry, 8);
+            err = zipWriteValueToBuffer(zi, zi->number_entry, 8);
         /* Total number of entries in the central dir */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_entry, 8);
+            err = zipWriteValueToBuffer(zi, zi->number_entry, 8);
         /* Size of the central directory */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint64_t)size_centraldir, 8);
+            err = zipWriteValueToBuffer(zi, (uint64_t)size_centraldir, 8);
 
         if (err == ZIP_OK)
         {
             /* Offset of start of central directory with respect to the starting disk number */
             cd_pos = centraldir_pos_inzip - zi->add_position_when_writting_offset;
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, cd_pos, 8);
+            err = zipWriteValueToBuffer(zi, cd_pos, 8);
         }
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)ZIP64ENDLOCHEADERMAGIC, 4);
+            err = zipWriteValueToBuffer(zi, (uint32_t)ZIP64ENDLOCHEADERMAGIC, 4);
 
         /* Number of the disk with the start of the central directory */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_disk_with_CD, 4);
+            err = zipWriteValueToBuffer(zi, zi->number_disk_with_CD, 4);
         /* Relative offset to the Zip64EndOfCentralDirectory */
         if (err == ZIP_OK)
         {
             cd_pos = zip64_eocd_pos_inzip - zi->add_position_when_writting_offset;
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, cd_pos, 8);
+            err = zipWriteValueToBuffer(zi, cd_pos, 8);
         }
         /* Number of the disk with the start of the central directory */
         if (err == ZIP_OK)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, zi->number_disk_with_CD + 1, 4);
+            err = zipWriteValueToBuffer(zi, zi->number_disk_with_CD + 1, 4);
     }
 
     /* Write the central directory header */
 
     /* Signature */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)ENDHEADERMAGIC, 4);
+        err = zipWriteValueToBuffer(zi, (uint32_t)ENDHEADERMAGIC, 4);
     /* Number of this disk */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)zi->number_disk_with_CD, 2);
+        err = zipWriteValueToBuffer(zi, (uint16_t)zi->number_disk_with_CD, 2);
     /* Number of the disk with the start of the central directory */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)zi->number_disk_with_CD, 2);
+        err = zipWriteValueToBuffer(zi, (uint16_t)zi->number_disk_with_CD, 2);
     /* Total number of entries in the central dir on this disk */
     if (err == ZIP_OK)
     {
         if (zi->number_entry >= UINT16_MAX)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, UINT16_MAX, 2); /* use value in ZIP64 record */
+            err = zipWriteValueToBuffer(zi, UINT16_MAX, 2); /* use value in ZIP64 record */
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)zi->number_entry, 2);
+            err = zipWriteValueToBuffer(zi, (uint16_t)zi->number_entry, 2);
     }
     /* Total number of entries in the central dir */
     if (err == ZIP_OK)
     {
         if (zi->number_entry >= UINT16_MAX)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, UINT16_MAX, 2); /* use value in ZIP64 record */
+            err = zipWriteValueToBuffer(zi, UINT16_MAX, 2); /* use value in ZIP64 record */
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint16_t)zi->number_entry, 2);
+            err = zipWriteValueToBuffer(zi, (uint16_t)zi->number_entry, 2);
     }
     /* Size of the central directory */
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, size_centraldir, 4);
+        err = zipWriteValueToBuffer(zi, size_centraldir, 4);
     /* Offset of start of central directory with respect to the starting disk number */
     if (err == ZIP_OK)
     {
         cd_pos = centraldir_pos_inzip - zi->add_position_when_writting_offset;
         if (pos >= UINT32_MAX)
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, UINT32_MAX, 4);
+            err = zipWriteValueToBuffer(zi, UINT32_MAX, 4);
         else
-            err = zipWriteValue(&zi->z_filefunc, zi->filestream, (uint32_t)cd_pos, 4);
+            err = zipWriteValueToBuffer(zi, (uint32_t)cd_pos, 4);
     }
 
     /* Write global comment */
@@ -1988,12 +3050,11 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
     if (global_comment != NULL)
         size_global_comment = (uint16_t)strlen(global_comment);
     if (err == ZIP_OK)
-        err = zipWriteValue(&zi->z_filefunc, zi->filestream, size_global_comment, 2);
+        err = zipWriteValueToBuffer(zi, size_global_comment, 2);
     if (err == ZIP_OK && size_global_comment > 0)
-    {
-        if (ZWRITE64(zi->z_filefunc, zi->filestream, global_comment, size_global_comment) != size_global_comment)
-            err = ZIP_ERRNO;
-    }
+        err = zipWriteToBuffer(zi, global_comment, size_global_comment);
+    if (err == ZIP_OK)
+        err = zipFlushWriteBuffer(zi);
 
     if ((ZCLOSE64(zi->z_filefunc, zi->filestream) != 0) && (err == ZIP_OK))
         err = ZIP_ERRNO;
@@ -2001,6 +3062,8 @@ extern int ZEXPORT zipClose2_64(zipFile file, const char *global_comment, uint16
 #ifndef NO_ADDFILEINEXISTINGZIP
     TRYFREE(zi->globalcomment);
 #endif
+    TRYFREE(zi->ci.buffered_data);
+    TRYFREE(zi->ci.sample);
     TRYFREE(zi);
 
     return err;
@@ -36,6 +36,8 @@ extern "C" {
 #endif
 
 #define Z_BZIP2ED 12
+/* Method that deflates an entry, or stores it when its first bytes show that deflate would not shrink it */
+#define Z_DEFLATED_AUTO 0x108
 
 #if defined(STRICTZIP) || defined(STRICTZIPUNZIP)
 /* like the STRICT of WIN32, we define a pointer that cannot be converted
@@ -72,6 +74,24 @@ typedef struct
 #define APPEND_STATUS_CREATEAFTER   (1)
 #define APPEND_STATUS_ADDINZIP      (2)
 
+typedef struct
+{
+    uint32_t    buffer_size;        /* bytes buffered before each write, 0 for 64 KB */
+    int         stream;             /* 1 if the output cannot seek, tell or read, like a pipe */
+} zip_options;
+
+typedef struct
+{
+    uint64_t    entries_stored;     /* Z_DEFLATED_AUTO entries that were stored */
+    uint64_t    entries_deflated;   /* Z_DEFLATED_AUTO entries that were deflated */
+    uint64_t    bytes_stored;       /* uncompressed bytes of all stored entries */
+    uint64_t    bytes_deflated;     /* uncompressed bytes of all deflated entries */
+    uint64_t    bytes_deflated_out; /* compressed bytes of all deflated entries */
+    uint64_t    sample_usec;        /* CPU time spent deciding how to write Z_DEFLATED_AUTO entries */
+    uint64_t    saved_usec;         /* CPU time deflate would have spent on the stored Z_DEFLATED_AUTO
+                                       entries, extrapolated from the trial deflate of their first bytes */
+} zip_compression_stats;
+
 /***************************************************************************/
 /* Writing a zip file */
 
@@ -107,6 +127,18 @@ extern zipFile ZEXPORT zipOpen3(const char *path, int append, uint64_t disk_size
 extern zipFile ZEXPORT zipOpen3_64(const void *path, int append, uint64_t disk_size, 
     const char **globalcomment, zlib_filefunc64_def *pzlib_filefunc_def);
 
+extern zipFile ZEXPORT zipOpen5(const void *path, int append, uint64_t disk_size,
+    const char **globalcomment, zlib_filefunc64_def *pzlib_filefunc_def, const zip_options *options);
+/* Same as zipOpen3_64 with options, NULL for the defaults
+
+   options->buffer_size is the size of the buffer the compressed data of an entry is gathered in, together
+   with its headers, before being written. The central directory is written in writes of the same size.
+
+   options->stream writes the zipfile front to back, opened with ZLIB_FILEFUNC_MODE_WRITE only and without
+   ever calling the tell, seek or read functions of pzlib_filefunc_def, which can be NULL. Each entry ends
+   with a data descriptor, with 8 byte sizes once the entry is zip64, and only the central directory is kept
+   in memory. append must be APPEND_STATUS_CREATE and disk_size 0. */
+
 extern int ZEXPORT zipOpenNewFileInZip(zipFile file, const char *filename, const zip_fileinfo *zipfi,
     const void *extrafield_local, uint16_t size_extrafield_local, const void *extrafield_global, 
     uint16_t size_extrafield_global, const char *comment, uint16_t method, int level);
@@ -119,7 +151,9 @@ extern int ZEXPORT zipOpenNewFileInZip(zipFile file, const char *filename, const
    extrafield_global buffer to store the global header extra field data, can be NULL
    size_extrafield_global size of extrafield_local buffer
    comment buffer for comment string
-   method contain the compression method (0 for store, Z_DEFLATED for deflate)
+   method contain the compression method (0 for store, Z_DEFLATED for deflate, Z_DEFLATED_AUTO to decide
+     from the first 64 KB written: they are stored if their byte entropy is high and a trial deflate at
+     level 1 saves less than 1/32 of them)
    level contain the level of compression (can be Z_DEFAULT_COMPRESSION)
    zip64 is set to 1 if a zip64 extended information block should be added to the local file header.
    this MUST be '1' if the uncompressed size is >= 0xffffffff. */
@@ -198,6 +232,44 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, uint64_t uncompressed_si
 /* Close the current file in the zipfile, for file opened with parameter raw=1 in zipOpenNewFileInZip2
    where raw is compressed data. Parameters uncompressed_size and crc32 are value for the uncompressed data. */
 
+extern int ZEXPORT zipGetCompressionStats(zipFile file, zip_compression_stats *stats);
+/* Get how the entries closed so far were written, raw entries other than those of zipParallelAddFile
+   are not counted */
+
+extern int ZEXPORT zipParallelBegin(zipFile file, uint32_t workers, uint64_t memory_budget, const char *spill_dir);
+/* Start workers that compress, and encrypt, the entries added with zipParallelAddFile. The entries are
+   still written to the zipfile in the order they were added, with the central directory at zipClose.
+
+   workers is the number of threads, 0 for one per CPU. memory_budget bounds the compressed data held in
+   memory for entries waiting to be written, 0 for 64 MB; an entry that outgrows its share continues in an
+   unlinked temporary file in spill_dir, or from tmpfile() if spill_dir is NULL.
+
+   return ZIP_PARAMERROR if parallel writing is not available, the caller can then add entries as usual */
+
+extern int ZEXPORT zipParallelAddFile(zipFile file, const char *filename, const zip_fileinfo *zipfi,
+    const char *source_path, uint16_t method, int level, const char *password, int aes);
+/* Queue the file at source_path as the entry filename, with method 0, Z_DEFLATED or Z_DEFLATED_AUTO. It is opened here and
+   read by a worker. Blocks while the queue is full, writing the oldest entries meanwhile.
+
+   return ZIP_ERRNO if source_path cannot be opened, else the first error of the entries written meanwhile */
+
+typedef void (ZCALLBACK *zip_written_func)(voidpf opaque, const char *filename, int err);
+
+extern int ZEXPORT zipParallelSetWrittenFunc(zipFile file, zip_written_func written_func, voidpf opaque);
+/* Call written_func once for every entry passed to zipParallelAddFile from now on: when it has been written
+   to the zipfile, with ZIP_OK or the error that stopped it, or when zipParallelAddFile could not queue it.
+   It runs on the thread calling into minizip, from zipParallelAddFile, zipParallelEnd, zipClose or an entry
+   opened with zipOpenNewFileInZip*. Written entries are reported in order; an entry that could not be queued
+   is reported right away, possibly before entries added earlier.
+
+   return ZIP_PARAMERROR if zipParallelBegin has not succeeded */
+
+extern int ZEXPORT zipParallelEnd(zipFile file);
+/* Write the queued entries and stop the workers. Opening an entry with zipOpenNewFileInZip* writes the
+   queued entries first, and zipClose calls zipParallelEnd.
+
+   return the first error of any entry added since zipParallelBegin */
+
 extern int ZEXPORT zipClose(zipFile file, const char *global_comment);
 /* Close the zipfile */
 
@@ -385,6 +385,357 @@ class Argon2Tests: XCTestCase {
         ), Argon2.Error.saltTooShort)
     }
 
+    // MARK: - Worker pool
+
+    func test_pool_katVectors() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        for vector in Argon2Tests.katVectors {
+            let tags = hashContexts([vector.parameters], version: vector.version, pool: pool) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, vector.variant.argon2Type), ARGON2_OK.rawValue)
+            }
+            XCTAssertEqual(hexString(tags[0]), vector.hexString)
+        }
+    }
+
+    func test_pool_matchesThreadPerLane() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        for lanes in UInt32(1)...8 {
+            let parameters = HashParameters(
+                iterations: 1 + lanes % 3,
+                memoryInKiB: 64 * lanes,
+                lanes: lanes,
+                password: randomBytes(16),
+                salt: randomBytes(16)
+            )
+            let withoutPool = hashContexts([parameters]) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+            }
+            let withPool = hashContexts([parameters], pool: pool) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+            }
+            XCTAssertEqual(withPool, withoutPool, "lanes: \(lanes)")
+        }
+    }
+
+    func test_performance_fourLanesWithoutPool() {
+        let parameters = HashParameters(iterations: 2, memoryInKiB: 1 << 14, lanes: 4, password: randomBytes(16), salt: randomBytes(16))
+        measure {
+            for _ in 0..<8 {
+                _ = hashContexts([parameters]) { contexts in
+                    XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+                }
+            }
+        }
+    }
+
+    func test_performance_fourLanesWithPool() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        let parameters = HashParameters(iterations: 2, memoryInKiB: 1 << 14, lanes: 4, password: randomBytes(16), salt: randomBytes(16))
+        measure {
+            for _ in 0..<8 {
+                _ = hashContexts([parameters], pool: pool) { contexts in
+                    XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+                }
+            }
+        }
+    }
+
+    // MARK: - Block kernel
+
+    /// argon2_ctx fills blocks with the SIMD kernel picked for this CPU at first use (NEON on arm64)
+    func test_dispatchedKernel_katVectors() {
+        for vector in Argon2Tests.katVectors {
+            let tags = hashContexts([vector.parameters], version: vector.version) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, vector.variant.argon2Type), ARGON2_OK.rawValue)
+            }
+            XCTAssertEqual(hexString(tags[0]), vector.hexString)
+        }
+    }
+
+    func test_dispatchedKernel_argon2d() {
+        // Argon2d has no vector above; RFC 9106, section 5.1, also covers the secret and associated data
+        let parameters = HashParameters(
+            iterations: 3,
+            memoryInKiB: 32,
+            lanes: 4,
+            password: [UInt8](repeating: 0x01, count: 32),
+            salt: [UInt8](repeating: 0x02, count: 16)
+        )
+        let secret = [UInt8](repeating: 0x03, count: 8)
+        let associatedData = [UInt8](repeating: 0x04, count: 12)
+        for threads in [UInt32(1), 4] {
+            let tags = secret.withUnsafeBufferPointer { secretBytes in
+                associatedData.withUnsafeBufferPointer { associatedBytes in
+                    hashContexts([parameters], version: .v13) { contexts in
+                        contexts[0].secret = UnsafeMutablePointer(mutating: secretBytes.baseAddress)
+                        contexts[0].secretlen = UInt32(secretBytes.count)
+                        contexts[0].ad = UnsafeMutablePointer(mutating: associatedBytes.baseAddress)
+                        contexts[0].adlen = UInt32(associatedBytes.count)
+                        contexts[0].threads = threads
+                        XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_d), ARGON2_OK.rawValue)
+                    }
+                }
+            }
+            XCTAssertEqual(
+                hexString(tags[0]),
+                "512b391b6f1162975371d30919734294f868e3be3984f3c1a13a4db9fabe4acb",
+                "threads: \(threads)"
+            )
+        }
+    }
+
+    func test_performance_dispatchedKernel() {
+        let parameters = HashParameters(iterations: 3, memoryInKiB: 1 << 16, lanes: 1, password: randomBytes(16), salt: randomBytes(16))
+        measure {
+            _ = hashContexts([parameters]) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+            }
+        }
+    }
+
+    // MARK: - Batches
+
+    func test_hashBatch_matchesContexts() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        var parameters = [HashParameters]()
+        for index in UInt32(0)..<12 {
+            let lanes = 1 + index % 4
+            parameters.append(HashParameters(
+                iterations: 1 + index % 3,
+                memoryInKiB: (8 << (index % 5)) * lanes,
+                lanes: lanes,
+                password: randomBytes(Int(index)),
+                salt: randomBytes(16)
+            ))
+        }
+        // An invalid item fails on its own without affecting the others
+        parameters.insert(HashParameters(iterations: 1, memoryInKiB: 64, lanes: 1, password: [], salt: randomBytes(4)), at: 5)
+
+        let expected = parameters.map { item in
+            hashContexts([item]) { contexts in
+                _ = argon2_ctx(contexts.baseAddress, Argon2_id)
+            }[0]
+        }
+        for batchPool in [nil, pool] {
+            var results = [Int32](repeating: ARGON2_OK.rawValue, count: parameters.count)
+            let tags = hashContexts(parameters) { contexts in
+                XCTAssertEqual(
+                    argon2_hash_batch(contexts.baseAddress, UInt32(contexts.count), Argon2_id, batchPool, &results),
+                    ARGON2_SALT_TOO_SHORT.rawValue
+                )
+            }
+            for index in parameters.indices {
+                if index == 5 {
+                    XCTAssertEqual(results[index], ARGON2_SALT_TOO_SHORT.rawValue)
+                } else {
+                    XCTAssertEqual(results[index], ARGON2_OK.rawValue, "item: \(index)")
+                    XCTAssertEqual(tags[index], expected[index], "item: \(index)")
+                }
+            }
+        }
+    }
+
+    func test_hashBatch_katVectors() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        for variant in [Argon2.Variant.i, .id] {
+            for version in [Argon2.Version.v10, .v13] {
+                let vectors = Argon2Tests.katVectors.filter { $0.variant == variant && $0.version == version }
+                if vectors.isEmpty {
+                    continue
+                }
+                let tags = hashContexts(vectors.map { $0.parameters }, version: version) { contexts in
+                    XCTAssertEqual(
+                        argon2_hash_batch(contexts.baseAddress, UInt32(contexts.count), variant.argon2Type, pool, nil),
+                        ARGON2_OK.rawValue
+                    )
+                }
+                XCTAssertEqual(tags.map { hexString($0) }, vectors.map { $0.hexString })
+            }
+        }
+    }
+
+    private func batchBenchmarkParameters() -> [HashParameters] {
+        return (0..<16).map { _ in
+            HashParameters(iterations: 2, memoryInKiB: 1 << 12, lanes: 1, password: randomBytes(16), salt: randomBytes(16))
+        }
+    }
+
+    func test_performance_contextLoop() {
+        let parameters = batchBenchmarkParameters()
+        measure {
+            for item in parameters {
+                _ = hashContexts([item]) { contexts in
+                    XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+                }
+            }
+        }
+    }
+
+    func test_performance_hashBatch() {
+        let pool = argon2_pool_create(3)
+        XCTAssertNotNil(pool)
+        defer { argon2_pool_destroy(pool) }
+
+        let parameters = batchBenchmarkParameters()
+        measure {
+            _ = hashContexts(parameters) { contexts in
+                XCTAssertEqual(
+                    argon2_hash_batch(contexts.baseAddress, UInt32(contexts.count), Argon2_id, pool, nil),
+                    ARGON2_OK.rawValue
+                )
+            }
+        }
+    }
+
+    // MARK: - Memory flags
+
+    // ARGON2_FLAG_MAPPED_MEMORY, ARGON2_FLAG_HUGE_PAGES and ARGON2_FLAG_PREFAULT_MEMORY,
+    // whose UINT32_C definitions are not imported into Swift
+    private static let mappedMemoryFlag: UInt32 = 1 << 2
+    private static let hugePagesFlag: UInt32 = 1 << 3
+    private static let prefaultMemoryFlag: UInt32 = 1 << 4
+
+    func test_memoryFlags_katVectors() {
+        let allFlags = [Argon2Tests.mappedMemoryFlag, Argon2Tests.hugePagesFlag, Argon2Tests.prefaultMemoryFlag]
+        for combination in 0..<(1 << allFlags.count) {
+            var flags: UInt32 = 0
+            for (bit, flag) in allFlags.enumerated() where combination & (1 << bit) != 0 {
+                flags |= flag
+            }
+            for vector in Argon2Tests.katVectors {
+                let tags = hashContexts([vector.parameters], version: vector.version, flags: flags) { contexts in
+                    XCTAssertEqual(argon2_ctx(contexts.baseAddress, vector.variant.argon2Type), ARGON2_OK.rawValue)
+                }
+                XCTAssertEqual(hexString(tags[0]), vector.hexString, "flags: \(flags)")
+            }
+        }
+    }
+
+    func test_memoryFlags_cacheReusesRegions() {
+        let parameters = HashParameters(iterations: 1, memoryInKiB: 1 << 14, lanes: 1, password: randomBytes(16), salt: randomBytes(16))
+        var before = argon2_memory_stats()
+        var after = argon2_memory_stats()
+
+        argon2_memory_cache_trim()
+        argon2_memory_stats_get(&before)
+        let tags = (0..<2).map { _ in
+            hashContexts([parameters], flags: Argon2Tests.mappedMemoryFlag) { contexts in
+                XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+            }[0]
+        }
+        argon2_memory_stats_get(&after)
+
+        // The second hash gets the wiped region the first one released
+        XCTAssertEqual(tags[0], tags[1])
+        XCTAssertEqual(after.maps, before.maps + 1)
+        XCTAssertEqual(after.cache_hits, before.cache_hits + 1)
+        XCTAssertGreaterThan(after.cached_bytes, 0)
+
+        argon2_memory_cache_trim()
+        argon2_memory_stats_get(&after)
+        XCTAssertEqual(after.cached_bytes, 0)
+    }
+
+    private func measureMemoryFlags(_ flags: UInt32) {
+        let parameters = HashParameters(iterations: 1, memoryInKiB: 1 << 14, lanes: 1, password: randomBytes(16), salt: randomBytes(16))
+        measure {
+            for _ in 0..<8 {
+                _ = hashContexts([parameters], flags: flags) { contexts in
+                    XCTAssertEqual(argon2_ctx(contexts.baseAddress, Argon2_id), ARGON2_OK.rawValue)
+                }
+            }
+        }
+    }
+
+    func test_performance_heapMemory() {
+        measureMemoryFlags(0)
+    }
+
+    func test_performance_mappedMemory() {
+        measureMemoryFlags(Argon2Tests.mappedMemoryFlag)
+    }
+
+    func test_performance_mappedPrefaultedHugePages() {
+        measureMemoryFlags(Argon2Tests.mappedMemoryFlag | Argon2Tests.hugePagesFlag | Argon2Tests.prefaultMemoryFlag)
+    }
+
+    // MARK: - BLAKE2b
+
+    func test_blake2bLongX4_matchesBlake2bLong() {
+        for outputLength in [1, 31, 32, 33, 64, 65, 100, 1024] {
+            for inputLength in [0, 1, 72, 1024] {
+                let inputs = (0..<4).map { _ in randomBytes(inputLength) }
+                // The third output is left out, so its input must be ignored
+                let outputs = blake2bLongX4(inputs, outputLength: outputLength, skipping: 2)
+                for index in [0, 1, 3] {
+                    var expected = [UInt8](repeating: 0, count: outputLength)
+                    XCTAssertEqual(argon2_blake2b_long(&expected, outputLength, inputs[index], inputLength), ARGON2_OK.rawValue)
+                    XCTAssertEqual(outputs[index], expected, "outlen: \(outputLength), inlen: \(inputLength)")
+                }
+            }
+        }
+    }
+
+    func test_performance_blake2bLong() {
+        let inputs = (0..<4).map { _ in randomBytes(72) }
+        let outputLength = 1024
+        var output = [UInt8](repeating: 0, count: outputLength)
+        measure {
+            for _ in 0..<1000 {
+                for input in inputs {
+                    XCTAssertEqual(argon2_blake2b_long(&output, outputLength, input, input.count), ARGON2_OK.rawValue)
+                }
+            }
+        }
+    }
+
+    func test_performance_blake2bLongX4() {
+        let inputs = (0..<4).map { _ in randomBytes(72) }
+        measure {
+            for _ in 0..<1000 {
+                _ = blake2bLongX4(inputs, outputLength: 1024)
+            }
+        }
+    }
+
+    /// argon2_blake2b_long_x4 of four equal-length inputs, leaving out the output at skipping
+    private func blake2bLongX4(_ inputs: [[UInt8]], outputLength: Int, skipping: Int? = nil) -> [[UInt8]] {
+        let outputs = (0..<4).map { _ -> UnsafeMutableRawPointer in
+            let buffer = UnsafeMutableRawPointer.allocate(byteCount: outputLength, alignment: 1)
+            buffer.initializeMemory(as: UInt8.self, repeating: 0, count: outputLength)
+            return buffer
+        }
+        let inputBuffers = inputs.map { input -> UnsafeMutableRawPointer in
+            let buffer = UnsafeMutableRawPointer.allocate(byteCount: max(input.count, 1), alignment: 1)
+            buffer.copyMemory(from: input, byteCount: input.count)
+            return buffer
+        }
+        defer {
+            outputs.forEach { $0.deallocate() }
+            inputBuffers.forEach { $0.deallocate() }
+        }
+
+        let outputPointers: [UnsafeMutableRawPointer?] = outputs.indices.map { $0 == skipping ? nil : outputs[$0] }
+        let inputPointers: [UnsafeRawPointer?] = inputBuffers.map { UnsafeRawPointer($0) }
+        XCTAssertEqual(argon2_blake2b_long_x4(outputPointers, outputLength, inputPointers, inputs[0].count), ARGON2_OK.rawValue)
+        return outputs.map { [UInt8](UnsafeRawBufferPointer(start: $0, count: outputLength)) }
+    }
+
     private func hashTest(
         iterations: UInt32,
         memory: UInt32,
@@ -442,4 +793,117 @@ class Argon2Tests: XCTestCase {
             XCTAssertEqual(error as? E, expectedError)
         })
     }
+
+    // MARK: - Contexts
+
+    private struct HashParameters {
+        let iterations: UInt32
+        let memoryInKiB: UInt32
+        let lanes: UInt32
+        let password: [UInt8]
+        let salt: [UInt8]
+    }
+
+    private struct KATVector {
+        let parameters: HashParameters
+        let variant: Argon2.Variant
+        let version: Argon2.Version
+        let hexString: String
+
+        init(
+            _ iterations: UInt32,
+            _ memory: UInt32,
+            _ lanes: UInt32,
+            _ password: String,
+            _ salt: String,
+            _ variant: Argon2.Variant,
+            _ version: Argon2.Version,
+            _ hexString: String
+        ) {
+            self.parameters = HashParameters(
+                iterations: iterations,
+                memoryInKiB: 1 << memory,
+                lanes: lanes,
+                password: Array(password.utf8),
+                salt: Array(salt.utf8)
+            )
+            self.variant = variant
+            self.version = version
+            self.hexString = hexString
+        }
+    }
+
+    /// The vectors of the tests above that need at most 64 MiB
+    private static let katVectors: [KATVector] = [
+        KATVector(2, 16, 1, "password", "somesalt", .i, .v10, "f6c4db4a54e2a370627aff3db6176b94a2a209a62c8e36152711802f7b30c694"),
+        KATVector(2, 8, 2, "password", "somesalt", .i, .v10, "b6c11560a6a9d61eac706b79a2f97d68b4463aa3ad87e00c07e2b01e90c564fb"),
+        KATVector(2, 16, 1, "password", "somesalt", .i, .latest, "c1628832147d9720c5bd1cfd61367078729f6dfb6f8fea9ff98158e0d7816ed0"),
+        KATVector(2, 8, 1, "password", "somesalt", .i, .latest, "89e9029f4637b295beb027056a7336c414fadd43f6b208645281cb214a56452f"),
+        KATVector(2, 8, 2, "password", "somesalt", .i, .latest, "4ff5ce2769a1d7f4c8a491df09d41a9fbe90e5eb02155a13e4c01e20cd4eab61"),
+        KATVector(1, 16, 1, "password", "somesalt", .i, .latest, "d168075c4d985e13ebeae560cf8b94c3b5d8a16c51916b6f4ac2da3ac11bbecf"),
+        KATVector(4, 16, 1, "password", "somesalt", .i, .latest, "aaa953d58af3706ce3df1aefd4a64a84e31d7f54175231f1285259f88174ce5b"),
+        KATVector(2, 16, 1, "differentpassword", "somesalt", .i, .latest, "14ae8da01afea8700c2358dcef7c5358d9021282bd88663a4562f59fb74d22ee"),
+        KATVector(2, 16, 1, "password", "diffsalt", .i, .latest, "b0357cccfbef91f3860b0dba447b2348cbefecadaf990abfe9cc40726c521271"),
+        KATVector(2, 16, 1, "password", "somesalt", .id, .latest, "09316115d5cf24ed5a15a31a3ba326e5cf32edc24702987c02b6566f61913cf7"),
+        KATVector(2, 8, 1, "password", "somesalt", .id, .latest, "9dfeb910e80bad0311fee20f9c0e2b12c17987b4cac90c2ef54d5b3021c68bfe"),
+        KATVector(2, 8, 2, "password", "somesalt", .id, .latest, "6d093c501fd5999645e0ea3bf620d7b8be7fd2db59c20d9fff9539da2bf57037"),
+        KATVector(1, 16, 1, "password", "somesalt", .id, .latest, "f6a5adc1ba723dddef9b5ac1d464e180fcd9dffc9d1cbf76cca2fed795d9ca98"),
+        KATVector(4, 16, 1, "password", "somesalt", .id, .latest, "9025d48e68ef7395cca9079da4c4ec3affb3c8911fe4f86d1a2520856f63172c"),
+        KATVector(2, 16, 1, "differentpassword", "somesalt", .id, .latest, "0b84d652cf6b0c4beaef0dfe278ba6a80df6696281d7e0d2891b817d8c458fde"),
+        KATVector(2, 16, 1, "password", "diffsalt", .id, .latest, "bdf32b05ccc42eb15d58fd19b1f856b113da1e9a5874fdcc544308565aa8141c"),
+    ]
+
+    /// Fills one argon2_context per parameter set, with threads equal to lanes and a 32-byte tag,
+    /// hands them to body and returns the tags
+    private func hashContexts(
+        _ parameters: [HashParameters],
+        version: Argon2.Version = .latest,
+        flags: UInt32 = 0,
+        pool: OpaquePointer? = nil,
+        body: (UnsafeMutableBufferPointer<argon2_context>) -> Void
+    ) -> [Data] {
+        let tagLength = 32
+        var buffers = [UnsafeMutablePointer<UInt8>]()
+        defer { buffers.forEach { $0.deallocate() } }
+
+        func buffer(_ bytes: [UInt8]) -> UnsafeMutablePointer<UInt8> {
+            let pointer = UnsafeMutablePointer<UInt8>.allocate(capacity: max(bytes.count, 1))
+            pointer.initialize(from: bytes, count: bytes.count)
+            buffers.append(pointer)
+            return pointer
+        }
+
+        var contexts = [argon2_context](repeating: argon2_context(), count: parameters.count)
+        for (index, item) in parameters.enumerated() {
+            contexts[index].out = buffer([UInt8](repeating: 0, count: tagLength))
+            contexts[index].outlen = UInt32(tagLength)
+            contexts[index].pwd = buffer(item.password)
+            contexts[index].pwdlen = UInt32(item.password.count)
+            contexts[index].salt = buffer(item.salt)
+            contexts[index].saltlen = UInt32(item.salt.count)
+            contexts[index].t_cost = item.iterations
+            contexts[index].m_cost = item.memoryInKiB
+            contexts[index].lanes = item.lanes
+            contexts[index].threads = item.lanes
+            contexts[index].version = version.rawValue
+            contexts[index].flags = flags
+            contexts[index].pool = pool
+        }
+        contexts.withUnsafeMutableBufferPointer { body($0) }
+        return contexts.map { Data(bytes: $0.out, count: tagLength) }
+    }
+
+    private func randomBytes(_ count: Int) -> [UInt8] {
+        return (0..<count).map { _ in UInt8.random(in: .min ... .max) }
+    }
+
+    private func hexString(_ data: Data) -> String {
+        return data.map { String(format: "%02hhx", $0) }.joined()
+    }
+}
+
+private extension Argon2.Variant {
+    var argon2Type: Argon2_type {
+        return Argon2_type(rawValue: rawValue)
+    }
 }
@@ -92,6 +92,16 @@ extern "C" {
 #define ARGON2_FLAG_CLEAR_PASSWORD (UINT32_C(1) << 0)
 #define ARGON2_FLAG_CLEAR_SECRET (UINT32_C(1) << 1)
 
+/* Flags selecting the built-in mmap allocator (ignored when allocate_cbk is
+ * set, and on platforms without mmap). Released regions are wiped and kept in
+ * a small per-process cache, so hashes of the same memory cost reuse pages
+ * that are already faulted in. HUGE_PAGES asks for MAP_HUGETLB, falling back
+ * to 2 MiB-aligned transparent huge pages; PREFAULT_MEMORY populates the
+ * mapping up front. Either of them implies MAPPED_MEMORY. */
+#define ARGON2_FLAG_MAPPED_MEMORY (UINT32_C(1) << 2)
+#define ARGON2_FLAG_HUGE_PAGES (UINT32_C(1) << 3)
+#define ARGON2_FLAG_PREFAULT_MEMORY (UINT32_C(1) << 4)
+
 /* Global flag to determine if we are wiping internal memory buffers. This flag
  * is defined in core.c and defaults to 1 (wipe internal memory). */
 extern int FLAG_clear_internal_memory;
@@ -161,6 +171,18 @@ typedef enum Argon2_ErrorCodes {
 typedef int (*allocate_fptr)(uint8_t **memory, size_t bytes_to_allocate);
 typedef void (*deallocate_fptr)(uint8_t *memory, size_t bytes_to_allocate);
 
+/* Counters of the built-in mmap allocator --- see argon2_memory_stats_get() */
+typedef struct Argon2_memory_stats {
+    uint64_t maps;           /* regions mapped from the kernel */
+    uint64_t huge_maps;      /* of which backed by MAP_HUGETLB */
+    uint64_t cache_hits;     /* allocations served from the region cache */
+    uint64_t faults_avoided; /* resident pages handed out again by the cache */
+    uint64_t cached_bytes;   /* bytes currently held by the cache */
+} argon2_memory_stats;
+
+/* Persistent worker pool --- see argon2_pool_create() */
+typedef struct Argon2_pool argon2_pool;
+
 /* Argon2 external data structures */
 
 /*
@@ -187,6 +209,10 @@ typedef void (*deallocate_fptr)(uint8_t *memory, size_t bytes_to_allocate);
  * erased. You want to use the default memory allocator.
  * Then you initialize:
  Argon2_Context(out,8,pwd,32,salt,16,NULL,0,NULL,0,5,1<<20,4,4,NULL,NULL,true,false,false,false)
+ *****
+ * When hashing repeatedly with threads > 1, a pool created once with
+ * argon2_pool_create() can be set in the pool field. Lanes are then run on its
+ * workers instead of creating and joining a thread per lane per slice.
  */
 typedef struct Argon2_Context {
     uint8_t *out;    /* output array */
@@ -215,6 +241,8 @@ typedef struct Argon2_Context {
     deallocate_fptr free_cbk;   /* pointer to memory deallocator */
 
     uint32_t flags; /* array of bool options */
+
+    argon2_pool *pool; /* optional worker pool (NULL: spawn threads per slice) */
 } argon2_context;
 
 /* Argon2 primitive type */
@@ -378,6 +406,28 @@ ARGON2_PUBLIC int argon2i_ctx(argon2_context *context);
  */
 ARGON2_PUBLIC int argon2id_ctx(argon2_context *context);
 
+/**
+ * Hashes many independent contexts of one Argon2 type. All items of a batch
+ * share one block arena, reused from item to item, and when @pool is set the
+ * lanes of several items are filled side by side on its workers, so single-lane
+ * hashes keep every core busy. The threads and pool fields of the contexts are
+ * ignored; contexts with a custom allocator are hashed one at a time with
+ * argon2_ctx. Tags are identical to argon2_ctx.
+ * The arena is allocated with the memory flags (ARGON2_FLAG_MAPPED_MEMORY,
+ * ARGON2_FLAG_HUGE_PAGES, ARGON2_FLAG_PREFAULT_MEMORY) of the first context
+ * that shares it; those flags of the other contexts are ignored, so mixing
+ * them within a batch is not supported.
+ * @param  contexts  Array of @count Argon2 contexts
+ * @param  count  Number of contexts
+ * @param  type  Argon2 type used for every context
+ * @param  pool  Pool to run on, or NULL to hash on the calling thread
+ * @param  results  Optional array receiving the error code of every item
+ * @return ARGON2_OK if all items succeeded, otherwise the first error code
+ */
+ARGON2_PUBLIC int argon2_hash_batch(argon2_context *contexts, uint32_t count,
+                                    argon2_type type, argon2_pool *pool,
+                                    int *results);
+
 /**
  * Verify if a given password is correct for Argon2d hashing
  * @param  context  Pointer to current Argon2 context
@@ -410,6 +460,66 @@ ARGON2_PUBLIC int argon2id_verify_ctx(argon2_context *context,
 ARGON2_PUBLIC int argon2_verify_ctx(argon2_context *context, const char *hash,
                                     argon2_type type);
 
+/**
+ * Creates a pool of persistent worker threads for filling lanes.
+ * The calling thread always takes part in the work, so a pool of n workers
+ * runs up to n + 1 lanes at once. A pool may be shared between contexts and
+ * threads; concurrent hashes take turns at each synchronization point.
+ * @param  threads  Number of worker threads to start
+ * @return A new pool, or NULL if threads could not be created or threading is
+ * disabled (ARGON2_NO_THREADS)
+ */
+ARGON2_PUBLIC argon2_pool *argon2_pool_create(uint32_t threads);
+
+/**
+ * Stops and joins the workers of a pool and frees it
+ * @param  pool  Pool created by argon2_pool_create, may be NULL
+ * @pre   No hash may be running on @pool
+ */
+ARGON2_PUBLIC void argon2_pool_destroy(argon2_pool *pool);
+
+/**
+ * Reads the counters of the built-in mmap allocator (all zero on platforms
+ * without mmap)
+ * @param  stats  Receives a snapshot of the counters
+ */
+ARGON2_PUBLIC void argon2_memory_stats_get(argon2_memory_stats *stats);
+
+/**
+ * Unmaps every region held by the mmap allocator's cache, e.g. when no more
+ * hashes are expected soon. Cached regions are already wiped.
+ */
+ARGON2_PUBLIC void argon2_memory_cache_trim(void);
+
+/**
+ * BLAKE2b using the same vectorized kernel as Argon2
+ * @param  out     Output buffer of outlen bytes
+ * @param  outlen  Digest length, 1 to 64 bytes
+ * @param  in      Input, may be NULL if inlen is 0
+ * @param  key     Optional key of up to 64 bytes, NULL if keylen is 0
+ * @return ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_blake2b(void *out, size_t outlen, const void *in,
+                                 size_t inlen, const void *key, size_t keylen);
+
+/**
+ * Argon2's variable-length hash H', a BLAKE2b chain producing outlen bytes
+ * @return ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_blake2b_long(void *out, size_t outlen, const void *in,
+                                      size_t inlen);
+
+/**
+ * Computes H' of four equal-length inputs at once. Entries of @out may be
+ * NULL to hash fewer than four; their inputs are ignored.
+ * @param  out     Four output buffers of outlen bytes each
+ * @param  in      Four inputs of inlen bytes each
+ * @return ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_blake2b_long_x4(void *const out[4], size_t outlen,
+                                         const void *const in[4],
+                                         size_t inlen);
+
 /**
  * Get the associated error message for given error code
  * @return  The error message associated with the given error code
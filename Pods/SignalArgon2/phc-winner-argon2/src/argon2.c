@@ -22,6 +22,7 @@
 #include "argon2.h"
 #include "encoding.h"
 #include "core.h"
+#include "thread.h"
 
 const char *argon2_type2string(argon2_type type, int uppercase) {
     switch (type) {
@@ -36,19 +37,10 @@ const char *argon2_type2string(argon2_type type, int uppercase) {
     return NULL;
 }
 
-int argon2_ctx(argon2_context *context, argon2_type type) {
-    /* 1. Validate all inputs */
-    int result = validate_inputs(context);
+/* Derives the memory layout of a validated context */
+static void init_instance(argon2_instance_t *instance,
+                          const argon2_context *context, argon2_type type) {
     uint32_t memory_blocks, segment_length;
-    argon2_instance_t instance;
-
-    if (ARGON2_OK != result) {
-        return result;
-    }
-
-    if (Argon2_d != type && Argon2_i != type && Argon2_id != type) {
-        return ARGON2_INCORRECT_TYPE;
-    }
 
     /* 2. Align memory size */
     /* Minimum memory_blocks = 8L blocks, where L is the number of lanes */
@@ -62,20 +54,36 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     /* Ensure that all segments have equal length */
     memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
 
-    instance.version = context->version;
-    instance.memory = NULL;
-    instance.passes = context->t_cost;
-    instance.memory_blocks = memory_blocks;
-    instance.segment_length = segment_length;
-    instance.lane_length = segment_length * ARGON2_SYNC_POINTS;
-    instance.lanes = context->lanes;
-    instance.threads = context->threads;
-    instance.type = type;
+    instance->version = context->version;
+    instance->memory = NULL;
+    instance->passes = context->t_cost;
+    instance->memory_blocks = memory_blocks;
+    instance->segment_length = segment_length;
+    instance->lane_length = segment_length * ARGON2_SYNC_POINTS;
+    instance->lanes = context->lanes;
+    instance->threads = context->threads;
+    instance->type = type;
+
+    if (instance->threads > instance->lanes) {
+        instance->threads = instance->lanes;
+    }
+}
+
+int argon2_ctx(argon2_context *context, argon2_type type) {
+    /* 1. Validate all inputs */
+    int result = validate_inputs(context);
+    argon2_instance_t instance;
+
+    if (ARGON2_OK != result) {
+        return result;
+    }
 
-    if (instance.threads > instance.lanes) {
-        instance.threads = instance.lanes;
+    if (Argon2_d != type && Argon2_i != type && Argon2_id != type) {
+        return ARGON2_INCORRECT_TYPE;
     }
 
+    init_instance(&instance, context, type);
+
     /* 3. Initialization: Hashing inputs, allocating memory, filling first
      * blocks
      */
@@ -97,6 +105,243 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     return ARGON2_OK;
 }
 
+/* One hash of an argon2_hash_batch call */
+typedef struct Argon2_batch_item {
+    argon2_context *context;
+    argon2_instance_t instance;
+    int batched;        /* filled in the shared arena */
+    int result;
+    uint32_t first_job; /* job index of lane 0 in the current slice */
+} argon2_batch_item;
+
+/* Items filled side by side, and the slice they are at */
+typedef struct Argon2_batch_wave {
+    argon2_batch_item *items;
+    uint32_t count;
+    uint32_t pass;
+    uint8_t slice;
+} argon2_batch_wave;
+
+typedef void (*argon2_batch_job_t)(void *arg, uint32_t index);
+
+static void batch_run(argon2_pool *pool, argon2_batch_job_t job, void *arg,
+                      uint32_t count) {
+    uint32_t i;
+
+#if !defined(ARGON2_NO_THREADS)
+    if (pool != NULL &&
+        argon2_pool_run(pool, ARGON2_MAX_THREADS, job, arg, count) == 0) {
+        return;
+    }
+#else
+    (void)pool;
+#endif
+    for (i = 0; i < count; ++i) {
+        job(arg, i);
+    }
+}
+
+static void batch_initialize_job(void *arg, uint32_t index) {
+    argon2_batch_item *item = &((argon2_batch_wave *)arg)->items[index];
+    if (item->batched) {
+        initialize_blocks(&item->instance, item->context);
+    }
+}
+
+static void batch_fill_job(void *arg, uint32_t index) {
+    const argon2_batch_wave *wave = arg;
+    const argon2_batch_item *item;
+    argon2_position_t position;
+    uint32_t i = wave->count - 1;
+
+    /* Items without lanes in this slice share first_job with the next one,
+       so the last item starting at or before index owns it */
+    while (wave->items[i].first_job > index) {
+        --i;
+    }
+    item = &wave->items[i];
+
+    position.pass = wave->pass;
+    position.lane = index - item->first_job;
+    position.slice = wave->slice;
+    position.index = 0;
+    fill_segment(&item->instance, position);
+}
+
+static void batch_finalize_job(void *arg, uint32_t index) {
+    argon2_batch_item *item = &((argon2_batch_wave *)arg)->items[index];
+    if (item->batched) {
+        finalize_tag(item->context, &item->instance);
+    }
+}
+
+static void batch_fill_wave(argon2_batch_wave *wave, argon2_pool *pool) {
+    uint32_t max_passes = 0, r, s, i, jobs;
+
+    for (i = 0; i < wave->count; ++i) {
+        if (wave->items[i].batched &&
+            wave->items[i].instance.passes > max_passes) {
+            max_passes = wave->items[i].instance.passes;
+        }
+    }
+
+    for (r = 0; r < max_passes; ++r) {
+        for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+            jobs = 0;
+            for (i = 0; i < wave->count; ++i) {
+                argon2_batch_item *item = &wave->items[i];
+                item->first_job = jobs;
+                if (item->batched && r < item->instance.passes) {
+                    jobs += item->instance.lanes;
+                }
+            }
+            wave->pass = r;
+            wave->slice = (uint8_t)s;
+            batch_run(pool, &batch_fill_job, wave, jobs);
+        }
+    }
+}
+
+/* Extends a wave from @start until it has @target_lanes lanes, returning its
+ * end and the number of blocks it needs in @blocks (0 on overflow) */
+static uint32_t batch_wave_end(const argon2_batch_item *items, uint32_t start,
+                               uint32_t count, uint32_t target_lanes,
+                               size_t *blocks) {
+    uint32_t end, lanes = 0;
+
+    *blocks = 0;
+    for (end = start; end < count && lanes < target_lanes; ++end) {
+        if (items[end].batched) {
+            size_t total = *blocks + items[end].instance.memory_blocks;
+            if (total < *blocks) {
+                *blocks = 0;
+                return end + 1;
+            }
+            *blocks = total;
+            lanes += items[end].instance.lanes;
+        }
+    }
+    return end;
+}
+
+int argon2_hash_batch(argon2_context *contexts, uint32_t count,
+                      argon2_type type, argon2_pool *pool, int *results) {
+    argon2_context alloc_context;
+    argon2_batch_item *items;
+    argon2_batch_wave wave;
+    block *arena = NULL;
+    size_t arena_blocks = 0, blocks;
+    uint32_t i, start, end, target_lanes = 1, batched = 0;
+    int first_error = ARGON2_OK;
+
+    if (contexts == NULL && count != 0) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    if (Argon2_d != type && Argon2_i != type && Argon2_id != type) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+
+    if (count == 0) {
+        return ARGON2_OK;
+    }
+
+    items = calloc(count, sizeof(argon2_batch_item));
+    if (items == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+
+    /* The arena never uses a custom allocator; it takes the memory flags of
+       the first batched context */
+    memset(&alloc_context, 0, sizeof(alloc_context));
+
+#if !defined(ARGON2_NO_THREADS)
+    if (pool != NULL) {
+        target_lanes += argon2_pool_size(pool);
+    }
+#endif
+
+    /* 1. Validate; items with their own allocator are hashed on their own */
+    for (i = 0; i < count; ++i) {
+        items[i].context = &contexts[i];
+        items[i].result = validate_inputs(&contexts[i]);
+        if (items[i].result != ARGON2_OK) {
+            continue;
+        }
+        if (contexts[i].allocate_cbk != NULL) {
+            items[i].result = argon2_ctx(&contexts[i], type);
+            continue;
+        }
+        init_instance(&items[i].instance, &contexts[i], type);
+        items[i].batched = 1;
+        if (batched++ == 0) {
+            alloc_context.flags =
+                contexts[i].flags &
+                (ARGON2_FLAG_MAPPED_MEMORY | ARGON2_FLAG_HUGE_PAGES |
+                 ARGON2_FLAG_PREFAULT_MEMORY);
+        }
+    }
+
+    /* 2. Size the arena for the largest wave */
+    for (start = 0; start < count; start = end) {
+        end = batch_wave_end(items, start, count, target_lanes, &blocks);
+        if (blocks > arena_blocks) {
+            arena_blocks = blocks;
+        }
+    }
+    if (arena_blocks != 0 &&
+        allocate_memory(&alloc_context, (uint8_t **)&arena, arena_blocks,
+                        sizeof(block)) != ARGON2_OK) {
+        arena = NULL;
+    }
+
+    /* 3. Hash wave by wave, each reusing the arena from the start */
+    for (start = 0; start < count; start = end) {
+        end = batch_wave_end(items, start, count, target_lanes, &blocks);
+
+        if (arena == NULL || blocks == 0) {
+            for (i = start; i < end; ++i) {
+                if (items[i].batched) {
+                    items[i].batched = 0;
+                    items[i].result = ARGON2_MEMORY_ALLOCATION_ERROR;
+                }
+            }
+            continue;
+        }
+
+        blocks = 0;
+        for (i = start; i < end; ++i) {
+            if (items[i].batched) {
+                items[i].instance.memory = arena + blocks;
+                blocks += items[i].instance.memory_blocks;
+            }
+        }
+
+        wave.items = items + start;
+        wave.count = end - start;
+        batch_run(pool, &batch_initialize_job, &wave, wave.count);
+        batch_fill_wave(&wave, pool);
+        batch_run(pool, &batch_finalize_job, &wave, wave.count);
+    }
+
+    if (arena != NULL) {
+        free_memory(&alloc_context, (uint8_t *)arena, arena_blocks,
+                    sizeof(block));
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (results != NULL) {
+            results[i] = items[i].result;
+        }
+        if (first_error == ARGON2_OK) {
+            first_error = items[i].result;
+        }
+    }
+    free(items);
+
+    return first_error;
+}
+
 int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
                 const uint32_t parallelism, const void *pwd,
                 const size_t pwdlen, const void *salt, const size_t saltlen,
@@ -146,6 +391,7 @@ int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
     context.allocate_cbk = NULL;
     context.free_cbk = NULL;
     context.flags = ARGON2_DEFAULT_FLAGS;
+    context.pool = NULL;
     context.version = version;
 
     result = argon2_ctx(&context, type);
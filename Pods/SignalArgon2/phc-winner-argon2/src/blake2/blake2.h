@@ -80,6 +80,9 @@ ARGON2_LOCAL int blake2b(void *out, size_t outlen, const void *in, size_t inlen,
 
 /* Argon2 Team - Begin Code */
 ARGON2_LOCAL int blake2b_long(void *out, size_t outlen, const void *in, size_t inlen);
+/* Four H' outputs of equal length; NULL outputs are skipped */
+ARGON2_LOCAL int blake2b_long_x4(void *const out[4], size_t outlen,
+                                 const void *const in[4], size_t inlen);
 /* Argon2 Team - End Code */
 
 #if defined(__cplusplus)
@@ -21,6 +21,7 @@
 
 #include "blake2.h"
 #include "blake2-impl.h"
+#include "blamka-round-simd.h"
 
 static const uint64_t blake2b_IV[8] = {
     UINT64_C(0x6a09e667f3bcc908), UINT64_C(0xbb67ae8584caa73b),
@@ -163,7 +164,7 @@ int blake2b_init_key(blake2b_state *S, size_t outlen, const void *key,
     return 0;
 }
 
-static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
+static void blake2b_compress_ref(blake2b_state *S, const uint8_t *block) {
     uint64_t m[16];
     uint64_t v[16];
     unsigned int i, r;
@@ -221,6 +222,350 @@ static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
 #undef ROUND
 }
 
+typedef void (*blake2b_compress_fn)(blake2b_state *S, const uint8_t *block);
+
+/* Four states advanced in lockstep, one block each */
+typedef void (*blake2b_compress_x4_fn)(blake2b_state S[4],
+                                       const uint8_t *const blocks[4]);
+
+#if defined(ARGON2_SIMD_X86)
+
+/*
+ * Single-buffer kernels keep the state as four rows, like the BlaMka kernels
+ * in blamka-round-simd.h. The message stays in eight registers of two words
+ * each; with the rounds unrolled the sigma indices are constants, so every
+ * message pair below folds to a single unpack, alignr or blend.
+ */
+
+#define ARGON2_SSE41 ARGON2_TARGET("sse4.1")
+
+/* (m[a], m[b]) out of M[k] = (m[2k], m[2k + 1]) */
+static BLAKE2_INLINE ARGON2_SSE41 __m128i msg_pair_sse41(const __m128i *M,
+                                                         unsigned int a,
+                                                         unsigned int b) {
+    if (a % 2 == 0) {
+        return b % 2 == 0 ? _mm_unpacklo_epi64(M[a / 2], M[b / 2])
+                          : _mm_blend_epi16(M[a / 2], M[b / 2], 0xF0);
+    }
+    return b % 2 == 0 ? _mm_alignr_epi8(M[b / 2], M[a / 2], 8)
+                      : _mm_unpackhi_epi64(M[a / 2], M[b / 2]);
+}
+
+#define MSG_SSE41(r, i, j) msg_pair_sse41(M, blake2b_sigma[r][i], blake2b_sigma[r][j])
+
+#define G_SSE41(A0, A1, B0, B1, C0, C1, D0, D1, M0, M1, rd, rb)                \
+    do {                                                                       \
+        A0 = _mm_add_epi64(_mm_add_epi64(A0, B0), M0);                         \
+        A1 = _mm_add_epi64(_mm_add_epi64(A1, B1), M1);                         \
+        D0 = rd(_mm_xor_si128(D0, A0));                                        \
+        D1 = rd(_mm_xor_si128(D1, A1));                                        \
+        C0 = _mm_add_epi64(C0, D0);                                            \
+        C1 = _mm_add_epi64(C1, D1);                                            \
+        B0 = rb(_mm_xor_si128(B0, C0));                                        \
+        B1 = rb(_mm_xor_si128(B1, C1));                                        \
+    } while ((void)0, 0)
+
+#define ROUND_SSE41(r)                                                         \
+    do {                                                                       \
+        G_SSE41(A0, A1, B0, B1, C0, C1, D0, D1, MSG_SSE41(r, 0, 2),            \
+                MSG_SSE41(r, 4, 6), rotr32_ssse3, rotr24_ssse3);               \
+        G_SSE41(A0, A1, B0, B1, C0, C1, D0, D1, MSG_SSE41(r, 1, 3),            \
+                MSG_SSE41(r, 5, 7), rotr16_ssse3, rotr63_ssse3);               \
+        DIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1);                             \
+        G_SSE41(A0, A1, B0, B1, C0, C1, D0, D1, MSG_SSE41(r, 8, 10),           \
+                MSG_SSE41(r, 12, 14), rotr32_ssse3, rotr24_ssse3);             \
+        G_SSE41(A0, A1, B0, B1, C0, C1, D0, D1, MSG_SSE41(r, 9, 11),           \
+                MSG_SSE41(r, 13, 15), rotr16_ssse3, rotr63_ssse3);             \
+        UNDIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1);                           \
+    } while ((void)0, 0)
+
+static ARGON2_SSE41 void blake2b_compress_sse41(blake2b_state *S,
+                                                const uint8_t *block) {
+    __m128i M[8];
+    __m128i A0, A1, B0, B1, C0, C1, D0, D1, H0, H1, H2, H3;
+    unsigned int i;
+
+    for (i = 0; i < 8; ++i) {
+        M[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+    }
+
+    A0 = H0 = _mm_loadu_si128((const __m128i *)&S->h[0]);
+    A1 = H1 = _mm_loadu_si128((const __m128i *)&S->h[2]);
+    B0 = H2 = _mm_loadu_si128((const __m128i *)&S->h[4]);
+    B1 = H3 = _mm_loadu_si128((const __m128i *)&S->h[6]);
+    C0 = _mm_loadu_si128((const __m128i *)&blake2b_IV[0]);
+    C1 = _mm_loadu_si128((const __m128i *)&blake2b_IV[2]);
+    D0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&blake2b_IV[4]),
+                       _mm_loadu_si128((const __m128i *)&S->t[0]));
+    D1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&blake2b_IV[6]),
+                       _mm_loadu_si128((const __m128i *)&S->f[0]));
+
+    ROUND_SSE41(0);
+    ROUND_SSE41(1);
+    ROUND_SSE41(2);
+    ROUND_SSE41(3);
+    ROUND_SSE41(4);
+    ROUND_SSE41(5);
+    ROUND_SSE41(6);
+    ROUND_SSE41(7);
+    ROUND_SSE41(8);
+    ROUND_SSE41(9);
+    ROUND_SSE41(10);
+    ROUND_SSE41(11);
+
+    _mm_storeu_si128((__m128i *)&S->h[0],
+                     _mm_xor_si128(H0, _mm_xor_si128(A0, C0)));
+    _mm_storeu_si128((__m128i *)&S->h[2],
+                     _mm_xor_si128(H1, _mm_xor_si128(A1, C1)));
+    _mm_storeu_si128((__m128i *)&S->h[4],
+                     _mm_xor_si128(H2, _mm_xor_si128(B0, D0)));
+    _mm_storeu_si128((__m128i *)&S->h[6],
+                     _mm_xor_si128(H3, _mm_xor_si128(B1, D1)));
+}
+
+#undef ROUND_SSE41
+#undef G_SSE41
+
+#define G_AVX2_MSG(A, B, C, D, M, rd, rb)                                      \
+    do {                                                                       \
+        A = _mm256_add_epi64(_mm256_add_epi64(A, B), M);                       \
+        D = rd(_mm256_xor_si256(D, A));                                        \
+        C = _mm256_add_epi64(C, D);                                            \
+        B = rb(_mm256_xor_si256(B, C));                                        \
+    } while ((void)0, 0)
+
+#define MSG_AVX2(r, i, j, k, l)                                                \
+    _mm256_inserti128_si256(_mm256_castsi128_si256(MSG_SSE41(r, i, j)),       \
+                            MSG_SSE41(r, k, l), 1)
+
+#define ROUND_AVX2(r)                                                          \
+    do {                                                                       \
+        G_AVX2_MSG(A, B, C, D, MSG_AVX2(r, 0, 2, 4, 6), rotr32_avx2,           \
+                   rotr24_avx2);                                               \
+        G_AVX2_MSG(A, B, C, D, MSG_AVX2(r, 1, 3, 5, 7), rotr16_avx2,           \
+                   rotr63_avx2);                                               \
+        B = _mm256_permute4x64_epi64(B, _MM_SHUFFLE(0, 3, 2, 1));              \
+        C = _mm256_permute4x64_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));              \
+        D = _mm256_permute4x64_epi64(D, _MM_SHUFFLE(2, 1, 0, 3));              \
+        G_AVX2_MSG(A, B, C, D, MSG_AVX2(r, 8, 10, 12, 14), rotr32_avx2,        \
+                   rotr24_avx2);                                               \
+        G_AVX2_MSG(A, B, C, D, MSG_AVX2(r, 9, 11, 13, 15), rotr16_avx2,        \
+                   rotr63_avx2);                                               \
+        B = _mm256_permute4x64_epi64(B, _MM_SHUFFLE(2, 1, 0, 3));              \
+        C = _mm256_permute4x64_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));              \
+        D = _mm256_permute4x64_epi64(D, _MM_SHUFFLE(0, 3, 2, 1));              \
+    } while ((void)0, 0)
+
+static ARGON2_AVX2 void blake2b_compress_avx2(blake2b_state *S,
+                                              const uint8_t *block) {
+    __m128i M[8];
+    __m256i A, B, C, D, H0, H1;
+    unsigned int i;
+
+    for (i = 0; i < 8; ++i) {
+        M[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+    }
+
+    A = H0 = _mm256_loadu_si256((const __m256i *)&S->h[0]);
+    B = H1 = _mm256_loadu_si256((const __m256i *)&S->h[4]);
+    C = _mm256_loadu_si256((const __m256i *)&blake2b_IV[0]);
+    D = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&blake2b_IV[4]),
+                         _mm256_loadu_si256((const __m256i *)&S->t[0]));
+
+    ROUND_AVX2(0);
+    ROUND_AVX2(1);
+    ROUND_AVX2(2);
+    ROUND_AVX2(3);
+    ROUND_AVX2(4);
+    ROUND_AVX2(5);
+    ROUND_AVX2(6);
+    ROUND_AVX2(7);
+    ROUND_AVX2(8);
+    ROUND_AVX2(9);
+    ROUND_AVX2(10);
+    ROUND_AVX2(11);
+
+    _mm256_storeu_si256((__m256i *)&S->h[0],
+                        _mm256_xor_si256(H0, _mm256_xor_si256(A, C)));
+    _mm256_storeu_si256((__m256i *)&S->h[4],
+                        _mm256_xor_si256(H1, _mm256_xor_si256(B, D)));
+}
+
+#undef ROUND_AVX2
+#undef MSG_AVX2
+#undef G_AVX2_MSG
+#undef MSG_SSE41
+
+/*
+ * Multi-buffer kernel: word i of all four states shares one register, so a
+ * round is the scalar round with every operation four lanes wide and no
+ * diagonalization is needed. Inputs and outputs are transposed 4x4.
+ */
+
+#define TRANSPOSE_X4_AVX2(r0, r1, r2, r3)                                      \
+    do {                                                                       \
+        __m256i t0 = _mm256_unpacklo_epi64(r0, r1);                            \
+        __m256i t1 = _mm256_unpackhi_epi64(r0, r1);                            \
+        __m256i t2 = _mm256_unpacklo_epi64(r2, r3);                            \
+        __m256i t3 = _mm256_unpackhi_epi64(r2, r3);                            \
+        r0 = _mm256_permute2x128_si256(t0, t2, 0x20);                          \
+        r1 = _mm256_permute2x128_si256(t1, t3, 0x20);                          \
+        r2 = _mm256_permute2x128_si256(t0, t2, 0x31);                          \
+        r3 = _mm256_permute2x128_si256(t1, t3, 0x31);                          \
+    } while ((void)0, 0)
+
+#define LOAD_X4_AVX2(dst, p0, p1, p2, p3)                                      \
+    do {                                                                       \
+        dst[0] = _mm256_loadu_si256((const __m256i *)(p0));                    \
+        dst[1] = _mm256_loadu_si256((const __m256i *)(p1));                    \
+        dst[2] = _mm256_loadu_si256((const __m256i *)(p2));                    \
+        dst[3] = _mm256_loadu_si256((const __m256i *)(p3));                    \
+        TRANSPOSE_X4_AVX2(dst[0], dst[1], dst[2], dst[3]);                     \
+    } while ((void)0, 0)
+
+#define G_X4_AVX2(r, i, a, b, c, d)                                            \
+    do {                                                                       \
+        v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]),                  \
+                                m[blake2b_sigma[r][2 * i + 0]]);               \
+        v[d] = rotr32_avx2(_mm256_xor_si256(v[d], v[a]));                      \
+        v[c] = _mm256_add_epi64(v[c], v[d]);                                   \
+        v[b] = rotr24_avx2(_mm256_xor_si256(v[b], v[c]));                      \
+        v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]),                  \
+                                m[blake2b_sigma[r][2 * i + 1]]);               \
+        v[d] = rotr16_avx2(_mm256_xor_si256(v[d], v[a]));                      \
+        v[c] = _mm256_add_epi64(v[c], v[d]);                                   \
+        v[b] = rotr63_avx2(_mm256_xor_si256(v[b], v[c]));                      \
+    } while ((void)0, 0)
+
+static ARGON2_AVX2 void
+blake2b_compress_x4_avx2(blake2b_state S[4], const uint8_t *const blocks[4]) {
+    __m256i m[16], v[16], h[8];
+    unsigned int i, r;
+
+    for (i = 0; i < 4; ++i) {
+        LOAD_X4_AVX2((&m[4 * i]), blocks[0] + 32 * i, blocks[1] + 32 * i,
+                     blocks[2] + 32 * i, blocks[3] + 32 * i);
+    }
+    for (i = 0; i < 2; ++i) {
+        LOAD_X4_AVX2((&h[4 * i]), &S[0].h[4 * i], &S[1].h[4 * i],
+                     &S[2].h[4 * i], &S[3].h[4 * i]);
+    }
+
+    for (i = 0; i < 8; ++i) {
+        v[i] = h[i];
+        v[i + 8] = _mm256_set1_epi64x((int64_t)blake2b_IV[i]);
+    }
+    v[12] = _mm256_xor_si256(v[12], _mm256_set_epi64x((int64_t)S[3].t[0],
+                                                      (int64_t)S[2].t[0],
+                                                      (int64_t)S[1].t[0],
+                                                      (int64_t)S[0].t[0]));
+    v[13] = _mm256_xor_si256(v[13], _mm256_set_epi64x((int64_t)S[3].t[1],
+                                                      (int64_t)S[2].t[1],
+                                                      (int64_t)S[1].t[1],
+                                                      (int64_t)S[0].t[1]));
+    v[14] = _mm256_xor_si256(v[14], _mm256_set_epi64x((int64_t)S[3].f[0],
+                                                      (int64_t)S[2].f[0],
+                                                      (int64_t)S[1].f[0],
+                                                      (int64_t)S[0].f[0]));
+    v[15] = _mm256_xor_si256(v[15], _mm256_set_epi64x((int64_t)S[3].f[1],
+                                                      (int64_t)S[2].f[1],
+                                                      (int64_t)S[1].f[1],
+                                                      (int64_t)S[0].f[1]));
+
+    for (r = 0; r < 12; ++r) {
+        G_X4_AVX2(r, 0, 0, 4, 8, 12);
+        G_X4_AVX2(r, 1, 1, 5, 9, 13);
+        G_X4_AVX2(r, 2, 2, 6, 10, 14);
+        G_X4_AVX2(r, 3, 3, 7, 11, 15);
+        G_X4_AVX2(r, 4, 0, 5, 10, 15);
+        G_X4_AVX2(r, 5, 1, 6, 11, 12);
+        G_X4_AVX2(r, 6, 2, 7, 8, 13);
+        G_X4_AVX2(r, 7, 3, 4, 9, 14);
+    }
+
+    for (i = 0; i < 8; ++i) {
+        h[i] = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+    }
+    for (i = 0; i < 2; ++i) {
+        TRANSPOSE_X4_AVX2(h[4 * i + 0], h[4 * i + 1], h[4 * i + 2],
+                          h[4 * i + 3]);
+        _mm256_storeu_si256((__m256i *)&S[0].h[4 * i], h[4 * i + 0]);
+        _mm256_storeu_si256((__m256i *)&S[1].h[4 * i], h[4 * i + 1]);
+        _mm256_storeu_si256((__m256i *)&S[2].h[4 * i], h[4 * i + 2]);
+        _mm256_storeu_si256((__m256i *)&S[3].h[4 * i], h[4 * i + 3]);
+    }
+}
+
+#undef G_X4_AVX2
+#undef LOAD_X4_AVX2
+#undef TRANSPOSE_X4_AVX2
+
+static blake2b_compress_fn select_compress(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &blake2b_compress_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return &blake2b_compress_sse41;
+    }
+    return &blake2b_compress_ref;
+}
+
+/* NULL makes blake2b_long_x4 run the lanes one after another */
+static blake2b_compress_x4_fn select_compress_x4(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &blake2b_compress_x4_avx2;
+    }
+    return NULL;
+}
+
+#else
+
+static blake2b_compress_fn select_compress(void) {
+    return &blake2b_compress_ref;
+}
+
+static blake2b_compress_x4_fn select_compress_x4(void) { return NULL; }
+
+#endif
+
+/* Kernels for this CPU, chosen on first use */
+#if defined(__GNUC__) || defined(__clang__)
+static blake2b_compress_fn compress_selected = NULL;
+static blake2b_compress_x4_fn compress_x4_selected = NULL;
+static int compress_x4_probed = 0;
+#endif
+
+static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
+#if defined(__GNUC__) || defined(__clang__)
+    blake2b_compress_fn fn =
+        __atomic_load_n(&compress_selected, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = select_compress();
+        __atomic_store_n(&compress_selected, fn, __ATOMIC_RELAXED);
+    }
+    fn(S, block);
+#else
+    select_compress()(S, block);
+#endif
+}
+
+static blake2b_compress_x4_fn blake2b_compress_x4_impl(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    blake2b_compress_x4_fn fn;
+    if (__atomic_load_n(&compress_x4_probed, __ATOMIC_ACQUIRE)) {
+        return __atomic_load_n(&compress_x4_selected, __ATOMIC_RELAXED);
+    }
+    fn = select_compress_x4();
+    __atomic_store_n(&compress_x4_selected, fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&compress_x4_probed, 1, __ATOMIC_RELEASE);
+    return fn;
+#else
+    return select_compress_x4();
+#endif
+}
+
 int blake2b_update(blake2b_state *S, const void *in, size_t inlen) {
     const uint8_t *pin = (const uint8_t *)in;
 
@@ -387,4 +732,225 @@ fail:
     return ret;
 #undef TRY
 }
+
+/*
+ * Four-way H'. Every lane receives updates of the same length, so the four
+ * states always have equal buflen and counters and can share one compress.
+ */
+static void blake2b_update_x4(blake2b_state S[4],
+                              blake2b_compress_x4_fn compress_x4,
+                              const uint8_t *const in[4], size_t inlen) {
+    const uint8_t *blocks[4];
+    size_t offset = 0;
+    unsigned int j;
+
+    if (S[0].buflen + inlen > BLAKE2B_BLOCKBYTES) {
+        size_t left = S[0].buflen;
+        size_t fill = BLAKE2B_BLOCKBYTES - left;
+        for (j = 0; j < 4; ++j) {
+            memcpy(&S[j].buf[left], in[j], fill);
+            blake2b_increment_counter(&S[j], BLAKE2B_BLOCKBYTES);
+            S[j].buflen = 0;
+            blocks[j] = S[j].buf;
+        }
+        compress_x4(S, blocks);
+        offset = fill;
+        inlen -= fill;
+        while (inlen > BLAKE2B_BLOCKBYTES) {
+            for (j = 0; j < 4; ++j) {
+                blake2b_increment_counter(&S[j], BLAKE2B_BLOCKBYTES);
+                blocks[j] = in[j] + offset;
+            }
+            compress_x4(S, blocks);
+            offset += BLAKE2B_BLOCKBYTES;
+            inlen -= BLAKE2B_BLOCKBYTES;
+        }
+    }
+    for (j = 0; j < 4; ++j) {
+        memcpy(&S[j].buf[S[j].buflen], in[j] + offset, inlen);
+        S[j].buflen += (unsigned int)inlen;
+    }
+}
+
+static void blake2b_final_x4(blake2b_state S[4],
+                             blake2b_compress_x4_fn compress_x4,
+                             uint8_t out[4][BLAKE2B_OUTBYTES]) {
+    const uint8_t *blocks[4];
+    unsigned int i, j;
+
+    for (j = 0; j < 4; ++j) {
+        blake2b_increment_counter(&S[j], S[j].buflen);
+        blake2b_set_lastblock(&S[j]);
+        memset(&S[j].buf[S[j].buflen], 0, BLAKE2B_BLOCKBYTES - S[j].buflen);
+        blocks[j] = S[j].buf;
+    }
+    compress_x4(S, blocks);
+    for (j = 0; j < 4; ++j) {
+        for (i = 0; i < 8; ++i) {
+            store64(out[j] + sizeof(S[j].h[i]) * i, S[j].h[i]);
+        }
+    }
+}
+
+static void blake2b_x4(blake2b_state S[4], blake2b_compress_x4_fn compress_x4,
+                       uint8_t out[4][BLAKE2B_OUTBYTES], size_t outlen,
+                       const uint8_t in[4][BLAKE2B_OUTBYTES]) {
+    const uint8_t *pin[4];
+    unsigned int j;
+
+    for (j = 0; j < 4; ++j) {
+        blake2b_init(&S[j], outlen);
+        pin[j] = in[j];
+    }
+    blake2b_update_x4(S, compress_x4, pin, BLAKE2B_OUTBYTES);
+    blake2b_final_x4(S, compress_x4, out);
+}
+
+static void copy_x4(uint8_t *const out[4], size_t offset,
+                    uint8_t src[4][BLAKE2B_OUTBYTES], size_t len) {
+    unsigned int j;
+    for (j = 0; j < 4; ++j) {
+        if (out[j] != NULL) {
+            memcpy(out[j] + offset, src[j], len);
+        }
+    }
+}
+
+int blake2b_long_x4(void *const pout[4], size_t outlen,
+                    const void *const pin[4], size_t inlen) {
+    blake2b_compress_x4_fn compress_x4 = blake2b_compress_x4_impl();
+    blake2b_state S[4];
+    uint8_t *out[4];
+    const uint8_t *in[4];
+    const uint8_t *prefix[4];
+    uint8_t outlen_bytes[sizeof(uint32_t)] = {0};
+    uint8_t out_buffer[4][BLAKE2B_OUTBYTES];
+    uint8_t in_buffer[4][BLAKE2B_OUTBYTES];
+    int first = -1;
+    unsigned int j;
+
+    if (pout == NULL || pin == NULL || outlen == 0 || outlen > UINT32_MAX) {
+        return -1;
+    }
+    for (j = 0; j < 4; ++j) {
+        out[j] = (uint8_t *)pout[j];
+        in[j] = (const uint8_t *)pin[j];
+        if (out[j] == NULL) {
+            continue;
+        }
+        if (in[j] == NULL && inlen > 0) {
+            return -1;
+        }
+        if (first < 0) {
+            first = (int)j;
+        }
+    }
+    if (first < 0) {
+        return 0;
+    }
+
+    if (compress_x4 == NULL) {
+        for (j = 0; j < 4; ++j) {
+            if (out[j] != NULL &&
+                blake2b_long(out[j], outlen, in[j], inlen) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    /* Idle lanes hash a copy of a live one and their output is dropped */
+    for (j = 0; j < 4; ++j) {
+        if (out[j] == NULL) {
+            in[j] = in[first];
+        }
+        prefix[j] = outlen_bytes;
+    }
+
+    store32(outlen_bytes, (uint32_t)outlen);
+
+    for (j = 0; j < 4; ++j) {
+        blake2b_init(&S[j], outlen <= BLAKE2B_OUTBYTES ? outlen
+                                                       : BLAKE2B_OUTBYTES);
+    }
+    blake2b_update_x4(S, compress_x4, prefix, sizeof(outlen_bytes));
+    blake2b_update_x4(S, compress_x4, in, inlen);
+    blake2b_final_x4(S, compress_x4, out_buffer);
+
+    if (outlen <= BLAKE2B_OUTBYTES) {
+        copy_x4(out, 0, out_buffer, outlen);
+    } else {
+        size_t offset = BLAKE2B_OUTBYTES / 2;
+        uint32_t toproduce = (uint32_t)outlen - BLAKE2B_OUTBYTES / 2;
+
+        copy_x4(out, 0, out_buffer, BLAKE2B_OUTBYTES / 2);
+        while (toproduce > BLAKE2B_OUTBYTES) {
+            memcpy(in_buffer, out_buffer, sizeof(in_buffer));
+            blake2b_x4(S, compress_x4, out_buffer, BLAKE2B_OUTBYTES,
+                       (const uint8_t(*)[BLAKE2B_OUTBYTES])in_buffer);
+            copy_x4(out, offset, out_buffer, BLAKE2B_OUTBYTES / 2);
+            offset += BLAKE2B_OUTBYTES / 2;
+            toproduce -= BLAKE2B_OUTBYTES / 2;
+        }
+
+        memcpy(in_buffer, out_buffer, sizeof(in_buffer));
+        blake2b_x4(S, compress_x4, out_buffer, toproduce,
+                   (const uint8_t(*)[BLAKE2B_OUTBYTES])in_buffer);
+        copy_x4(out, offset, out_buffer, toproduce);
+    }
+
+    clear_internal_memory(S, sizeof(S));
+    clear_internal_memory(out_buffer, sizeof(out_buffer));
+    clear_internal_memory(in_buffer, sizeof(in_buffer));
+    return 0;
+}
 /* Argon2 Team - End Code */
+
+static int blake2b_public_result(int ret) {
+    return ret < 0 ? ARGON2_INCORRECT_PARAMETER : ARGON2_OK;
+}
+
+int argon2_blake2b(void *out, size_t outlen, const void *in, size_t inlen,
+                   const void *key, size_t keylen) {
+    if (out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (outlen == 0) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (outlen > BLAKE2B_OUTBYTES) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    if (keylen > BLAKE2B_KEYBYTES) {
+        return ARGON2_SECRET_TOO_LONG;
+    }
+    return blake2b_public_result(blake2b(out, outlen, in, inlen, key, keylen));
+}
+
+int argon2_blake2b_long(void *out, size_t outlen, const void *in,
+                        size_t inlen) {
+    if (out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (outlen == 0) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (outlen > UINT32_MAX) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    return blake2b_public_result(blake2b_long(out, outlen, in, inlen));
+}
+
+int argon2_blake2b_long_x4(void *const out[4], size_t outlen,
+                           const void *const in[4], size_t inlen) {
+    if (out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (outlen == 0) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (outlen > UINT32_MAX) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    return blake2b_public_result(blake2b_long_x4(out, outlen, in, inlen));
+}
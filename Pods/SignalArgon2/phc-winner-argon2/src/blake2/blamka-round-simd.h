@@ -0,0 +1,272 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : http://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef BLAKE_ROUND_MKA_SIMD_H
+#define BLAKE_ROUND_MKA_SIMD_H
+
+#include "blake2.h"
+#include "blake2-impl.h"
+
+/*
+ * Vectorized BlaMka rounds for fill_block. The sixteen words v0..v15 of a
+ * round are held as four rows A = (v0..v3), B = (v4..v7), C = (v8..v11) and
+ * D = (v12..v15), so one G step works on all four columns at once and the
+ * diagonal step is a lane rotation of B, C and D.
+ *
+ * x86 kernels are compiled with target attributes and picked at run time, so
+ * the file builds without any -m flags. NEON is part of the arm64 baseline and
+ * is used unconditionally there. Define ARGON2_NO_SIMD to build only the
+ * portable code.
+ */
+
+#if !defined(ARGON2_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) &&  \
+    (defined(__x86_64__) || defined(__i386__))
+#define ARGON2_SIMD_X86 1
+#elif !defined(ARGON2_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define ARGON2_SIMD_NEON 1
+#endif
+
+#if defined(ARGON2_SIMD_X86)
+
+#include <immintrin.h>
+
+#define ARGON2_TARGET(isa) __attribute__((target(isa)))
+
+/* SSSE3: two 128-bit halves per row */
+
+#define ARGON2_SSSE3 ARGON2_TARGET("ssse3")
+
+static BLAKE2_INLINE ARGON2_SSSE3 __m128i fBlaMka_ssse3(__m128i x, __m128i y) {
+    const __m128i z = _mm_mul_epu32(x, y);
+    return _mm_add_epi64(_mm_add_epi64(x, y), _mm_add_epi64(z, z));
+}
+
+#define rotr32_ssse3(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_ssse3(x)                                                        \
+    _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14,  \
+                                      15, 8, 9, 10))
+#define rotr16_ssse3(x)                                                        \
+    _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13,  \
+                                      14, 15, 8, 9))
+#define rotr63_ssse3(x) _mm_xor_si128(_mm_srli_epi64((x), 63), _mm_add_epi64((x), (x)))
+
+#define G_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1, rd, rb)                        \
+    do {                                                                       \
+        A0 = fBlaMka_ssse3(A0, B0);                                            \
+        A1 = fBlaMka_ssse3(A1, B1);                                            \
+        D0 = rd(_mm_xor_si128(D0, A0));                                        \
+        D1 = rd(_mm_xor_si128(D1, A1));                                        \
+        C0 = fBlaMka_ssse3(C0, D0);                                            \
+        C1 = fBlaMka_ssse3(C1, D1);                                            \
+        B0 = rb(_mm_xor_si128(B0, C0));                                        \
+        B1 = rb(_mm_xor_si128(B1, C1));                                        \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1)                              \
+    do {                                                                       \
+        __m128i t0 = _mm_alignr_epi8(B1, B0, 8);                               \
+        __m128i t1 = _mm_alignr_epi8(B0, B1, 8);                               \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm_alignr_epi8(D0, D1, 8);                                       \
+        t1 = _mm_alignr_epi8(D1, D0, 8);                                       \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1)                            \
+    do {                                                                       \
+        __m128i t0 = _mm_alignr_epi8(B0, B1, 8);                               \
+        __m128i t1 = _mm_alignr_epi8(B1, B0, 8);                               \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm_alignr_epi8(D1, D0, 8);                                       \
+        t1 = _mm_alignr_epi8(D0, D1, 8);                                       \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1)                     \
+    do {                                                                       \
+        G_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1, rotr32_ssse3, rotr24_ssse3);   \
+        G_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1, rotr16_ssse3, rotr63_ssse3);   \
+        DIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1);                             \
+        G_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1, rotr32_ssse3, rotr24_ssse3);   \
+        G_SSSE3(A0, A1, B0, B1, C0, C1, D0, D1, rotr16_ssse3, rotr63_ssse3);   \
+        UNDIAGONALIZE_SSSE3(B0, B1, C0, C1, D0, D1);                           \
+    } while ((void)0, 0)
+
+/* AVX2: one 256-bit register per row */
+
+#define ARGON2_AVX2 ARGON2_TARGET("avx2")
+
+static BLAKE2_INLINE ARGON2_AVX2 __m256i fBlaMka_avx2(__m256i x, __m256i y) {
+    const __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+#define rotr32_avx2(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_avx2(x)                                                         \
+    _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12,   \
+                                            13, 14, 15, 8, 9, 10, 3, 4, 5, 6, \
+                                            7, 0, 1, 2, 11, 12, 13, 14, 15, 8, \
+                                            9, 10))
+#define rotr16_avx2(x)                                                         \
+    _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11,   \
+                                            12, 13, 14, 15, 8, 9, 2, 3, 4, 5, \
+                                            6, 7, 0, 1, 10, 11, 12, 13, 14,   \
+                                            15, 8, 9))
+#define rotr63_avx2(x)                                                         \
+    _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define G_AVX2(A, B, C, D, rd, rb)                                             \
+    do {                                                                       \
+        A = fBlaMka_avx2(A, B);                                                \
+        D = rd(_mm256_xor_si256(D, A));                                        \
+        C = fBlaMka_avx2(C, D);                                                \
+        B = rb(_mm256_xor_si256(B, C));                                        \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_AVX2(A, B, C, D)                                          \
+    do {                                                                       \
+        G_AVX2(A, B, C, D, rotr32_avx2, rotr24_avx2);                          \
+        G_AVX2(A, B, C, D, rotr16_avx2, rotr63_avx2);                          \
+        B = _mm256_permute4x64_epi64(B, _MM_SHUFFLE(0, 3, 2, 1));              \
+        C = _mm256_permute4x64_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));              \
+        D = _mm256_permute4x64_epi64(D, _MM_SHUFFLE(2, 1, 0, 3));              \
+        G_AVX2(A, B, C, D, rotr32_avx2, rotr24_avx2);                          \
+        G_AVX2(A, B, C, D, rotr16_avx2, rotr63_avx2);                          \
+        B = _mm256_permute4x64_epi64(B, _MM_SHUFFLE(2, 1, 0, 3));              \
+        C = _mm256_permute4x64_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));              \
+        D = _mm256_permute4x64_epi64(D, _MM_SHUFFLE(0, 3, 2, 1));              \
+    } while ((void)0, 0)
+
+/* AVX-512F: two independent rounds per register, one in each 256-bit half */
+
+#define ARGON2_AVX512F ARGON2_TARGET("avx512f")
+
+static BLAKE2_INLINE ARGON2_AVX512F __m512i fBlaMka_avx512f(__m512i x,
+                                                            __m512i y) {
+    const __m512i z = _mm512_mul_epu32(x, y);
+    return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(z, z));
+}
+
+#define G_AVX512F(A, B, C, D, nd, nb)                                          \
+    do {                                                                       \
+        A = fBlaMka_avx512f(A, B);                                             \
+        D = _mm512_ror_epi64(_mm512_xor_si512(D, A), nd);                      \
+        C = fBlaMka_avx512f(C, D);                                             \
+        B = _mm512_ror_epi64(_mm512_xor_si512(B, C), nb);                      \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_AVX512F(A, B, C, D)                                       \
+    do {                                                                       \
+        G_AVX512F(A, B, C, D, 32, 24);                                         \
+        G_AVX512F(A, B, C, D, 16, 63);                                         \
+        B = _mm512_permutex_epi64(B, _MM_SHUFFLE(0, 3, 2, 1));                 \
+        C = _mm512_permutex_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));                 \
+        D = _mm512_permutex_epi64(D, _MM_SHUFFLE(2, 1, 0, 3));                 \
+        G_AVX512F(A, B, C, D, 32, 24);                                         \
+        G_AVX512F(A, B, C, D, 16, 63);                                         \
+        B = _mm512_permutex_epi64(B, _MM_SHUFFLE(2, 1, 0, 3));                 \
+        C = _mm512_permutex_epi64(C, _MM_SHUFFLE(1, 0, 3, 2));                 \
+        D = _mm512_permutex_epi64(D, _MM_SHUFFLE(0, 3, 2, 1));                 \
+    } while ((void)0, 0)
+
+#elif defined(ARGON2_SIMD_NEON)
+
+#include <arm_neon.h>
+
+/* NEON: two 128-bit halves per row, laid out like the SSSE3 kernel */
+
+static BLAKE2_INLINE uint64x2_t fBlaMka_neon(uint64x2_t x, uint64x2_t y) {
+    const uint64x2_t z = vmull_u32(vmovn_u64(x), vmovn_u64(y));
+    return vaddq_u64(vaddq_u64(x, y), vaddq_u64(z, z));
+}
+
+#define rotr32_neon(x)                                                         \
+    vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(x)))
+#define rotr24_neon(x) vsriq_n_u64(vshlq_n_u64((x), 40), (x), 24)
+#define rotr16_neon(x) vsriq_n_u64(vshlq_n_u64((x), 48), (x), 16)
+#define rotr63_neon(x) vsriq_n_u64(vshlq_n_u64((x), 1), (x), 63)
+
+#define G_NEON(A0, A1, B0, B1, C0, C1, D0, D1, rd, rb)                         \
+    do {                                                                       \
+        A0 = fBlaMka_neon(A0, B0);                                             \
+        A1 = fBlaMka_neon(A1, B1);                                             \
+        D0 = veorq_u64(D0, A0);                                                \
+        D1 = veorq_u64(D1, A1);                                                \
+        D0 = rd(D0);                                                           \
+        D1 = rd(D1);                                                           \
+        C0 = fBlaMka_neon(C0, D0);                                             \
+        C1 = fBlaMka_neon(C1, D1);                                             \
+        B0 = veorq_u64(B0, C0);                                                \
+        B1 = veorq_u64(B1, C1);                                                \
+        B0 = rb(B0);                                                           \
+        B1 = rb(B1);                                                           \
+    } while ((void)0, 0)
+
+/* vextq_u64(a, b, 1) is (a[1], b[0]) */
+#define DIAGONALIZE_NEON(B0, B1, C0, C1, D0, D1)                               \
+    do {                                                                       \
+        uint64x2_t t0 = vextq_u64(B0, B1, 1);                                  \
+        uint64x2_t t1 = vextq_u64(B1, B0, 1);                                  \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = vextq_u64(D1, D0, 1);                                             \
+        t1 = vextq_u64(D0, D1, 1);                                             \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_NEON(B0, B1, C0, C1, D0, D1)                             \
+    do {                                                                       \
+        uint64x2_t t0 = vextq_u64(B1, B0, 1);                                  \
+        uint64x2_t t1 = vextq_u64(B0, B1, 1);                                  \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = vextq_u64(D0, D1, 1);                                             \
+        t1 = vextq_u64(D1, D0, 1);                                             \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_NEON(A0, A1, B0, B1, C0, C1, D0, D1)                      \
+    do {                                                                       \
+        G_NEON(A0, A1, B0, B1, C0, C1, D0, D1, rotr32_neon, rotr24_neon);      \
+        G_NEON(A0, A1, B0, B1, C0, C1, D0, D1, rotr16_neon, rotr63_neon);      \
+        DIAGONALIZE_NEON(B0, B1, C0, C1, D0, D1);                              \
+        G_NEON(A0, A1, B0, B1, C0, C1, D0, D1, rotr32_neon, rotr24_neon);      \
+        G_NEON(A0, A1, B0, B1, C0, C1, D0, D1, rotr16_neon, rotr63_neon);      \
+        UNDIAGONALIZE_NEON(B0, B1, C0, C1, D0, D1);                            \
+    } while ((void)0, 0)
+
+#endif
+
+#endif
@@ -32,6 +32,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32) && !defined(ARGON2_NO_MMAP)
+#include <sys/mman.h>
+#include <unistd.h>
+#define ARGON2_HAVE_MMAP 1
+#endif
+
 #include "core.h"
 #include "thread.h"
 #include "blake2/blake2.h"
@@ -86,6 +92,237 @@ static void store_block(void *output, const block *src) {
 
 /***************Memory functions*****************/
 
+#define ARGON2_MAPPED_FLAGS                                                    \
+    (ARGON2_FLAG_MAPPED_MEMORY | ARGON2_FLAG_HUGE_PAGES |                      \
+     ARGON2_FLAG_PREFAULT_MEMORY)
+
+#if defined(ARGON2_HAVE_MMAP)
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Granule of huge-page mappings; 2 MiB on x86-64 and arm64 */
+#define ARGON2_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* Number of released regions kept mapped for the next hash */
+#define ARGON2_MEMORY_CACHE_SLOTS 4
+
+typedef struct Argon2_mapped_region {
+    void *ptr;
+    size_t length;
+    uint32_t huge; /* ARGON2_FLAG_HUGE_PAGES if mapped for huge pages */
+} argon2_mapped_region;
+
+static argon2_mapped_region memory_cache[ARGON2_MEMORY_CACHE_SLOTS];
+static argon2_memory_stats memory_stats;
+
+#if !defined(ARGON2_NO_THREADS)
+static pthread_mutex_t memory_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define MEMORY_CACHE_LOCK() pthread_mutex_lock(&memory_cache_lock)
+#define MEMORY_CACHE_UNLOCK() pthread_mutex_unlock(&memory_cache_lock)
+#else
+#define MEMORY_CACHE_LOCK() do { } while (0)
+#define MEMORY_CACHE_UNLOCK() do { } while (0)
+#endif
+
+static size_t page_size(void) {
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+}
+
+/* Length of the mapping backing @size bytes; a function of the size and flags
+ * only, so that it can be recomputed when the region is released */
+static size_t mapped_length(size_t size, uint32_t flags) {
+    size_t granule =
+        (flags & ARGON2_FLAG_HUGE_PAGES) ? ARGON2_HUGE_PAGE_SIZE : page_size();
+    if (size > SIZE_MAX - (granule - 1)) {
+        return 0;
+    }
+    return (size + granule - 1) & ~(granule - 1);
+}
+
+static void prefault_region(uint8_t *ptr, size_t length) {
+#if defined(MADV_POPULATE_WRITE)
+    if (madvise(ptr, length, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    {
+        size_t step = page_size(), offset;
+        for (offset = 0; offset < length; offset += step) {
+            ((volatile uint8_t *)ptr)[offset] = 0;
+        }
+    }
+}
+
+/* Called without memory_cache_lock held; *hugetlb is set to 1 if the region
+ * came from the explicit huge-page pool */
+static void *map_region(size_t length, uint32_t flags, int *hugetlb) {
+    int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    uint8_t *ptr;
+
+    *hugetlb = 0;
+
+#if defined(MAP_HUGETLB)
+    if (flags & ARGON2_FLAG_HUGE_PAGES) {
+        int huge_flags = mmap_flags | MAP_HUGETLB;
+#if defined(MAP_POPULATE)
+        if (flags & ARGON2_FLAG_PREFAULT_MEMORY) {
+            huge_flags |= MAP_POPULATE;
+        }
+#endif
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, huge_flags, -1, 0);
+        if (ptr != MAP_FAILED) {
+            *hugetlb = 1;
+            return ptr;
+        }
+    }
+#endif
+
+    if (flags & ARGON2_FLAG_HUGE_PAGES) {
+        /* Transparent huge pages need 2 MiB alignment: over-map and trim */
+        size_t head;
+        ptr = mmap(NULL, length + ARGON2_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   mmap_flags, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+        head = (ARGON2_HUGE_PAGE_SIZE -
+                ((uintptr_t)ptr & (ARGON2_HUGE_PAGE_SIZE - 1))) &
+               (ARGON2_HUGE_PAGE_SIZE - 1);
+        if (head != 0) {
+            munmap(ptr, head);
+        }
+        munmap(ptr + head + length, ARGON2_HUGE_PAGE_SIZE - head);
+        ptr += head;
+#if defined(MADV_HUGEPAGE)
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+        if (flags & ARGON2_FLAG_PREFAULT_MEMORY) {
+            prefault_region(ptr, length);
+        }
+        return ptr;
+    }
+
+#if defined(MAP_POPULATE)
+    if (flags & ARGON2_FLAG_PREFAULT_MEMORY) {
+        mmap_flags |= MAP_POPULATE;
+    }
+#endif
+    ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+#if !defined(MAP_POPULATE)
+    if (flags & ARGON2_FLAG_PREFAULT_MEMORY) {
+        prefault_region(ptr, length);
+    }
+#endif
+    return ptr;
+}
+
+static uint8_t *allocate_mapped(size_t size, uint32_t flags) {
+    size_t length = mapped_length(size, flags);
+    uint32_t huge = flags & ARGON2_FLAG_HUGE_PAGES;
+    uint8_t *ptr = NULL;
+    int hugetlb;
+    unsigned i;
+
+    if (length == 0) {
+        return NULL;
+    }
+
+    /* Only the slot lookup runs under the lock; a miss maps (and possibly
+       prefaults) the region after releasing it */
+    MEMORY_CACHE_LOCK();
+    for (i = 0; i < ARGON2_MEMORY_CACHE_SLOTS; ++i) {
+        if (memory_cache[i].ptr != NULL && memory_cache[i].length == length &&
+            memory_cache[i].huge == huge) {
+            ptr = memory_cache[i].ptr;
+            memory_cache[i].ptr = NULL;
+            memory_stats.cache_hits++;
+            memory_stats.faults_avoided += length / page_size();
+            memory_stats.cached_bytes -= length;
+            break;
+        }
+    }
+    MEMORY_CACHE_UNLOCK();
+
+    if (ptr == NULL) {
+        ptr = map_region(length, flags, &hugetlb);
+        if (ptr != NULL) {
+            MEMORY_CACHE_LOCK();
+            memory_stats.maps++;
+            memory_stats.huge_maps += hugetlb;
+            MEMORY_CACHE_UNLOCK();
+        }
+    }
+
+    return ptr;
+}
+
+static void free_mapped(uint8_t *memory, size_t size, uint32_t flags) {
+    size_t length = mapped_length(size, flags);
+    unsigned i;
+
+    /* Cached regions are always wiped, whatever FLAG_clear_internal_memory
+       says, so a reused region never holds another hash's blocks */
+    secure_wipe_memory(memory, size);
+
+    MEMORY_CACHE_LOCK();
+    for (i = 0; i < ARGON2_MEMORY_CACHE_SLOTS; ++i) {
+        if (memory_cache[i].ptr == NULL) {
+            memory_cache[i].ptr = memory;
+            memory_cache[i].length = length;
+            memory_cache[i].huge = flags & ARGON2_FLAG_HUGE_PAGES;
+            memory_stats.cached_bytes += length;
+            memory = NULL;
+            break;
+        }
+    }
+    MEMORY_CACHE_UNLOCK();
+
+    if (memory != NULL) {
+        munmap(memory, length);
+    }
+}
+
+void argon2_memory_stats_get(argon2_memory_stats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    MEMORY_CACHE_LOCK();
+    *stats = memory_stats;
+    MEMORY_CACHE_UNLOCK();
+}
+
+void argon2_memory_cache_trim(void) {
+    unsigned i;
+
+    MEMORY_CACHE_LOCK();
+    for (i = 0; i < ARGON2_MEMORY_CACHE_SLOTS; ++i) {
+        if (memory_cache[i].ptr != NULL) {
+            munmap(memory_cache[i].ptr, memory_cache[i].length);
+            memory_stats.cached_bytes -= memory_cache[i].length;
+            memory_cache[i].ptr = NULL;
+        }
+    }
+    MEMORY_CACHE_UNLOCK();
+}
+
+#else /* ARGON2_HAVE_MMAP */
+
+void argon2_memory_stats_get(argon2_memory_stats *stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+void argon2_memory_cache_trim(void) {}
+
+#endif /* ARGON2_HAVE_MMAP */
+
 int allocate_memory(const argon2_context *context, uint8_t **memory,
                     size_t num, size_t size) {
     size_t memory_size = num*size;
@@ -101,6 +338,10 @@ int allocate_memory(const argon2_context *context, uint8_t **memory,
     /* 2. Try to allocate with appropriate allocator */
     if (context->allocate_cbk) {
         (context->allocate_cbk)(memory, memory_size);
+#if defined(ARGON2_HAVE_MMAP)
+    } else if (context->flags & ARGON2_MAPPED_FLAGS) {
+        *memory = allocate_mapped(memory_size, context->flags);
+#endif
     } else {
         *memory = malloc(memory_size);
     }
@@ -115,6 +356,12 @@ int allocate_memory(const argon2_context *context, uint8_t **memory,
 void free_memory(const argon2_context *context, uint8_t *memory,
                  size_t num, size_t size) {
     size_t memory_size = num*size;
+#if defined(ARGON2_HAVE_MMAP)
+    if (!context->free_cbk && (context->flags & ARGON2_MAPPED_FLAGS)) {
+        free_mapped(memory, memory_size, context->flags);
+        return;
+    }
+#endif
     clear_internal_memory(memory, memory_size);
     if (context->free_cbk) {
         (context->free_cbk)(memory, memory_size);
@@ -153,6 +400,15 @@ void clear_internal_memory(void *v, size_t n) {
 }
 
 void finalize(const argon2_context *context, argon2_instance_t *instance) {
+    if (context != NULL && instance != NULL) {
+        finalize_tag(context, instance);
+        free_memory(context, (uint8_t *)instance->memory,
+                    instance->memory_blocks, sizeof(block));
+    }
+}
+
+void finalize_tag(const argon2_context *context,
+                  const argon2_instance_t *instance) {
     if (context != NULL && instance != NULL) {
         block blockhash;
         uint32_t l;
@@ -180,9 +436,6 @@ void finalize(const argon2_context *context, argon2_instance_t *instance) {
 #ifdef GENKAT
         print_tag(context->out, context->outlen);
 #endif
-
-        free_memory(context, (uint8_t *)instance->memory,
-                    instance->memory_blocks, sizeof(block));
     }
 }
 
@@ -371,6 +624,44 @@ fail:
     return rc;
 }
 
+/* Slice of one pass handed to the pool, one job index per lane */
+typedef struct Argon2_slice_job {
+    const argon2_instance_t *instance;
+    uint32_t pass;
+    uint8_t slice;
+} argon2_slice_job;
+
+static void fill_segment_job(void *arg, uint32_t lane) {
+    const argon2_slice_job *job = arg;
+    argon2_position_t position = {job->pass, lane, job->slice, 0};
+    fill_segment(job->instance, position);
+}
+
+/* Multi-threaded version running lanes on a persistent argon2_pool */
+static int fill_memory_blocks_pool(argon2_instance_t *instance,
+                                   argon2_pool *pool) {
+    argon2_slice_job job;
+    uint32_t r, s;
+
+    job.instance = instance;
+    for (r = 0; r < instance->passes; ++r) {
+        for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+            job.pass = r;
+            job.slice = (uint8_t)s;
+            /* Returns once every lane of the slice is filled */
+            if (argon2_pool_run(pool, instance->threads, &fill_segment_job,
+                                &job, instance->lanes)) {
+                return ARGON2_THREAD_FAIL;
+            }
+        }
+
+#ifdef GENKAT
+        internal_kat(instance, r); /* Print all memory blocks */
+#endif
+    }
+    return ARGON2_OK;
+}
+
 #endif /* ARGON2_NO_THREADS */
 
 int fill_memory_blocks(argon2_instance_t *instance) {
@@ -380,8 +671,13 @@ int fill_memory_blocks(argon2_instance_t *instance) {
 #if defined(ARGON2_NO_THREADS)
     return fill_memory_blocks_st(instance);
 #else
-    return instance->threads == 1 ?
-			fill_memory_blocks_st(instance) : fill_memory_blocks_mt(instance);
+    if (instance->threads == 1) {
+        return fill_memory_blocks_st(instance);
+    }
+    if (instance->context_ptr != NULL && instance->context_ptr->pool != NULL) {
+        return fill_memory_blocks_pool(instance, instance->context_ptr->pool);
+    }
+    return fill_memory_blocks_mt(instance);
 #endif
 }
 
@@ -513,26 +809,31 @@ int validate_inputs(const argon2_context *context) {
 }
 
 void fill_first_blocks(uint8_t *blockhash, const argon2_instance_t *instance) {
-    uint32_t l;
+    uint32_t l, j;
     /* Make the first and second block in each lane as G(H0||0||i) or
-       G(H0||1||i) */
-    uint8_t blockhash_bytes[ARGON2_BLOCK_SIZE];
-    for (l = 0; l < instance->lanes; ++l) {
-
-        store32(blockhash + ARGON2_PREHASH_DIGEST_LENGTH, 0);
-        store32(blockhash + ARGON2_PREHASH_DIGEST_LENGTH + 4, l);
-        blake2b_long(blockhash_bytes, ARGON2_BLOCK_SIZE, blockhash,
-                     ARGON2_PREHASH_SEED_LENGTH);
-        load_block(&instance->memory[l * instance->lane_length + 0],
-                   blockhash_bytes);
-
-        store32(blockhash + ARGON2_PREHASH_DIGEST_LENGTH, 1);
-        blake2b_long(blockhash_bytes, ARGON2_BLOCK_SIZE, blockhash,
-                     ARGON2_PREHASH_SEED_LENGTH);
-        load_block(&instance->memory[l * instance->lane_length + 1],
-                   blockhash_bytes);
-    }
-    clear_internal_memory(blockhash_bytes, ARGON2_BLOCK_SIZE);
+       G(H0||1||i), four blocks (two lanes) per multi-buffer H' call */
+    uint8_t seeds[4][ARGON2_PREHASH_SEED_LENGTH];
+    uint8_t blockhash_bytes[4][ARGON2_BLOCK_SIZE];
+    void *out[4];
+    const void *in[4];
+    for (l = 0; l < instance->lanes; l += 2) {
+        for (j = 0; j < 4; ++j) {
+            const uint32_t lane = l + j / 2;
+            memcpy(seeds[j], blockhash, ARGON2_PREHASH_DIGEST_LENGTH);
+            store32(seeds[j] + ARGON2_PREHASH_DIGEST_LENGTH, j % 2);
+            store32(seeds[j] + ARGON2_PREHASH_DIGEST_LENGTH + 4, lane);
+            out[j] = lane < instance->lanes ? blockhash_bytes[j] : NULL;
+            in[j] = seeds[j];
+        }
+        blake2b_long_x4(out, ARGON2_BLOCK_SIZE, in, ARGON2_PREHASH_SEED_LENGTH);
+        for (j = 0; j < 4 && out[j] != NULL; ++j) {
+            load_block(&instance->memory[(l + j / 2) * instance->lane_length +
+                                         j % 2],
+                       blockhash_bytes[j]);
+        }
+    }
+    clear_internal_memory(seeds, sizeof(seeds));
+    clear_internal_memory(blockhash_bytes, sizeof(blockhash_bytes));
 }
 
 void initial_hash(uint8_t *blockhash, argon2_context *context,
@@ -610,12 +911,10 @@ void initial_hash(uint8_t *blockhash, argon2_context *context,
 }
 
 int initialize(argon2_instance_t *instance, argon2_context *context) {
-    uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
     int result = ARGON2_OK;
 
     if (instance == NULL || context == NULL)
         return ARGON2_INCORRECT_PARAMETER;
-    instance->context_ptr = context;
 
     /* 1. Memory allocation */
     result = allocate_memory(context, (uint8_t **)&(instance->memory),
@@ -624,6 +923,17 @@ int initialize(argon2_instance_t *instance, argon2_context *context) {
         return result;
     }
 
+    initialize_blocks(instance, context);
+    return ARGON2_OK;
+}
+
+void initialize_blocks(argon2_instance_t *instance, argon2_context *context) {
+    uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
+
+    if (instance == NULL || context == NULL)
+        return;
+    instance->context_ptr = context;
+
     /* 2. Initial hashing */
     /* H_0 + 8 extra bytes to produce the first blocks */
     /* uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH]; */
@@ -643,6 +953,4 @@ int initialize(argon2_instance_t *instance, argon2_context *context) {
     fill_first_blocks(blockhash, instance);
     /* Clearing the hash */
     clear_internal_memory(blockhash, ARGON2_PREHASH_SEED_LENGTH);
-
-    return ARGON2_OK;
 }
@@ -193,6 +193,16 @@ void fill_first_blocks(uint8_t *blockhash, const argon2_instance_t *instance);
  */
 int initialize(argon2_instance_t *instance, argon2_context *context);
 
+/*
+ * Same as initialize, for an instance whose memory is already set: hashes the
+ * inputs and creates the first two blocks of every lane
+ * @param  context  Pointer to the Argon2 internal structure containing memory
+ * pointer, and parameters for time and space requirements.
+ * @param  instance Current Argon2 instance
+ * @pre instance->memory must point to instance->memory_blocks blocks
+ */
+void initialize_blocks(argon2_instance_t *instance, argon2_context *context);
+
 /*
  * XORing the last block of each lane, hashing it, making the tag. Deallocates
  * the memory.
@@ -206,6 +216,17 @@ int initialize(argon2_instance_t *instance, argon2_context *context);
  */
 void finalize(const argon2_context *context, argon2_instance_t *instance);
 
+/*
+ * XORing the last block of each lane, hashing it, making the tag. Unlike
+ * finalize, leaves the memory allocated.
+ * @param context Pointer to current Argon2 context (use only the out parameters
+ * from it)
+ * @param instance Pointer to current instance of Argon2
+ * @pre context->out must point to outlen bytes of memory
+ */
+void finalize_tag(const argon2_context *context,
+                  const argon2_instance_t *instance);
+
 /*
  * Function that fills the segment using previous segments also from other
  * threads
@@ -23,6 +23,7 @@
 #include "core.h"
 
 #include "blake2/blamka-round-ref.h"
+#include "blake2/blamka-round-simd.h"
 #include "blake2/blake2-impl.h"
 #include "blake2/blake2.h"
 
@@ -80,11 +81,246 @@ static void fill_block(const block *prev_block, const block *ref_block,
     xor_block(next_block, &blockR);
 }
 
-static void next_addresses(block *address_block, block *input_block,
-                           const block *zero_block) {
+typedef void (*fill_block_fn)(const block *prev_block, const block *ref_block,
+                              block *next_block, int with_xor);
+
+#if defined(ARGON2_SIMD_X86)
+
+/*
+ * The vector kernels below compute the same function as fill_block. The
+ * block is loaded as an array of registers; a column round covers 16
+ * consecutive words and a row round the word pairs (2i, 2i+1) of all eight
+ * 16-word rows.
+ */
+static ARGON2_SSSE3 void fill_block_ssse3(const block *prev_block,
+                                          const block *ref_block,
+                                          block *next_block, int with_xor) {
+    __m128i state[ARGON2_OWORDS_IN_BLOCK], block_tmp[ARGON2_OWORDS_IN_BLOCK];
+    const __m128i *prev = (const __m128i *)prev_block->v;
+    const __m128i *ref = (const __m128i *)ref_block->v;
+    __m128i *next = (__m128i *)next_block->v;
+    unsigned i;
+
+    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; ++i) {
+        state[i] = _mm_xor_si128(_mm_loadu_si128(ref + i),
+                                 _mm_loadu_si128(prev + i));
+        block_tmp[i] = with_xor
+                           ? _mm_xor_si128(state[i], _mm_loadu_si128(next + i))
+                           : state[i];
+    }
+
+    for (i = 0; i < 8; ++i) {
+        BLAKE2_ROUND_SSSE3(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2],
+                           state[8 * i + 3], state[8 * i + 4], state[8 * i + 5],
+                           state[8 * i + 6], state[8 * i + 7]);
+    }
+
+    for (i = 0; i < 8; ++i) {
+        BLAKE2_ROUND_SSSE3(state[i + 0], state[i + 8], state[i + 16],
+                           state[i + 24], state[i + 32], state[i + 40],
+                           state[i + 48], state[i + 56]);
+    }
+
+    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; ++i) {
+        _mm_storeu_si128(next + i, _mm_xor_si128(state[i], block_tmp[i]));
+    }
+}
+
+static ARGON2_AVX2 void fill_block_avx2(const block *prev_block,
+                                        const block *ref_block,
+                                        block *next_block, int with_xor) {
+    __m256i state[ARGON2_HWORDS_IN_BLOCK], block_tmp[ARGON2_HWORDS_IN_BLOCK];
+    const __m256i *prev = (const __m256i *)prev_block->v;
+    const __m256i *ref = (const __m256i *)ref_block->v;
+    __m256i *next = (__m256i *)next_block->v;
+    unsigned i;
+
+    for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; ++i) {
+        state[i] = _mm256_xor_si256(_mm256_loadu_si256(ref + i),
+                                    _mm256_loadu_si256(prev + i));
+        block_tmp[i] =
+            with_xor ? _mm256_xor_si256(state[i], _mm256_loadu_si256(next + i))
+                     : state[i];
+    }
+
+    for (i = 0; i < 8; ++i) {
+        BLAKE2_ROUND_AVX2(state[4 * i + 0], state[4 * i + 1], state[4 * i + 2],
+                          state[4 * i + 3]);
+    }
+
+    /* Row rounds 2i and 2i+1 share registers: the low and high 128 bits of
+       state[i + 4k] hold their word pairs from row 2k */
+    for (i = 0; i < 4; ++i) {
+        __m256i A0 = _mm256_permute2x128_si256(state[i], state[i + 4], 0x20);
+        __m256i A1 = _mm256_permute2x128_si256(state[i], state[i + 4], 0x31);
+        __m256i B0 = _mm256_permute2x128_si256(state[i + 8], state[i + 12], 0x20);
+        __m256i B1 = _mm256_permute2x128_si256(state[i + 8], state[i + 12], 0x31);
+        __m256i C0 = _mm256_permute2x128_si256(state[i + 16], state[i + 20], 0x20);
+        __m256i C1 = _mm256_permute2x128_si256(state[i + 16], state[i + 20], 0x31);
+        __m256i D0 = _mm256_permute2x128_si256(state[i + 24], state[i + 28], 0x20);
+        __m256i D1 = _mm256_permute2x128_si256(state[i + 24], state[i + 28], 0x31);
+
+        BLAKE2_ROUND_AVX2(A0, B0, C0, D0);
+        BLAKE2_ROUND_AVX2(A1, B1, C1, D1);
+
+        state[i] = _mm256_permute2x128_si256(A0, A1, 0x20);
+        state[i + 4] = _mm256_permute2x128_si256(A0, A1, 0x31);
+        state[i + 8] = _mm256_permute2x128_si256(B0, B1, 0x20);
+        state[i + 12] = _mm256_permute2x128_si256(B0, B1, 0x31);
+        state[i + 16] = _mm256_permute2x128_si256(C0, C1, 0x20);
+        state[i + 20] = _mm256_permute2x128_si256(C0, C1, 0x31);
+        state[i + 24] = _mm256_permute2x128_si256(D0, D1, 0x20);
+        state[i + 28] = _mm256_permute2x128_si256(D0, D1, 0x31);
+    }
+
+    for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; ++i) {
+        _mm256_storeu_si256(next + i, _mm256_xor_si256(state[i], block_tmp[i]));
+    }
+}
+
+/* 4x4 transpose of the 128-bit lanes of four registers */
+#define TRANSPOSE_LANES_AVX512F(X0, X1, X2, X3)                                \
+    do {                                                                       \
+        __m512i t0 = _mm512_shuffle_i64x2(X0, X1, _MM_SHUFFLE(2, 0, 2, 0));    \
+        __m512i t1 = _mm512_shuffle_i64x2(X0, X1, _MM_SHUFFLE(3, 1, 3, 1));    \
+        __m512i t2 = _mm512_shuffle_i64x2(X2, X3, _MM_SHUFFLE(2, 0, 2, 0));    \
+        __m512i t3 = _mm512_shuffle_i64x2(X2, X3, _MM_SHUFFLE(3, 1, 3, 1));    \
+        X0 = _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(2, 0, 2, 0));            \
+        X1 = _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(2, 0, 2, 0));            \
+        X2 = _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(3, 1, 3, 1));            \
+        X3 = _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(3, 1, 3, 1));            \
+    } while ((void)0, 0)
+
+static ARGON2_AVX512F void fill_block_avx512f(const block *prev_block,
+                                              const block *ref_block,
+                                              block *next_block, int with_xor) {
+    __m512i state[ARGON2_512BIT_WORDS_IN_BLOCK];
+    __m512i block_tmp[ARGON2_512BIT_WORDS_IN_BLOCK];
+    const __m512i *prev = (const __m512i *)prev_block->v;
+    const __m512i *ref = (const __m512i *)ref_block->v;
+    __m512i *next = (__m512i *)next_block->v;
+    unsigned i;
+
+    for (i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; ++i) {
+        state[i] = _mm512_xor_si512(_mm512_loadu_si512(ref + i),
+                                    _mm512_loadu_si512(prev + i));
+        block_tmp[i] =
+            with_xor ? _mm512_xor_si512(state[i], _mm512_loadu_si512(next + i))
+                     : state[i];
+    }
+
+    /* Column rounds i and i+1: each row takes one 256-bit half from each */
+    for (i = 0; i < 8; i += 2) {
+        __m512i *s = &state[2 * i];
+        __m512i A = _mm512_shuffle_i64x2(s[0], s[2], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i B = _mm512_shuffle_i64x2(s[0], s[2], _MM_SHUFFLE(3, 2, 3, 2));
+        __m512i C = _mm512_shuffle_i64x2(s[1], s[3], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i D = _mm512_shuffle_i64x2(s[1], s[3], _MM_SHUFFLE(3, 2, 3, 2));
+
+        BLAKE2_ROUND_AVX512F(A, B, C, D);
+
+        s[0] = _mm512_shuffle_i64x2(A, B, _MM_SHUFFLE(1, 0, 1, 0));
+        s[2] = _mm512_shuffle_i64x2(A, B, _MM_SHUFFLE(3, 2, 3, 2));
+        s[1] = _mm512_shuffle_i64x2(C, D, _MM_SHUFFLE(1, 0, 1, 0));
+        s[3] = _mm512_shuffle_i64x2(C, D, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    /* Row rounds i and i+4: after the transposes, register i of each group
+       of four holds round i in its low half and round i+4 in its high half */
+    TRANSPOSE_LANES_AVX512F(state[0], state[2], state[1], state[3]);
+    TRANSPOSE_LANES_AVX512F(state[4], state[6], state[5], state[7]);
+    TRANSPOSE_LANES_AVX512F(state[8], state[10], state[9], state[11]);
+    TRANSPOSE_LANES_AVX512F(state[12], state[14], state[13], state[15]);
+
+    BLAKE2_ROUND_AVX512F(state[0], state[4], state[8], state[12]);
+    BLAKE2_ROUND_AVX512F(state[2], state[6], state[10], state[14]);
+    BLAKE2_ROUND_AVX512F(state[1], state[5], state[9], state[13]);
+    BLAKE2_ROUND_AVX512F(state[3], state[7], state[11], state[15]);
+
+    TRANSPOSE_LANES_AVX512F(state[0], state[2], state[1], state[3]);
+    TRANSPOSE_LANES_AVX512F(state[4], state[6], state[5], state[7]);
+    TRANSPOSE_LANES_AVX512F(state[8], state[10], state[9], state[11]);
+    TRANSPOSE_LANES_AVX512F(state[12], state[14], state[13], state[15]);
+
+    for (i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; ++i) {
+        _mm512_storeu_si512(next + i, _mm512_xor_si512(state[i], block_tmp[i]));
+    }
+}
+
+static fill_block_fn select_fill_block(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return &fill_block_avx512f;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return &fill_block_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return &fill_block_ssse3;
+    }
+    return &fill_block;
+}
+
+#elif defined(ARGON2_SIMD_NEON)
+
+static void fill_block_neon(const block *prev_block, const block *ref_block,
+                            block *next_block, int with_xor) {
+    uint64x2_t state[ARGON2_OWORDS_IN_BLOCK], block_tmp[ARGON2_OWORDS_IN_BLOCK];
+    unsigned i;
+
+    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; ++i) {
+        state[i] = veorq_u64(vld1q_u64(ref_block->v + 2 * i),
+                             vld1q_u64(prev_block->v + 2 * i));
+        block_tmp[i] = with_xor
+                           ? veorq_u64(state[i], vld1q_u64(next_block->v + 2 * i))
+                           : state[i];
+    }
+
+    for (i = 0; i < 8; ++i) {
+        BLAKE2_ROUND_NEON(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2],
+                          state[8 * i + 3], state[8 * i + 4], state[8 * i + 5],
+                          state[8 * i + 6], state[8 * i + 7]);
+    }
+
+    for (i = 0; i < 8; ++i) {
+        BLAKE2_ROUND_NEON(state[i + 0], state[i + 8], state[i + 16],
+                          state[i + 24], state[i + 32], state[i + 40],
+                          state[i + 48], state[i + 56]);
+    }
+
+    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; ++i) {
+        vst1q_u64(next_block->v + 2 * i, veorq_u64(state[i], block_tmp[i]));
+    }
+}
+
+static fill_block_fn select_fill_block(void) { return &fill_block_neon; }
+
+#else
+
+static fill_block_fn select_fill_block(void) { return &fill_block; }
+
+#endif
+
+/* Kernel for this CPU, chosen on first use */
+static fill_block_fn fill_block_impl(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    static fill_block_fn selected = NULL;
+    fill_block_fn fn = __atomic_load_n(&selected, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = select_fill_block();
+        __atomic_store_n(&selected, fn, __ATOMIC_RELAXED);
+    }
+    return fn;
+#else
+    return select_fill_block();
+#endif
+}
+
+static void next_addresses(fill_block_fn fill, block *address_block,
+                           block *input_block, const block *zero_block) {
     input_block->v[6]++;
-    fill_block(zero_block, input_block, address_block, 0);
-    fill_block(zero_block, address_block, address_block, 0);
+    fill(zero_block, input_block, address_block, 0);
+    fill(zero_block, address_block, address_block, 0);
 }
 
 void fill_segment(const argon2_instance_t *instance,
@@ -96,11 +332,14 @@ void fill_segment(const argon2_instance_t *instance,
     uint32_t starting_index;
     uint32_t i;
     int data_independent_addressing;
+    fill_block_fn fill;
 
     if (instance == NULL) {
         return;
     }
 
+    fill = fill_block_impl();
+
     data_independent_addressing =
         (instance->type == Argon2_i) ||
         (instance->type == Argon2_id && (position.pass == 0) &&
@@ -125,7 +364,7 @@ void fill_segment(const argon2_instance_t *instance,
 
         /* Don't forget to generate the first block of addresses: */
         if (data_independent_addressing) {
-            next_addresses(&address_block, &input_block, &zero_block);
+            next_addresses(fill, &address_block, &input_block, &zero_block);
         }
     }
 
@@ -152,7 +391,8 @@ void fill_segment(const argon2_instance_t *instance,
         /* 1.2.1 Taking pseudo-random value from the previous block */
         if (data_independent_addressing) {
             if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
-                next_addresses(&address_block, &input_block, &zero_block);
+                next_addresses(fill, &address_block, &input_block,
+                               &zero_block);
             }
             pseudo_rand = address_block.v[i % ARGON2_ADDRESSES_IN_BLOCK];
         } else {
@@ -180,14 +420,12 @@ void fill_segment(const argon2_instance_t *instance,
         curr_block = instance->memory + curr_offset;
         if (ARGON2_VERSION_10 == instance->version) {
             /* version 1.2.1 and earlier: overwrite, not XOR */
-            fill_block(instance->memory + prev_offset, ref_block, curr_block, 0);
+            fill(instance->memory + prev_offset, ref_block, curr_block, 0);
         } else {
             if(0 == position.pass) {
-                fill_block(instance->memory + prev_offset, ref_block,
-                           curr_block, 0);
+                fill(instance->memory + prev_offset, ref_block, curr_block, 0);
             } else {
-                fill_block(instance->memory + prev_offset, ref_block,
-                           curr_block, 1);
+                fill(instance->memory + prev_offset, ref_block, curr_block, 1);
             }
         }
     }
@@ -17,9 +17,13 @@
 
 #if !defined(ARGON2_NO_THREADS)
 
+#include <stdlib.h>
+
 #include "thread.h"
 #if defined(_WIN32)
 #include <windows.h>
+#else
+#include <unistd.h>
 #endif
 
 int argon2_thread_create(argon2_thread_handle_t *handle,
@@ -54,4 +58,267 @@ void argon2_thread_exit(void) {
 #endif
 }
 
+#if defined(_WIN32)
+
+/* The pool is only implemented on top of pthreads; callers fall back to
+ * spawning a thread per lane. */
+argon2_pool *argon2_pool_create(uint32_t threads) {
+    (void)threads;
+    return NULL;
+}
+
+void argon2_pool_destroy(argon2_pool *pool) { (void)pool; }
+
+int argon2_pool_run(argon2_pool *pool, uint32_t threads, argon2_pool_job_t job,
+                    void *arg, uint32_t count) {
+    (void)pool;
+    (void)threads;
+    (void)job;
+    (void)arg;
+    (void)count;
+    return -1;
+}
+
+uint32_t argon2_pool_size(const argon2_pool *pool) {
+    (void)pool;
+    return 0;
+}
+
+#else
+
+/* Iterations a thread busy-waits at the barrier before sleeping on a
+ * condition variable. Segments are short enough at small memory costs that
+ * the next slice usually starts within this window. On a single CPU the
+ * spinning thread would only delay the one it waits for, so it is skipped. */
+#define ARGON2_POOL_SPIN 4096
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ARGON2_POOL_PAUSE() __asm__ __volatile__("pause")
+#elif defined(__aarch64__) || defined(__arm__)
+#define ARGON2_POOL_PAUSE() __asm__ __volatile__("yield")
+#else
+#define ARGON2_POOL_PAUSE() do { } while (0)
+#endif
+
+#define ARGON2_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+
+struct Argon2_pool {
+    pthread_mutex_t run_lock; /* one job at a time */
+    pthread_mutex_t lock;     /* guards sleeping on the two conditions */
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    argon2_thread_handle_t *workers;
+    uint32_t num_workers;
+    unsigned spin;
+
+    /* The current job, published by bumping generation */
+    argon2_pool_job_t job;
+    void *arg;
+    uint32_t count;
+    uint32_t next_index;
+    uint32_t pending; /* participants still working */
+    uint32_t shutdown;
+
+    /* Generation in the high half, number of participating workers in the
+     * low half. Read as one word so that a worker skipping a job can never
+     * pair a generation with another job's participant count. */
+    uint64_t ticket;
+};
+
+typedef struct Argon2_pool_worker {
+    argon2_pool *pool;
+    uint32_t id;
+} argon2_pool_worker;
+
+static void pool_work(argon2_pool *pool) {
+    uint32_t index;
+    while ((index = __atomic_fetch_add(&pool->next_index, 1,
+                                       __ATOMIC_RELAXED)) < pool->count) {
+        pool->job(pool->arg, index);
+    }
+}
+
+static void pool_finish(argon2_pool *pool) {
+    if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->done_cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+#define POOL_GENERATION(ticket) ((uint32_t)((ticket) >> 32))
+#define POOL_PARTICIPANTS(ticket) ((uint32_t)(ticket))
+
+static void *pool_worker_thr(void *thread_data) {
+    argon2_pool_worker *worker = thread_data;
+    argon2_pool *pool = worker->pool;
+    uint32_t seen = 0;
+    uint64_t ticket;
+    unsigned spin;
+
+    for (;;) {
+        ticket = ARGON2_LOAD(&pool->ticket);
+        for (spin = 0; spin < pool->spin && POOL_GENERATION(ticket) == seen;
+             ++spin) {
+            ARGON2_POOL_PAUSE();
+            ticket = ARGON2_LOAD(&pool->ticket);
+        }
+        if (POOL_GENERATION(ticket) == seen) {
+            pthread_mutex_lock(&pool->lock);
+            while (POOL_GENERATION(ticket = ARGON2_LOAD(&pool->ticket)) ==
+                   seen) {
+                pthread_cond_wait(&pool->work_cond, &pool->lock);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        seen = POOL_GENERATION(ticket);
+
+        if (ARGON2_LOAD(&pool->shutdown)) {
+            break;
+        }
+        if (worker->id < POOL_PARTICIPANTS(ticket)) {
+            pool_work(pool);
+            pool_finish(pool);
+        }
+    }
+    return NULL;
+}
+
+/* Publishes the fields written since the previous call to every worker */
+static void pool_publish(argon2_pool *pool, uint32_t participants) {
+    uint64_t generation = POOL_GENERATION(pool->ticket) + 1;
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->ticket, (generation << 32) | participants,
+                     __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+argon2_pool *argon2_pool_create(uint32_t threads) {
+    argon2_pool *pool;
+    argon2_pool_worker *worker_data;
+    uint32_t i;
+
+    if (threads == 0) {
+        return NULL;
+    }
+
+    pool = calloc(1, sizeof(argon2_pool) + threads * sizeof(argon2_pool_worker));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = calloc(threads, sizeof(argon2_thread_handle_t));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pool->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? ARGON2_POOL_SPIN : 0;
+
+    worker_data = (argon2_pool_worker *)(pool + 1);
+    for (i = 0; i < threads; ++i) {
+        worker_data[i].pool = pool;
+        worker_data[i].id = i;
+        if (argon2_thread_create(&pool->workers[i], &pool_worker_thr,
+                                 &worker_data[i])) {
+            break;
+        }
+        pool->num_workers = i + 1;
+    }
+
+    if (pool->num_workers != threads) {
+        argon2_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void argon2_pool_destroy(argon2_pool *pool) {
+    uint32_t i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&pool->shutdown, 1, __ATOMIC_RELAXED);
+    pool_publish(pool, 0);
+    for (i = 0; i < pool->num_workers; ++i) {
+        argon2_thread_join(pool->workers[i]);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int argon2_pool_run(argon2_pool *pool, uint32_t threads, argon2_pool_job_t job,
+                    void *arg, uint32_t count) {
+    uint32_t participants;
+    unsigned spin;
+
+    if (pool == NULL || job == NULL) {
+        return -1;
+    }
+
+    participants = threads > 1 ? threads - 1 : 0;
+    if (participants > pool->num_workers) {
+        participants = pool->num_workers;
+    }
+    if (participants > count) {
+        participants = count;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+
+    pool->job = job;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next_index = 0;
+    pool->pending = participants + 1;
+    pool_publish(pool, participants);
+
+    /* The caller works as well, then waits for the other participants */
+    pool_work(pool);
+    pool_finish(pool);
+
+    for (spin = 0; spin < pool->spin && ARGON2_LOAD(&pool->pending) != 0;
+         ++spin) {
+        ARGON2_POOL_PAUSE();
+    }
+    if (ARGON2_LOAD(&pool->pending) != 0) {
+        pthread_mutex_lock(&pool->lock);
+        while (ARGON2_LOAD(&pool->pending) != 0) {
+            pthread_cond_wait(&pool->done_cond, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->run_lock);
+    return 0;
+}
+
+uint32_t argon2_pool_size(const argon2_pool *pool) {
+    return pool != NULL ? pool->num_workers : 0;
+}
+
+#endif /* _WIN32 */
+
+#else /* ARGON2_NO_THREADS */
+
+#include "argon2.h"
+
+argon2_pool *argon2_pool_create(uint32_t threads) {
+    (void)threads;
+    return NULL;
+}
+
+void argon2_pool_destroy(argon2_pool *pool) { (void)pool; }
+
 #endif /* ARGON2_NO_THREADS */
@@ -18,6 +18,8 @@
 #ifndef ARGON2_THREAD_H
 #define ARGON2_THREAD_H
 
+#include "argon2.h"
+
 #if !defined(ARGON2_NO_THREADS)
 
 /*
@@ -63,5 +65,31 @@ int argon2_thread_join(argon2_thread_handle_t handle);
 */
 void argon2_thread_exit(void);
 
+/*
+        The worker pool behind argon2_pool_create() keeps its threads parked
+        between jobs. A job is a function applied to the indices 0..count-1;
+        the workers and the calling thread pull indices until none are left,
+        and argon2_pool_run() returns once every participant has finished.
+        That return is the barrier between slices, so a pool replaces the
+        per-lane create/join pairs of fill_memory_blocks_mt().
+*/
+typedef void (*argon2_pool_job_t)(void *arg, uint32_t index);
+
+/* Runs a job on a pool
+ * @param pool Pool created with argon2_pool_create. Must not be NULL.
+ * @param threads Maximum number of threads working on the job, including the
+ * calling thread.
+ * @param job Function called once for every index in [0, @count).
+ * @param arg Pointer that is passed as the first argument to @job.
+ * @param count Number of indices.
+ * @return 0 once all calls to @job have returned.
+ */
+int argon2_pool_run(argon2_pool *pool, uint32_t threads, argon2_pool_job_t job,
+                    void *arg, uint32_t count);
+
+/* Number of worker threads in a pool, not counting callers of
+ * argon2_pool_run. */
+uint32_t argon2_pool_size(const argon2_pool *pool);
+
 #endif /* ARGON2_NO_THREADS */
 #endif
@@ -200,8 +200,8 @@ static void ReconstructRow(const VP8Decoder* const dec,
 //                 U/V, so it's 8 samples total (because of the 2x upsampling).
 static const uint8_t kFilterExtraRows[3] = { 0, 2, 8 };
 
-static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+static void DoFilter(const VP8Decoder* const dec,
+                     const VP8ThreadContext* const ctx, int mb_x, int mb_y) {
   const int cache_id = ctx->id_;
   const int y_bps = dec->cache_y_stride_;
   const VP8FInfo* const f_info = ctx->f_info_ + mb_x;
@@ -250,12 +250,13 @@ static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
 }
 
 // Filter the decoded macroblock row (if needed)
-static void FilterRow(const VP8Decoder* const dec) {
+static void FilterRow(const VP8Decoder* const dec,
+                      const VP8ThreadContext* const ctx) {
   int mb_x;
-  const int mb_y = dec->thread_ctx_.mb_y_;
-  assert(dec->thread_ctx_.filter_row_);
+  const int mb_y = ctx->mb_y_;
+  assert(ctx->filter_row_);
   for (mb_x = dec->tl_mb_x_; mb_x < dec->br_mb_x_; ++mb_x) {
-    DoFilter(dec, mb_x, mb_y);
+    DoFilter(dec, ctx, mb_x, mb_y);
   }
 }
 
@@ -368,11 +369,11 @@ static void Dither8x8(VP8Random* const rg, uint8_t* dst, int bps, int amp) {
   VP8DitherCombine8x8(dither, dst, bps);
 }
 
-static void DitherRow(VP8Decoder* const dec) {
+static void DitherRow(VP8Decoder* const dec,
+                      const VP8ThreadContext* const ctx) {
   int mb_x;
   assert(dec->dither_);
   for (mb_x = dec->tl_mb_x_; mb_x < dec->br_mb_x_; ++mb_x) {
-    const VP8ThreadContext* const ctx = &dec->thread_ctx_;
     const VP8MBData* const data = ctx->mb_data_ + mb_x;
     const int cache_id = ctx->id_;
     const int uv_bps = dec->cache_uv_stride_;
@@ -398,45 +399,29 @@ static void DitherRow(VP8Decoder* const dec) {
 
 #define MACROBLOCK_VPOS(mb_y)  ((mb_y) * 16)    // vertical position of a MB
 
-// Finalize and transmit a complete row. Return false in case of user-abort.
-static int FinishRow(void* arg1, void* arg2) {
-  VP8Decoder* const dec = (VP8Decoder*)arg1;
-  VP8Io* const io = (VP8Io*)arg2;
+// Transmit the filtered part of a complete row to io->put().
+// Return false in case of user-abort.
+static int EmitRow(VP8Decoder* const dec, const VP8ThreadContext* const ctx,
+                   VP8Io* const io) {
   int ok = 1;
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
   const int cache_id = ctx->id_;
   const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
   const int ysize = extra_y_rows * dec->cache_y_stride_;
   const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride_;
   const int y_offset = cache_id * 16 * dec->cache_y_stride_;
   const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
-  uint8_t* const ydst = dec->cache_y_ - ysize + y_offset;
-  uint8_t* const udst = dec->cache_u_ - uvsize + uv_offset;
-  uint8_t* const vdst = dec->cache_v_ - uvsize + uv_offset;
   const int mb_y = ctx->mb_y_;
   const int is_first_row = (mb_y == 0);
   const int is_last_row = (mb_y >= dec->br_mb_y_ - 1);
 
-  if (dec->mt_method_ == 2) {
-    ReconstructRow(dec, ctx);
-  }
-
-  if (ctx->filter_row_) {
-    FilterRow(dec);
-  }
-
-  if (dec->dither_) {
-    DitherRow(dec);
-  }
-
   if (io->put != NULL) {
     int y_start = MACROBLOCK_VPOS(mb_y);
     int y_end = MACROBLOCK_VPOS(mb_y + 1);
     if (!is_first_row) {
       y_start -= extra_y_rows;
-      io->y = ydst;
-      io->u = udst;
-      io->v = vdst;
+      io->y = dec->cache_y_ - ysize + y_offset;
+      io->u = dec->cache_u_ - uvsize + uv_offset;
+      io->v = dec->cache_v_ - uvsize + uv_offset;
     } else {
       io->y = dec->cache_y_ + y_offset;
       io->u = dec->cache_u_ + uv_offset;
@@ -482,20 +467,160 @@ static int FinishRow(void* arg1, void* arg2) {
       ok = io->put(io);
     }
   }
-  // rotate top samples if needed
-  if (cache_id + 1 == dec->num_caches_) {
-    if (!is_last_row) {
-      memcpy(dec->cache_y_ - ysize, ydst + 16 * dec->cache_y_stride_, ysize);
-      memcpy(dec->cache_u_ - uvsize, udst + 8 * dec->cache_uv_stride_, uvsize);
-      memcpy(dec->cache_v_ - uvsize, vdst + 8 * dec->cache_uv_stride_, uvsize);
-    }
+  return ok;
+}
+
+// Rotate the still unfiltered bottom samples of the last cache row above the
+// first one, where the filtering of the next row will complete them.
+static void RotateCacheRows(const VP8Decoder* const dec,
+                            const VP8ThreadContext* const ctx) {
+  const int cache_id = ctx->id_;
+  const int is_last_row = (ctx->mb_y_ >= dec->br_mb_y_ - 1);
+  if (cache_id + 1 == dec->num_caches_ && !is_last_row) {
+    const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
+    const int ysize = extra_y_rows * dec->cache_y_stride_;
+    const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride_;
+    const int y_offset = cache_id * 16 * dec->cache_y_stride_;
+    const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
+    const uint8_t* const ydst = dec->cache_y_ - ysize + y_offset;
+    const uint8_t* const udst = dec->cache_u_ - uvsize + uv_offset;
+    const uint8_t* const vdst = dec->cache_v_ - uvsize + uv_offset;
+    memcpy(dec->cache_y_ - ysize, ydst + 16 * dec->cache_y_stride_, ysize);
+    memcpy(dec->cache_u_ - uvsize, udst + 8 * dec->cache_uv_stride_, uvsize);
+    memcpy(dec->cache_v_ - uvsize, vdst + 8 * dec->cache_uv_stride_, uvsize);
+  }
+}
+
+// Finalize and transmit a complete row. Return false in case of user-abort.
+static int FinishRow(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8Io* const io = (VP8Io*)arg2;
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  int ok;
+
+  if (dec->mt_method_ == 2) {
+    ReconstructRow(dec, ctx);
+  }
+
+  if (ctx->filter_row_) {
+    FilterRow(dec, ctx);
   }
 
+  if (dec->dither_) {
+    DitherRow(dec, ctx);
+  }
+
+  ok = EmitRow(dec, ctx, io);
+  // rotate top samples if needed
+  RotateCacheRows(dec, ctx);
   return ok;
 }
 
 #undef MACROBLOCK_VPOS
 
+//------------------------------------------------------------------------------
+// Staged pipeline (mt_method_ 3 and 4)
+//
+// Reconstruction, filtering and output of a row each depend on the previous
+// row having gone through the same stage: intra-prediction needs the top
+// samples, the loop-filter completes the bottom edge of the previous row and
+// io->put() keeps state across rows (fancy upsampling, rescaling, alpha).
+// Rows can't be spread over workers freely, hence each worker is given one
+// stage instead, and the rows travel along the ring of workers:
+//   parse (main):  [row n+3][...
+//   recon:         [row n+2][...
+//   filter:        [row n+1][...
+//   output:        [row n  ][...
+// Each stage processes the rows in order, and the cache rows are recycled
+// only once the output stage is done with them (see InitThreadContext()).
+
+// Number of workers of the pipeline, one per stage.
+static WEBP_INLINE int NumStages(const VP8Decoder* const dec) {
+  assert(dec->mt_method_ >= 3 && dec->mt_method_ - 1 <= MAX_NUM_WORKERS);
+  return dec->mt_method_ - 1;
+}
+
+static int ProcessStage(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8ThreadContext* const ctx = (VP8ThreadContext*)arg2;
+  const int stage = (int)(ctx - dec->stage_ctx_);
+  int ok = 1;
+  if (stage == 0) {
+    ReconstructRow(dec, ctx);
+    return 1;
+  }
+  if (stage == 1) {
+    if (ctx->filter_row_) {
+      FilterRow(dec, ctx);
+    }
+    if (dec->dither_) {
+      DitherRow(dec, ctx);
+    }
+  }
+  if (stage == NumStages(dec) - 1) {
+    ok = EmitRow(dec, ctx, &ctx->io_);
+  }
+  if (stage == 1) {
+    // The output of the last cache row doesn't read the rotated samples, so
+    // they can be moved as soon as the row is filtered.
+    RotateCacheRows(dec, ctx);
+  }
+  return ok;
+}
+
+// Move each row to the next stage, start processing the just parsed row
+// (unless 'io' is NULL, when only flushing the pipeline) and launch the
+// workers having a row to process.
+static int AdvancePipeline(VP8Decoder* const dec, const VP8Io* const io,
+                           int filter_row) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const int num_stages = NumStages(dec);
+  VP8ThreadContext* const ctx = dec->stage_ctx_;
+  // buffers of the row leaving the pipeline, recycled for parsing
+  VP8FInfo* const f_info = ctx[num_stages - 1].f_info_;
+  VP8MBData* const mb_data = ctx[num_stages - 1].mb_data_;
+  int s;
+  if (!VP8SyncWorkers(dec)) return 0;
+  for (s = num_stages - 1; s > 0; --s) {
+    ctx[s] = ctx[s - 1];
+  }
+  ctx[0].f_info_ = dec->f_info_;
+  ctx[0].mb_data_ = dec->mb_data_;
+  dec->f_info_ = f_info;
+  dec->mb_data_ = mb_data;
+  if (io != NULL) {
+    ctx[0].io_ = *io;
+    ctx[0].id_ = dec->cache_id_;
+    ctx[0].mb_y_ = dec->mb_y_;
+    ctx[0].filter_row_ = filter_row;
+    if (++dec->cache_id_ == dec->num_caches_) {
+      dec->cache_id_ = 0;
+    }
+  } else {
+    ctx[0].mb_y_ = -1;
+  }
+  for (s = 0; s < num_stages; ++s) {
+    if (ctx[s].mb_y_ >= 0) {
+      winterface->Launch(&dec->stage_workers_[s]);
+    }
+  }
+  return 1;
+}
+
+int VP8SyncWorkers(VP8Decoder* const dec) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  int ok = 1;
+  if (dec->mt_method_ >= 3) {
+    int s;
+    for (s = 0; s < NumStages(dec); ++s) {
+      ok &= winterface->Sync(&dec->stage_workers_[s]);
+    }
+  } else if (dec->mt_method_ > 0) {
+    ok = winterface->Sync(&dec->worker_);
+  }
+  return ok;
+}
+
 //------------------------------------------------------------------------------
 
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
@@ -510,6 +635,16 @@ int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
     ctx->filter_row_ = filter_row;
     ReconstructRow(dec, ctx);
     ok = FinishRow(dec, io);
+  } else if (dec->mt_method_ >= 3) {
+    ok = AdvancePipeline(dec, io, filter_row);
+    if (ok && dec->mb_y_ >= dec->br_mb_y_ - 1) {
+      // Last row: push the rows still in the pipeline through to the output.
+      int s;
+      for (s = 1; ok && s < NumStages(dec); ++s) {
+        ok = AdvancePipeline(dec, NULL, 0);
+      }
+      ok = ok && VP8SyncWorkers(dec);
+    }
   } else {
     WebPWorker* const worker = &dec->worker_;
     // Finish previous job *before* updating context
@@ -599,10 +734,7 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
 }
 
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
-  int ok = 1;
-  if (dec->mt_method_ > 0) {
-    ok = WebPGetWorkerInterface()->Sync(&dec->worker_);
-  }
+  const int ok = VP8SyncWorkers(dec);
 
   if (io->teardown != NULL) {
     io->teardown(io);
@@ -633,6 +765,11 @@ int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
 // and output process have non-concurrent writing:
 // Decode:  [ 0..15][16..31][ 0..15][16..31][...
 // io->put:         [ 0..15][16..31][ 0..15][...
+// The staged pipeline extends this by one cache line per additional stage,
+// as the output of a row now lags behind its decoding by several rows:
+// Decode:  [ 0..15][16..31][32..47][48..63][ 0..15][...
+// Deblock:         [ 0..11][12..27][28..43][44..59][...
+// io->put:                 [ 0..11][12..27][28..43][...
 
 #define MT_CACHE_LINES 3
 #define ST_CACHE_LINES 1   // 1 cache row only for single-threaded case
@@ -640,7 +777,21 @@ int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
 // Initialize multi/single-thread worker
 static int InitThreadContext(VP8Decoder* const dec) {
   dec->cache_id_ = 0;
-  if (dec->mt_method_ > 0) {
+  if (dec->mt_method_ >= 3) {
+    const int num_stages = NumStages(dec);
+    int s;
+    for (s = 0; s < num_stages; ++s) {
+      WebPWorker* const worker = &dec->stage_workers_[s];
+      if (!WebPGetWorkerInterface()->Reset(worker)) {
+        return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                           "thread initialization failed.");
+      }
+      worker->data1 = dec;
+      worker->data2 = (void*)&dec->stage_ctx_[s];
+      worker->hook = ProcessStage;
+    }
+    dec->num_caches_ = (dec->filter_type_ > 0) ? num_stages + 1 : num_stages;
+  } else if (dec->mt_method_ > 0) {
     WebPWorker* const worker = &dec->worker_;
     if (!WebPGetWorkerInterface()->Reset(worker)) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
@@ -668,7 +819,14 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
   (void)height;
   assert(headers == NULL || !headers->is_lossless);
 #if defined(WEBP_USE_THREAD)
-  if (width >= MIN_WIDTH_FOR_THREADS) return 2;
+  if (width >= MIN_WIDTH_FOR_THREADS) {
+    // The method number matches the number of threads it uses.
+    const int num_threads =
+        (options->num_threads <= 0) ? 2 : options->num_threads;
+    if (num_threads == 1) return 0;
+    return (num_threads > MAX_NUM_WORKERS + 1) ? MAX_NUM_WORKERS + 1
+                                               : num_threads;
+  }
 #endif
   return 0;
 }
@@ -686,13 +844,16 @@ static int AllocateMemory(VP8Decoder* const dec) {
   const size_t intra_pred_mode_size = 4 * mb_w * sizeof(uint8_t);
   const size_t top_size = sizeof(VP8TopSamples) * mb_w;
   const size_t mb_info_size = (mb_w + 1) * sizeof(VP8MB);
+  // number of rows of parsed data being used at once: with the staged
+  // pipeline, one per stage plus the one being parsed.
+  const int num_f_infos = (dec->mt_method_ >= 3) ? NumStages(dec) + 1
+                        : (dec->mt_method_ > 0) ? 2 : 1;
+  const int num_mb_datas = (dec->mt_method_ >= 3) ? NumStages(dec) + 1
+                         : (dec->mt_method_ == 2) ? 2 : 1;
   const size_t f_info_size =
-      (dec->filter_type_ > 0) ?
-          mb_w * (dec->mt_method_ > 0 ? 2 : 1) * sizeof(VP8FInfo)
-        : 0;
+      (dec->filter_type_ > 0) ? mb_w * num_f_infos * sizeof(VP8FInfo) : 0;
   const size_t yuv_size = YUV_SIZE * sizeof(*dec->yuv_b_);
-  const size_t mb_data_size =
-      (dec->mt_method_ == 2 ? 2 : 1) * mb_w * sizeof(*dec->mb_data_);
+  const size_t mb_data_size = num_mb_datas * mb_w * sizeof(*dec->mb_data_);
   const size_t cache_height = (16 * num_caches
                             + kFilterExtraRows[dec->filter_type_]) * 3 / 2;
   const size_t cache_size = top_size * cache_height;
@@ -751,6 +912,17 @@ static int AllocateMemory(VP8Decoder* const dec) {
   }
   mem += mb_data_size;
 
+  if (dec->mt_method_ >= 3) {
+    int s;
+    for (s = 0; s < NumStages(dec); ++s) {
+      VP8ThreadContext* const ctx = &dec->stage_ctx_[s];
+      ctx->mb_y_ = -1;   // no row to process yet
+      ctx->f_info_ = (dec->f_info_ != NULL) ? dec->f_info_ + (s + 1) * mb_w
+                                            : NULL;
+      ctx->mb_data_ = dec->mb_data_ + (s + 1) * mb_w;
+    }
+  }
+
   dec->cache_y_stride_ = 16 * mb_w;
   dec->cache_uv_stride_ = 8 * mb_w;
   {
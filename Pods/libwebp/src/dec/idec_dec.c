@@ -475,7 +475,7 @@ static VP8StatusCode DecodeRemaining(WebPIDecoder* const idec) {
         }
         // Synchronize the threads.
         if (dec->mt_method_ > 0) {
-          if (!WebPGetWorkerInterface()->Sync(&dec->worker_)) {
+          if (!VP8SyncWorkers(dec)) {
             return IDecError(idec, VP8_STATUS_BITSTREAM_ERROR);
           }
         }
@@ -57,8 +57,12 @@ int VP8InitIoInternal(VP8Io* const io, int version) {
 VP8Decoder* VP8New(void) {
   VP8Decoder* const dec = (VP8Decoder*)WebPSafeCalloc(1ULL, sizeof(*dec));
   if (dec != NULL) {
+    int i;
     SetOk(dec);
     WebPGetWorkerInterface()->Init(&dec->worker_);
+    for (i = 0; i < MAX_NUM_WORKERS; ++i) {
+      WebPGetWorkerInterface()->Init(&dec->stage_workers_[i]);
+    }
     dec->ready_ = 0;
     dec->num_parts_minus_one_ = 0;
     InitGetCoeffs();
@@ -659,7 +663,7 @@ static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
     }
   }
   if (dec->mt_method_ > 0) {
-    if (!WebPGetWorkerInterface()->Sync(&dec->worker_)) return 0;
+    if (!VP8SyncWorkers(dec)) return 0;
   }
 
   return 1;
@@ -706,10 +710,14 @@ int VP8Decode(VP8Decoder* const dec, VP8Io* const io) {
 }
 
 void VP8Clear(VP8Decoder* const dec) {
+  int i;
   if (dec == NULL) {
     return;
   }
   WebPGetWorkerInterface()->End(&dec->worker_);
+  for (i = 0; i < MAX_NUM_WORKERS; ++i) {
+    WebPGetWorkerInterface()->End(&dec->stage_workers_[i]);
+  }
   WebPDeallocateAlphaMemory(dec);
   WebPSafeFree(dec->mem_);
   dec->mem_ = NULL;
@@ -64,6 +64,9 @@ extern "C" {
 // minimal width under which lossy multi-threading is always disabled
 #define MIN_WIDTH_FOR_THREADS 512
 
+// maximal number of worker threads for lossy decoding (see mt_method_)
+#define MAX_NUM_WORKERS 3
+
 //------------------------------------------------------------------------------
 // Headers
 
@@ -163,7 +166,7 @@ typedef struct {
 
 // Persistent information needed by the parallel processing
 typedef struct {
-  int id_;              // cache row to process (in [0..2])
+  int id_;              // cache row to process (in [0..num_caches_-1])
   int mb_y_;            // macroblock position of the row
   int filter_row_;      // true if row-filtering is needed
   VP8FInfo* f_info_;    // filter strengths (swapped with dec->f_info_)
@@ -197,9 +200,17 @@ struct VP8Decoder {
   WebPWorker worker_;
   int mt_method_;      // multi-thread method: 0=off, 1=[parse+recon][filter]
                        // 2=[parse][recon+filter]
+                       // 3=[parse][recon][filter]
+                       // 4=[parse][recon][filter][output]
+                       // (output is done along with filtering if not listed)
   int cache_id_;       // current cache row
-  int num_caches_;     // number of cached rows of 16 pixels (1, 2 or 3)
+  int num_caches_;     // number of cached rows of 16 pixels (1 to 4)
   VP8ThreadContext thread_ctx_;  // Thread context
+  // Pipeline used by methods 3 and 4: one worker per stage, each with the
+  // context of the row it is processing. Contexts are handed over from one
+  // stage to the next as new rows get parsed.
+  WebPWorker stage_workers_[MAX_NUM_WORKERS];
+  VP8ThreadContext stage_ctx_[MAX_NUM_WORKERS];
 
   // dimension, in macroblock units.
   int mb_w_, mb_h_;
@@ -300,6 +311,9 @@ void VP8InitDithering(const WebPDecoderOptions* const options,
                       VP8Decoder* const dec);
 // Process the last decoded row (filtering + output).
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io);
+// Wait for the worker threads, if any, to be done with the rows handed over so
+// far. Returns false in case of error.
+int VP8SyncWorkers(VP8Decoder* const dec);
 // To be called at the start of a new scanline, to initialize predictors.
 void VP8InitScanline(VP8Decoder* const dec);
 // Decode one macroblock. Returns false if there is not enough data.
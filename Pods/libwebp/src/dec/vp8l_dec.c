@@ -26,6 +26,11 @@
 
 #define NUM_ARGB_CACHE_ROWS          16
 
+// minimal width under which lossless multi-threading is always disabled
+#define MIN_WIDTH_FOR_THREADS        512
+// number of rows handed over to the worker at once when multi-threading
+#define NUM_MT_ROWS                  (4 * NUM_ARGB_CACHE_ROWS)
+
 static const int kCodeLengthLiterals = 16;
 static const int kCodeLengthRepeatCode = 16;
 static const uint8_t kCodeLengthExtraBits[3] = { 2, 3, 7 };
@@ -825,6 +830,35 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
   assert(dec->last_row_ <= dec->height_);
 }
 
+// Multi-threaded row-processing: the inverse transforms and the output of
+// the rows are done in 'worker_', while the main thread keeps decoding the
+// following rows into 'pixels_'. Rows which are handed over to the worker are
+// final, since decoding only ever writes past them.
+static int ProcessRowsHook(void* arg1, void* arg2) {
+  VP8LDecoder* const dec = (VP8LDecoder*)arg1;
+  const int last_row = dec->mt_last_row_;
+  (void)arg2;
+  while (dec->last_row_ < last_row) {
+    const int row = dec->last_row_ + NUM_ARGB_CACHE_ROWS;
+    ProcessRows(dec, (row < last_row) ? row : last_row);
+  }
+  return 1;
+}
+
+static void ProcessRowsMT(VP8LDecoder* const dec, int row) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  WebPWorker* const worker = &dec->worker_;
+  // Rows are handed over by groups of NUM_MT_ROWS, except for the last ones.
+  if (row - dec->mt_last_row_ < NUM_MT_ROWS && row < dec->io_->crop_bottom) {
+    return;
+  }
+  // Wait for the previous batch: 'argb_cache_' and the top-row used by the
+  // predictor transform are only available once it is done.
+  worker_interface->Sync(worker);
+  dec->mt_last_row_ = row;
+  worker_interface->Launch(worker);
+}
+
 // Row-processing for the special case when alpha data contains only one
 // transform (color indexing), and trivial non-green literals.
 static int Is8bOptimizable(const VP8LMetadata* const hdr) {
@@ -1372,6 +1406,7 @@ VP8LDecoder* VP8LNew(void) {
   if (dec == NULL) return NULL;
   dec->status_ = VP8_STATUS_OK;
   dec->state_ = READ_DIM;
+  WebPGetWorkerInterface()->Init(&dec->worker_);
 
   VP8LDspInit();  // Init critical function pointers.
 
@@ -1381,6 +1416,8 @@ VP8LDecoder* VP8LNew(void) {
 void VP8LClear(VP8LDecoder* const dec) {
   int i;
   if (dec == NULL) return;
+  WebPGetWorkerInterface()->End(&dec->worker_);
+  dec->mt_method_ = 0;
   ClearMetadata(&dec->hdr_);
 
   WebPSafeFree(dec->pixels_);
@@ -1666,6 +1703,25 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
   return 0;
 }
 
+// Returns the multi-threading method to use (0=off), depending on options
+// and image dimensions. Incremental decoding stays single-threaded, as it
+// returns to the caller after each partial update.
+static int GetThreadMethod(const WebPDecoderOptions* const options,
+                           const VP8LDecoder* const dec) {
+  if (options == NULL || options->use_threads == 0 ||
+      options->num_threads == 1) {
+    return 0;
+  }
+  (void)dec;
+#if defined(WEBP_USE_THREAD)
+  if (!dec->incremental_ && dec->io_->width >= MIN_WIDTH_FOR_THREADS &&
+      dec->io_->crop_bottom - dec->io_->crop_top > NUM_ARGB_CACHE_ROWS) {
+    return 1;
+  }
+#endif
+  return 0;
+}
+
 int VP8LDecodeImage(VP8LDecoder* const dec) {
   VP8Io* io = NULL;
   WebPDecParams* params = NULL;
@@ -1721,13 +1777,31 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
         }
       }
     }
+    dec->mt_method_ = GetThreadMethod(params->options, dec);
+    if (dec->mt_method_ > 0) {
+      WebPWorker* const worker = &dec->worker_;
+      if (!WebPGetWorkerInterface()->Reset(worker)) {
+        dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+        goto Err;
+      }
+      worker->data1 = dec;
+      worker->data2 = NULL;
+      worker->hook = ProcessRowsHook;
+      dec->mt_last_row_ = dec->last_row_;
+    }
     dec->state_ = READ_DATA;
   }
 
   // Decode.
-  if (!DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
-                       io->crop_bottom, ProcessRows)) {
-    goto Err;
+  {
+    const int ok =
+        DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
+                        io->crop_bottom,
+                        (dec->mt_method_ > 0) ? ProcessRowsMT : ProcessRows);
+    // Wait for the last rows to be output, or for the worker to let go of
+    // the buffers in case of error.
+    if (dec->mt_method_ > 0) WebPGetWorkerInterface()->Sync(&dec->worker_);
+    if (!ok) goto Err;
   }
 
   params->last_y = dec->last_out_row_;
@@ -20,6 +20,7 @@
 #include "src/utils/bit_reader_utils.h"
 #include "src/utils/color_cache_utils.h"
 #include "src/utils/huffman_utils.h"
+#include "src/utils/thread_utils.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -88,6 +89,12 @@ struct VP8LDecoder {
 
   uint8_t         *rescaler_memory;  // Working memory for rescaling work.
   WebPRescaler    *rescaler;         // Common rescaler for all channels.
+
+  // Worker
+  WebPWorker       worker_;
+  int              mt_method_;     // multi-thread method: 0=off,
+                                   // 1=[entropy decode][transform+output]
+  int              mt_last_row_;   // row up to which 'worker_' processes.
 };
 
 //------------------------------------------------------------------------------
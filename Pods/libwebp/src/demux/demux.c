@@ -787,6 +787,104 @@ uint32_t WebPDemuxGetI(const WebPDemuxer* dmux, WebPFormatFeature feature) {
   return 0;
 }
 
+// -----------------------------------------------------------------------------
+// Canvas information
+
+// Walks the chunks following VP8X up to 'riff_end', counting the ANMF chunks
+// of an animation or the image chunk of a still. As in ParseAnimationFrame(),
+// the image bearing chunks of a frame are walked rather than skipped with the
+// ANMF size. Returns -1 if a chunk size runs past the end of the RIFF payload.
+static int CountFrames(const uint8_t* const data, size_t pos, size_t riff_end,
+                       int is_animation) {
+  int num_frames = 0;
+  while (riff_end - pos >= CHUNK_HEADER_SIZE) {
+    const uint8_t* const chunk = data + pos;
+    const uint32_t payload_size = GetLE32(chunk + TAG_SIZE);
+    const uint32_t disk_size = payload_size + (payload_size & 1);
+    if (payload_size > MAX_CHUNK_PAYLOAD) return -1;
+    if (disk_size > riff_end - pos - CHUNK_HEADER_SIZE) return -1;
+    if (is_animation) {
+      if (!memcmp(chunk, "ANMF", TAG_SIZE)) {
+        if (payload_size < ANMF_CHUNK_SIZE) return -1;
+        ++num_frames;
+        pos += CHUNK_HEADER_SIZE + ANMF_CHUNK_SIZE;
+        continue;
+      }
+    } else if (!memcmp(chunk, "VP8 ", TAG_SIZE) ||
+               !memcmp(chunk, "VP8L", TAG_SIZE)) {
+      return 1;
+    }
+    pos += CHUNK_HEADER_SIZE + disk_size;
+  }
+  return num_frames;
+}
+
+static int GetExtendedCanvasInfo(const uint8_t* const data, size_t riff_end,
+                                 WebPCanvasInfo* const info) {
+  const uint8_t* const vp8x = data + RIFF_HEADER_SIZE;
+  const size_t min_size = RIFF_HEADER_SIZE + CHUNK_HEADER_SIZE +
+                          VP8X_CHUNK_SIZE;
+  uint32_t vp8x_size;
+  int num_frames;
+
+  if (riff_end < min_size) return 0;
+  vp8x_size = GetLE32(vp8x + TAG_SIZE);
+  if (vp8x_size > MAX_CHUNK_PAYLOAD) return 0;
+  if (vp8x_size < VP8X_CHUNK_SIZE) return 0;
+  vp8x_size += vp8x_size & 1;
+  if (vp8x_size > riff_end - RIFF_HEADER_SIZE - CHUNK_HEADER_SIZE) return 0;
+
+  info->format_flags = vp8x[CHUNK_HEADER_SIZE];
+  info->canvas_width = 1 + GetLE24(vp8x + CHUNK_HEADER_SIZE + 4);
+  info->canvas_height = 1 + GetLE24(vp8x + CHUNK_HEADER_SIZE + 7);
+  if (info->canvas_width * (uint64_t)info->canvas_height >= MAX_IMAGE_AREA) {
+    return 0;  // image final dimension is too large
+  }
+
+  num_frames = CountFrames(data,
+                           RIFF_HEADER_SIZE + CHUNK_HEADER_SIZE + vp8x_size,
+                           riff_end,
+                           !!(info->format_flags & ANIMATION_FLAG));
+  if (num_frames <= 0) return 0;
+  info->frame_count = (uint32_t)num_frames;
+  return 1;
+}
+
+int WebPGetCanvasInfo(const uint8_t* data, size_t data_size,
+                      WebPCanvasInfo* info) {
+  WebPBitstreamFeatures features;
+  if (info == NULL) return 0;
+  memset(info, 0, sizeof(*info));
+  if (data == NULL || data_size == 0) return 0;
+
+  if (data_size >= RIFF_HEADER_SIZE &&
+      !memcmp(data, "RIFF", TAG_SIZE) &&
+      !memcmp(data + CHUNK_HEADER_SIZE, "WEBP", TAG_SIZE)) {
+    const uint32_t riff_size = GetLE32(data + TAG_SIZE);
+    const size_t riff_end = (size_t)riff_size + CHUNK_HEADER_SIZE;
+    if (riff_size < CHUNK_HEADER_SIZE) return 0;
+    if (riff_size > MAX_CHUNK_PAYLOAD) return 0;
+    if (data_size < riff_end) return 0;  // truncated file
+    if (riff_end >= RIFF_HEADER_SIZE + TAG_SIZE &&
+        !memcmp(data + RIFF_HEADER_SIZE, "VP8X", TAG_SIZE)) {
+      if (!GetExtendedCanvasInfo(data, riff_end, info)) {
+        memset(info, 0, sizeof(*info));
+        return 0;
+      }
+      return 1;
+    }
+    data_size = riff_end;
+  }
+
+  // Simple format, with or without the RIFF header.
+  if (WebPGetFeatures(data, data_size, &features) != VP8_STATUS_OK) return 0;
+  info->canvas_width = (uint32_t)features.width;
+  info->canvas_height = (uint32_t)features.height;
+  info->format_flags = features.has_alpha ? ALPHA_FLAG : 0;
+  info->frame_count = 1;
+  return 1;
+}
+
 // -----------------------------------------------------------------------------
 // Frame iteration
 
@@ -0,0 +1,584 @@
+// Copyright 2011 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of some decoding functions (idct, loop filtering).
+//
+// The arithmetic is the same as in dec_sse2.c, bit for bit. The 256b registers
+// are used as two lanes: the chroma transform handles four blocks at once, and
+// the complex loop filters keep the 'p' side of the edge in the low lane and
+// the mirrored 'q' side in the high lane, so that p3..q3 fit in 4 registers.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include <immintrin.h>
+#include "src/dec/vp8i_dec.h"
+
+//------------------------------------------------------------------------------
+// Transforms (Paragraph 14.4)
+
+// Transposes the 4x4 16b blocks held in each 64b half of the four registers.
+static WEBP_AVX2_TARGET WEBP_INLINE void Transpose_4x4x4_16b_AVX2(
+    const __m256i* const in0, const __m256i* const in1,
+    const __m256i* const in2, const __m256i* const in3, __m256i* const out0,
+    __m256i* const out1, __m256i* const out2, __m256i* const out3) {
+  const __m256i transpose0_0 = _mm256_unpacklo_epi16(*in0, *in1);
+  const __m256i transpose0_1 = _mm256_unpacklo_epi16(*in2, *in3);
+  const __m256i transpose0_2 = _mm256_unpackhi_epi16(*in0, *in1);
+  const __m256i transpose0_3 = _mm256_unpackhi_epi16(*in2, *in3);
+  const __m256i transpose1_0 =
+      _mm256_unpacklo_epi32(transpose0_0, transpose0_1);
+  const __m256i transpose1_1 =
+      _mm256_unpacklo_epi32(transpose0_2, transpose0_3);
+  const __m256i transpose1_2 =
+      _mm256_unpackhi_epi32(transpose0_0, transpose0_1);
+  const __m256i transpose1_3 =
+      _mm256_unpackhi_epi32(transpose0_2, transpose0_3);
+  *out0 = _mm256_unpacklo_epi64(transpose1_0, transpose1_1);
+  *out1 = _mm256_unpackhi_epi64(transpose1_0, transpose1_1);
+  *out2 = _mm256_unpacklo_epi64(transpose1_2, transpose1_3);
+  *out3 = _mm256_unpackhi_epi64(transpose1_2, transpose1_3);
+}
+
+// One 1-D pass of the inverse transform on four blocks (see Transform_SSE2()
+// for the meaning of the k1/k2 constants). 'dc' is added to the first input.
+static WEBP_AVX2_TARGET WEBP_INLINE void ITransformPass_AVX2(
+    const __m256i* const in0, const __m256i* const in1,
+    const __m256i* const in2, const __m256i* const in3,
+    const __m256i* const dc, __m256i* const out0, __m256i* const out1,
+    __m256i* const out2, __m256i* const out3) {
+  const __m256i k1 = _mm256_set1_epi16(20091);
+  const __m256i k2 = _mm256_set1_epi16(-30068);
+  const __m256i in0dc = _mm256_add_epi16(*in0, *dc);
+  const __m256i a = _mm256_add_epi16(in0dc, *in2);
+  const __m256i b = _mm256_sub_epi16(in0dc, *in2);
+  // c = MUL(in1, K2) - MUL(in3, K1) = MUL(in1, k2) - MUL(in3, k1) + in1 - in3
+  const __m256i c1 = _mm256_mulhi_epi16(*in1, k2);
+  const __m256i c2 = _mm256_mulhi_epi16(*in3, k1);
+  const __m256i c3 = _mm256_sub_epi16(*in1, *in3);
+  const __m256i c4 = _mm256_sub_epi16(c1, c2);
+  const __m256i c = _mm256_add_epi16(c3, c4);
+  // d = MUL(in1, K1) + MUL(in3, K2) = MUL(in1, k1) + MUL(in3, k2) + in1 + in3
+  const __m256i d1 = _mm256_mulhi_epi16(*in1, k1);
+  const __m256i d2 = _mm256_mulhi_epi16(*in3, k2);
+  const __m256i d3 = _mm256_add_epi16(*in1, *in3);
+  const __m256i d4 = _mm256_add_epi16(d1, d2);
+  const __m256i d = _mm256_add_epi16(d3, d4);
+  *out0 = _mm256_add_epi16(a, d);
+  *out1 = _mm256_add_epi16(b, c);
+  *out2 = _mm256_sub_epi16(b, c);
+  *out3 = _mm256_sub_epi16(a, d);
+}
+
+// Same as TransformUV_C(): blocks 0 and 1 go to the low lane and rows 0-3 of
+// 'dst', blocks 2 and 3 to the high lane and rows 4-7.
+static WEBP_AVX2_TARGET void TransformUV_AVX2(const int16_t* in,
+                                              uint8_t* dst) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i in0, in1, in2, in3;
+  __m256i T0, T1, T2, T3;
+
+  // Load and concatenate the transform coefficients.
+  {
+    const __m256i B0 = _mm256_loadu_si256((const __m256i*)&in[0]);
+    const __m256i B1 = _mm256_loadu_si256((const __m256i*)&in[16]);
+    const __m256i B2 = _mm256_loadu_si256((const __m256i*)&in[32]);
+    const __m256i B3 = _mm256_loadu_si256((const __m256i*)&in[48]);
+    // rows 0-1 of blocks 0/2 and 1/3, then rows 2-3
+    const __m256i A01 = _mm256_permute2x128_si256(B0, B2, 0x20);
+    const __m256i B01 = _mm256_permute2x128_si256(B1, B3, 0x20);
+    const __m256i A23 = _mm256_permute2x128_si256(B0, B2, 0x31);
+    const __m256i B23 = _mm256_permute2x128_si256(B1, B3, 0x31);
+    // a0x a1x a2x a3x  b0x b1x b2x b3x | c0x c1x c2x c3x  d0x d1x d2x d3x
+    in0 = _mm256_unpacklo_epi64(A01, B01);
+    in1 = _mm256_unpackhi_epi64(A01, B01);
+    in2 = _mm256_unpacklo_epi64(A23, B23);
+    in3 = _mm256_unpackhi_epi64(A23, B23);
+  }
+
+  // Vertical pass and subsequent transpose.
+  {
+    __m256i tmp0, tmp1, tmp2, tmp3;
+    ITransformPass_AVX2(&in0, &in1, &in2, &in3, &zero,
+                        &tmp0, &tmp1, &tmp2, &tmp3);
+    Transpose_4x4x4_16b_AVX2(&tmp0, &tmp1, &tmp2, &tmp3, &T0, &T1, &T2, &T3);
+  }
+
+  // Horizontal pass and subsequent transpose.
+  {
+    const __m256i four = _mm256_set1_epi16(4);
+    __m256i tmp0, tmp1, tmp2, tmp3;
+    ITransformPass_AVX2(&T0, &T1, &T2, &T3, &four,
+                        &tmp0, &tmp1, &tmp2, &tmp3);
+    tmp0 = _mm256_srai_epi16(tmp0, 3);
+    tmp1 = _mm256_srai_epi16(tmp1, 3);
+    tmp2 = _mm256_srai_epi16(tmp2, 3);
+    tmp3 = _mm256_srai_epi16(tmp3, 3);
+    Transpose_4x4x4_16b_AVX2(&tmp0, &tmp1, &tmp2, &tmp3, &T0, &T1, &T2, &T3);
+  }
+
+  // Add inverse transform to 'dst' and store.
+  {
+    int i;
+    const __m256i T[4] = { T0, T1, T2, T3 };
+    for (i = 0; i < 4; ++i) {
+      uint8_t* const d0 = dst + i * BPS;
+      uint8_t* const d1 = dst + (i + 4) * BPS;
+      const __m128i lo = _mm_loadl_epi64((const __m128i*)d0);
+      const __m128i hi = _mm_loadl_epi64((const __m128i*)d1);
+      const __m256i ref =
+          _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+      const __m256i sum =
+          _mm256_add_epi16(_mm256_unpacklo_epi8(ref, zero), T[i]);
+      const __m256i out = _mm256_packus_epi16(sum, sum);
+      _mm_storel_epi64((__m128i*)d0, _mm256_castsi256_si128(out));
+      _mm_storel_epi64((__m128i*)d1, _mm256_extracti128_si256(out, 1));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Loop Filter (Paragraph 15)
+//
+// The eight samples across an edge are held as four 'pairs':
+//   X3 = [p3 | q3], X2 = [p2 | q2], X1 = [p1 | q1], X0 = [p0 | q0]
+// with each half holding sixteen pixels along the edge. The masks are made
+// symmetric so both halves agree, and the filter deltas are applied as
+// p += delta in the low lane and q -= delta in the high lane.
+
+#define MM256_ABS(p, q)  _mm256_or_si256(                                      \
+    _mm256_subs_epu8((q), (p)),                                                \
+    _mm256_subs_epu8((p), (q)))
+
+// Returns the register with its two lanes exchanged.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i Swap_AVX2(const __m256i x) {
+  return _mm256_permute2x128_si256(x, x, 0x01);
+}
+
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i Pair_AVX2(const __m128i lo,
+                                                      const __m128i hi) {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+// Computes the (symmetric) filtering and not-hev masks of the edge.
+static WEBP_AVX2_TARGET WEBP_INLINE void ComplexMask_AVX2(
+    const __m256i* const X3, const __m256i* const X2,
+    const __m256i* const X1, const __m256i* const X0,
+    int thresh, int ithresh, int hev_thresh,
+    __m256i* const mask, __m256i* const not_hev) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i kFE = _mm256_set1_epi8((char)0xFE);
+  const __m256i S1 = Swap_AVX2(*X1);
+  const __m256i S0 = Swap_AVX2(*X0);
+  const __m256i d10 = MM256_ABS(*X1, *X0);   // abs(p1 - p0) | abs(q1 - q0)
+  const __m256i d32 = MM256_ABS(*X3, *X2);
+  const __m256i d21 = MM256_ABS(*X2, *X1);
+  const __m256i h = _mm256_max_epu8(d10, Swap_AVX2(d10));
+  const __m256i m0 = _mm256_max_epu8(_mm256_max_epu8(d32, d21), d10);
+  const __m256i m = _mm256_max_epu8(m0, Swap_AVX2(m0));
+  const __m256i thresh_mask = _mm256_cmpeq_epi8(
+      _mm256_subs_epu8(m, _mm256_set1_epi8((char)ithresh)), zero);
+  // abs(p0 - q0) * 2 + abs(p1 - q1) / 2 <= thresh
+  const __m256i t1 = MM256_ABS(*X1, S1);
+  const __m256i t3 = _mm256_srli_epi16(_mm256_and_si256(t1, kFE), 1);
+  const __m256i t4 = MM256_ABS(*X0, S0);
+  const __m256i t6 = _mm256_adds_epu8(_mm256_adds_epu8(t4, t4), t3);
+  const __m256i filter_mask = _mm256_cmpeq_epi8(
+      _mm256_subs_epu8(t6, _mm256_set1_epi8((char)thresh)), zero);
+  *mask = _mm256_and_si256(thresh_mask, filter_mask);
+  *not_hev = _mm256_cmpeq_epi8(
+      _mm256_subs_epu8(h, _mm256_set1_epi8((char)hev_thresh)), zero);
+}
+
+// Arithmetic shift right by 3 of each int8_t.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i SignedShift8b_AVX2(
+    const __m256i x) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i lo_0 = _mm256_unpacklo_epi8(zero, x);
+  const __m256i hi_0 = _mm256_unpackhi_epi8(zero, x);
+  const __m256i lo_1 = _mm256_srai_epi16(lo_0, 3 + 8);
+  const __m256i hi_1 = _mm256_srai_epi16(hi_0, 3 + 8);
+  return _mm256_packs_epi16(lo_1, hi_1);
+}
+
+// Given the base filter value 'f' in both lanes, returns
+// [(f + 3) >> 3 | (f + 4) >> 3].
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i SimpleDelta_AVX2(const __m256i f) {
+  const __m256i k34 = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3,
+                                       3, 3, 3, 3, 3, 3, 3, 3,
+                                       4, 4, 4, 4, 4, 4, 4, 4,
+                                       4, 4, 4, 4, 4, 4, 4, 4);
+  return SignedShift8b_AVX2(_mm256_adds_epi8(f, k34));
+}
+
+// Applies 'delta' to the int8_t pair: p += delta_lo, q -= delta_hi. None of
+// the deltas can be -128, so negating them keeps the saturation of the
+// _mm_subs_epi8() used by the SSE2 version.
+static WEBP_AVX2_TARGET WEBP_INLINE void ApplyDelta_AVX2(
+    __m256i* const X, const __m256i delta) {
+  const __m256i kPM = _mm256_setr_epi8(1, 1, 1, 1, 1, 1, 1, 1,
+                                       1, 1, 1, 1, 1, 1, 1, 1,
+                                       -1, -1, -1, -1, -1, -1, -1, -1,
+                                       -1, -1, -1, -1, -1, -1, -1, -1);
+  *X = _mm256_adds_epi8(*X, _mm256_sign_epi8(delta, kPM));
+}
+
+// Returns the base delta p1 - q1 + 3 * (q0 - p0), valid in the low lane.
+// The input pixels are int8_t.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i BaseDelta_AVX2(
+    const __m256i* const X1, const __m256i* const X0,
+    const __m256i* const not_hev) {
+  // beware of addition order, for saturation!
+  const __m256i p1_q1 = _mm256_subs_epi8(*X1, Swap_AVX2(*X1));
+  const __m256i q0_p0 = _mm256_subs_epi8(Swap_AVX2(*X0), *X0);
+  const __m256i t = _mm256_andnot_si256(*not_hev, p1_q1);
+  const __m256i s1 = _mm256_adds_epi8(t, q0_p0);
+  const __m256i s2 = _mm256_adds_epi8(q0_p0, s1);
+  return _mm256_adds_epi8(q0_p0, s2);
+}
+
+// Broadcasts the low lane to the high one.
+#define DUP_LO(x) _mm256_permute4x64_epi64((x), 0x44)
+#define DUP_HI(x) _mm256_permute4x64_epi64((x), 0xee)
+
+// Applies filter on 4 pixels (p1, p0, q0 and q1)
+static WEBP_AVX2_TARGET WEBP_INLINE void DoFilter4_AVX2(
+    __m256i* const X1, __m256i* const X0,
+    const __m256i* const mask, const __m256i* const not_hev) {
+  const __m256i sign_bit = _mm256_set1_epi8((char)0x80);
+  const __m256i k64 = _mm256_set1_epi8(64);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i a, v34, t;
+
+  *X1 = _mm256_xor_si256(*X1, sign_bit);
+  *X0 = _mm256_xor_si256(*X0, sign_bit);
+  // hev(p1 - q1) + 3 * (q0 - p0)
+  a = _mm256_and_si256(BaseDelta_AVX2(X1, X0, not_hev), *mask);
+  v34 = SimpleDelta_AVX2(DUP_LO(a));
+  ApplyDelta_AVX2(X0, v34);            // p0 += v3, q0 -= v4
+
+  // this is equivalent to signed (a + 1) >> 1 calculation, on v4
+  t = _mm256_add_epi8(v34, sign_bit);
+  t = _mm256_sub_epi8(_mm256_avg_epu8(t, zero), k64);
+  t = _mm256_and_si256(*not_hev, DUP_HI(t));   // if !hev
+  ApplyDelta_AVX2(X1, t);              // p1 += t, q1 -= t
+  *X1 = _mm256_xor_si256(*X1, sign_bit);
+  *X0 = _mm256_xor_si256(*X0, sign_bit);
+}
+
+// Returns [d | d] for the sixteen 16b values of 'a' (spread over the two
+// lanes), where d = (a >> 7) saturated to int8_t.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i Pack7_AVX2(const __m256i a) {
+  const __m256i d = _mm256_srai_epi16(a, 7);
+  return _mm256_permute4x64_epi64(_mm256_packs_epi16(d, d), 0x88);
+}
+
+// Applies filter on 6 pixels (p2, p1, p0, q0, q1 and q2)
+static WEBP_AVX2_TARGET WEBP_INLINE void DoFilter6_AVX2(
+    __m256i* const X2, __m256i* const X1, __m256i* const X0,
+    const __m256i* const mask, const __m256i* const not_hev) {
+  const __m256i sign_bit = _mm256_set1_epi8((char)0x80);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i a;
+
+  *X2 = _mm256_xor_si256(*X2, sign_bit);
+  *X1 = _mm256_xor_si256(*X1, sign_bit);
+  *X0 = _mm256_xor_si256(*X0, sign_bit);
+  a = DUP_LO(BaseDelta_AVX2(X1, X0, &zero));
+
+  { // do simple filter on pixels with hev
+    const __m256i m = _mm256_andnot_si256(*not_hev, *mask);
+    ApplyDelta_AVX2(X0, SimpleDelta_AVX2(_mm256_and_si256(a, m)));
+  }
+
+  { // do strong filter on pixels with not hev
+    const __m256i k9 = _mm256_set1_epi16(9);
+    const __m256i k63 = _mm256_set1_epi16(63);
+    const __m256i m = _mm256_and_si256(*not_hev, *mask);
+    const __m256i f = _mm256_and_si256(a, m);
+    const __m256i f16 = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(f));
+    const __m256i f9 = _mm256_mullo_epi16(f16, k9);   // Filter * 9
+    const __m256i a2 = _mm256_add_epi16(f9, k63);     // Filter * 9 + 63
+    const __m256i a1 = _mm256_add_epi16(a2, f9);      // Filter * 18 + 63
+    const __m256i a0 = _mm256_add_epi16(a1, f9);      // Filter * 27 + 63
+    ApplyDelta_AVX2(X2, Pack7_AVX2(a2));
+    ApplyDelta_AVX2(X1, Pack7_AVX2(a1));
+    ApplyDelta_AVX2(X0, Pack7_AVX2(a0));
+  }
+  *X2 = _mm256_xor_si256(*X2, sign_bit);
+  *X1 = _mm256_xor_si256(*X1, sign_bit);
+  *X0 = _mm256_xor_si256(*X0, sign_bit);
+}
+
+#undef DUP_LO
+#undef DUP_HI
+
+// Loads 8 bytes from 16 rows (rows 8-15 starting at 'r8') and transposes them
+// into the column pairs [c0 | c1], [c2 | c3], [c4 | c5] and [c6 | c7].
+static WEBP_AVX2_TARGET WEBP_INLINE void Load16x8_AVX2(
+    const uint8_t* const r0, const uint8_t* const r8, int stride,
+    __m256i* const c01, __m256i* const c23,
+    __m256i* const c45, __m256i* const c67) {
+  __m256i R[8];
+  int i;
+  for (i = 0; i < 8; ++i) {
+    R[i] = Pair_AVX2(_mm_loadl_epi64((const __m128i*)&r0[i * stride]),
+                     _mm_loadl_epi64((const __m128i*)&r8[i * stride]));
+  }
+  {
+    // Each lane transposes its own 8x8 block.
+    const __m256i A0 = _mm256_unpacklo_epi8(R[0], R[1]);
+    const __m256i A1 = _mm256_unpacklo_epi8(R[2], R[3]);
+    const __m256i A2 = _mm256_unpacklo_epi8(R[4], R[5]);
+    const __m256i A3 = _mm256_unpacklo_epi8(R[6], R[7]);
+    const __m256i B0 = _mm256_unpacklo_epi16(A0, A1);
+    const __m256i B1 = _mm256_unpackhi_epi16(A0, A1);
+    const __m256i B2 = _mm256_unpacklo_epi16(A2, A3);
+    const __m256i B3 = _mm256_unpackhi_epi16(A2, A3);
+    // then the 64b halves are gathered into full 16-pixel columns
+    *c01 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(B0, B2), 0xd8);
+    *c23 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(B0, B2), 0xd8);
+    *c45 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi32(B1, B3), 0xd8);
+    *c67 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi32(B1, B3), 0xd8);
+  }
+}
+
+// Inverse of Load16x8_AVX2().
+static WEBP_AVX2_TARGET WEBP_INLINE void Store16x8_AVX2(
+    const __m256i* const c01, const __m256i* const c23,
+    const __m256i* const c45, const __m256i* const c67,
+    uint8_t* const r0, uint8_t* const r8, int stride) {
+  const __m256i G01 = _mm256_permute4x64_epi64(*c01, 0xd8);
+  const __m256i G23 = _mm256_permute4x64_epi64(*c23, 0xd8);
+  const __m256i G45 = _mm256_permute4x64_epi64(*c45, 0xd8);
+  const __m256i G67 = _mm256_permute4x64_epi64(*c67, 0xd8);
+  const __m256i E01 = _mm256_unpacklo_epi8(G01, _mm256_srli_si256(G01, 8));
+  const __m256i E23 = _mm256_unpacklo_epi8(G23, _mm256_srli_si256(G23, 8));
+  const __m256i E45 = _mm256_unpacklo_epi8(G45, _mm256_srli_si256(G45, 8));
+  const __m256i E67 = _mm256_unpacklo_epi8(G67, _mm256_srli_si256(G67, 8));
+  const __m256i I0 = _mm256_unpacklo_epi16(E01, E23);
+  const __m256i I1 = _mm256_unpackhi_epi16(E01, E23);
+  const __m256i I2 = _mm256_unpacklo_epi16(E45, E67);
+  const __m256i I3 = _mm256_unpackhi_epi16(E45, E67);
+  const __m256i J[4] = {
+    _mm256_unpacklo_epi32(I0, I2), _mm256_unpackhi_epi32(I0, I2),
+    _mm256_unpacklo_epi32(I1, I3), _mm256_unpackhi_epi32(I1, I3)
+  };
+  int i;
+  for (i = 0; i < 4; ++i) {
+    const __m128i lo = _mm256_castsi256_si128(J[i]);
+    const __m128i hi = _mm256_extracti128_si256(J[i], 1);
+    _mm_storel_epi64((__m128i*)&r0[(2 * i + 0) * stride], lo);
+    _mm_storel_epi64((__m128i*)&r8[(2 * i + 0) * stride], hi);
+    _mm_storel_epi64((__m128i*)&r0[(2 * i + 1) * stride],
+                     _mm_unpackhi_epi64(lo, lo));
+    _mm_storel_epi64((__m128i*)&r8[(2 * i + 1) * stride],
+                     _mm_unpackhi_epi64(hi, hi));
+  }
+}
+
+// Column pairs [ca | cb] and [cc | cd] to edge pairs [ca | cd] and [cb | cc].
+#define OUTER(a, b) _mm256_permute2x128_si256((a), (b), 0x30)
+#define INNER(a, b) _mm256_permute2x128_si256((a), (b), 0x21)
+// ...and back: [X | Y] and [Z | W] to [X | Z] or [Y | W].
+#define LOWS(a, b) _mm256_permute2x128_si256((a), (b), 0x20)
+#define HIGHS(a, b) _mm256_permute2x128_si256((a), (b), 0x31)
+
+// Loads the rows p - 4 * stride ... p + 3 * stride of 16 (or 8 + 8) pixels.
+#define LOAD_V_EDGE(L, p, stride, X3, X2, X1, X0) do {                         \
+  X3 = Pair_AVX2(L((p) - 4 * (stride)), L((p) + 3 * (stride)));                \
+  X2 = Pair_AVX2(L((p) - 3 * (stride)), L((p) + 2 * (stride)));                \
+  X1 = Pair_AVX2(L((p) - 2 * (stride)), L((p) + 1 * (stride)));                \
+  X0 = Pair_AVX2(L((p) - 1 * (stride)), L((p) + 0 * (stride)));                \
+} while (0)
+
+#define LOAD16(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE16(p, x) _mm_storeu_si128((__m128i*)(p), (x))
+#define LOADUV(off) _mm_unpacklo_epi64(                                        \
+    _mm_loadl_epi64((const __m128i*)(u + (off))),                              \
+    _mm_loadl_epi64((const __m128i*)(v + (off))))
+#define STOREUV(off, x) do {                                                   \
+  _mm_storel_epi64((__m128i*)(u + (off)), (x));                                \
+  _mm_storel_epi64((__m128i*)(v + (off)), _mm_unpackhi_epi64((x), (x)));       \
+} while (0)
+
+// Stores the pair X as rows p - k * stride and p + (k - 1) * stride.
+#define STORE_PAIR(S, p, stride, k, X) do {                                    \
+  S((p) - (k) * (stride), _mm256_castsi256_si128(X));                          \
+  S((p) + ((k) - 1) * (stride), _mm256_extracti128_si256((X), 1));             \
+} while (0)
+
+// on macroblock edges
+static WEBP_AVX2_TARGET void VFilter16_AVX2(uint8_t* p, int stride,
+                                            int thresh, int ithresh,
+                                            int hev_thresh) {
+  __m256i X3, X2, X1, X0, mask, not_hev;
+  LOAD_V_EDGE(LOAD16, p, stride, X3, X2, X1, X0);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter6_AVX2(&X2, &X1, &X0, &mask, &not_hev);
+  STORE_PAIR(STORE16, p, stride, 3, X2);
+  STORE_PAIR(STORE16, p, stride, 2, X1);
+  STORE_PAIR(STORE16, p, stride, 1, X0);
+}
+
+static WEBP_AVX2_TARGET void HFilter16_AVX2(uint8_t* p, int stride,
+                                            int thresh, int ithresh,
+                                            int hev_thresh) {
+  __m256i c01, c23, c45, c67, X3, X2, X1, X0, mask, not_hev;
+  uint8_t* const b = p - 4;
+  Load16x8_AVX2(b, b + 8 * stride, stride, &c01, &c23, &c45, &c67);
+  X3 = OUTER(c01, c67);
+  X2 = INNER(c01, c67);
+  X1 = OUTER(c23, c45);
+  X0 = INNER(c23, c45);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter6_AVX2(&X2, &X1, &X0, &mask, &not_hev);
+  c01 = LOWS(X3, X2);
+  c23 = LOWS(X1, X0);
+  c45 = HIGHS(X0, X1);
+  c67 = HIGHS(X2, X3);
+  Store16x8_AVX2(&c01, &c23, &c45, &c67, b, b + 8 * stride, stride);
+}
+
+// on three inner edges. There is no vertical variant: VFilter16i_SSE2() needs
+// no transpose, and the lane exchanges of the paired layout only slow it down.
+static WEBP_AVX2_TARGET void HFilter16i_AVX2(uint8_t* p, int stride,
+                                             int thresh, int ithresh,
+                                             int hev_thresh) {
+  // The whole 16x16 block is transposed once, and the three edges are
+  // filtered in registers.
+  __m256i c01, c23, c45, c67, c89, cAB, cCD, cEF;
+  __m256i X3, X2, X1, X0, Y1, Y0, mask, not_hev;
+  Load16x8_AVX2(p, p + 8 * stride, stride, &c01, &c23, &c45, &c67);
+  Load16x8_AVX2(p + 8, p + 8 + 8 * stride, stride, &c89, &cAB, &cCD, &cEF);
+
+  // edge 4: c0 ... c7
+  X3 = OUTER(c01, c67);
+  X2 = INNER(c01, c67);
+  X1 = OUTER(c23, c45);
+  X0 = INNER(c23, c45);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter4_AVX2(&X1, &X0, &mask, &not_hev);
+  c23 = LOWS(X1, X0);
+
+  // edge 8: c4 ... c11
+  X3 = HIGHS(X0, cAB);
+  X2 = INNER(X1, cAB);
+  Y1 = OUTER(c67, c89);
+  Y0 = INNER(c67, c89);
+  ComplexMask_AVX2(&X3, &X2, &Y1, &Y0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter4_AVX2(&Y1, &Y0, &mask, &not_hev);
+  c45 = LOWS(X3, X2);
+  c67 = LOWS(Y1, Y0);
+
+  // edge 12: c8 ... c15
+  X3 = HIGHS(Y0, cEF);
+  X2 = INNER(Y1, cEF);
+  X1 = OUTER(cAB, cCD);
+  X0 = INNER(cAB, cCD);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter4_AVX2(&X1, &X0, &mask, &not_hev);
+  c89 = LOWS(X3, X2);
+  cAB = LOWS(X1, X0);
+  cCD = HIGHS(X0, X1);
+
+  Store16x8_AVX2(&c01, &c23, &c45, &c67, p, p + 8 * stride, stride);
+  Store16x8_AVX2(&c89, &cAB, &cCD, &cEF, p + 8, p + 8 + 8 * stride, stride);
+}
+
+// 8-pixels wide variant, for chroma filtering: u in the low 64b of each half,
+// v in the high 64b.
+static WEBP_AVX2_TARGET void VFilter8_AVX2(uint8_t* u, uint8_t* v, int stride,
+                                           int thresh, int ithresh,
+                                           int hev_thresh) {
+  __m256i X3, X2, X1, X0, mask, not_hev;
+  LOAD_V_EDGE(LOADUV, 0, stride, X3, X2, X1, X0);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter6_AVX2(&X2, &X1, &X0, &mask, &not_hev);
+  STORE_PAIR(STOREUV, 0, stride, 3, X2);
+  STORE_PAIR(STOREUV, 0, stride, 2, X1);
+  STORE_PAIR(STOREUV, 0, stride, 1, X0);
+}
+
+static WEBP_AVX2_TARGET void HFilter8_AVX2(uint8_t* u, uint8_t* v, int stride,
+                                           int thresh, int ithresh,
+                                           int hev_thresh) {
+  __m256i c01, c23, c45, c67, X3, X2, X1, X0, mask, not_hev;
+  Load16x8_AVX2(u - 4, v - 4, stride, &c01, &c23, &c45, &c67);
+  X3 = OUTER(c01, c67);
+  X2 = INNER(c01, c67);
+  X1 = OUTER(c23, c45);
+  X0 = INNER(c23, c45);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter6_AVX2(&X2, &X1, &X0, &mask, &not_hev);
+  c01 = LOWS(X3, X2);
+  c23 = LOWS(X1, X0);
+  c45 = HIGHS(X0, X1);
+  c67 = HIGHS(X2, X3);
+  Store16x8_AVX2(&c01, &c23, &c45, &c67, u - 4, v - 4, stride);
+}
+
+static WEBP_AVX2_TARGET void HFilter8i_AVX2(uint8_t* u, uint8_t* v, int stride,
+                                            int thresh, int ithresh,
+                                            int hev_thresh) {
+  __m256i c01, c23, c45, c67, X3, X2, X1, X0, mask, not_hev;
+  Load16x8_AVX2(u, v, stride, &c01, &c23, &c45, &c67);
+  X3 = OUTER(c01, c67);
+  X2 = INNER(c01, c67);
+  X1 = OUTER(c23, c45);
+  X0 = INNER(c23, c45);
+  ComplexMask_AVX2(&X3, &X2, &X1, &X0, thresh, ithresh, hev_thresh,
+                   &mask, &not_hev);
+  DoFilter4_AVX2(&X1, &X0, &mask, &not_hev);
+  c23 = LOWS(X1, X0);
+  c45 = HIGHS(X0, X1);
+  Store16x8_AVX2(&c01, &c23, &c45, &c67, u, v, stride);
+}
+
+#undef OUTER
+#undef INNER
+#undef LOWS
+#undef HIGHS
+#undef LOAD_V_EDGE
+#undef LOAD16
+#undef STORE16
+#undef LOADUV
+#undef STOREUV
+#undef STORE_PAIR
+#undef MM256_ABS
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8DspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8DspInitAVX2(void) {
+  VP8TransformUV = TransformUV_AVX2;
+
+  VP8VFilter16 = VFilter16_AVX2;
+  VP8HFilter16 = HFilter16_AVX2;
+  VP8VFilter8 = VFilter8_AVX2;
+  VP8HFilter8 = HFilter8_AVX2;
+  VP8HFilter16i = HFilter16i_AVX2;
+  VP8HFilter8i = HFilter8i_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8DspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
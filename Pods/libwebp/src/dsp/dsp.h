@@ -76,6 +76,20 @@ extern "C" {
 #define WEBP_USE_SSE41
 #endif
 
+// AVX2 functions are tagged with WEBP_AVX2_TARGET instead of requiring the
+// whole file to be built with -mavx2, so that an SSE2 build still carries them
+// for selection at run time through VP8GetCPUInfo(kAVX2).
+#if defined(__AVX2__) || defined(WEBP_HAVE_AVX2) || \
+    (defined(_MSC_VER) && _MSC_VER >= 1700 &&      \
+     (defined(_M_X64) || defined(_M_IX86)))
+#define WEBP_USE_AVX2
+#define WEBP_AVX2_TARGET
+#elif defined(WEBP_USE_SSE2) && (defined(__x86_64__) || defined(__i386__)) && \
+      (LOCAL_GCC_PREREQ(4, 9) || LOCAL_CLANG_PREREQ(3, 8))
+#define WEBP_USE_AVX2
+#define WEBP_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
 // The intrinsics currently cause compiler errors with arm-nacl-gcc and the
 // inline assembly would need to be modified for use with Native Client.
 #if (defined(__ARM_NEON__) || \
@@ -0,0 +1,62 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 variant of methods for lossless decoder
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include "src/dsp/lossless.h"
+#include <immintrin.h>
+
+//------------------------------------------------------------------------------
+// Color-space conversion functions
+
+static WEBP_AVX2_TARGET void ConvertBGRAToRGBA_AVX2(const uint32_t* src,
+                                                    int num_pixels,
+                                                    uint8_t* dst) {
+  // exchange the B and R bytes of each pixel
+  const __m256i kShuffle = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i* in = (const __m256i*)src;
+  __m256i* out = (__m256i*)dst;
+  while (num_pixels >= 16) {
+    const __m256i A1 = _mm256_loadu_si256(in++);
+    const __m256i A2 = _mm256_loadu_si256(in++);
+    _mm256_storeu_si256(out++, _mm256_shuffle_epi8(A1, kShuffle));
+    _mm256_storeu_si256(out++, _mm256_shuffle_epi8(A2, kShuffle));
+    num_pixels -= 16;
+  }
+  if (num_pixels >= 8) {
+    const __m256i A = _mm256_loadu_si256(in++);
+    _mm256_storeu_si256(out++, _mm256_shuffle_epi8(A, kShuffle));
+    num_pixels -= 8;
+  }
+  // left-overs
+  if (num_pixels > 0) {
+    VP8LConvertBGRAToRGBA_C((const uint32_t*)in, num_pixels, (uint8_t*)out);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8LDspInitAVX2(void) {
+  VP8LConvertBGRAToRGBA = ConvertBGRAToRGBA_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8LDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
@@ -218,6 +218,7 @@ WebPYUV444Converter WebPYUV444Converters[MODE_LAST];
 extern void WebPInitYUV444ConvertersMIPSdspR2(void);
 extern void WebPInitYUV444ConvertersSSE2(void);
 extern void WebPInitYUV444ConvertersSSE41(void);
+extern void WebPInitYUV444ConvertersAVX2(void);
 
 WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
   WebPYUV444Converters[MODE_RGBA]      = WebPYuv444ToRgba_C;
@@ -243,6 +244,11 @@ WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
       WebPInitYUV444ConvertersSSE41();
     }
 #endif
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPInitYUV444ConvertersAVX2();
+    }
+#endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitYUV444ConvertersMIPSdspR2();
@@ -256,6 +262,7 @@ WEBP_DSP_INIT_FUNC(WebPInitYUV444Converters) {
 
 extern void WebPInitUpsamplersSSE2(void);
 extern void WebPInitUpsamplersSSE41(void);
+extern void WebPInitUpsamplersAVX2(void);
 extern void WebPInitUpsamplersNEON(void);
 extern void WebPInitUpsamplersMIPSdspR2(void);
 extern void WebPInitUpsamplersMSA(void);
@@ -288,6 +295,11 @@ WEBP_DSP_INIT_FUNC(WebPInitUpsamplers) {
       WebPInitUpsamplersSSE41();
     }
 #endif
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPInitUpsamplersAVX2();
+    }
+#endif
 #if defined(WEBP_USE_MIPS_DSP_R2)
     if (VP8GetCPUInfo(kMIPSdspR2)) {
       WebPInitUpsamplersMIPSdspR2();
@@ -72,6 +72,7 @@ WebPSamplerRowFunc WebPSamplers[MODE_LAST];
 
 extern void WebPInitSamplersSSE2(void);
 extern void WebPInitSamplersSSE41(void);
+extern void WebPInitSamplersAVX2(void);
 extern void WebPInitSamplersMIPS32(void);
 extern void WebPInitSamplersMIPSdspR2(void);
 
@@ -100,6 +101,11 @@ WEBP_DSP_INIT_FUNC(WebPInitSamplers) {
       WebPInitSamplersSSE41();
     }
 #endif  // WEBP_USE_SSE41
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPInitSamplersAVX2();
+    }
+#endif  // WEBP_USE_AVX2
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       WebPInitSamplersMIPS32();
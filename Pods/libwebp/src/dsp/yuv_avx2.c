@@ -0,0 +1,350 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 variant of YUV->RGB conversion functions: same arithmetic as the SSE2
+// version, sixteen pixels at a time.
+
+#include "src/dsp/yuv.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include <immintrin.h>
+
+//-----------------------------------------------------------------------------
+// Convert spans of 32 pixels to various RGB formats for the fancy upsampler.
+
+// See ConvertYUV444ToRGB_SSE2() for the constants and ranges.
+static WEBP_AVX2_TARGET WEBP_INLINE void ConvertYUV444ToRGB_AVX2(
+    const __m256i* const Y0, const __m256i* const U0, const __m256i* const V0,
+    __m256i* const R, __m256i* const G, __m256i* const B) {
+  const __m256i k19077 = _mm256_set1_epi16(19077);
+  const __m256i k26149 = _mm256_set1_epi16(26149);
+  const __m256i k14234 = _mm256_set1_epi16(14234);
+  // 33050 doesn't fit in a signed short: only use this with unsigned arithmetic
+  const __m256i k33050 = _mm256_set1_epi16((short)33050);
+  const __m256i k17685 = _mm256_set1_epi16(17685);
+  const __m256i k6419  = _mm256_set1_epi16(6419);
+  const __m256i k13320 = _mm256_set1_epi16(13320);
+  const __m256i k8708  = _mm256_set1_epi16(8708);
+
+  const __m256i Y1 = _mm256_mulhi_epu16(*Y0, k19077);
+
+  const __m256i R0 = _mm256_mulhi_epu16(*V0, k26149);
+  const __m256i R1 = _mm256_sub_epi16(Y1, k14234);
+  const __m256i R2 = _mm256_add_epi16(R1, R0);
+
+  const __m256i G0 = _mm256_mulhi_epu16(*U0, k6419);
+  const __m256i G1 = _mm256_mulhi_epu16(*V0, k13320);
+  const __m256i G2 = _mm256_add_epi16(Y1, k8708);
+  const __m256i G3 = _mm256_add_epi16(G0, G1);
+  const __m256i G4 = _mm256_sub_epi16(G2, G3);
+
+  // be careful with the saturated *unsigned* arithmetic here!
+  const __m256i B0 = _mm256_mulhi_epu16(*U0, k33050);
+  const __m256i B1 = _mm256_adds_epu16(B0, Y1);
+  const __m256i B2 = _mm256_subs_epu16(B1, k17685);
+
+  // use logical shift for B2, which can be larger than 32767
+  *R = _mm256_srai_epi16(R2, 6);   // range: [-14234, 30815]
+  *G = _mm256_srai_epi16(G4, 6);   // range: [-10953, 27710]
+  *B = _mm256_srli_epi16(B2, 6);   // range: [0, 34238]
+}
+
+// Load 16 bytes into the *upper* part of 16b words. That's "<< 8", basically.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i Load_HI_16_AVX2(
+    const uint8_t* src) {
+  const __m128i in = _mm_loadu_si128((const __m128i*)src);
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(in), 8);
+}
+
+// Load and replicate 8 U/V samples
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i Load_UV_HI_8_AVX2(
+    const uint8_t* src) {
+  const __m128i in = _mm_loadl_epi64((const __m128i*)src);
+  const __m128i tmp = _mm_unpacklo_epi8(in, in);   // replicate samples
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(tmp), 8);
+}
+
+// Convert 16 samples of YUV444 to R/G/B
+static WEBP_AVX2_TARGET WEBP_INLINE void YUV444ToRGB_AVX2(
+    const uint8_t* const y, const uint8_t* const u, const uint8_t* const v,
+    __m256i* const R, __m256i* const G, __m256i* const B) {
+  const __m256i Y0 = Load_HI_16_AVX2(y), U0 = Load_HI_16_AVX2(u),
+                V0 = Load_HI_16_AVX2(v);
+  ConvertYUV444ToRGB_AVX2(&Y0, &U0, &V0, R, G, B);
+}
+
+// Convert 16 samples of YUV420 to R/G/B
+static WEBP_AVX2_TARGET WEBP_INLINE void YUV420ToRGB_AVX2(
+    const uint8_t* const y, const uint8_t* const u, const uint8_t* const v,
+    __m256i* const R, __m256i* const G, __m256i* const B) {
+  const __m256i Y0 = Load_HI_16_AVX2(y), U0 = Load_UV_HI_8_AVX2(u),
+                V0 = Load_UV_HI_8_AVX2(v);
+  ConvertYUV444ToRGB_AVX2(&Y0, &U0, &V0, R, G, B);
+}
+
+// Pack R/G/B/A results into 32b output.
+static WEBP_AVX2_TARGET WEBP_INLINE void PackAndStore4_AVX2(
+    const __m256i* const R, const __m256i* const G, const __m256i* const B,
+    const __m256i* const A, uint8_t* const dst) {
+  // Lane 0 holds pixels 0-7, lane 1 pixels 8-15.
+  const __m256i rb = _mm256_packus_epi16(*R, *B);
+  const __m256i ga = _mm256_packus_epi16(*G, *A);
+  const __m256i rg = _mm256_unpacklo_epi8(rb, ga);
+  const __m256i ba = _mm256_unpackhi_epi8(rb, ga);
+  const __m256i RGBA_lo = _mm256_unpacklo_epi16(rg, ba);   // 0-3 | 8-11
+  const __m256i RGBA_hi = _mm256_unpackhi_epi16(rg, ba);   // 4-7 | 12-15
+  _mm256_storeu_si256((__m256i*)(dst +  0),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x20));
+  _mm256_storeu_si256((__m256i*)(dst + 32),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x31));
+}
+
+// Byte shuffles gathering the R, G or B samples of sixteen pixels into each of
+// the three 16-byte chunks of their rgbrgbrgb... output.
+static const uint8_t kPlanarTo24bShuffles[3][3][16] = {
+  { { 0, 128, 128, 1, 128, 128, 2, 128, 128, 3, 128, 128, 4, 128, 128, 5 },
+    { 128, 0, 128, 128, 1, 128, 128, 2, 128, 128, 3, 128, 128, 4, 128, 128 },
+    { 128, 128, 0, 128, 128, 1, 128, 128, 2, 128, 128, 3, 128, 128, 4, 128 } },
+  { { 128, 128, 6, 128, 128, 7, 128, 128, 8, 128, 128, 9, 128, 128, 10, 128 },
+    { 5, 128, 128, 6, 128, 128, 7, 128, 128, 8, 128, 128, 9, 128, 128, 10 },
+    { 128, 5, 128, 128, 6, 128, 128, 7, 128, 128, 8, 128, 128, 9, 128, 128 } },
+  { { 128, 11, 128, 128, 12, 128, 128, 13, 128, 128, 14, 128, 128, 15, 128,
+      128 },
+    { 128, 128, 11, 128, 128, 12, 128, 128, 13, 128, 128, 14, 128, 128, 15,
+      128 },
+    { 10, 128, 128, 11, 128, 128, 12, 128, 128, 13, 128, 128, 14, 128, 128,
+      15 } }
+};
+
+// Interleaves the 8b planes of 32 pixels (pixels 0-15 in the low lane, 16-31
+// in the high lane) as one 16-byte output chunk per lane.
+static WEBP_AVX2_TARGET WEBP_INLINE __m256i PlanarTo24bChunk_AVX2(
+    const __m256i* const r, const __m256i* const g, const __m256i* const b,
+    int chunk) {
+  const __m256i kR = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i*)kPlanarTo24bShuffles[chunk][0]));
+  const __m256i kG = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i*)kPlanarTo24bShuffles[chunk][1]));
+  const __m256i kB = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i*)kPlanarTo24bShuffles[chunk][2]));
+  return _mm256_or_si256(
+      _mm256_or_si256(_mm256_shuffle_epi8(*r, kR), _mm256_shuffle_epi8(*g, kG)),
+      _mm256_shuffle_epi8(*b, kB));
+}
+
+// Pack the 16b planes of 32 pixels (two registers each) and store them as
+// rgbrgbrgb... (or bgrbgrbgr... with R and B exchanged).
+static WEBP_AVX2_TARGET WEBP_INLINE void PackAndStore3_AVX2(
+    const __m256i* const R0, const __m256i* const R1,
+    const __m256i* const G0, const __m256i* const G1,
+    const __m256i* const B0, const __m256i* const B1, uint8_t* const rgb) {
+  // packus works within lanes: restore the pixel order afterward.
+  const __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(*R0, *R1),
+                                             0xd8);
+  const __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(*G0, *G1),
+                                             0xd8);
+  const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(*B0, *B1),
+                                             0xd8);
+  const __m256i out0 = PlanarTo24bChunk_AVX2(&r, &g, &b, 0);
+  const __m256i out1 = PlanarTo24bChunk_AVX2(&r, &g, &b, 1);
+  const __m256i out2 = PlanarTo24bChunk_AVX2(&r, &g, &b, 2);
+  _mm256_storeu_si256((__m256i*)(rgb +  0),
+                      _mm256_permute2x128_si256(out0, out1, 0x20));
+  _mm256_storeu_si256((__m256i*)(rgb + 32),
+                      _mm256_permute2x128_si256(out2, out0, 0x30));
+  _mm256_storeu_si256((__m256i*)(rgb + 64),
+                      _mm256_permute2x128_si256(out1, out2, 0x31));
+}
+
+WEBP_AVX2_TARGET void VP8YuvToRgba32_AVX2(const uint8_t* y, const uint8_t* u,
+                                          const uint8_t* v, uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&R, &G, &B, &kAlpha, dst);
+  }
+}
+
+WEBP_AVX2_TARGET void VP8YuvToBgra32_AVX2(const uint8_t* y, const uint8_t* u,
+                                          const uint8_t* v, uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&B, &G, &R, &kAlpha, dst);
+  }
+}
+
+WEBP_AVX2_TARGET void VP8YuvToArgb32_AVX2(const uint8_t* y, const uint8_t* u,
+                                          const uint8_t* v, uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB_AVX2(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4_AVX2(&kAlpha, &R, &G, &B, dst);
+  }
+}
+
+WEBP_AVX2_TARGET void VP8YuvToRgb32_AVX2(const uint8_t* y, const uint8_t* u,
+                                         const uint8_t* v, uint8_t* dst) {
+  __m256i R0, R1, G0, G1, B0, B1;
+  YUV444ToRGB_AVX2(y +  0, u +  0, v +  0, &R0, &G0, &B0);
+  YUV444ToRGB_AVX2(y + 16, u + 16, v + 16, &R1, &G1, &B1);
+  PackAndStore3_AVX2(&R0, &R1, &G0, &G1, &B0, &B1, dst);
+}
+
+WEBP_AVX2_TARGET void VP8YuvToBgr32_AVX2(const uint8_t* y, const uint8_t* u,
+                                         const uint8_t* v, uint8_t* dst) {
+  __m256i R0, R1, G0, G1, B0, B1;
+  YUV444ToRGB_AVX2(y +  0, u +  0, v +  0, &R0, &G0, &B0);
+  YUV444ToRGB_AVX2(y + 16, u + 16, v + 16, &R1, &G1, &B1);
+  PackAndStore3_AVX2(&B0, &B1, &G0, &G1, &R0, &R1, dst);
+}
+
+//-----------------------------------------------------------------------------
+// Arbitrary-length row conversion functions
+
+static WEBP_AVX2_TARGET void YuvToRgbaRow_AVX2(const uint8_t* y,
+                                               const uint8_t* u,
+                                               const uint8_t* v,
+                                               uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&R, &G, &B, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgba(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static WEBP_AVX2_TARGET void YuvToBgraRow_AVX2(const uint8_t* y,
+                                               const uint8_t* u,
+                                               const uint8_t* v,
+                                               uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&B, &G, &R, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToBgra(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static WEBP_AVX2_TARGET void YuvToArgbRow_AVX2(const uint8_t* y,
+                                               const uint8_t* u,
+                                               const uint8_t* v,
+                                               uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB_AVX2(y, u, v, &R, &G, &B);
+    PackAndStore4_AVX2(&kAlpha, &R, &G, &B, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToArgb(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static WEBP_AVX2_TARGET void YuvToRgbRow_AVX2(const uint8_t* y,
+                                              const uint8_t* u,
+                                              const uint8_t* v,
+                                              uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 32 <= len; n += 32, dst += 32 * 3) {
+    __m256i R0, R1, G0, G1, B0, B1;
+    YUV420ToRGB_AVX2(y +  0, u + 0, v + 0, &R0, &G0, &B0);
+    YUV420ToRGB_AVX2(y + 16, u + 8, v + 8, &R1, &G1, &B1);
+    PackAndStore3_AVX2(&R0, &R1, &G0, &G1, &B0, &B1, dst);
+    y += 32;
+    u += 16;
+    v += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgb(y[0], u[0], v[0], dst);
+    dst += 3;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static WEBP_AVX2_TARGET void YuvToBgrRow_AVX2(const uint8_t* y,
+                                              const uint8_t* u,
+                                              const uint8_t* v,
+                                              uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 32 <= len; n += 32, dst += 32 * 3) {
+    __m256i R0, R1, G0, G1, B0, B1;
+    YUV420ToRGB_AVX2(y +  0, u + 0, v + 0, &R0, &G0, &B0);
+    YUV420ToRGB_AVX2(y + 16, u + 8, v + 8, &R1, &G1, &B1);
+    PackAndStore3_AVX2(&B0, &B1, &G0, &G1, &R0, &R1, dst);
+    y += 32;
+    u += 16;
+    v += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToBgr(y[0], u[0], v[0], dst);
+    dst += 3;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitSamplersAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplersAVX2(void) {
+  WebPSamplers[MODE_RGB]  = YuvToRgbRow_AVX2;
+  WebPSamplers[MODE_RGBA] = YuvToRgbaRow_AVX2;
+  WebPSamplers[MODE_BGR]  = YuvToBgrRow_AVX2;
+  WebPSamplers[MODE_BGRA] = YuvToBgraRow_AVX2;
+  WebPSamplers[MODE_ARGB] = YuvToArgbRow_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(WebPInitSamplersAVX2)
+
+#endif  // WEBP_USE_AVX2
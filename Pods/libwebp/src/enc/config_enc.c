@@ -117,7 +117,7 @@ int WebPValidateConfig(const WebPConfig* config) {
   if (config->near_lossless < 0 || config->near_lossless > 100) return 0;
   if (config->image_hint >= WEBP_HINT_LAST) return 0;
   if (config->emulate_jpeg_size < 0 || config->emulate_jpeg_size > 1) return 0;
-  if (config->thread_level < 0 || config->thread_level > 1) return 0;
+  if (config->thread_level < 0) return 0;
   if (config->low_memory < 0 || config->low_memory > 1) return 0;
   if (config->exact < 0 || config->exact > 1) return 0;
   if (config->use_delta_palette < 0 || config->use_delta_palette > 1) {
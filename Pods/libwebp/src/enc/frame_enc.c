@@ -405,8 +405,10 @@ static void RecordResiduals(VP8EncIterator* const it,
 
 #if !defined(DISABLE_TOKEN_BUFFER)
 
+// Records the tokens, and their statistics into 'stats'.
 static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
-                        VP8TBuffer* const tokens) {
+                        VP8TBuffer* const tokens,
+                        StatsArray (* const stats)[NUM_BANDS]) {
   int x, y, ch;
   VP8Residual res;
   VP8Encoder* const enc = it->enc_;
@@ -415,12 +417,15 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
   if (it->mb_->type_ == 1) {   // i16x16
     const int ctx = it->top_nz_[8] + it->left_nz_[8];
     VP8InitResidual(0, 1, enc, &res);
+    res.stats = stats[1];
     VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz_[8] = it->left_nz_[8] =
         VP8RecordCoeffTokens(ctx, &res, tokens);
     VP8InitResidual(1, 0, enc, &res);
+    res.stats = stats[0];
   } else {
     VP8InitResidual(0, 3, enc, &res);
+    res.stats = stats[3];
   }
 
   // luma-AC
@@ -435,6 +440,7 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
 
   // U/V
   VP8InitResidual(0, 2, enc, &res);
+  res.stats = stats[2];
   for (ch = 0; ch <= 2; ch += 2) {
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
@@ -771,6 +777,271 @@ int VP8EncLoop(VP8Encoder* const enc) {
 
 #define MIN_COUNT 96  // minimum number of macroblocks before updating stats
 
+// With thread_level > 1, the macroblock rows are coded as a wavefront: each
+// job codes one row, staying two macroblocks behind the row above so that
+// the top (and top-right) samples and contexts it reads are final. The jobs
+// are synchronized every TOKEN_JOB_MBS macroblocks, which is also when their
+// token statistics are merged and the probabilities refreshed. Hence the
+// output depends on the number of jobs, but not on the thread timing.
+#define MAX_TOKEN_JOBS 8   // maximum number of rows coded in parallel
+#define TOKEN_JOB_MBS 8    // number of macroblocks coded by a job in one step
+
+typedef struct {
+  WebPWorker worker_;
+  VP8EncIterator it_;      // positioned on the next macroblock to code
+  VP8TBuffer* tokens_;     // token buffer for the current row
+  int row_;                // current row, or -1 if idle
+  int num_mbs_;            // number of macroblocks to code in this step
+  int is_last_pass_;
+  VP8RDLevel rd_opt_;
+  uint64_t size_p0_;
+  uint64_t distortion_;
+  StatsArray stats_[NUM_TYPES][NUM_BANDS];  // not yet merged into proba_
+  LFStats lf_stats_;
+  int max_edge_[NUM_MB_SEGMENTS];           // not yet merged into enc->dqm_
+} TokenJob;
+
+typedef struct {
+  int num_jobs_;
+  TokenJob* jobs_;       // only used if num_jobs_ > 1
+  int num_rows_;
+  VP8TBuffer* rows_;     // token buffers, in coding order
+  int* row_done_;        // number of coded macroblocks per row
+} TokenJobs;
+
+static int GetNumTokenJobs(const VP8Encoder* const enc) {
+#ifdef WEBP_USE_THREAD
+  int num_jobs = enc->thread_level_;
+  // the side statistics are accumulated in the encoder, not per job
+  if (enc->pic_->stats != NULL) return 1;
+  if (num_jobs > MAX_TOKEN_JOBS) num_jobs = MAX_TOKEN_JOBS;
+  if (num_jobs > enc->mb_h_) num_jobs = enc->mb_h_;
+  return (num_jobs > 1) ? num_jobs : 1;
+#else
+  (void)enc;
+  return 1;
+#endif
+}
+
+static int TokenJobHook(void* arg1, void* arg2) {
+  TokenJob* const job = (TokenJob*)arg1;
+  VP8EncIterator* const it = &job->it_;
+  int n;
+  (void)arg2;
+  for (n = 0; n < job->num_mbs_; ++n) {
+    VP8ModeScore info;
+    VP8IteratorImport(it, NULL);
+    VP8Decimate(it, &info, job->rd_opt_);
+    if (!RecordTokens(it, &info, job->tokens_, job->stats_)) return 0;
+    job->size_p0_ += info.H;
+    job->distortion_ += info.D;
+    if (job->is_last_pass_) {
+      StoreSideInfo(it);
+      VP8StoreFilterStats(it);
+      VP8IteratorExport(it);
+    }
+    VP8IteratorSaveBoundary(it);
+    VP8IteratorNext(it);
+  }
+  return 1;
+}
+
+static int InitTokenJobs(VP8Encoder* const enc, TokenJobs* const jobs) {
+  const int num_jobs = GetNumTokenJobs(enc);
+  memset(jobs, 0, sizeof(*jobs));
+  jobs->num_jobs_ = num_jobs;
+  if (num_jobs == 1) {
+    jobs->num_rows_ = 1;
+    jobs->rows_ = &enc->tokens_;
+  } else {
+    const WebPWorkerInterface* const worker_interface =
+        WebPGetWorkerInterface();
+    const int mb_h = enc->mb_h_;
+    const size_t size = num_jobs * sizeof(*jobs->jobs_)
+                      + mb_h * sizeof(*jobs->rows_)
+                      + mb_h * sizeof(*jobs->row_done_);
+    uint8_t* const mem = (uint8_t*)WebPSafeMalloc(1ULL, size);
+    int j, y, ok = 1;
+    if (mem == NULL) {
+      return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    jobs->jobs_ = (TokenJob*)mem;
+    jobs->rows_ = (VP8TBuffer*)(jobs->jobs_ + num_jobs);
+    jobs->row_done_ = (int*)(jobs->rows_ + mb_h);
+    jobs->num_rows_ = mb_h;
+    for (y = 0; y < mb_h; ++y) {
+      VP8TBufferInit(&jobs->rows_[y], enc->tokens_.page_size_ / mb_h);
+    }
+    for (j = 0; j < num_jobs; ++j) {
+      TokenJob* const job = &jobs->jobs_[j];
+      worker_interface->Init(&job->worker_);
+      job->worker_.data1 = job;
+      job->worker_.data2 = NULL;
+      job->worker_.hook = TokenJobHook;
+      memset(job->stats_, 0, sizeof(job->stats_));
+      // the first job is run by the calling thread, using Execute()
+      if (j > 0) ok &= worker_interface->Reset(&job->worker_);
+    }
+    if (!ok) {
+      return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+  }
+  return 1;
+}
+
+static void DeleteTokenJobs(TokenJobs* const jobs) {
+  if (jobs->jobs_ != NULL) {
+    const WebPWorkerInterface* const worker_interface =
+        WebPGetWorkerInterface();
+    int j, y;
+    for (j = 0; j < jobs->num_jobs_; ++j) {
+      worker_interface->End(&jobs->jobs_[j].worker_);
+    }
+    for (y = 0; y < jobs->num_rows_; ++y) {
+      VP8TBufferClear(&jobs->rows_[y]);
+    }
+    WebPSafeFree(jobs->jobs_);
+  }
+  memset(jobs, 0, sizeof(*jobs));
+}
+
+// Adds two counters the way VP8RecordStats() would have accumulated them.
+static proba_t MergeStats(proba_t a, proba_t b) {
+  uint32_t nb = (a & 0xffffu) + (b & 0xffffu);
+  uint32_t total = (a >> 16) + (b >> 16);
+  while (total >= 0xfffeu) {
+    nb = (nb + 1) >> 1;
+    total = (total + 1) >> 1;
+  }
+  return (total << 16) | nb;
+}
+
+static void MergeTokenStats(TokenJobs* const jobs, VP8EncProba* const proba) {
+  int j, t, b, c, p;
+  for (j = 0; j < jobs->num_jobs_; ++j) {
+    TokenJob* const job = &jobs->jobs_[j];
+    for (t = 0; t < NUM_TYPES; ++t) {
+      for (b = 0; b < NUM_BANDS; ++b) {
+        for (c = 0; c < NUM_CTX; ++c) {
+          for (p = 0; p < NUM_PROBAS; ++p) {
+            proba->stats_[t][b][c][p] =
+                MergeStats(proba->stats_[t][b][c][p], job->stats_[t][b][c][p]);
+          }
+        }
+      }
+    }
+    memset(job->stats_, 0, sizeof(job->stats_));
+  }
+}
+
+// Codes one pass over all the macroblocks, using the jobs in parallel.
+static int TokenPassMT(VP8Encoder* const enc, TokenJobs* const jobs,
+                       int is_last_pass, int max_count,
+                       uint64_t* const size_p0, uint64_t* const distortion) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  VP8EncProba* const proba = &enc->proba_;
+  const int mb_w = enc->mb_w_, mb_h = enc->mb_h_;
+  const int total_mbs = mb_w * mb_h;
+  const int percent0 = enc->percent_;
+  int* const row_done = jobs->row_done_;
+  int next_row = 0;
+  int num_done = 0;
+  int cnt = 0;
+  int ok = 1;
+  int j, y;
+
+  for (y = 0; y < mb_h; ++y) {
+    VP8TBufferClear(&jobs->rows_[y]);
+    row_done[y] = 0;
+  }
+  for (j = 0; j < jobs->num_jobs_; ++j) {
+    TokenJob* const job = &jobs->jobs_[j];
+    VP8IteratorInit(enc, &job->it_);
+    job->it_.lf_stats_ = (enc->lf_stats_ != NULL) ? &job->lf_stats_ : NULL;
+    job->it_.max_edge_ = job->max_edge_;
+    memset(job->max_edge_, 0, sizeof(job->max_edge_));
+    if (is_last_pass) VP8InitFilter(&job->it_);
+    job->row_ = -1;
+    job->is_last_pass_ = is_last_pass;
+    job->rd_opt_ = enc->rd_opt_level_;
+    job->size_p0_ = 0;
+    job->distortion_ = 0;
+  }
+
+  while (ok && num_done < total_mbs) {
+    // Give each job its next chunk, within the range finished above it.
+    for (j = 0; j < jobs->num_jobs_; ++j) {
+      TokenJob* const job = &jobs->jobs_[j];
+      if (job->row_ < 0 && next_row < mb_h) {
+        job->row_ = next_row++;
+        job->tokens_ = &jobs->rows_[job->row_];
+        VP8IteratorSetRow(&job->it_, job->row_);
+      }
+      job->num_mbs_ = 0;
+      if (job->row_ >= 0) {
+        const int x = row_done[job->row_];
+        const int above = (job->row_ > 0) ? row_done[job->row_ - 1] : mb_w;
+        int x_end = (above == mb_w) ? mb_w : above - 1;
+        if (x_end > x + TOKEN_JOB_MBS) x_end = x + TOKEN_JOB_MBS;
+        if (x_end > x) job->num_mbs_ = x_end - x;
+      }
+    }
+    for (j = 1; j < jobs->num_jobs_; ++j) {
+      if (jobs->jobs_[j].num_mbs_ > 0) {
+        worker_interface->Launch(&jobs->jobs_[j].worker_);
+      }
+    }
+    if (jobs->jobs_[0].num_mbs_ > 0) {
+      worker_interface->Execute(&jobs->jobs_[0].worker_);
+    }
+    for (j = 0; j < jobs->num_jobs_; ++j) {
+      TokenJob* const job = &jobs->jobs_[j];
+      ok &= worker_interface->Sync(&job->worker_);
+      if (job->num_mbs_ > 0) {
+        row_done[job->row_] += job->num_mbs_;
+        if (row_done[job->row_] == mb_w) job->row_ = -1;
+        num_done += job->num_mbs_;
+        cnt += job->num_mbs_;
+      }
+    }
+    if (!ok) {
+      WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      break;
+    }
+    if (cnt > max_count) {
+      MergeTokenStats(jobs, proba);
+      FinalizeTokenProbas(proba);
+      VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+      cnt = 0;
+    }
+    if (is_last_pass) {
+      ok = WebPReportProgress(enc->pic_, percent0 + 20 * num_done / total_mbs,
+                              &enc->percent_);
+    }
+  }
+  MergeTokenStats(jobs, proba);
+
+  for (j = 0; j < jobs->num_jobs_; ++j) {
+    const TokenJob* const job = &jobs->jobs_[j];
+    int s;
+    *size_p0 += job->size_p0_;
+    *distortion += job->distortion_;
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      const int max_edge = job->max_edge_[s];
+      if (max_edge > enc->dqm_[s].max_edge_) enc->dqm_[s].max_edge_ = max_edge;
+    }
+    if (is_last_pass && enc->lf_stats_ != NULL) {
+      int i;
+      for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+        for (i = 0; i < MAX_LF_LEVELS; ++i) {
+          (*enc->lf_stats_)[s][i] += job->lf_stats_[s][i];
+        }
+      }
+    }
+  }
+  return ok;
+}
+
 int VP8EncTokenLoop(VP8Encoder* const enc) {
   // Roughly refresh the proba eight times per pass
   int max_count = (enc->mb_w_ * enc->mb_h_) >> 3;
@@ -781,7 +1052,9 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   const VP8RDLevel rd_opt = enc->rd_opt_level_;
   const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
   PassStats stats;
+  TokenJobs jobs;
   int ok;
+  int y;
 
   InitPassStats(enc, &stats);
   ok = PreLoopInitialize(enc);
@@ -795,6 +1068,12 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   assert(rd_opt >= RD_OPT_BASIC);   // otherwise, token-buffer won't be useful
   assert(num_pass_left > 0);
 
+  if (!InitTokenJobs(enc, &jobs)) {
+    DeleteTokenJobs(&jobs);
+    VP8EncFreeBitWriters(enc);
+    return 0;
+  }
+
   while (ok && num_pass_left-- > 0) {
     const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
                              (num_pass_left == 0) ||
@@ -808,38 +1087,45 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       ResetTokenStats(enc);
       VP8InitFilter(&it);  // don't collect stats until last pass (too costly)
     }
-    VP8TBufferClear(&enc->tokens_);
-    do {
-      VP8ModeScore info;
-      VP8IteratorImport(&it, NULL);
-      if (--cnt < 0) {
-        FinalizeTokenProbas(proba);
-        VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
-        cnt = max_count;
-      }
-      VP8Decimate(&it, &info, rd_opt);
-      ok = RecordTokens(&it, &info, &enc->tokens_);
-      if (!ok) {
-        WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
-        break;
-      }
-      size_p0 += info.H;
-      distortion += info.D;
-      if (is_last_pass) {
-        StoreSideInfo(&it);
-        VP8StoreFilterStats(&it);
-        VP8IteratorExport(&it);
-        ok = VP8IteratorProgress(&it, 20);
-      }
-      VP8IteratorSaveBoundary(&it);
-    } while (ok && VP8IteratorNext(&it));
+    if (jobs.num_jobs_ > 1) {
+      ok = TokenPassMT(enc, &jobs, is_last_pass, max_count,
+                       &size_p0, &distortion);
+    } else {
+      VP8TBufferClear(&enc->tokens_);
+      do {
+        VP8ModeScore info;
+        VP8IteratorImport(&it, NULL);
+        if (--cnt < 0) {
+          FinalizeTokenProbas(proba);
+          VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+          cnt = max_count;
+        }
+        VP8Decimate(&it, &info, rd_opt);
+        ok = RecordTokens(&it, &info, &enc->tokens_, proba->stats_);
+        if (!ok) {
+          WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+          break;
+        }
+        size_p0 += info.H;
+        distortion += info.D;
+        if (is_last_pass) {
+          StoreSideInfo(&it);
+          VP8StoreFilterStats(&it);
+          VP8IteratorExport(&it);
+          ok = VP8IteratorProgress(&it, 20);
+        }
+        VP8IteratorSaveBoundary(&it);
+      } while (ok && VP8IteratorNext(&it));
+    }
     if (!ok) break;
 
     size_p0 += enc->segment_hdr_.size_;
     if (stats.do_size_search) {
       uint64_t size = FinalizeTokenProbas(&enc->proba_);
-      size += VP8EstimateTokenSize(&enc->tokens_,
-                                   (const uint8_t*)proba->coeffs_);
+      for (y = 0; y < jobs.num_rows_; ++y) {
+        size += VP8EstimateTokenSize(&jobs.rows_[y],
+                                     (const uint8_t*)proba->coeffs_);
+      }
       size = (size + size_p0 + 1024) >> 11;  // -> size in bytes
       size += HEADER_SIZE_ESTIMATE;
       stats.value = (double)size;
@@ -871,9 +1157,12 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
     if (!stats.do_size_search) {
       FinalizeTokenProbas(&enc->proba_);
     }
-    ok = VP8EmitTokens(&enc->tokens_, enc->parts_ + 0,
-                       (const uint8_t*)proba->coeffs_, 1);
+    for (y = 0; ok && y < jobs.num_rows_; ++y) {
+      ok = VP8EmitTokens(&jobs.rows_[y], enc->parts_ + 0,
+                         (const uint8_t*)proba->coeffs_, 1);
+    }
   }
+  DeleteTokenJobs(&jobs);
   ok = ok && WebPReportProgress(enc->pic_, enc->percent_ + 20, &enc->percent_);
   return PostLoopFinalize(&it, ok);
 }
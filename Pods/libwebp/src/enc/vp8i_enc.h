@@ -243,6 +243,8 @@ typedef struct {
   uint64_t      luma_bits_;        // macroblock bit-cost for luma
   uint64_t      uv_bits_;          // macroblock bit-cost for chroma
   LFStats*      lf_stats_;         // filter stats (borrowed from enc_)
+  int*          max_edge_;         // per-segment max edge delta, if not NULL
+                                   // (otherwise stored in enc_->dqm_[])
   int           do_trellis_;       // if true, perform extra level optimisation
   int           count_down_;       // number of mb still to be processed
   int           count_down0_;      // starting counter value (for progress)
@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DECODER_ABI_VERSION 0x0208    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DECODER_ABI_VERSION 0x0209    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -458,8 +458,11 @@ struct WebPDecoderOptions {
   int dithering_strength;             // dithering strength (0=Off, 100=full)
   int flip;                           // flip output vertically
   int alpha_dithering_strength;       // alpha dithering strength in [0..100]
+  int num_threads;                    // if 'use_threads' is true, maximum number
+                                      // of threads, including the calling one
+                                      // (0=default, 1=no threading)
 
-  uint32_t pad[5];                    // padding for later use
+  uint32_t pad[4];                    // padding for later use
 };
 
 // Main object storing the configuration for advanced decoding.
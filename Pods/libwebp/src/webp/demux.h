@@ -64,6 +64,7 @@ extern "C" {
 typedef struct WebPDemuxer WebPDemuxer;
 typedef struct WebPIterator WebPIterator;
 typedef struct WebPChunkIterator WebPChunkIterator;
+typedef struct WebPCanvasInfo WebPCanvasInfo;
 typedef struct WebPAnimInfo WebPAnimInfo;
 typedef struct WebPAnimDecoderOptions WebPAnimDecoderOptions;
 
@@ -137,6 +138,28 @@ typedef enum WebPFormatFeature {
 WEBP_EXTERN uint32_t WebPDemuxGetI(
     const WebPDemuxer* dmux, WebPFormatFeature feature);
 
+//------------------------------------------------------------------------------
+// Canvas information without a demuxer.
+
+struct WebPCanvasInfo {
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+  uint32_t format_flags;   // equivalent to WEBP_FF_FORMAT_FLAGS.
+  uint32_t frame_count;    // equivalent to WEBP_FF_FRAME_COUNT.
+  uint32_t pad[4];         // padding for later use.
+};
+
+// Retrieves the canvas dimensions, feature flags and frame count of the
+// complete WebP file given by 'data' of 'data_size' bytes.
+// Only the VP8X/VP8/VP8L headers are parsed; for animations the ANMF chunks
+// are counted by hopping over the chunk sizes, without allocating memory or
+// validating the frames themselves. Use WebPDemux() when the frames are
+// needed.
+// Returns false if 'info' is NULL, if the data is truncated or if the headers
+// are invalid, true otherwise.
+WEBP_EXTERN int WebPGetCanvasInfo(const uint8_t* data, size_t data_size,
+                                  WebPCanvasInfo* info);
+
 //------------------------------------------------------------------------------
 // Frame iteration.
 
@@ -135,6 +135,9 @@ struct WebPConfig {
                           // JPEG compression. Generally, the output size will
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
+                          // Values above 1 also set the number of threads
+                          // coding the lossy macroblocks (method >= 3). The
+                          // output then differs slightly (about +/-0.1%).
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
 
   int near_lossless;      // Near lossless encoding [0 = max loss .. 100 = off
@@ -494,23 +494,18 @@ typedef struct {
 {
     WebpMetadata webpMetadata;
 
-    WebPData webPData = { 0 };
-    webPData.bytes = self.bytes;
-    webPData.size = self.length;
-    WebPDemuxer *demuxer = WebPDemux(&webPData);
-    if (!demuxer) {
+    WebPCanvasInfo canvasInfo;
+    if (!WebPGetCanvasInfo(self.bytes, self.length, &canvasInfo)) {
         webpMetadata.isValid = NO;
         return webpMetadata;
     }
 
-    webpMetadata.canvasWidth = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_WIDTH);
-    webpMetadata.canvasHeight = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_HEIGHT);
-    webpMetadata.frameCount = WebPDemuxGetI(demuxer, WEBP_FF_FRAME_COUNT);
+    webpMetadata.canvasWidth = canvasInfo.canvas_width;
+    webpMetadata.canvasHeight = canvasInfo.canvas_height;
+    webpMetadata.frameCount = canvasInfo.frame_count;
     webpMetadata.isValid
         = (webpMetadata.canvasWidth > 0 && webpMetadata.canvasHeight > 0 && webpMetadata.frameCount > 0);
 
-    WebPDemuxDelete(demuxer);
-
     return webpMetadata;
 }
 
@@ -41,4 +41,38 @@ class NSDataImageTests: SSKBaseTestSwift {
             XCTAssertNil(isApng)
         }
     }
+
+    // A 3x2 lossless still.
+    private let webpStillBase64 = "UklGRi4AAABXRUJQVlA4TCIAAAAvAkAAAC8gEEjyJ9triUEZhfnPLENN2wZsqPMvp0b0P6YX"
+
+    // A 3x2 lossless animation with three frames.
+    private let webpAnimationBase64 = "UklGRuIAAABXRUJQVlA4WAoAAAACAAAAAgAAAQAAQU5JTQYAAAD/////AABBTk1GMgAAAAAAAAAAAAIAAAEAAGQAAAJWUDhMGgAAAC8CQAAALzAeEfMfVgU1bRuwoc6/nBrR/5heQU5NRjoAAAAAAAAAAAACAAABAABkAAAAVlA4TCEAAAAvAkAAAC8gEEgi2d9ziYGK+U/HUNO2ARvq/MupEf2P6QUAQU5NRjoAAAAAAAAAAAACAAABAABkAAAAVlA4TCEAAAAvAkAAAC8gEEgi2d9ziQGN+U/HUNO2ARvq/MupEf2P6QUA"
+
+    func testImageMetadata_webpStill() {
+        let data = Data(base64Encoded: webpStillBase64)! as NSData
+        XCTAssertTrue(data.isMaybeWebpData)
+        let imageMetadata = data.imageMetadata(withPath: nil, mimeType: OWSMimeTypeImageWebp)
+        XCTAssertTrue(imageMetadata.isValid)
+        XCTAssertEqual(imageMetadata.imageFormat, .webp)
+        XCTAssertEqual(imageMetadata.pixelSize, CGSize(width: 3, height: 2))
+        XCTAssertFalse(imageMetadata.isAnimated)
+    }
+
+    func testImageMetadata_webpAnimation() {
+        let data = Data(base64Encoded: webpAnimationBase64)! as NSData
+        XCTAssertTrue(data.isMaybeWebpData)
+        let imageMetadata = data.imageMetadata(withPath: nil, mimeType: OWSMimeTypeImageWebp)
+        XCTAssertEqual(imageMetadata.isValid, FeatureFlags.supportAnimatedStickers_AnimatedWebp)
+        if imageMetadata.isValid {
+            XCTAssertEqual(imageMetadata.pixelSize, CGSize(width: 3, height: 2))
+            XCTAssertTrue(imageMetadata.isAnimated)
+        }
+    }
+
+    func testImageMetadata_webpTruncated() {
+        let data = Data(base64Encoded: webpAnimationBase64)!
+        let truncated = data.prefix(data.count - 5) as NSData
+        XCTAssertTrue(truncated.isMaybeWebpData)
+        XCTAssertFalse(truncated.imageMetadata(withPath: nil, mimeType: OWSMimeTypeImageWebp).isValid)
+    }
 }